@@ -53,14 +53,21 @@
  * and output directory can be overridden with the `UCODE_DEBUG_MEMDUMP_SIGNAL`
  * and `UCODE_DEBUG_MEMDUMP_PATH` environment variables respectively.
  *
+ * When the `UCODE_DEBUG_ALLOCSITES` environment variable is set to `1`,
+ * allocation site tracking is enabled as soon as the module is loaded and a
+ * report of the values still alive per allocation site is written to stderr
+ * when the VM terminates. See {@link module:debug#trackalloc|trackalloc()}.
+ *
  * @module debug
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <assert.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 
 #ifdef HAVE_ULOOP
 #include <libubox/uloop.h>
@@ -550,6 +557,358 @@ print_memdump(uc_vm_t *vm, FILE *out)
 	lh_table_free(ctx.seen);
 }
 
+/* Allocation site tracking: a side table maps the address of each value
+ * allocated while tracking is active to the site which allocated it, that is
+ * the innermost ucode function along with its instruction offset and the C
+ * function called from there, if any. */
+
+typedef struct {
+	uc_function_t *function;
+	uc_cfunction_t *cfunction;
+	size_t off;
+	char *label;
+	size_t count;
+	size_t bytes;
+	size_t allocated;
+} alloc_site_t;
+
+uc_declare_vector(alloc_sites_t, alloc_site_t);
+
+typedef struct {
+	uintptr_t key;
+	uint32_t site;
+	uint32_t size;
+} alloc_slot_t;
+
+static struct {
+	uc_vm_t *vm;
+	pthread_t thread;
+	bool report;
+	alloc_slot_t *slots;
+	size_t mask, count;
+	alloc_sites_t sites;
+	uint32_t *siteidx;
+	size_t sitemask;
+} alloc_track;
+
+static inline size_t
+alloc_hash(uintptr_t key)
+{
+	return (size_t)(((uint64_t)key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+static char *
+alloc_site_label(uc_function_t *function, size_t off, uc_cfunction_t *cfunction)
+{
+	const char *fname;
+	size_t line;
+	char *s;
+
+	if (!function) {
+		xasprintf(&s, "[C function \"%s\"]",
+			cfunction ? cfunction->name : "");
+
+		return s;
+	}
+
+	fname = function->name[0] ? function->name : "[anonymous function]";
+	line = insnoff_to_srcpos(function, &off);
+
+	if (cfunction)
+		xasprintf(&s, "%s() in %s @ %s:%zu:%zu", cfunction->name, fname,
+			uc_program_function_source(function)->filename, line, off);
+	else
+		xasprintf(&s, "%s @ %s:%zu:%zu", fname,
+			uc_program_function_source(function)->filename, line, off);
+
+	return s;
+}
+
+static uint32_t
+alloc_site_current(uc_vm_t *vm)
+{
+	uc_cfunction_t *cfunction = NULL;
+	uc_function_t *function = NULL;
+	uc_callframe_t *frame;
+	uint32_t *idx, *old;
+	size_t i, off = 0, h;
+	alloc_site_t *site;
+
+	for (i = vm->callframes.count; i > 0; i--) {
+		frame = &vm->callframes.entries[i - 1];
+
+		if (frame->closure) {
+			function = frame->closure->function;
+			off = frame->ip - function->chunk.entries;
+			break;
+		}
+
+		if (!cfunction)
+			cfunction = frame->cfunction;
+	}
+
+	h = alloc_hash((uintptr_t)function ^ ((uintptr_t)cfunction << 1) ^ (off * 31));
+
+	for (i = h & alloc_track.sitemask; alloc_track.siteidx[i]; i = (i + 1) & alloc_track.sitemask) {
+		site = &alloc_track.sites.entries[alloc_track.siteidx[i] - 1];
+
+		if (site->function == function && site->cfunction == cfunction && site->off == off)
+			return alloc_track.siteidx[i] - 1;
+	}
+
+	uc_vector_push(&alloc_track.sites, {
+		.function = function,
+		.cfunction = cfunction,
+		.off = off,
+		.label = alloc_site_label(function, off, cfunction)
+	});
+
+	alloc_track.siteidx[i] = alloc_track.sites.count;
+
+	/* keep the site index at most half full */
+	if (alloc_track.sites.count * 2 > alloc_track.sitemask) {
+		old = alloc_track.siteidx;
+		alloc_track.sitemask = alloc_track.sitemask * 2 + 1;
+		alloc_track.siteidx = xalloc(sizeof(uint32_t) * (alloc_track.sitemask + 1));
+
+		for (i = 0; i < alloc_track.sites.count; i++) {
+			site = &alloc_track.sites.entries[i];
+			h = alloc_hash((uintptr_t)site->function ^
+				((uintptr_t)site->cfunction << 1) ^ (site->off * 31));
+
+			for (idx = &alloc_track.siteidx[h & alloc_track.sitemask];
+			     *idx;
+			     idx = &alloc_track.siteidx[(idx - alloc_track.siteidx + 1) & alloc_track.sitemask])
+				;
+
+			*idx = i + 1;
+		}
+
+		free(old);
+	}
+
+	return alloc_track.sites.count - 1;
+}
+
+static alloc_slot_t *
+alloc_slot_find(uintptr_t key)
+{
+	size_t i;
+
+	if (!alloc_track.slots)
+		return NULL;
+
+	for (i = alloc_hash(key) & alloc_track.mask;
+	     alloc_track.slots[i].key;
+	     i = (i + 1) & alloc_track.mask)
+		if (alloc_track.slots[i].key == key)
+			return &alloc_track.slots[i];
+
+	return NULL;
+}
+
+static void
+alloc_slot_put(alloc_slot_t *slots, size_t mask, alloc_slot_t *slot)
+{
+	size_t i;
+
+	for (i = alloc_hash(slot->key) & mask; slots[i].key; i = (i + 1) & mask)
+		;
+
+	slots[i] = *slot;
+}
+
+static void
+alloc_slot_remove(alloc_slot_t *slot)
+{
+	size_t i = slot - alloc_track.slots, j = i, k;
+
+	/* backward shift deletion keeps probe sequences intact */
+	while (true) {
+		j = (j + 1) & alloc_track.mask;
+
+		if (!alloc_track.slots[j].key)
+			break;
+
+		k = alloc_hash(alloc_track.slots[j].key) & alloc_track.mask;
+
+		if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+			alloc_track.slots[i] = alloc_track.slots[j];
+			i = j;
+		}
+	}
+
+	alloc_track.slots[i].key = 0;
+	alloc_track.count--;
+}
+
+/* The tracker is notified by every thread, VMs running in other threads
+ * must not touch the unsynchronized tables. Releases made by the host on
+ * the tracking thread are still recorded. */
+static bool
+alloc_track_thread(void)
+{
+	return pthread_equal(pthread_self(), alloc_track.thread);
+}
+
+static void
+alloc_track_free(uc_value_t *uv, void *ctx)
+{
+	alloc_slot_t *slot;
+	alloc_site_t *site;
+
+	if (!alloc_track_thread())
+		return;
+
+	slot = alloc_slot_find((uintptr_t)uv);
+
+	if (!slot)
+		return;
+
+	site = &alloc_track.sites.entries[slot->site];
+	site->count--;
+	site->bytes -= slot->size;
+
+	alloc_slot_remove(slot);
+}
+
+static void
+alloc_track_alloc(uc_value_t *uv, size_t size, void *ctx)
+{
+	alloc_slot_t slot = { .key = (uintptr_t)uv }, *old;
+	alloc_site_t *site;
+	size_t i;
+
+	/* only values created while the tracked VM runs have a site */
+	if (!alloc_track_thread() || alloc_track.vm->callframes.count == 0)
+		return;
+
+	/* a stale entry means the value was released without notification */
+	alloc_track_free(uv, ctx);
+
+	if ((alloc_track.count + 1) * 2 > alloc_track.mask) {
+		old = alloc_track.slots;
+		alloc_track.slots = xalloc(sizeof(alloc_slot_t) * (alloc_track.mask + 1) * 2);
+
+		for (i = 0; i <= alloc_track.mask; i++)
+			if (old[i].key)
+				alloc_slot_put(alloc_track.slots, alloc_track.mask * 2 + 1, &old[i]);
+
+		alloc_track.mask = alloc_track.mask * 2 + 1;
+		free(old);
+	}
+
+	slot.site = alloc_site_current(alloc_track.vm);
+	slot.size = (size > UINT32_MAX) ? UINT32_MAX : size;
+
+	alloc_slot_put(alloc_track.slots, alloc_track.mask, &slot);
+	alloc_track.count++;
+
+	site = &alloc_track.sites.entries[slot.site];
+	site->count++;
+	site->bytes += slot.size;
+	site->allocated++;
+}
+
+static int
+alloc_site_cmp(const void *a, const void *b)
+{
+	const alloc_site_t *sa = *(alloc_site_t * const *)a;
+	const alloc_site_t *sb = *(alloc_site_t * const *)b;
+
+	return (sb->bytes > sa->bytes) - (sb->bytes < sa->bytes);
+}
+
+static alloc_site_t **
+alloc_sites_sorted(void)
+{
+	alloc_site_t **sorted;
+	size_t i;
+
+	sorted = xalloc(sizeof(*sorted) * (alloc_track.sites.count + 1));
+
+	for (i = 0; i < alloc_track.sites.count; i++)
+		sorted[i] = &alloc_track.sites.entries[i];
+
+	qsort(sorted, alloc_track.sites.count, sizeof(*sorted), alloc_site_cmp);
+
+	return sorted;
+}
+
+static void
+print_allocsites(FILE *out)
+{
+	alloc_site_t **sorted = alloc_sites_sorted();
+	size_t i;
+
+	fprintf(out, "ALLOCATION SITES\n");
+
+	for (i = 0; i < alloc_track.sites.count && sorted[i]->count; i++)
+		fprintf(out, "[%zu] %zu bytes in %zu values (%zu allocated) @ %s\n",
+			i, sorted[i]->bytes, sorted[i]->count, sorted[i]->allocated,
+			sorted[i]->label);
+
+	fprintf(out, "---\n\n");
+
+	free(sorted);
+}
+
+static void alloc_track_stop(void);
+
+static void
+alloc_track_teardown(uc_vm_t *vm, void *ctx)
+{
+	if (vm != alloc_track.vm)
+		return;
+
+	if (alloc_track.report)
+		print_allocsites(stderr);
+
+	alloc_track_stop();
+}
+
+static const uc_value_tracker_t alloc_tracker = {
+	.alloc = alloc_track_alloc,
+	.free = alloc_track_free,
+	.teardown = alloc_track_teardown
+};
+
+static bool
+alloc_track_start(uc_vm_t *vm, bool report)
+{
+	if (alloc_track.vm)
+		return (alloc_track.vm == vm);
+
+	alloc_track.vm = vm;
+	alloc_track.thread = pthread_self();
+	alloc_track.report = report;
+	alloc_track.mask = 1023;
+	alloc_track.slots = xalloc(sizeof(alloc_slot_t) * (alloc_track.mask + 1));
+	alloc_track.sitemask = 255;
+	alloc_track.siteidx = xalloc(sizeof(uint32_t) * (alloc_track.sitemask + 1));
+
+	ucv_tracker_set(&alloc_tracker);
+
+	return true;
+}
+
+static void
+alloc_track_stop(void)
+{
+	size_t i;
+
+	ucv_tracker_set(NULL);
+
+	for (i = 0; i < alloc_track.sites.count; i++)
+		free(alloc_track.sites.entries[i].label);
+
+	uc_vector_clear(&alloc_track.sites);
+	free(alloc_track.slots);
+	free(alloc_track.siteidx);
+
+	memset(&alloc_track, 0, sizeof(alloc_track));
+}
+
 static uc_value_t *
 debug_handle_memdump(uc_vm_t *vm, size_t nargs)
 {
@@ -644,6 +1003,11 @@ debug_setup(uc_vm_t *vm)
 
 	if (!ev || !strcmp(ev, "1") || !strcmp(ev, "yes") || !strcmp(ev, "true"))
 		debug_setup_memdump(vm);
+
+	ev = getenv("UCODE_DEBUG_ALLOCSITES");
+
+	if (ev && (!strcmp(ev, "1") || !strcmp(ev, "yes") || !strcmp(ev, "true")))
+		alloc_track_start(vm, true);
 }
 
 
@@ -693,96 +1057,1143 @@ uc_memdump(uc_vm_t *vm, size_t nargs)
 	return ucv_boolean_new(true);
 }
 
-/**
- * Capture call stack trace.
- *
- * This function captures the current call stack and returns it. The optional
- * level parameter controls how many calls up the trace should start. It
- * defaults to `1`, that is the function calling this `traceback()` function.
- *
- * Returns an array of stack trace entries describing the function invocations
- * up to the point where `traceback()` is called.
- *
- * @function module:debug#traceback
- *
- * @param {number} [level=1]
- * The number of callframes up the call trace should start, `0` is this function
- * itself, `1` the function calling it and so on.
- *
- * @return {module:debug.StackTraceEntry[]}
- */
+/* Heap snapshots: nodes are the heap allocated values reachable from the VM
+ * roots plus any values still pending collection, node 0 is a virtual root
+ * referring to all of them. */
 
-/**
- * @typedef {Object} module:debug.StackTraceEntry
- *
- * @property {function} callee
- * The function that was called.
- *
- * @property {*} this
- * The `this` context the function was called with.
- *
- * @property {boolean} mcall
- * Indicates whether the function was invoked as a method.
- *
- * @property {boolean} [strict]
- * Indicates whether the VM was running in strict mode when the function was
- * called (only applicable to non-C, pure ucode calls).
- *
- * @property {string} [filename]
- * The name of the source file that called the function (only applicable to
- * non-C, pure ucode calls).
- *
- * @property {number} [line]
- * The source line of the function call (only applicable to non-C, pure ucode
- * calls).
- *
- * @property {number} [byte]
- * The source line offset of the function call (only applicable to non-C, pure
- * ucode calls).
- *
- * @property {string} [context]
- * The surrounding source code context formatted as human-readable string,
- * useful for generating debug messages (only applicable to non-C, pure ucode
- * calls).
- */
+typedef struct {
+	uc_value_t *uv;
+	char *root;
+	size_t size;
+	size_t edges;
+	size_t nedges;
+	size_t idom;
+	size_t order;
+	size_t retained;
+} heap_node_t;
+
+uc_declare_vector(heap_nodes_t, heap_node_t);
+uc_declare_vector(heap_edges_t, size_t);
+
+typedef struct {
+	heap_nodes_t nodes;
+	heap_edges_t edges;
+	heap_edges_t roots;
+	struct lh_table *index;
+	struct lh_table *exclude;
+	uc_value_t *tag;
+} heap_snapshot_t;
+
+static bool
+heap_is_node(uc_value_t *uv)
+{
+	if (((uintptr_t)uv & 3) != 0 || uv == NULL)
+		return false;
 
+	switch (ucv_type(uv)) {
+	case UC_NULL:
+	case UC_BOOLEAN:
+	case UC_INTEGER:
+	case UC_DOUBLE:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+/* Snapshot results carry a per-VM prototype object as tag, they and the
+ * values only reachable through them are left out of later snapshots. */
 static uc_value_t *
-uc_traceback(uc_vm_t *vm, size_t nargs)
+heap_snapshot_tag(uc_vm_t *vm)
 {
-	uc_value_t *stacktrace, *entry, *level = uc_fn_arg(0);
-	uc_function_t *function;
-	uc_stringbuf_t *context;
-	uc_callframe_t *frame;
-	uc_source_t *source;
-	size_t off, srcpos;
-	size_t i, lv;
+	uc_value_t *tag = uc_vm_registry_get(vm, "debug.heapsnapshot");
 
-	lv = level ? ucv_uint64_get(level) : 1;
+	if (!tag) {
+		tag = ucv_object_new(vm);
+		uc_vm_registry_set(vm, "debug.heapsnapshot", tag);
+	}
 
-	if (level && errno)
-		return NULL;
+	return tag;
+}
 
-	stacktrace = ucv_array_new(vm);
+static bool
+heap_is_snapshot(heap_snapshot_t *h, uc_value_t *uv)
+{
+	return (ucv_type(uv) == UC_OBJECT && ucv_prototype_get(uv) == h->tag);
+}
 
-	for (i = (lv < vm->callframes.count) ? vm->callframes.count - lv : 0;
-	     i > 0;
-	     i--) {
+static void
+heap_exclude(heap_snapshot_t *h, uc_value_t *uv)
+{
+	uc_object_t *object;
+	uc_array_t *array;
+	struct lh_entry *entry;
+	size_t i;
 
-		frame = &vm->callframes.entries[i - 1];
-		entry = ucv_object_new(vm);
+	if (!heap_is_node(uv) || uv == h->tag ||
+	    lh_table_lookup_entry(h->index, uv) ||
+	    lh_table_lookup_entry(h->exclude, uv))
+		return;
 
-		if (frame->closure) {
-			function = frame->closure->function;
-			source = uc_program_function_source(function);
+	lh_table_insert(h->exclude, uv, NULL);
 
-			off = (frame->ip - function->chunk.entries) - 1;
-			srcpos = uc_program_function_srcpos(function, off);
+	switch (ucv_type(uv)) {
+	case UC_ARRAY:
+		array = (uc_array_t *)uv;
 
-			context = ucv_stringbuf_new();
+		for (i = 0; i < array->count; i++)
+			heap_exclude(h, array->entries[i]);
 
-			uc_source_context_format(context,
-				uc_program_function_source(function),
-				srcpos, false);
+		break;
+
+	case UC_OBJECT:
+		object = (uc_object_t *)uv;
+
+		lh_foreach(object->table, entry)
+			heap_exclude(h, (uc_value_t *)lh_entry_v(entry));
+
+		break;
+
+	default:
+		break;
+	}
+}
+
+static size_t
+heap_value_size(uc_value_t *uv)
+{
+	uc_resource_ext_t *res;
+	struct lh_entry *entry;
+	uc_object_t *object;
+	size_t size;
+
+	switch (ucv_type(uv)) {
+	case UC_STRING:
+		return sizeof(uc_string_t) + ((uc_string_t *)uv)->length + 1;
+
+	case UC_ARRAY:
+		return sizeof(uc_array_t) +
+			((uc_array_t *)uv)->count * sizeof(uc_value_t *);
+
+	case UC_OBJECT:
+		object = (uc_object_t *)uv;
+		size = sizeof(uc_object_t) + sizeof(struct lh_table) +
+			object->table->size * sizeof(struct lh_entry);
+
+		lh_foreach(object->table, entry)
+			size += strlen(lh_entry_k(entry)) + 1;
+
+		return size;
+
+	case UC_CLOSURE:
+		return sizeof(uc_closure_t) +
+			((uc_closure_t *)uv)->function->nupvals * sizeof(uc_upvalref_t *);
+
+	case UC_UPVALUE:
+		return sizeof(uc_upvalref_t);
+
+	case UC_CFUNCTION:
+		return sizeof(uc_cfunction_t) + strlen(((uc_cfunction_t *)uv)->name) + 1;
+
+	case UC_REGEXP:
+		return sizeof(uc_regexp_t) + strlen(((uc_regexp_t *)uv)->source) + 1;
+
+	case UC_RESOURCE:
+		if (!uv->ext_flag)
+			return sizeof(uc_resource_t);
+
+		res = (uc_resource_ext_t *)uv;
+
+		return sizeof(uc_resource_ext_t) +
+			res->uvcount * sizeof(uc_value_t *) + res->datasize * 8;
+
+	case UC_PROGRAM:
+		return sizeof(uc_program_t);
+
+	case UC_SOURCE:
+		return sizeof(uc_source_t);
+
+	default:
+		return sizeof(uc_value_t);
+	}
+}
+
+static size_t
+heap_node_get(heap_snapshot_t *h, uc_value_t *uv)
+{
+	unsigned long hash = lh_get_hash(h->index, uv);
+	struct lh_entry *e = lh_table_lookup_entry_w_hash(h->index, uv, hash);
+
+	if (e)
+		return (uintptr_t)lh_entry_v(e) - 1;
+
+	uc_vector_push(&h->nodes, {
+		.uv = uv,
+		.size = heap_value_size(uv),
+		.idom = SIZE_MAX,
+		.order = SIZE_MAX
+	});
+
+	lh_table_insert_w_hash(h->index, uv,
+		(void *)(uintptr_t)h->nodes.count, hash, 0);
+
+	return h->nodes.count - 1;
+}
+
+static void
+heap_add_edge(heap_snapshot_t *h, uc_value_t *uv)
+{
+	if (heap_is_node(uv) && !heap_is_snapshot(h, uv))
+		uc_vector_push(&h->edges, heap_node_get(h, uv));
+}
+
+static void
+heap_add_root(heap_snapshot_t *h, uc_value_t *uv, const char *fmt, ...)
+{
+	heap_node_t *node;
+	va_list ap;
+	size_t idx;
+
+	if (!heap_is_node(uv) || heap_is_snapshot(h, uv))
+		return;
+
+	idx = heap_node_get(h, uv);
+	uc_vector_push(&h->roots, idx);
+
+	node = &h->nodes.entries[idx];
+
+	if (!node->root) {
+		va_start(ap, fmt);
+		xvasprintf(&node->root, fmt, ap);
+		va_end(ap);
+	}
+}
+
+static void
+heap_scan_node(heap_snapshot_t *h, size_t idx)
+{
+	uc_value_t *uv = h->nodes.entries[idx].uv;
+	uc_resource_type_t *restype;
+	uc_program_t *program;
+	uc_closure_t *closure;
+	struct lh_entry *entry;
+	uc_object_t *object;
+	uc_array_t *array;
+	size_t i, start;
+
+	start = h->edges.count;
+
+	switch (ucv_type(uv)) {
+	case UC_ARRAY:
+		array = (uc_array_t *)uv;
+
+		heap_add_edge(h, array->proto);
+
+		for (i = 0; i < array->count; i++)
+			heap_add_edge(h, array->entries[i]);
+
+		break;
+
+	case UC_OBJECT:
+		object = (uc_object_t *)uv;
+
+		heap_add_edge(h, object->proto);
+
+		lh_foreach(object->table, entry)
+			heap_add_edge(h, (uc_value_t *)lh_entry_v(entry));
+
+		break;
+
+	case UC_CLOSURE:
+		closure = (uc_closure_t *)uv;
+
+		for (i = 0; i < closure->function->nupvals; i++)
+			heap_add_edge(h, &closure->upvals[i]->header);
+
+		heap_add_edge(h, &closure->function->program->header);
+
+		break;
+
+	case UC_UPVALUE:
+		heap_add_edge(h, ((uc_upvalref_t *)uv)->value);
+		break;
+
+	case UC_RESOURCE:
+		restype = ucv_resource_type(uv);
+
+		if (restype)
+			heap_add_edge(h, restype->proto);
+
+		if (uv->ext_flag)
+			for (i = 0; i < ((uc_resource_ext_t *)uv)->uvcount; i++)
+				heap_add_edge(h, ucv_resource_value_get(uv, i));
+
+		break;
+
+	case UC_PROGRAM:
+		program = (uc_program_t *)uv;
+
+		for (i = 0; i < program->sources.count; i++)
+			heap_add_edge(h, &program->sources.entries[i]->header);
+
+		for (i = 0; i < program->exports.count; i++)
+			heap_add_edge(h, &program->exports.entries[i]->header);
+
+		break;
+
+	default:
+		break;
+	}
+
+	h->nodes.entries[idx].edges = start;
+	h->nodes.entries[idx].nedges = h->edges.count - start;
+}
+
+static size_t
+heap_intersect(heap_node_t *nodes, size_t a, size_t b)
+{
+	while (a != b) {
+		while (nodes[a].order > nodes[b].order)
+			a = nodes[a].idom;
+
+		while (nodes[b].order > nodes[a].order)
+			b = nodes[b].idom;
+	}
+
+	return a;
+}
+
+/* Compute immediate dominators using the iterative algorithm by Cooper,
+ * Harvey and Kennedy, then accumulate retained sizes bottom up. */
+static void
+heap_dominators(heap_snapshot_t *h)
+{
+	size_t n = h->nodes.count, i, j, k, e, p, pos, idom, *rpo, *npreds, *preds;
+	heap_node_t *nodes = h->nodes.entries;
+	struct { size_t node, edge; } *stack;
+	bool changed;
+
+	rpo = xalloc(sizeof(*rpo) * n);
+	stack = xalloc(sizeof(*stack) * n);
+	npreds = xalloc(sizeof(*npreds) * (n + 1));
+	preds = xalloc(sizeof(*preds) * (h->edges.count + 1));
+
+	/* iterative depth first search yielding the reverse postorder */
+	pos = n;
+	k = 0;
+	stack[k].node = 0;
+	stack[k++].edge = 0;
+	nodes[0].order = 0;
+
+	while (k > 0) {
+		i = stack[k - 1].node;
+
+		if (stack[k - 1].edge < nodes[i].nedges) {
+			j = h->edges.entries[nodes[i].edges + stack[k - 1].edge++];
+
+			if (nodes[j].order == SIZE_MAX) {
+				nodes[j].order = 0;
+				stack[k].node = j;
+				stack[k++].edge = 0;
+			}
+		}
+		else {
+			rpo[--pos] = i;
+			k--;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		nodes[rpo[i]].order = i;
+
+	/* predecessor lists in compressed row form */
+	for (i = 0; i < n; i++)
+		for (e = 0; e < nodes[i].nedges; e++)
+			npreds[h->edges.entries[nodes[i].edges + e] + 1]++;
+
+	for (i = 0; i < n; i++)
+		npreds[i + 1] += npreds[i];
+
+	for (i = 0; i < n; i++) {
+		for (e = 0; e < nodes[i].nedges; e++) {
+			j = h->edges.entries[nodes[i].edges + e];
+			preds[npreds[j]++] = i;
+		}
+	}
+
+	/* npreds[j] now points past the predecessors of j */
+	nodes[0].idom = 0;
+
+	do {
+		changed = false;
+
+		for (k = 1; k < n; k++) {
+			i = rpo[k];
+			idom = SIZE_MAX;
+
+			for (p = i ? npreds[i - 1] : 0; p < npreds[i]; p++) {
+				j = preds[p];
+
+				if (nodes[j].idom == SIZE_MAX)
+					continue;
+
+				idom = (idom == SIZE_MAX) ? j : heap_intersect(nodes, j, idom);
+			}
+
+			if (nodes[i].idom != idom) {
+				nodes[i].idom = idom;
+				changed = true;
+			}
+		}
+	} while (changed);
+
+	for (i = 0; i < n; i++)
+		nodes[i].retained = nodes[i].size;
+
+	for (k = n; k > 1; k--) {
+		i = rpo[k - 1];
+		nodes[nodes[i].idom].retained += nodes[i].retained;
+	}
+
+	free(preds);
+	free(npreds);
+	free(stack);
+	free(rpo);
+}
+
+static bool
+heap_snapshot_build(uc_vm_t *vm, heap_snapshot_t *h)
+{
+	uc_callframe_t *frame;
+	uc_weakref_t *ref;
+	uc_value_t *uv;
+	size_t i, e;
+
+	memset(h, 0, sizeof(*h));
+
+	h->tag = heap_snapshot_tag(vm);
+	h->index = lh_kptr_table_new(256, NULL);
+	h->exclude = lh_kptr_table_new(256, NULL);
+
+	if (!h->index || !h->exclude) {
+		if (h->index)
+			lh_table_free(h->index);
+
+		if (h->exclude)
+			lh_table_free(h->exclude);
+
+		return false;
+	}
+
+	/* virtual root */
+	uc_vector_push(&h->nodes, { .idom = SIZE_MAX, .order = SIZE_MAX });
+
+	for (i = 0; i < vm->stack.count; i++)
+		heap_add_root(h, vm->stack.entries[i], "stack[%zu]", i);
+
+	for (i = 0; i < vm->callframes.count; i++) {
+		frame = &vm->callframes.entries[i];
+
+		heap_add_root(h, frame->ctx, "callframe[%zu] this", i);
+		heap_add_root(h, &frame->closure->header, "callframe[%zu] closure", i);
+		heap_add_root(h, &frame->cfunction->header, "callframe[%zu] cfunction", i);
+	}
+
+	ucv_object_foreach(vm->globals, gk, gv)
+		heap_add_root(h, gv, "global %s", gk);
+
+	heap_add_root(h, vm->globals, "globals");
+
+	ucv_object_foreach(vm->registry, rk, rv)
+		heap_add_root(h, rv, "registry %s", rk);
+
+	heap_add_root(h, vm->registry, "registry");
+	heap_add_root(h, vm->exception.stacktrace, "exception");
+
+	for (i = 0; i < vm->restypes.count; i++)
+		heap_add_root(h, vm->restypes.entries[i]->proto,
+			"resource type %s", vm->restypes.entries[i]->name);
+
+	for (i = 1; i < h->nodes.count; i++)
+		heap_scan_node(h, i);
+
+	/* collect the contents of earlier snapshot results not referenced
+	 * otherwise, they would show up as garbage below */
+	for (ref = vm->values.next; ref != &vm->values; ref = ref->next) {
+		uv = (uc_value_t *)((uintptr_t)ref - offsetof(uc_array_t, ref));
+
+		if (heap_is_snapshot(h, uv))
+			heap_exclude(h, uv);
+	}
+
+	/* tracked values not found so far are garbage awaiting collection */
+	for (ref = vm->values.next; ref != &vm->values; ref = ref->next) {
+		uv = (uc_value_t *)((uintptr_t)ref - offsetof(uc_array_t, ref));
+
+		if (!lh_table_lookup_entry(h->index, uv) &&
+		    !lh_table_lookup_entry(h->exclude, uv))
+			heap_add_root(h, uv, "unreachable");
+	}
+
+	for (; i < h->nodes.count; i++)
+		heap_scan_node(h, i);
+
+	h->nodes.entries[0].edges = h->edges.count;
+	h->nodes.entries[0].nedges = h->roots.count;
+
+	for (e = 0; e < h->roots.count; e++)
+		uc_vector_push(&h->edges, h->roots.entries[e]);
+
+	heap_dominators(h);
+
+	return true;
+}
+
+static void
+heap_snapshot_free(heap_snapshot_t *h)
+{
+	size_t i;
+
+	for (i = 0; i < h->nodes.count; i++)
+		free(h->nodes.entries[i].root);
+
+	uc_vector_clear(&h->nodes);
+	uc_vector_clear(&h->edges);
+	uc_vector_clear(&h->roots);
+	lh_table_free(h->index);
+	lh_table_free(h->exclude);
+}
+
+static uc_value_t *
+heap_node_value(uc_vm_t *vm, heap_snapshot_t *h, size_t idx)
+{
+	heap_node_t *node = &h->nodes.entries[idx];
+	uc_resource_type_t *restype;
+	uc_value_t *rv, *refs;
+	alloc_slot_t *slot;
+	size_t e;
+
+	rv = ucv_object_new(vm);
+	refs = ucv_array_new_length(vm, node->nedges);
+
+	for (e = 0; e < node->nedges; e++)
+		ucv_array_push(refs, ucv_uint64_new(
+			(uintptr_t)h->nodes.entries[h->edges.entries[node->edges + e]].uv));
+
+	ucv_object_add(rv, "id", ucv_uint64_new((uintptr_t)node->uv));
+	ucv_object_add(rv, "type", ucv_string_new(ucv_typename(node->uv)));
+
+	if (ucv_type(node->uv) == UC_RESOURCE) {
+		restype = ucv_resource_type(node->uv);
+
+		if (restype)
+			ucv_object_add(rv, "class", ucv_string_new(restype->name));
+	}
+
+	ucv_object_add(rv, "size", ucv_uint64_new(node->size));
+	ucv_object_add(rv, "retained", ucv_uint64_new(node->retained));
+	ucv_object_add(rv, "dominator", node->idom
+		? ucv_uint64_new((uintptr_t)h->nodes.entries[node->idom].uv) : NULL);
+
+	if (node->root)
+		ucv_object_add(rv, "root", ucv_string_new(node->root));
+
+	slot = alloc_slot_find((uintptr_t)node->uv);
+
+	if (slot)
+		ucv_object_add(rv, "site",
+			ucv_string_new(alloc_track.sites.entries[slot->site].label));
+
+	ucv_object_add(rv, "refs", refs);
+
+	return rv;
+}
+
+/**
+ * Capture a machine readable heap snapshot.
+ *
+ * This function walks all heap allocated values reachable from the VM roots,
+ * that is the stack, callframes, globals, registry, pending exception and
+ * resource type prototypes, plus tracked values which are unreachable but not
+ * yet collected. For each value, its outgoing references, shallow size and
+ * retained size are recorded, along with its immediate dominator, the value
+ * through which all paths from the roots to it lead.
+ *
+ * Following the dominator chain of a large retained node up to a node having a
+ * `root` property points at the root keeping it alive.
+ *
+ * Node ids are memory addresses which may be reused by unrelated values after
+ * the original one has been freed.
+ *
+ * Snapshots returned as object are left out of subsequent snapshots, along
+ * with all values only reachable through them, so that comparing two
+ * snapshots does not report the earlier one as growth.
+ *
+ * If a file path or handle is given, the snapshot is written to it as JSON
+ * document and `true` is returned. Otherwise the snapshot is returned as
+ * object.
+ *
+ * Returns `null` if the file could not be opened or if the snapshot could not
+ * be created.
+ *
+ * @function module:debug#heapsnapshot
+ *
+ * @param {string|module:fs.file|module:fs.proc} [file]
+ * The file path or open file handle to write the snapshot to.
+ *
+ * @return {?(module:debug.HeapSnapshot|boolean)}
+ *
+ * @example
+ * const before = heapsnapshot();
+ * run_workload();
+ * const after = heapsnapshot();
+ *
+ * for (let group in heapdiff(before, after))
+ *   printf("%-20s +%d values, %+d bytes\n",
+ *     group.type, group.added, group.added_size - group.removed_size);
+ */
+
+/**
+ * @typedef {Object} module:debug.HeapSnapshot
+ *
+ * @property {module:debug.HeapNode[]} nodes
+ * The heap nodes.
+ *
+ * @property {number} size
+ * The sum of the shallow sizes of all nodes.
+ */
+
+/**
+ * @typedef {Object} module:debug.HeapNode
+ *
+ * @property {number} id
+ * The node id.
+ *
+ * @property {string} type
+ * The value type name.
+ *
+ * @property {string} [class]
+ * The resource type name (only applicable to resource values).
+ *
+ * @property {number} size
+ * The approximate number of bytes allocated for the value itself.
+ *
+ * @property {number} retained
+ * The approximate number of bytes which would be freed along with the value,
+ * that is the sum of the sizes of all nodes dominated by it.
+ *
+ * @property {?number} dominator
+ * The id of the immediate dominator or `null` if the node is only reachable
+ * through multiple roots or directly held by a root.
+ *
+ * @property {string} [root]
+ * A description of the root directly referring to this node.
+ *
+ * @property {string} [site]
+ * The allocation site of the value (only available if allocation tracking was
+ * enabled when the value was created).
+ *
+ * @property {number[]} refs
+ * The ids of the nodes referenced by this node.
+ */
+static uc_value_t *
+uc_heapsnapshot(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *file = uc_fn_arg(0), *rv = NULL, *nodes = NULL, *node;
+	heap_snapshot_t h;
+	size_t i, total;
+	FILE *fp = NULL;
+	char *s;
+
+	if (ucv_type(file) == UC_RESOURCE) {
+		fp = ucv_resource_data(file, "fs.file");
+
+		if (!fp)
+			fp = ucv_resource_data(file, "fs.proc");
+
+		if (!fp)
+			return NULL;
+	}
+	else if (ucv_type(file) == UC_STRING) {
+		fp = fopen(ucv_string_get(file), "w");
+
+		if (!fp)
+			return NULL;
+	}
+
+	if (!heap_snapshot_build(vm, &h)) {
+		if (fp && ucv_type(file) == UC_STRING)
+			fclose(fp);
+
+		return NULL;
+	}
+
+	if (fp)
+		fprintf(fp, "{ \"nodes\": [\n");
+	else
+		nodes = ucv_array_new_length(vm, h.nodes.count - 1);
+
+	for (i = 1, total = 0; i < h.nodes.count; i++) {
+		node = heap_node_value(vm, &h, i);
+		total += h.nodes.entries[i].size;
+
+		if (fp) {
+			s = ucv_to_jsonstring(NULL, node);
+			fprintf(fp, "%s%s\n", s, (i + 1 < h.nodes.count) ? "," : "");
+			free(s);
+			ucv_put(node);
+		}
+		else {
+			ucv_array_push(nodes, node);
+		}
+	}
+
+	if (fp) {
+		fprintf(fp, "], \"size\": %zu }\n", total);
+
+		if (ucv_type(file) == UC_STRING)
+			fclose(fp);
+		else
+			fflush(fp);
+
+		rv = ucv_boolean_new(true);
+	}
+	else {
+		rv = ucv_object_new(vm);
+		ucv_object_add(rv, "nodes", nodes);
+		ucv_object_add(rv, "size", ucv_uint64_new(total));
+		ucv_prototype_set(rv, ucv_get(h.tag));
+	}
+
+	heap_snapshot_free(&h);
+
+	return rv;
+}
+
+static void
+heap_diff_account(uc_vm_t *vm, uc_value_t *groups, uc_value_t *node, bool added)
+{
+	uc_value_t *type = ucv_object_get(node, "type", NULL);
+	uc_value_t *class = ucv_object_get(node, "class", NULL);
+	uc_value_t *site = ucv_object_get(node, "site", NULL);
+	uint64_t size = ucv_to_unsigned(ucv_object_get(node, "size", NULL));
+	const char *field = added ? "added" : "removed";
+	char *key, *ts, *cs, *ss, sizefield[sizeof("removed_size")];
+	uc_value_t *group, *cnt;
+
+	ts = ucv_to_string(NULL, type);
+	cs = ucv_to_string(NULL, class);
+	ss = ucv_to_string(NULL, site);
+
+	xasprintf(&key, "%s\x1f%s\x1f%s", ts, cs, ss);
+
+	free(ts);
+	free(cs);
+	free(ss);
+
+	group = ucv_object_get(groups, key, NULL);
+
+	if (!group) {
+		group = ucv_object_new(vm);
+
+		ucv_object_add(group, "type", ucv_get(type));
+
+		if (class)
+			ucv_object_add(group, "class", ucv_get(class));
+
+		if (site)
+			ucv_object_add(group, "site", ucv_get(site));
+
+		ucv_object_add(group, "added", ucv_uint64_new(0));
+		ucv_object_add(group, "added_size", ucv_uint64_new(0));
+		ucv_object_add(group, "removed", ucv_uint64_new(0));
+		ucv_object_add(group, "removed_size", ucv_uint64_new(0));
+
+		ucv_object_add(groups, key, group);
+	}
+
+	free(key);
+
+	snprintf(sizefield, sizeof(sizefield), "%s_size", field);
+
+	cnt = ucv_object_get(group, field, NULL);
+	ucv_object_add(group, field, ucv_uint64_new(ucv_uint64_get(cnt) + 1));
+
+	cnt = ucv_object_get(group, sizefield, NULL);
+	ucv_object_add(group, sizefield, ucv_uint64_new(ucv_uint64_get(cnt) + size));
+}
+
+static struct lh_table *
+heap_diff_index(uc_value_t *nodes)
+{
+	struct lh_table *index = lh_kptr_table_new(256, NULL);
+	uc_value_t *node;
+	size_t i;
+
+	for (i = 0; index && i < ucv_array_length(nodes); i++) {
+		node = ucv_array_get(nodes, i);
+
+		lh_table_insert(index,
+			(void *)(uintptr_t)ucv_to_unsigned(ucv_object_get(node, "id", NULL)),
+			node);
+	}
+
+	return index;
+}
+
+static bool
+heap_diff_present(struct lh_table *index, uc_value_t *node)
+{
+	uc_value_t *id = ucv_object_get(node, "id", NULL);
+	uc_value_t *other = NULL, *t1, *t2;
+
+	if (!lh_table_lookup_ex(index, (void *)(uintptr_t)ucv_to_unsigned(id),
+	                        (void **)&other))
+		return false;
+
+	/* an address reused by a value of different type is a new value */
+	t1 = ucv_object_get(node, "type", NULL);
+	t2 = ucv_object_get(other, "type", NULL);
+
+	return ucv_is_equal(t1, t2);
+}
+
+static int
+heap_diff_cmp(const void *a, const void *b)
+{
+	uc_value_t *ga = *(uc_value_t **)a, *gb = *(uc_value_t **)b;
+	int64_t da, db;
+
+	da = ucv_to_integer(ucv_object_get(ga, "added_size", NULL)) -
+		ucv_to_integer(ucv_object_get(ga, "removed_size", NULL));
+
+	db = ucv_to_integer(ucv_object_get(gb, "added_size", NULL)) -
+		ucv_to_integer(ucv_object_get(gb, "removed_size", NULL));
+
+	return (db > da) - (db < da);
+}
+
+/**
+ * Compare two heap snapshots.
+ *
+ * Determines the values present in the `after` snapshot but not in the
+ * `before` one and vice versa, and aggregates them by value type, resource
+ * type and, if allocation site tracking was enabled, allocation site.
+ *
+ * Returns an array of groups, ordered by their net size growth with the
+ * largest growth first.
+ *
+ * Returns `null` if either argument is not a heap snapshot.
+ *
+ * @function module:debug#heapdiff
+ *
+ * @param {module:debug.HeapSnapshot} before
+ * The earlier snapshot.
+ *
+ * @param {module:debug.HeapSnapshot} after
+ * The later snapshot.
+ *
+ * @return {?module:debug.HeapDiffGroup[]}
+ */
+
+/**
+ * @typedef {Object} module:debug.HeapDiffGroup
+ *
+ * @property {string} type
+ * The value type name.
+ *
+ * @property {string} [class]
+ * The resource type name.
+ *
+ * @property {string} [site]
+ * The allocation site.
+ *
+ * @property {number} added
+ * The number of new values.
+ *
+ * @property {number} added_size
+ * The total shallow size of new values.
+ *
+ * @property {number} removed
+ * The number of values no longer present.
+ *
+ * @property {number} removed_size
+ * The total shallow size of values no longer present.
+ */
+static uc_value_t *
+uc_heapdiff(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *before = ucv_object_get(uc_fn_arg(0), "nodes", NULL);
+	uc_value_t *after = ucv_object_get(uc_fn_arg(1), "nodes", NULL);
+	struct lh_table *bidx, *aidx;
+	uc_value_t *groups, *rv, *node;
+	size_t i;
+
+	if (ucv_type(before) != UC_ARRAY || ucv_type(after) != UC_ARRAY)
+		return NULL;
+
+	bidx = heap_diff_index(before);
+	aidx = heap_diff_index(after);
+
+	if (!bidx || !aidx) {
+		if (bidx)
+			lh_table_free(bidx);
+
+		if (aidx)
+			lh_table_free(aidx);
+
+		return NULL;
+	}
+
+	groups = ucv_object_new(vm);
+
+	for (i = 0; i < ucv_array_length(after); i++) {
+		node = ucv_array_get(after, i);
+
+		if (!heap_diff_present(bidx, node))
+			heap_diff_account(vm, groups, node, true);
+	}
+
+	for (i = 0; i < ucv_array_length(before); i++) {
+		node = ucv_array_get(before, i);
+
+		if (!heap_diff_present(aidx, node))
+			heap_diff_account(vm, groups, node, false);
+	}
+
+	lh_table_free(bidx);
+	lh_table_free(aidx);
+
+	rv = ucv_array_new_length(vm, ucv_object_length(groups));
+
+	ucv_object_foreach(groups, gk, gv) {
+		(void)gk;
+		ucv_array_push(rv, ucv_get(gv));
+	}
+
+	ucv_put(groups);
+	ucv_array_sort(rv, heap_diff_cmp);
+
+	return rv;
+}
+
+/**
+ * Enable or disable allocation site tracking.
+ *
+ * While tracking is enabled, each value allocated by the VM is associated
+ * with the site allocating it, that is the innermost ucode function along with
+ * the source position being executed and the C function called from there, if
+ * any. Sites are kept in a side table outside of the values themselves.
+ *
+ * The number and size of values still alive per allocation site can then be
+ * queried with {@link module:debug#allocsites|allocsites()}. Heap snapshots
+ * created by {@link module:debug#heapsnapshot|heapsnapshot()} include the
+ * site of each tracked value.
+ *
+ * Tracking slows down value allocation considerably and is only possible for
+ * one VM per process at a time. Allocations made by other threads or while
+ * the tracked VM is not executing are ignored. Disabling tracking discards
+ * the collected data.
+ *
+ * Returns `true` if tracking has been enabled or disabled.
+ *
+ * Returns `false` if another VM is already tracking allocations.
+ *
+ * @function module:debug#trackalloc
+ *
+ * @param {boolean} enable
+ * Whether to enable or to disable tracking.
+ *
+ * @param {boolean} [report=false]
+ * Whether to write a report of the values still alive to stderr when the VM
+ * is terminated.
+ *
+ * @return {boolean}
+ *
+ * @example
+ * trackalloc(true);
+ * render_template();
+ *
+ * for (let site in slice(allocsites(), 0, 10))
+ *   printf("%8d bytes %6d values  %s\n", site.bytes, site.count, site.site);
+ */
+static uc_value_t *
+uc_trackalloc(uc_vm_t *vm, size_t nargs)
+{
+	bool enable = ucv_is_truish(uc_fn_arg(0));
+	bool report = ucv_is_truish(uc_fn_arg(1));
+
+	if (!enable) {
+		if (alloc_track.vm && alloc_track.vm != vm)
+			return ucv_boolean_new(false);
+
+		if (alloc_track.vm)
+			alloc_track_stop();
+
+		return ucv_boolean_new(true);
+	}
+
+	if (!alloc_track_start(vm, report))
+		return ucv_boolean_new(false);
+
+	alloc_track.report = report;
+
+	return ucv_boolean_new(true);
+}
+
+/**
+ * Report values alive per allocation site.
+ *
+ * Returns an array describing each allocation site recorded since tracking
+ * has been enabled with {@link module:debug#trackalloc|trackalloc()}, ordered
+ * by the number of bytes still allocated with the largest first.
+ *
+ * Returns `null` if allocation tracking is not enabled.
+ *
+ * @function module:debug#allocsites
+ *
+ * @return {?module:debug.AllocSite[]}
+ */
+
+/**
+ * @typedef {Object} module:debug.AllocSite
+ *
+ * @property {string} site
+ * The allocating function and source position, prefixed by the name of the
+ * C function called from there, if any.
+ *
+ * @property {number} count
+ * The number of values allocated at this site which are still alive.
+ *
+ * @property {number} bytes
+ * The approximate number of bytes held by these values.
+ *
+ * @property {number} allocated
+ * The total number of values allocated at this site.
+ */
+static uc_value_t *
+uc_allocsites(uc_vm_t *vm, size_t nargs)
+{
+	alloc_site_t **sorted;
+	uc_value_t *rv, *site;
+	size_t i;
+
+	if (alloc_track.vm != vm)
+		return NULL;
+
+	/* build the result first, its own allocations are tracked as well */
+	rv = ucv_array_new_length(vm, alloc_track.sites.count);
+
+	for (i = 0; i < alloc_track.sites.count; i++)
+		ucv_array_push(rv, ucv_object_new(vm));
+
+	sorted = alloc_sites_sorted();
+
+	for (i = 0; i < alloc_track.sites.count; i++) {
+		site = ucv_array_get(rv, i);
+
+		ucv_object_add(site, "site", ucv_string_new(sorted[i]->label));
+		ucv_object_add(site, "count", ucv_uint64_new(sorted[i]->count));
+		ucv_object_add(site, "bytes", ucv_uint64_new(sorted[i]->bytes));
+		ucv_object_add(site, "allocated", ucv_uint64_new(sorted[i]->allocated));
+	}
+
+	free(sorted);
+
+	return rv;
+}
+
+/**
+ * Capture call stack trace.
+ *
+ * This function captures the current call stack and returns it. The optional
+ * level parameter controls how many calls up the trace should start. It
+ * defaults to `1`, that is the function calling this `traceback()` function.
+ *
+ * Returns an array of stack trace entries describing the function invocations
+ * up to the point where `traceback()` is called.
+ *
+ * @function module:debug#traceback
+ *
+ * @param {number} [level=1]
+ * The number of callframes up the call trace should start, `0` is this function
+ * itself, `1` the function calling it and so on.
+ *
+ * @return {module:debug.StackTraceEntry[]}
+ */
+
+/**
+ * @typedef {Object} module:debug.StackTraceEntry
+ *
+ * @property {function} callee
+ * The function that was called.
+ *
+ * @property {*} this
+ * The `this` context the function was called with.
+ *
+ * @property {boolean} mcall
+ * Indicates whether the function was invoked as a method.
+ *
+ * @property {boolean} [strict]
+ * Indicates whether the VM was running in strict mode when the function was
+ * called (only applicable to non-C, pure ucode calls).
+ *
+ * @property {string} [filename]
+ * The name of the source file that called the function (only applicable to
+ * non-C, pure ucode calls).
+ *
+ * @property {number} [line]
+ * The source line of the function call (only applicable to non-C, pure ucode
+ * calls).
+ *
+ * @property {number} [byte]
+ * The source line offset of the function call (only applicable to non-C, pure
+ * ucode calls).
+ *
+ * @property {string} [context]
+ * The surrounding source code context formatted as human-readable string,
+ * useful for generating debug messages (only applicable to non-C, pure ucode
+ * calls).
+ */
+
+static uc_value_t *
+uc_traceback(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *stacktrace, *entry, *level = uc_fn_arg(0);
+	uc_function_t *function;
+	uc_stringbuf_t *context;
+	uc_callframe_t *frame;
+	uc_source_t *source;
+	size_t off, srcpos;
+	size_t i, lv;
+
+	lv = level ? ucv_uint64_get(level) : 1;
+
+	if (level && errno)
+		return NULL;
+
+	stacktrace = ucv_array_new(vm);
+
+	for (i = (lv < vm->callframes.count) ? vm->callframes.count - lv : 0;
+	     i > 0;
+	     i--) {
+
+		frame = &vm->callframes.entries[i - 1];
+		entry = ucv_object_new(vm);
+
+		if (frame->closure) {
+			function = frame->closure->function;
+			source = uc_program_function_source(function);
+
+			off = (frame->ip - function->chunk.entries) - 1;
+			srcpos = uc_program_function_srcpos(function, off);
+
+			context = ucv_stringbuf_new();
+
+			uc_source_context_format(context,
+				uc_program_function_source(function),
+				srcpos, false);
 
 			ucv_object_add(entry, "callee", ucv_get(&frame->closure->header));
 			ucv_object_add(entry, "this", ucv_get(frame->ctx));
@@ -805,6 +2216,61 @@ uc_traceback(uc_vm_t *vm, size_t nargs)
 	return stacktrace;
 }
 
+/**
+ * Write an lcov coverage tracefile for the code executed so far.
+ *
+ * Coverage is only collected when the interpreter has been built with
+ * `UC_COVERAGE` defined. Such builds record each executed basic block of every
+ * called function and additionally append the tracefile to the path given in
+ * the `UCODE_COVERAGE` environment variable when the VM is torn down, which
+ * allows accumulating the coverage of an entire test suite run.
+ *
+ * The file parameter can be either a string value containing a file path or
+ * an already open file handle this function should write to.
+ *
+ * Line hits are reported as `0` or `1`, branch records are derived from the
+ * conditional jumps of each function.
+ *
+ * Returns `true` if the tracefile has been written.
+ *
+ * Returns `null` if the file could not be opened, if the handle was invalid or
+ * if coverage support is not compiled in.
+ *
+ * @function module:debug#coverage
+ *
+ * @param {string|module:fs.file|module:fs.proc} file
+ * The file path or open file handle to write the tracefile to.
+ *
+ * @return {?boolean}
+ */
+static uc_value_t *
+uc_coverage(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *file = uc_fn_arg(0);
+	FILE *fp = NULL;
+	bool rv;
+
+	if (ucv_type(file) == UC_RESOURCE) {
+		fp = ucv_resource_data(file, "fs.file");
+
+		if (!fp)
+			fp = ucv_resource_data(file, "fs.proc");
+	}
+	else if (ucv_type(file) == UC_STRING) {
+		fp = fopen(ucv_string_get(file), "w");
+	}
+
+	if (!fp)
+		return NULL;
+
+	rv = uc_vm_coverage_write(vm, fp);
+
+	if (ucv_type(file) == UC_STRING)
+		fclose(fp);
+
+	return rv ? ucv_boolean_new(true) : NULL;
+}
+
 /**
  * Obtain information about the current source position.
  *
@@ -1616,6 +3082,11 @@ uc_setupval(uc_vm_t *vm, size_t nargs)
 
 static const uc_function_list_t debug_fns[] = {
 	{ "memdump",	uc_memdump },
+	{ "heapsnapshot",	uc_heapsnapshot },
+	{ "heapdiff",	uc_heapdiff },
+	{ "trackalloc",	uc_trackalloc },
+	{ "allocsites",	uc_allocsites },
+	{ "coverage",	uc_coverage },
 	{ "traceback",	uc_traceback },
 	{ "sourcepos",	uc_sourcepos },
 	{ "getinfo",	uc_getinfo },
@@ -19,9 +19,17 @@
  *
  * The `digest` module bundles various digest functions.
  *
+ * Besides the one-shot functions operating on strings and files, the
+ * {@link module:digest#hasher|hasher()} function creates objects for
+ * incremental digest computation over strings, buffers and file handles.
+ *
  * @module digest
  */
 
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
 #include <md5.h>
 #include <sha1.h>
 #include <sha2.h>
@@ -31,9 +39,1100 @@
 #include <md4.h>
 #endif
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#include <cpuid.h>
+#include <immintrin.h>
+#define DIGEST_X86_ACCEL
+#define DIGEST_TARGET_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+#define DIGEST_TARGET_CRC32 __attribute__((target("sse4.2")))
+#elif defined(__aarch64__) && defined(__linux__) && \
+      (defined(__clang__) || __GNUC__ >= 9)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_acle.h>
+#include <arm_neon.h>
+#define DIGEST_ARM_ACCEL
+#ifdef __clang__
+#define DIGEST_TARGET_ARMCE __attribute__((target("crypto")))
+#define DIGEST_TARGET_CRC32 __attribute__((target("crc")))
+#else
+#define DIGEST_TARGET_ARMCE __attribute__((target("+crypto")))
+#define DIGEST_TARGET_CRC32 __attribute__((target("+crc")))
+#endif
+#endif
+
 #include "module.h"
 
+#define DIGEST_MAX_LENGTH 32
+#define DIGEST_FILE_CHUNK 65536
+
+typedef void (*digest_compress_fn)(uint32_t *, const uint8_t *, size_t);
+typedef uint32_t (*digest_crc32c_fn)(uint32_t, const uint8_t *, size_t);
+
+typedef struct {
+	uint64_t length;
+	uint32_t state[8];
+	uint8_t buf[64];
+} digest_block_state_t;
+
+typedef struct {
+	uint64_t length;
+	uint32_t v[4];
+	uint8_t buf[16];
+	uint32_t seed;
+} digest_xxh32_state_t;
+
+typedef struct {
+	uint64_t length;
+	uint64_t v[4];
+	uint8_t buf[32];
+	uint64_t seed;
+} digest_xxh64_state_t;
+
+typedef union {
+	MD5_CTX md5;
+	digest_block_state_t block;
+	digest_xxh32_state_t xxh32;
+	digest_xxh64_state_t xxh64;
+	uint32_t crc;
+} digest_state_t;
+
+typedef struct {
+	const char *name;
+	size_t length;
+	void (*init)(digest_state_t *, uint64_t);
+	void (*update)(digest_state_t *, const uint8_t *, size_t);
+	void (*final)(digest_state_t *, uint8_t *);
+} digest_algo_t;
+
+static struct {
+	digest_compress_fn sha1;
+	digest_compress_fn sha256;
+	digest_crc32c_fn crc32c;
+	const char *sha1_impl;
+	const char *sha256_impl;
+	const char *crc32c_impl;
+} digest_impl;
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static inline uint32_t
+load_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint32_t
+load_le32(const uint8_t *p)
+{
+	return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[1] << 8) | p[0];
+}
+
+static inline uint64_t
+load_le64(const uint8_t *p)
+{
+	return ((uint64_t)load_le32(p + 4) << 32) | load_le32(p);
+}
+
+static inline void
+store_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static inline void
+store_be64(uint8_t *p, uint64_t v)
+{
+	store_be32(p, v >> 32);
+	store_be32(p + 4, v);
+}
+
+
+/* Portable block functions */
+
+static void
+sha1_compress_generic(uint32_t *state, const uint8_t *data, size_t nblocks)
+{
+	uint32_t a, b, c, d, e, f, k, t, w[80];
+	size_t i;
+
+	while (nblocks--) {
+		for (i = 0; i < 16; i++)
+			w[i] = load_be32(data + i * 4);
+
+		for (i = 16; i < 80; i++)
+			w[i] = ROTL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		for (i = 0; i < 80; i++) {
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5a827999;
+			}
+			else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ed9eba1;
+			}
+			else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8f1bbcdc;
+			}
+			else {
+				f = b ^ c ^ d;
+				k = 0xca62c1d6;
+			}
+
+			t = ROTL32(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = ROTL32(b, 30);
+			b = a;
+			a = t;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+
+		data += 64;
+	}
+}
+
+static void
+sha256_compress_generic(uint32_t *state, const uint8_t *data, size_t nblocks)
+{
+	uint32_t a, b, c, d, e, f, g, h, s0, s1, t1, t2, w[64];
+	size_t i;
+
+	while (nblocks--) {
+		for (i = 0; i < 16; i++)
+			w[i] = load_be32(data + i * 4);
+
+		for (i = 16; i < 64; i++) {
+			s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		for (i = 0; i < 64; i++) {
+			s1 = ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25);
+			t1 = h + s1 + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+			s0 = ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22);
+			t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+
+		data += 64;
+	}
+}
+
+static uint32_t crc32c_table[8][256];
+
+static void
+crc32c_table_init(void)
+{
+	uint32_t crc;
+	size_t i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+
+		crc32c_table[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; i++)
+		for (j = 1; j < 8; j++)
+			crc32c_table[j][i] = (crc32c_table[j - 1][i] >> 8) ^
+				crc32c_table[0][crc32c_table[j - 1][i] & 0xff];
+}
+
+/* slicing-by-8 */
+static uint32_t
+crc32c_generic(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint32_t lo, hi;
+
+	while (len >= 8) {
+		lo = load_le32(p) ^ crc;
+		hi = load_le32(p + 4);
+
+		crc = crc32c_table[7][lo & 0xff] ^
+		      crc32c_table[6][(lo >> 8) & 0xff] ^
+		      crc32c_table[5][(lo >> 16) & 0xff] ^
+		      crc32c_table[4][lo >> 24] ^
+		      crc32c_table[3][hi & 0xff] ^
+		      crc32c_table[2][(hi >> 8) & 0xff] ^
+		      crc32c_table[1][(hi >> 16) & 0xff] ^
+		      crc32c_table[0][hi >> 24];
+
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xff];
+
+	return crc;
+}
+
+
+/* Accelerated block functions, selected at runtime */
+
+#ifdef DIGEST_X86_ACCEL
+DIGEST_TARGET_SHANI static void
+sha1_compress_shani(uint32_t *state, const uint8_t *data, size_t nblocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+	                                    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1, m[4];
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1b);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+/* four rounds per group, interleaved with the message schedule of the
+ * following groups; f must be a constant for sha1rnds4 */
+#define SHA1_GROUP(g, f) do { \
+	if (g < 4) \
+		m[g & 3] = _mm_shuffle_epi8( \
+			_mm_loadu_si128((const __m128i *)(data + g * 16)), mask); \
+	if (g == 0) \
+		e0 = _mm_add_epi32(e0, m[0]); \
+	else \
+		e0 = _mm_sha1nexte_epu32(e0, m[g & 3]); \
+	e1 = abcd; \
+	if (g >= 3 && g <= 18) \
+		m[(g + 1) & 3] = _mm_sha1msg2_epu32(m[(g + 1) & 3], m[g & 3]); \
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, f); \
+	if (g >= 1 && g <= 16) \
+		m[(g + 3) & 3] = _mm_sha1msg1_epu32(m[(g + 3) & 3], m[g & 3]); \
+	if (g >= 2 && g <= 17) \
+		m[(g + 2) & 3] = _mm_xor_si128(m[(g + 2) & 3], m[g & 3]); \
+	e0 = e1; \
+} while (0)
+
+	while (nblocks--) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		SHA1_GROUP(0, 0);  SHA1_GROUP(1, 0);  SHA1_GROUP(2, 0);
+		SHA1_GROUP(3, 0);  SHA1_GROUP(4, 0);  SHA1_GROUP(5, 1);
+		SHA1_GROUP(6, 1);  SHA1_GROUP(7, 1);  SHA1_GROUP(8, 1);
+		SHA1_GROUP(9, 1);  SHA1_GROUP(10, 2); SHA1_GROUP(11, 2);
+		SHA1_GROUP(12, 2); SHA1_GROUP(13, 2); SHA1_GROUP(14, 2);
+		SHA1_GROUP(15, 3); SHA1_GROUP(16, 3); SHA1_GROUP(17, 3);
+		SHA1_GROUP(18, 3); SHA1_GROUP(19, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+
+		data += 64;
+	}
+
+#undef SHA1_GROUP
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+DIGEST_TARGET_SHANI static void
+sha256_compress_shani(uint32_t *state, const uint8_t *data, size_t nblocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+	                                    0x0405060700010203ULL);
+	__m128i s0, s1, s0_save, s1_save, msg, tmp, m[4];
+	size_t i;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+	s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+	s0 = _mm_alignr_epi8(tmp, s1, 8);      /* ABEF */
+	s1 = _mm_blend_epi16(s1, tmp, 0xf0);   /* CDGH */
+
+	while (nblocks--) {
+		s0_save = s0;
+		s1_save = s1;
+
+		for (i = 0; i < 4; i++)
+			m[i] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + i * 16)), mask);
+
+		for (i = 0; i < 16; i++) {
+			msg = _mm_add_epi32(m[i & 3],
+				_mm_loadu_si128((const __m128i *)&sha256_k[i * 4]));
+
+			s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+			s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));
+
+			if (i < 12) {
+				tmp = _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4);
+				m[i & 3] = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+				m[i & 3] = _mm_add_epi32(m[i & 3], tmp);
+				m[i & 3] = _mm_sha256msg2_epu32(m[i & 3], m[(i + 3) & 3]);
+			}
+		}
+
+		s0 = _mm_add_epi32(s0, s0_save);
+		s1 = _mm_add_epi32(s1, s1_save);
+
+		data += 64;
+	}
+
+	tmp = _mm_shuffle_epi32(s0, 0x1b);     /* FEBA */
+	s1 = _mm_shuffle_epi32(s1, 0xb1);      /* DCHG */
+	s0 = _mm_blend_epi16(tmp, s1, 0xf0);   /* DCBA */
+	s1 = _mm_alignr_epi8(s1, tmp, 8);      /* HGFE */
+
+	_mm_storeu_si128((__m128i *)&state[0], s0);
+	_mm_storeu_si128((__m128i *)&state[4], s1);
+}
+
+DIGEST_TARGET_CRC32 static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+
+	for (; len >= 8; p += 8, len -= 8)
+		crc64 = _mm_crc32_u64(crc64, load_le64(p));
+
+	crc = crc64;
+#endif
+
+	for (; len >= 4; p += 4, len -= 4)
+		crc = _mm_crc32_u32(crc, load_le32(p));
+
+	while (len--)
+		crc = _mm_crc32_u8(crc, *p++);
+
+	return crc;
+}
+
+static void
+digest_dispatch_accel(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	bool ssse3, sse41, sse42;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return;
+
+	ssse3 = ecx & (1 << 9);
+	sse41 = ecx & (1 << 19);
+	sse42 = ecx & (1 << 20);
+
+	if (sse42) {
+		digest_impl.crc32c = crc32c_sse42;
+		digest_impl.crc32c_impl = "sse4.2";
+	}
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	if ((ebx & (1 << 29)) && ssse3 && sse41) {
+		digest_impl.sha1 = sha1_compress_shani;
+		digest_impl.sha256 = sha256_compress_shani;
+		digest_impl.sha1_impl = "sha-ni";
+		digest_impl.sha256_impl = "sha-ni";
+	}
+}
+#endif
+
+#ifdef DIGEST_ARM_ACCEL
+DIGEST_TARGET_ARMCE static void
+sha1_compress_armce(uint32_t *state, const uint8_t *data, size_t nblocks)
+{
+	static const uint32_t k[4] = {
+		0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
+	};
+
+	uint32x4_t abcd, abcd_save, wk, m[4];
+	uint32_t e0, e1, e0_save;
+	size_t g;
+
+	abcd = vld1q_u32(state);
+	e0 = state[4];
+
+	while (nblocks--) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		for (g = 0; g < 4; g++)
+			m[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + g * 16)));
+
+		for (g = 0; g < 20; g++) {
+			wk = vaddq_u32(m[g & 3], vdupq_n_u32(k[g / 5]));
+			e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+
+			if (g < 5)
+				abcd = vsha1cq_u32(abcd, e0, wk);
+			else if (g < 10 || g >= 15)
+				abcd = vsha1pq_u32(abcd, e0, wk);
+			else
+				abcd = vsha1mq_u32(abcd, e0, wk);
+
+			e0 = e1;
+
+			if (g < 16)
+				m[g & 3] = vsha1su1q_u32(
+					vsha1su0q_u32(m[g & 3], m[(g + 1) & 3], m[(g + 2) & 3]),
+					m[(g + 3) & 3]);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		e0 += e0_save;
+
+		data += 64;
+	}
+
+	vst1q_u32(state, abcd);
+	state[4] = e0;
+}
+
+DIGEST_TARGET_ARMCE static void
+sha256_compress_armce(uint32_t *state, const uint8_t *data, size_t nblocks)
+{
+	uint32x4_t s0, s1, s0_save, s1_save, wk, tmp, m[4];
+	size_t i;
+
+	s0 = vld1q_u32(&state[0]);
+	s1 = vld1q_u32(&state[4]);
+
+	while (nblocks--) {
+		s0_save = s0;
+		s1_save = s1;
+
+		for (i = 0; i < 4; i++)
+			m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		for (i = 0; i < 16; i++) {
+			wk = vaddq_u32(m[i & 3], vld1q_u32(&sha256_k[i * 4]));
+
+			if (i < 12)
+				m[i & 3] = vsha256su1q_u32(
+					vsha256su0q_u32(m[i & 3], m[(i + 1) & 3]),
+					m[(i + 2) & 3], m[(i + 3) & 3]);
+
+			tmp = s0;
+			s0 = vsha256hq_u32(s0, s1, wk);
+			s1 = vsha256h2q_u32(s1, tmp, wk);
+		}
+
+		s0 = vaddq_u32(s0, s0_save);
+		s1 = vaddq_u32(s1, s1_save);
+
+		data += 64;
+	}
+
+	vst1q_u32(&state[0], s0);
+	vst1q_u32(&state[4], s1);
+}
+
+DIGEST_TARGET_CRC32 static uint32_t
+crc32c_armv8(uint32_t crc, const uint8_t *p, size_t len)
+{
+	for (; len >= 8; p += 8, len -= 8)
+		crc = __crc32cd(crc, load_le64(p));
+
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+
+static void
+digest_dispatch_accel(void)
+{
+	unsigned long hwcap = getauxval(AT_HWCAP);
+
+	if (hwcap & HWCAP_CRC32) {
+		digest_impl.crc32c = crc32c_armv8;
+		digest_impl.crc32c_impl = "armv8-crc";
+	}
+
+	if (hwcap & HWCAP_SHA1) {
+		digest_impl.sha1 = sha1_compress_armce;
+		digest_impl.sha1_impl = "armv8-ce";
+	}
+
+	if (hwcap & HWCAP_SHA2) {
+		digest_impl.sha256 = sha256_compress_armce;
+		digest_impl.sha256_impl = "armv8-ce";
+	}
+}
+#endif
+
+static void
+digest_dispatch_init(void)
+{
+	if (digest_impl.sha1)
+		return;
+
+	crc32c_table_init();
+
+	digest_impl.sha1 = sha1_compress_generic;
+	digest_impl.sha256 = sha256_compress_generic;
+	digest_impl.crc32c = crc32c_generic;
+	digest_impl.sha1_impl = "generic";
+	digest_impl.sha256_impl = "generic";
+	digest_impl.crc32c_impl = "generic";
+
+#if defined(DIGEST_X86_ACCEL) || defined(DIGEST_ARM_ACCEL)
+	digest_dispatch_accel();
+#endif
+}
+
+
+/* Streaming state handling */
+
+static void
+block_update(digest_block_state_t *st, digest_compress_fn compress,
+             const uint8_t *data, size_t len)
+{
+	size_t fill = st->length & 63, n;
+
+	st->length += len;
+
+	if (fill) {
+		n = (len < 64 - fill) ? len : 64 - fill;
+		memcpy(st->buf + fill, data, n);
+
+		if (fill + n < 64)
+			return;
+
+		compress(st->state, st->buf, 1);
+		data += n;
+		len -= n;
+	}
+
+	if (len >= 64) {
+		compress(st->state, data, len / 64);
+		data += len & ~(size_t)63;
+		len &= 63;
+	}
+
+	memcpy(st->buf, data, len);
+}
+
+static void
+block_final(digest_block_state_t *st, digest_compress_fn compress,
+            uint8_t *out, size_t words)
+{
+	size_t fill = st->length & 63, i;
+	uint64_t bits = st->length * 8;
+
+	st->buf[fill++] = 0x80;
+
+	if (fill > 56) {
+		memset(st->buf + fill, 0, 64 - fill);
+		compress(st->state, st->buf, 1);
+		fill = 0;
+	}
+
+	memset(st->buf + fill, 0, 56 - fill);
+	store_be64(st->buf + 56, bits);
+	compress(st->state, st->buf, 1);
+
+	for (i = 0; i < words; i++)
+		store_be32(out + i * 4, st->state[i]);
+}
+
+static void
+md5_init(digest_state_t *st, uint64_t seed)
+{
+	MD5Init(&st->md5);
+}
+
+static void
+md5_update(digest_state_t *st, const uint8_t *data, size_t len)
+{
+	MD5Update(&st->md5, data, len);
+}
+
+static void
+md5_final(digest_state_t *st, uint8_t *out)
+{
+	MD5Final(out, &st->md5);
+}
+
+static void
+sha1_init(digest_state_t *st, uint64_t seed)
+{
+	static const uint32_t iv[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+
+	memset(&st->block, 0, sizeof(st->block));
+	memcpy(st->block.state, iv, sizeof(iv));
+}
+
+static void
+sha1_update(digest_state_t *st, const uint8_t *data, size_t len)
+{
+	block_update(&st->block, digest_impl.sha1, data, len);
+}
+
+static void
+sha1_final(digest_state_t *st, uint8_t *out)
+{
+	block_final(&st->block, digest_impl.sha1, out, 5);
+}
+
+static void
+sha256_init(digest_state_t *st, uint64_t seed)
+{
+	static const uint32_t iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memset(&st->block, 0, sizeof(st->block));
+	memcpy(st->block.state, iv, sizeof(iv));
+}
+
+static void
+sha256_update(digest_state_t *st, const uint8_t *data, size_t len)
+{
+	block_update(&st->block, digest_impl.sha256, data, len);
+}
+
+static void
+sha256_final(digest_state_t *st, uint8_t *out)
+{
+	block_final(&st->block, digest_impl.sha256, out, 8);
+}
+
+static void
+crc32c_init(digest_state_t *st, uint64_t seed)
+{
+	st->crc = ~(uint32_t)seed;
+}
+
+static void
+crc32c_update(digest_state_t *st, const uint8_t *data, size_t len)
+{
+	st->crc = digest_impl.crc32c(st->crc, data, len);
+}
+
+static void
+crc32c_final(digest_state_t *st, uint8_t *out)
+{
+	store_be32(out, ~st->crc);
+}
+
+#define XXH32_P1 0x9e3779b1u
+#define XXH32_P2 0x85ebca77u
+#define XXH32_P3 0xc2b2ae3du
+#define XXH32_P4 0x27d4eb2fu
+#define XXH32_P5 0x165667b1u
+
+static inline uint32_t
+xxh32_round(uint32_t acc, uint32_t in)
+{
+	acc += in * XXH32_P2;
+	acc = ROTL32(acc, 13);
+
+	return acc * XXH32_P1;
+}
+
+static void
+xxh32_init(digest_state_t *st, uint64_t seed)
+{
+	digest_xxh32_state_t *x = &st->xxh32;
+
+	memset(x, 0, sizeof(*x));
+	x->seed = seed;
+	x->v[0] = x->seed + XXH32_P1 + XXH32_P2;
+	x->v[1] = x->seed + XXH32_P2;
+	x->v[2] = x->seed;
+	x->v[3] = x->seed - XXH32_P1;
+}
+
+static void
+xxh32_stripes(digest_xxh32_state_t *x, const uint8_t *p, size_t n)
+{
+	while (n--) {
+		x->v[0] = xxh32_round(x->v[0], load_le32(p));
+		x->v[1] = xxh32_round(x->v[1], load_le32(p + 4));
+		x->v[2] = xxh32_round(x->v[2], load_le32(p + 8));
+		x->v[3] = xxh32_round(x->v[3], load_le32(p + 12));
+		p += 16;
+	}
+}
+
+static void
+xxh32_update(digest_state_t *st, const uint8_t *data, size_t len)
+{
+	digest_xxh32_state_t *x = &st->xxh32;
+	size_t fill = x->length & 15, n;
+
+	x->length += len;
+
+	if (fill) {
+		n = (len < 16 - fill) ? len : 16 - fill;
+		memcpy(x->buf + fill, data, n);
+
+		if (fill + n < 16)
+			return;
+
+		xxh32_stripes(x, x->buf, 1);
+		data += n;
+		len -= n;
+	}
+
+	xxh32_stripes(x, data, len / 16);
+	memcpy(x->buf, data + (len & ~(size_t)15), len & 15);
+}
+
+static void
+xxh32_final(digest_state_t *st, uint8_t *out)
+{
+	digest_xxh32_state_t *x = &st->xxh32;
+	size_t len = x->length & 15;
+	const uint8_t *p = x->buf;
+	uint32_t h;
+
+	if (x->length >= 16)
+		h = ROTL32(x->v[0], 1) + ROTL32(x->v[1], 7) +
+		    ROTL32(x->v[2], 12) + ROTL32(x->v[3], 18);
+	else
+		h = x->seed + XXH32_P5;
+
+	h += (uint32_t)x->length;
+
+	for (; len >= 4; p += 4, len -= 4) {
+		h += load_le32(p) * XXH32_P3;
+		h = ROTL32(h, 17) * XXH32_P4;
+	}
+
+	while (len--) {
+		h += (*p++) * XXH32_P5;
+		h = ROTL32(h, 11) * XXH32_P1;
+	}
+
+	h ^= h >> 15;
+	h *= XXH32_P2;
+	h ^= h >> 13;
+	h *= XXH32_P3;
+	h ^= h >> 16;
+
+	store_be32(out, h);
+}
+
+#define XXH64_P1 0x9e3779b185ebca87ULL
+#define XXH64_P2 0xc2b2ae3d27d4eb4fULL
+#define XXH64_P3 0x165667b19e3779f9ULL
+#define XXH64_P4 0x85ebca77c2b2ae63ULL
+#define XXH64_P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t
+xxh64_round(uint64_t acc, uint64_t in)
+{
+	acc += in * XXH64_P2;
+	acc = ROTL64(acc, 31);
+
+	return acc * XXH64_P1;
+}
+
+static inline uint64_t
+xxh64_merge(uint64_t acc, uint64_t v)
+{
+	acc ^= xxh64_round(0, v);
+
+	return acc * XXH64_P1 + XXH64_P4;
+}
+
+static void
+xxh64_init(digest_state_t *st, uint64_t seed)
+{
+	digest_xxh64_state_t *x = &st->xxh64;
+
+	memset(x, 0, sizeof(*x));
+	x->seed = seed;
+	x->v[0] = seed + XXH64_P1 + XXH64_P2;
+	x->v[1] = seed + XXH64_P2;
+	x->v[2] = seed;
+	x->v[3] = seed - XXH64_P1;
+}
+
+static void
+xxh64_stripes(digest_xxh64_state_t *x, const uint8_t *p, size_t n)
+{
+	while (n--) {
+		x->v[0] = xxh64_round(x->v[0], load_le64(p));
+		x->v[1] = xxh64_round(x->v[1], load_le64(p + 8));
+		x->v[2] = xxh64_round(x->v[2], load_le64(p + 16));
+		x->v[3] = xxh64_round(x->v[3], load_le64(p + 24));
+		p += 32;
+	}
+}
+
+static void
+xxh64_update(digest_state_t *st, const uint8_t *data, size_t len)
+{
+	digest_xxh64_state_t *x = &st->xxh64;
+	size_t fill = x->length & 31, n;
+
+	x->length += len;
+
+	if (fill) {
+		n = (len < 32 - fill) ? len : 32 - fill;
+		memcpy(x->buf + fill, data, n);
+
+		if (fill + n < 32)
+			return;
+
+		xxh64_stripes(x, x->buf, 1);
+		data += n;
+		len -= n;
+	}
+
+	xxh64_stripes(x, data, len / 32);
+	memcpy(x->buf, data + (len & ~(size_t)31), len & 31);
+}
+
+static void
+xxh64_final(digest_state_t *st, uint8_t *out)
+{
+	digest_xxh64_state_t *x = &st->xxh64;
+	size_t len = x->length & 31;
+	const uint8_t *p = x->buf;
+	uint64_t h;
+
+	if (x->length >= 32) {
+		h = ROTL64(x->v[0], 1) + ROTL64(x->v[1], 7) +
+		    ROTL64(x->v[2], 12) + ROTL64(x->v[3], 18);
+		h = xxh64_merge(h, x->v[0]);
+		h = xxh64_merge(h, x->v[1]);
+		h = xxh64_merge(h, x->v[2]);
+		h = xxh64_merge(h, x->v[3]);
+	}
+	else {
+		h = x->seed + XXH64_P5;
+	}
+
+	h += x->length;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		h ^= xxh64_round(0, load_le64(p));
+		h = ROTL64(h, 27) * XXH64_P1 + XXH64_P4;
+	}
+
+	if (len >= 4) {
+		h ^= (uint64_t)load_le32(p) * XXH64_P1;
+		h = ROTL64(h, 23) * XXH64_P2 + XXH64_P3;
+		p += 4;
+		len -= 4;
+	}
+
+	while (len--) {
+		h ^= (*p++) * XXH64_P5;
+		h = ROTL64(h, 11) * XXH64_P1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH64_P2;
+	h ^= h >> 29;
+	h *= XXH64_P3;
+	h ^= h >> 32;
+
+	store_be64(out, h);
+}
+
+enum {
+	DIGEST_MD5,
+	DIGEST_SHA1,
+	DIGEST_SHA256,
+	DIGEST_CRC32C,
+	DIGEST_XXH32,
+	DIGEST_XXH64,
+};
+
+static const digest_algo_t digest_algos[] = {
+	[DIGEST_MD5]    = { "md5",    16, md5_init,    md5_update,    md5_final    },
+	[DIGEST_SHA1]   = { "sha1",   20, sha1_init,   sha1_update,   sha1_final   },
+	[DIGEST_SHA256] = { "sha256", 32, sha256_init, sha256_update, sha256_final },
+	[DIGEST_CRC32C] = { "crc32c", 4,  crc32c_init, crc32c_update, crc32c_final },
+	[DIGEST_XXH32]  = { "xxh32",  4,  xxh32_init,  xxh32_update,  xxh32_final  },
+	[DIGEST_XXH64]  = { "xxh64",  8,  xxh64_init,  xxh64_update,  xxh64_final  },
+};
+
+static bool
+uc_digest_encoding_valid(const digest_algo_t *algo, const char *enc)
+{
+	if (!enc || !strcmp(enc, "hex") || !strcmp(enc, "binary"))
+		return true;
+
+	return (!strcmp(enc, "integer") && algo->length <= 8);
+}
 
+static uc_value_t *
+uc_digest_encode(const digest_algo_t *algo, const uint8_t *out, const char *enc)
+{
+	char hex[DIGEST_MAX_LENGTH * 2 + 1];
+	uint64_t n = 0;
+	size_t i;
+
+	if (!enc)
+		enc = "hex";
+
+	if (!strcmp(enc, "binary"))
+		return ucv_string_new_length((const char *)out, algo->length);
+
+	if (!strcmp(enc, "integer")) {
+		if (algo->length > 8)
+			return NULL;
+
+		for (i = 0; i < algo->length; i++)
+			n = (n << 8) | out[i];
+
+		return ucv_uint64_new(n);
+	}
+
+	if (strcmp(enc, "hex"))
+		return NULL;
+
+	for (i = 0; i < algo->length; i++)
+		snprintf(hex + i * 2, 3, "%02x", out[i]);
+
+	return ucv_string_new_length(hex, algo->length * 2);
+}
+
+static FILE *
+uc_digest_file_handle(uc_value_t *uv)
+{
+	FILE *fp = ucv_resource_data(uv, "fs.file");
+
+	return fp ? fp : ucv_resource_data(uv, "fs.proc");
+}
+
+static bool
+uc_digest_update_file(const digest_algo_t *algo, digest_state_t *st, FILE *fp)
+{
+	uint8_t *buf = xalloc(DIGEST_FILE_CHUNK);
+	size_t len;
+
+	while ((len = fread(buf, 1, DIGEST_FILE_CHUNK, fp)) > 0)
+		algo->update(st, buf, len);
+
+	free(buf);
+
+	return !ferror(fp);
+}
+
+static uc_value_t *
+uc_digest_calc(uc_value_t *data, const digest_algo_t *algo, uint64_t seed,
+               const char *encoding)
+{
+	uint8_t out[DIGEST_MAX_LENGTH];
+	digest_state_t st;
+	size_t len;
+	char *p;
+
+	p = ucv_bytes_get(data, &len);
+
+	if (!p)
+		return NULL;
+
+	algo->init(&st, seed);
+	algo->update(&st, (const uint8_t *)p, len);
+	algo->final(&st, out);
+
+	return uc_digest_encode(algo, out, encoding);
+}
+
+static uc_value_t *
+uc_digest_calc_path(uc_value_t *path, const digest_algo_t *algo)
+{
+	uint8_t out[DIGEST_MAX_LENGTH];
+	digest_state_t st;
+	FILE *fp;
+	bool ok;
+
+	if (ucv_type(path) != UC_STRING)
+		return NULL;
+
+	fp = fopen(ucv_string_get(path), "r");
+
+	if (!fp)
+		return NULL;
+
+	algo->init(&st, 0);
+	ok = uc_digest_update_file(algo, &st, fp);
+	fclose(fp);
+
+	if (!ok)
+		return NULL;
+
+	algo->final(&st, out);
+
+	return uc_digest_encode(algo, out, NULL);
+}
+
+#ifdef HAVE_DIGEST_EXTENDED
 static uc_value_t *
 uc_digest_calc_data(uc_value_t *str, char *(*fn)(const uint8_t *,size_t,char *))
 {
@@ -61,6 +1160,7 @@ uc_digest_calc_file(uc_value_t *path, char *(fn)(const char *,char *))
 
 	return NULL;
 }
+#endif
 
 /**
  * Calculates the MD5 hash of string and returns that hash.
@@ -81,7 +1181,7 @@ uc_digest_calc_file(uc_value_t *path, char *(fn)(const char *,char *))
 static uc_value_t *
 uc_digest_md5(uc_vm_t *vm, size_t nargs)
 {
-	return uc_digest_calc_data(uc_fn_arg(0), MD5Data);
+	return uc_digest_calc(uc_fn_arg(0), &digest_algos[DIGEST_MD5], 0, NULL);
 }
 
 /**
@@ -103,7 +1203,7 @@ uc_digest_md5(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_digest_sha1(uc_vm_t *vm, size_t nargs)
 {
-	return uc_digest_calc_data(uc_fn_arg(0), SHA1Data);
+	return uc_digest_calc(uc_fn_arg(0), &digest_algos[DIGEST_SHA1], 0, NULL);
 }
 
 /**
@@ -125,7 +1225,7 @@ uc_digest_sha1(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_digest_sha256(uc_vm_t *vm, size_t nargs)
 {
-	return uc_digest_calc_data(uc_fn_arg(0), SHA256Data);
+	return uc_digest_calc(uc_fn_arg(0), &digest_algos[DIGEST_SHA256], 0, NULL);
 }
 
 #ifdef HAVE_DIGEST_EXTENDED
@@ -233,7 +1333,7 @@ uc_digest_sha512(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_digest_md5_file(uc_vm_t *vm, size_t nargs)
 {
-	return uc_digest_calc_file(uc_fn_arg(0), MD5File);
+	return uc_digest_calc_path(uc_fn_arg(0), &digest_algos[DIGEST_MD5]);
 }
 
 /**
@@ -251,7 +1351,7 @@ uc_digest_md5_file(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_digest_sha1_file(uc_vm_t *vm, size_t nargs)
 {
-	return uc_digest_calc_file(uc_fn_arg(0), SHA1File);
+	return uc_digest_calc_path(uc_fn_arg(0), &digest_algos[DIGEST_SHA1]);
 }
 
 /**
@@ -269,7 +1369,7 @@ uc_digest_sha1_file(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_digest_sha256_file(uc_vm_t *vm, size_t nargs)
 {
-	return uc_digest_calc_file(uc_fn_arg(0), SHA256File);
+	return uc_digest_calc_path(uc_fn_arg(0), &digest_algos[DIGEST_SHA256]);
 }
 
 #ifdef HAVE_DIGEST_EXTENDED
@@ -347,6 +1447,342 @@ uc_digest_sha512_file(uc_vm_t *vm, size_t nargs)
 #endif
 
 
+typedef struct {
+	const digest_algo_t *algo;
+	uint64_t seed;
+	digest_state_t state;
+} uc_digest_hasher_t;
+
+static uint64_t
+uc_digest_seed(uc_value_t *seed)
+{
+	return (ucv_type(seed) == UC_INTEGER) ? ucv_uint64_get(seed) : 0;
+}
+
+static uc_value_t *
+uc_digest_hasher_new(uc_vm_t *vm, const digest_algo_t *algo, uint64_t seed)
+{
+	uc_digest_hasher_t *h;
+	uc_value_t *res;
+
+	res = ucv_resource_create_ex(vm, "digest.hasher", (void **)&h, 0, sizeof(*h));
+
+	if (!res)
+		return NULL;
+
+	h->algo = algo;
+	h->seed = seed;
+	h->algo->init(&h->state, seed);
+
+	return res;
+}
+
+/**
+ * Represents an incremental digest computation.
+ *
+ * @class module:digest.hasher
+ * @hideconstructor
+ *
+ * @see {@link module:digest#hasher|hasher()}
+ */
+
+/**
+ * Feeds data into the hasher.
+ *
+ * The data may be a string, a buffer-like resource or an open file handle,
+ * which is read until end of file.
+ *
+ * Returns the hasher itself to allow chaining calls.
+ *
+ * Returns `null` if an invalid argument is given or reading a file handle
+ * failed.
+ *
+ * @function module:digest.hasher#update
+ *
+ * @param {string|module:fs.file|module:fs.proc} data
+ * The data to hash.
+ *
+ * @returns {?module:digest.hasher}
+ *
+ * @example
+ * const h = hasher("sha256");
+ *
+ * h.update("Header\n").update(open("/etc/config/network"));
+ */
+static uc_value_t *
+uc_digest_hasher_update(uc_vm_t *vm, size_t nargs)
+{
+	uc_digest_hasher_t *h = uc_fn_thisval("digest.hasher");
+	uc_value_t *data = uc_fn_arg(0);
+	size_t len;
+	FILE *fp;
+	char *p;
+
+	if (!h)
+		return NULL;
+
+	if ((p = ucv_bytes_get(data, &len)) != NULL)
+		h->algo->update(&h->state, (const uint8_t *)p, len);
+	else if ((fp = uc_digest_file_handle(data)) != NULL) {
+		if (!uc_digest_update_file(h->algo, &h->state, fp))
+			return NULL;
+	}
+	else
+		return NULL;
+
+	return ucv_get(_uc_fn_this_res(vm));
+}
+
+/**
+ * Finishes the digest computation and returns the result.
+ *
+ * The hasher is reset afterwards and may be reused for new data.
+ *
+ * The `encoding` argument selects the result format:
+ *  - `"hex"` (default) returns a lowercase hex string
+ *  - `"binary"` returns the raw digest bytes as string
+ *  - `"integer"` returns the digest as number, only supported for digests
+ *    of up to 64 bit such as `crc32c`, `xxh32` and `xxh64`
+ *
+ * Returns `null` if an invalid encoding is given, the hasher state is left
+ * untouched in this case.
+ *
+ * @function module:digest.hasher#final
+ *
+ * @param {string} [encoding="hex"]
+ * The result encoding.
+ *
+ * @returns {?(string|number)}
+ *
+ * @example
+ * hasher("sha1").update("This is a test").final();
+ * // Returns "a54d88e06612d820bc3be72877c74f257b561b19"
+ */
+static uc_value_t *
+uc_digest_hasher_final(uc_vm_t *vm, size_t nargs)
+{
+	uc_digest_hasher_t *h = uc_fn_thisval("digest.hasher");
+	uc_value_t *encoding = uc_fn_arg(0);
+	uint8_t out[DIGEST_MAX_LENGTH];
+
+	if (!h || (encoding && ucv_type(encoding) != UC_STRING))
+		return NULL;
+
+	/* keep the state intact if the result can't be encoded */
+	if (!uc_digest_encoding_valid(h->algo, ucv_string_get(encoding)))
+		return NULL;
+
+	h->algo->final(&h->state, out);
+	h->algo->init(&h->state, h->seed);
+
+	return uc_digest_encode(h->algo, out, ucv_string_get(encoding));
+}
+
+/**
+ * Discards all data fed into the hasher so far.
+ *
+ * Returns the hasher itself.
+ *
+ * @function module:digest.hasher#reset
+ *
+ * @returns {module:digest.hasher}
+ */
+static uc_value_t *
+uc_digest_hasher_reset(uc_vm_t *vm, size_t nargs)
+{
+	uc_digest_hasher_t *h = uc_fn_thisval("digest.hasher");
+
+	if (!h)
+		return NULL;
+
+	h->algo->init(&h->state, h->seed);
+
+	return ucv_get(_uc_fn_this_res(vm));
+}
+
+/**
+ * Duplicates the hasher including its current state.
+ *
+ * This allows computing digests of several messages sharing a common prefix
+ * without hashing the prefix repeatedly.
+ *
+ * @function module:digest.hasher#copy
+ *
+ * @returns {module:digest.hasher}
+ */
+static uc_value_t *
+uc_digest_hasher_copy(uc_vm_t *vm, size_t nargs)
+{
+	uc_digest_hasher_t *h = uc_fn_thisval("digest.hasher");
+	uc_digest_hasher_t *copy;
+	uc_value_t *res;
+
+	if (!h)
+		return NULL;
+
+	res = uc_digest_hasher_new(vm, h->algo, h->seed);
+	copy = ucv_resource_data(res, "digest.hasher");
+
+	if (copy)
+		copy->state = h->state;
+
+	return res;
+}
+
+/**
+ * Creates a hasher object for incremental digest computation.
+ *
+ * Supported algorithms are `md5`, `sha1`, `sha256`, `crc32c`, `xxh32` and
+ * `xxh64`. The SHA and CRC32C implementations use CPU instructions (SHA-NI,
+ * SSE4.2, ARMv8 crypto and CRC extensions) when available at runtime.
+ *
+ * The optional seed is used as initial CRC value for `crc32c` and as seed for
+ * the xxHash algorithms, it is ignored otherwise.
+ *
+ * Returns `null` if an unknown algorithm is given.
+ *
+ * @function module:digest#hasher
+ *
+ * @param {string} algorithm
+ * The digest algorithm to use.
+ *
+ * @param {number} [seed=0]
+ * The seed value.
+ *
+ * @returns {?module:digest.hasher}
+ *
+ * @example
+ * const h = hasher("sha256");
+ *
+ * for (let chunk in chunks)
+ *     h.update(chunk);
+ *
+ * print(h.final(), "\n");
+ */
+static uc_value_t *
+uc_digest_hasher(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *algo = uc_fn_arg(0);
+	size_t i;
+
+	if (ucv_type(algo) != UC_STRING)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(digest_algos); i++)
+		if (!strcmp(digest_algos[i].name, ucv_string_get(algo)))
+			return uc_digest_hasher_new(vm, &digest_algos[i],
+			                            uc_digest_seed(uc_fn_arg(1)));
+
+	return NULL;
+}
+
+/**
+ * Calculates the CRC32C (Castagnoli) checksum of the given data.
+ *
+ * A previously returned checksum may be passed as second argument to continue
+ * the calculation over subsequent data.
+ *
+ * Returns `null` if a non-string argument is given.
+ *
+ * @function module:digest#crc32c
+ *
+ * @param {string} data
+ * The data to checksum.
+ *
+ * @param {number} [crc=0]
+ * The checksum to continue from.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * crc32c("This is a test");               // Returns 3635254285
+ * crc32c(" test", crc32c("This is a"));   // Returns 3635254285
+ */
+static uc_value_t *
+uc_digest_crc32c(uc_vm_t *vm, size_t nargs)
+{
+	return uc_digest_calc(uc_fn_arg(0), &digest_algos[DIGEST_CRC32C],
+	                      uc_digest_seed(uc_fn_arg(1)),
+	                      "integer");
+}
+
+/**
+ * Calculates the 32 bit xxHash of the given data.
+ *
+ * Returns `null` if a non-string argument is given.
+ *
+ * @function module:digest#xxh32
+ *
+ * @param {string} data
+ * The data to hash.
+ *
+ * @param {number} [seed=0]
+ * The seed value.
+ *
+ * @returns {?number}
+ */
+static uc_value_t *
+uc_digest_xxh32(uc_vm_t *vm, size_t nargs)
+{
+	return uc_digest_calc(uc_fn_arg(0), &digest_algos[DIGEST_XXH32],
+	                      uc_digest_seed(uc_fn_arg(1)),
+	                      "integer");
+}
+
+/**
+ * Calculates the 64 bit xxHash of the given data.
+ *
+ * The xxHash functions are not suitable for cryptographic purposes but are
+ * considerably faster than any of the SHA digests, making them a good fit
+ * for cache keys and change detection.
+ *
+ * Returns `null` if a non-string argument is given.
+ *
+ * @function module:digest#xxh64
+ *
+ * @param {string} data
+ * The data to hash.
+ *
+ * @param {number} [seed=0]
+ * The seed value.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * xxh64("This is a test");  // Returns a 64 bit unsigned number
+ */
+static uc_value_t *
+uc_digest_xxh64(uc_vm_t *vm, size_t nargs)
+{
+	return uc_digest_calc(uc_fn_arg(0), &digest_algos[DIGEST_XXH64],
+	                      uc_digest_seed(uc_fn_arg(1)),
+	                      "integer");
+}
+
+/**
+ * Reports the implementations selected for the current CPU.
+ *
+ * Returns an object with the keys `sha1`, `sha256` and `crc32c`, each holding
+ * the name of the implementation in use, e.g. `"sha-ni"`, `"sse4.2"`,
+ * `"armv8-ce"` or `"generic"`.
+ *
+ * @function module:digest#implementations
+ *
+ * @returns {Object<string, string>}
+ */
+static uc_value_t *
+uc_digest_implementations(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *rv = ucv_object_new(vm);
+
+	ucv_object_add(rv, "sha1", ucv_string_new(digest_impl.sha1_impl));
+	ucv_object_add(rv, "sha256", ucv_string_new(digest_impl.sha256_impl));
+	ucv_object_add(rv, "crc32c", ucv_string_new(digest_impl.crc32c_impl));
+
+	return rv;
+}
+
+
 static const uc_function_list_t global_fns[] = {
 	{ "md5",         uc_digest_md5         },
 	{ "sha1",        uc_digest_sha1        },
@@ -354,6 +1790,11 @@ static const uc_function_list_t global_fns[] = {
 	{ "md5_file",    uc_digest_md5_file    },
 	{ "sha1_file",   uc_digest_sha1_file   },
 	{ "sha256_file", uc_digest_sha256_file },
+	{ "crc32c",      uc_digest_crc32c      },
+	{ "xxh32",       uc_digest_xxh32       },
+	{ "xxh64",       uc_digest_xxh64       },
+	{ "hasher",      uc_digest_hasher      },
+	{ "implementations", uc_digest_implementations },
 #ifdef HAVE_DIGEST_EXTENDED
 	{ "md2",         uc_digest_md2         },
 	{ "md4",         uc_digest_md4         },
@@ -366,7 +1807,18 @@ static const uc_function_list_t global_fns[] = {
 #endif
 };
 
+static const uc_function_list_t hasher_fns[] = {
+	{ "update",      uc_digest_hasher_update },
+	{ "final",       uc_digest_hasher_final  },
+	{ "reset",       uc_digest_hasher_reset  },
+	{ "copy",        uc_digest_hasher_copy   },
+};
+
 void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 {
+	digest_dispatch_init();
+
 	uc_function_list_register(scope, global_fns);
+
+	uc_type_declare(vm, "digest.hasher", hasher_fns, NULL);
 }
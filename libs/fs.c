@@ -152,6 +152,7 @@ static uc_value_t *
 uc_fs_read_common(uc_vm_t *vm, size_t nargs, const char *type)
 {
 	uc_value_t *limit = uc_fn_arg(0);
+	uc_value_t *target = uc_fn_arg(1);
 	uc_value_t *rv = NULL;
 	char buf[128], *p = NULL, *tmp;
 	size_t rlen, len = 0;
@@ -164,6 +165,10 @@ uc_fs_read_common(uc_vm_t *vm, size_t nargs, const char *type)
 	if (!fp || !*fp)
 		err_return(EBADF);
 
+	/* reject unusable targets before consuming any input */
+	if (target && !ucv_bytes_reserve(vm, target, 0))
+		err_return(EINVAL);
+
 	if (ucv_type(limit) == UC_STRING) {
 		lstr = ucv_string_get(limit);
 		llen = ucv_string_length(limit);
@@ -218,6 +223,22 @@ uc_fs_read_common(uc_vm_t *vm, size_t nargs, const char *type)
 		if (lsize <= 0)
 			return NULL;
 
+		/* read directly into a given byte buffer */
+		if (target) {
+			p = ucv_bytes_reserve(vm, target, lsize);
+
+			if (!p)
+				err_return(EINVAL);
+
+			len = fread(p, 1, lsize, *fp);
+			ucv_bytes_commit(target, len);
+
+			if (ferror(*fp))
+				err_return(errno);
+
+			return ucv_int64_new(len);
+		}
+
 		p = calloc(1, lsize);
 
 		if (!p)
@@ -234,6 +255,24 @@ uc_fs_read_common(uc_vm_t *vm, size_t nargs, const char *type)
 		err_return(EINVAL);
 	}
 
+	/* store delimited reads in the given byte buffer */
+	if (target) {
+		tmp = ucv_bytes_reserve(vm, target, len);
+
+		if (!tmp) {
+			free(p);
+			err_return(EINVAL);
+		}
+
+		if (len)
+			memcpy(tmp, p, len);
+
+		ucv_bytes_commit(target, len);
+		free(p);
+
+		return ucv_int64_new(len);
+	}
+
 	rv = ucv_string_new_length(p, len);
 	free(p);
 
@@ -252,9 +291,8 @@ uc_fs_write_common(uc_vm_t *vm, size_t nargs, const char *type)
 	if (!fp || !*fp)
 		err_return(EBADF);
 
-	if (ucv_type(data) == UC_STRING) {
-		len = ucv_string_length(data);
-		wsize = fwrite(ucv_string_get(data), 1, len, *fp);
+	if ((str = ucv_bytes_get(data, &len)) != NULL) {
+		wsize = fwrite(str, 1, len, *fp);
 	}
 	else {
 		str = ucv_to_jsonstring(vm, data);
@@ -641,7 +679,12 @@ uc_fs_close(uc_vm_t *vm, size_t nargs)
  *    EOF. The returned data will contain the terminating character if one was
  *    read.
  *
- * Returns a string containing the read data.
+ * If a byte buffer, such as a `struct.buffer()` instance, is given, the read
+ * data is stored in the buffer at its current position and the position is
+ * advanced past it. Numeric lengths are read directly into the buffer.
+ *
+ * Returns a string containing the read data or, if reading into a buffer, the
+ * number of bytes read.
  *
  * Returns an empty string on EOF.
  *
@@ -653,7 +696,10 @@ uc_fs_close(uc_vm_t *vm, size_t nargs)
  * The length of data to read. Can be a number, the string "line", the string
  * "all", or a single character string.
  *
- * @returns {?string}
+ * @param {module:struct.buffer} [buffer]
+ * The buffer to read data into.
+ *
+ * @returns {?string|number}
  *
  * @example
  * const fp = open("file.txt", "r");
@@ -681,7 +727,8 @@ uc_fs_read(uc_vm_t *vm, size_t nargs)
  * Writes a chunk of data to the file handle.
  *
  * In case the given data is not a string, it is converted to a string before
- * being written into the file. String values are written as-is, integer and
+ * being written into the file. String values and byte buffers, such as
+ * `struct.buffer()` instances and their views, are written as-is, integer and
  * double values are written in decimal notation, boolean values are written as
  * `true` or `false` while arrays and objects are converted to their JSON
  * representation before being written. The `null` value is represented by an
@@ -1080,6 +1127,7 @@ uc_fs_ioctl(uc_vm_t *vm, size_t nargs)
 		mem->refcount = 1;
 		buf = ucv_string_get(mem);
 		((uc_string_t *)mem)->length = sz;
+		ucv_account(mem);
 		break;
 
 	case IOC_DIR_RW:
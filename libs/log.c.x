@@ -121,16 +121,352 @@
 
 #include <syslog.h>
 #include <errno.h>
+#include <time.h>
 
 #ifdef HAVE_ULOG
 #include <libubox/ulog.h>
+#include <libubox/uloop.h>
 #endif
 
 #include "ucode/module.h"
 
 
+#define LOG_SINK_MAXARGS 8
+
+enum {
+	LOG_BACKEND_SYSLOG,
+	LOG_BACKEND_ULOG,
+};
+
+typedef struct {
+	int priority;
+	uint8_t backend;
+	uint8_t nargs;
+	bool raw;
+	uc_value_t *args[LOG_SINK_MAXARGS];
+} log_entry_t;
+
+typedef struct {
+	bool active;
+	bool drop;
+	log_entry_t *ring;
+	size_t size, head, count, batch;
+	uint32_t interval;
+	double rate, burst, tokens;
+	struct timespec refill, since;
+	uint64_t queued, emitted, dropped_full, dropped_rate, suppressed;
+	int suppressed_backend;
+#ifdef HAVE_ULOG
+	struct uloop_timeout timer;
+#endif
+} log_sink_t;
+
 static char log_ident[32];
 
+static void
+log_emit(int backend, int priority, const char *msg)
+{
+#ifdef HAVE_ULOG
+	if (backend == LOG_BACKEND_ULOG) {
+		ulog(priority, "%s", msg);
+
+		return;
+	}
+#endif
+
+	syslog(priority, "%s", msg);
+}
+
+static void
+log_entry_free(log_entry_t *e)
+{
+	while (e->nargs > 0)
+		ucv_put(e->args[--e->nargs]);
+}
+
+static uint64_t
+log_elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)(now.tv_sec - since->tv_sec) * 1000 +
+		(now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/*
+ * Emit up to `max` queued messages. Formatting happens here and does not
+ * require a running VM since only immutable scalar arguments are ever
+ * queued, which allows draining the ring from timer callbacks and when the
+ * owning VM is torn down.
+ */
+static size_t
+log_sink_drain(log_sink_t *sink, size_t max)
+{
+	uc_stringbuf_t *buf;
+	log_entry_t *e;
+	size_t n = 0;
+
+	if (!sink->ring)
+		return 0;
+
+	buf = ucv_stringbuf_new();
+
+	if (sink->suppressed) {
+		ucv_stringbuf_printf(buf, "%" PRIu64 " log messages suppressed",
+			sink->suppressed);
+
+		log_emit(sink->suppressed_backend, LOG_WARNING, buf->buf);
+		sink->suppressed = 0;
+	}
+
+	while (n < max && sink->count > 0) {
+		e = &sink->ring[sink->head];
+
+		if (e->raw) {
+			log_emit(e->backend, e->priority, ucv_string_get(e->args[0]));
+		}
+		else {
+			printbuf_reset(buf);
+			uc_format_values(NULL, buf, e->args, e->nargs);
+			log_emit(e->backend, e->priority, buf->buf);
+		}
+
+		log_entry_free(e);
+
+		sink->head = (sink->head + 1) % sink->size;
+		sink->count--;
+		sink->emitted++;
+		n++;
+	}
+
+	printbuf_free(buf);
+
+	clock_gettime(CLOCK_MONOTONIC, &sink->since);
+
+	return n;
+}
+
+#ifdef HAVE_ULOG
+static void
+log_sink_timer_cb(struct uloop_timeout *timeout)
+{
+	log_sink_t *sink = container_of(timeout, log_sink_t, timer);
+
+	log_sink_drain(sink, sink->batch);
+
+	/* yield back to the event loop between batches */
+	if (sink->count > 0)
+		uloop_timeout_set(timeout, 0);
+}
+#endif
+
+static void
+log_sink_schedule(log_sink_t *sink)
+{
+#ifdef HAVE_ULOG
+	if (!sink->timer.pending)
+		uloop_timeout_set(&sink->timer, sink->interval);
+#else
+	(void)sink;
+#endif
+}
+
+static void
+log_sink_release(log_sink_t *sink)
+{
+	log_sink_drain(sink, SIZE_MAX);
+
+#ifdef HAVE_ULOG
+	uloop_timeout_cancel(&sink->timer);
+#endif
+
+	free(sink->ring);
+
+	sink->ring = NULL;
+	sink->active = false;
+	sink->size = 0;
+	sink->head = 0;
+	sink->count = 0;
+}
+
+/* The sink belongs to the VM, queued values are released along with it. */
+static void
+log_sink_free(void *ud)
+{
+	log_sink_t *sink = ud;
+
+	log_sink_release(sink);
+	free(sink);
+}
+
+static log_sink_t *
+log_sink_get(uc_vm_t *vm, bool create)
+{
+	uc_value_t *res = uc_vm_registry_get(vm, "log.sink");
+	log_sink_t *sink = ucv_resource_data(res, "log.sink");
+
+	if (!sink && create) {
+		sink = xalloc(sizeof(*sink));
+
+#ifdef HAVE_ULOG
+		sink->timer.cb = log_sink_timer_cb;
+#endif
+
+		res = ucv_resource_create(vm, "log.sink", sink);
+
+		uc_vm_registry_set(vm, "log.sink", res);
+	}
+
+	return sink;
+}
+
+static log_sink_t *
+log_sink_active(uc_vm_t *vm)
+{
+	log_sink_t *sink = log_sink_get(vm, false);
+
+	return (sink && sink->active) ? sink : NULL;
+}
+
+static bool
+log_sink_ratelimit(log_sink_t *sink)
+{
+	struct timespec now;
+	double elapsed;
+
+	if (sink->rate <= 0)
+		return true;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	elapsed = (now.tv_sec - sink->refill.tv_sec) +
+		(now.tv_nsec - sink->refill.tv_nsec) / 1e9;
+
+	sink->refill = now;
+	sink->tokens += elapsed * sink->rate;
+
+	if (sink->tokens > sink->burst)
+		sink->tokens = sink->burst;
+
+	if (sink->tokens < 1)
+		return false;
+
+	sink->tokens -= 1;
+
+	return true;
+}
+
+static bool
+log_sink_capturable(uc_value_t *val)
+{
+	switch (ucv_type(val)) {
+	case UC_NULL:
+	case UC_BOOLEAN:
+	case UC_INTEGER:
+	case UC_DOUBLE:
+	case UC_STRING:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/*
+ * Queue the message formed by the arguments `off` .. `nargs - 1` of the
+ * current call. Arguments which may change or be collected before the next
+ * flush, such as arrays, objects or resources, cause the message to be
+ * formatted immediately instead.
+ */
+static bool
+log_sink_enqueue(uc_vm_t *vm, log_sink_t *sink, size_t nargs, size_t off,
+                 int backend, int priority)
+{
+	uc_value_t *fmt = uc_fn_arg(off), *msg;
+	log_entry_t *e;
+	bool capture;
+	size_t i;
+	char *s;
+
+	if (ucv_type(fmt) == UC_NULL)
+		return false;
+
+	/* without an event loop driving the timer, pending messages are
+	 * written out by the first log call after the interval elapsed */
+	if (sink->count > 0 && log_elapsed_ms(&sink->since) >= sink->interval)
+		log_sink_drain(sink, SIZE_MAX);
+
+	if (!log_sink_ratelimit(sink)) {
+		sink->dropped_rate++;
+		sink->suppressed++;
+		sink->suppressed_backend = backend;
+
+		return false;
+	}
+
+	if (sink->count == sink->size) {
+		if (sink->drop) {
+			sink->dropped_full++;
+			sink->suppressed++;
+			sink->suppressed_backend = backend;
+
+			return false;
+		}
+
+		log_sink_drain(sink, sink->batch);
+	}
+
+	if (sink->count == 0)
+		clock_gettime(CLOCK_MONOTONIC, &sink->since);
+
+	e = &sink->ring[(sink->head + sink->count) % sink->size];
+	e->backend = backend;
+	e->priority = priority;
+	e->raw = false;
+	e->nargs = 0;
+
+	if (ucv_type(fmt) == UC_STRING) {
+		capture = (nargs - off <= LOG_SINK_MAXARGS);
+
+		for (i = off + 1; capture && i < nargs; i++)
+			capture = log_sink_capturable(uc_fn_arg(i));
+
+		if (capture) {
+			for (i = off; i < nargs; i++)
+				e->args[e->nargs++] = ucv_get(uc_fn_arg(i));
+		}
+		else {
+			msg = uc_stdlib_function("sprintf")(vm, nargs - off);
+
+			if (!msg)
+				return false;
+
+			e->args[e->nargs++] = msg;
+			e->raw = true;
+		}
+	}
+	else {
+		s = ucv_to_string(vm, fmt);
+
+		if (!s)
+			return false;
+
+		e->args[e->nargs++] = ucv_string_new(s);
+		e->raw = true;
+
+		free(s);
+	}
+
+	sink->count++;
+	sink->queued++;
+
+	log_sink_schedule(sink);
+
+	return true;
+}
+
 /**
  * The following log option strings are recognized:
  *
@@ -490,10 +826,15 @@ static uc_value_t *
 uc_syslog(uc_vm_t *vm, size_t nargs)
 {
 	int priority = parse_priority(uc_fn_arg(0));
+	log_sink_t *sink;
 
 	if (priority == -1 || nargs < 2)
 		return ucv_boolean_new(false);
 
+	if ((sink = log_sink_active(vm)) != NULL)
+		return ucv_boolean_new(
+			log_sink_enqueue(vm, sink, nargs, 1, LOG_BACKEND_SYSLOG, priority));
+
 	uc_value_t *fmt = uc_fn_arg(1), *msg;
 	uc_cfn_ptr_t fmtfn;
 	char *s;
@@ -548,6 +889,206 @@ uc_closelog(uc_vm_t *vm, size_t nargs)
 }
 
 
+static bool
+parse_sink_option(uc_value_t *options, const char *name, double *value)
+{
+	uc_value_t *val = ucv_object_get(options, name, NULL);
+
+	switch (ucv_type(val)) {
+	case UC_NULL:
+		return true;
+
+	case UC_INTEGER:
+	case UC_DOUBLE:
+		*value = ucv_to_double(val);
+
+		return (*value >= 0);
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Enable buffered, asynchronous logging.
+ *
+ * Once a log sink is active, `syslog()`, `ulog()` and the ulog convenience
+ * functions no longer emit messages immediately but append them to an
+ * in-process ring buffer. Format string processing is deferred until the
+ * buffered messages are written out, unless an argument is an array, object or
+ * other mutable value, in which case the message is formatted right away.
+ *
+ * Buffered messages are emitted in batches by a uloop timer when running an
+ * event loop. Without one, pending messages are written out by the first log
+ * call after the flush interval elapsed. They are also written out when
+ * calling {@link module:log#sink_flush|sink_flush()}, when the ring buffer is
+ * full, when the sink is closed and when the VM is torn down. Each VM has its
+ * own sink. Since messages are
+ * passed to the system logger only when flushed, log timestamps reflect the
+ * time of emission rather than the time of the `syslog()` call.
+ *
+ * An optional rate limit drops messages exceeding the configured number of
+ * messages per second. The amount of dropped messages is reported by a summary
+ * message upon the next flush and counted in the statistics returned by
+ * {@link module:log#sink_stats|sink_stats()}.
+ *
+ * Calling `sink_open()` while a sink is already active flushes pending
+ * messages and reconfigures the sink.
+ *
+ * Returns `true` if the sink has been enabled.
+ *
+ * Returns `false` if invalid options were given.
+ *
+ * @function module:log#sink_open
+ *
+ * @param {Object} [options]
+ * The sink options.
+ *
+ * @param {number} [options.size=256]
+ * The capacity of the ring buffer in messages.
+ *
+ * @param {number} [options.batch=32]
+ * The maximum number of messages to emit at once.
+ *
+ * @param {number} [options.interval=100]
+ * The flush interval in milliseconds.
+ *
+ * @param {number} [options.rate=0]
+ * The maximum number of messages per second, `0` disables rate limiting.
+ *
+ * @param {number} [options.burst]
+ * The number of messages which may exceed the rate limit at once, defaults to
+ * the rate value.
+ *
+ * @param {boolean} [options.drop=false]
+ * Whether to drop new messages when the ring buffer is full instead of flushing
+ * it synchronously.
+ *
+ * @returns {boolean}
+ *
+ * @example
+ * // Buffer up to 1024 messages and allow at most 50 messages per second
+ * sink_open({ size: 1024, rate: 50, burst: 100 });
+ *
+ * syslog(LOG_INFO, "Request %d served in %.3fs", id, duration);
+ */
+static uc_value_t *
+uc_sink_open(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *options = uc_fn_arg(0);
+	double size = 256, batch = 32, interval = 100, rate = 0, burst = -1;
+	log_sink_t *sink;
+
+	if (options && ucv_type(options) != UC_OBJECT)
+		return ucv_boolean_new(false);
+
+	if (!parse_sink_option(options, "size", &size) ||
+	    !parse_sink_option(options, "batch", &batch) ||
+	    !parse_sink_option(options, "interval", &interval) ||
+	    !parse_sink_option(options, "rate", &rate) ||
+	    !parse_sink_option(options, "burst", &burst))
+		return ucv_boolean_new(false);
+
+	if (size < 1 || size > 65536 || batch < 1 || interval > UINT32_MAX)
+		return ucv_boolean_new(false);
+
+	sink = log_sink_get(vm, true);
+
+	log_sink_release(sink);
+
+	sink->ring = xalloc(sizeof(*sink->ring) * (size_t)size);
+	sink->size = (size_t)size;
+	sink->batch = (size_t)batch;
+	sink->interval = (uint32_t)interval;
+	sink->rate = rate;
+	sink->burst = (burst < 1) ? ((rate < 1) ? 1 : rate) : burst;
+	sink->tokens = sink->burst;
+	sink->drop = ucv_is_truish(ucv_object_get(options, "drop", NULL));
+	sink->active = true;
+
+	clock_gettime(CLOCK_MONOTONIC, &sink->refill);
+
+	return ucv_boolean_new(true);
+}
+
+/**
+ * Emit buffered log messages.
+ *
+ * Writes out all messages currently held in the log sink ring buffer.
+ *
+ * Returns the number of emitted messages.
+ *
+ * @function module:log#sink_flush
+ *
+ * @returns {number}
+ *
+ * @example
+ * syslog(LOG_INFO, "About to exit");
+ * sink_flush();
+ */
+static uc_value_t *
+uc_sink_flush(uc_vm_t *vm, size_t nargs)
+{
+	log_sink_t *sink = log_sink_get(vm, false);
+
+	return ucv_uint64_new(sink ? log_sink_drain(sink, SIZE_MAX) : 0);
+}
+
+/**
+ * Disable buffered logging.
+ *
+ * Flushes all pending messages and releases the log sink. Subsequent log
+ * messages are emitted synchronously again.
+ *
+ * @function module:log#sink_close
+ */
+static uc_value_t *
+uc_sink_close(uc_vm_t *vm, size_t nargs)
+{
+	log_sink_t *sink = log_sink_get(vm, false);
+
+	if (sink)
+		log_sink_release(sink);
+
+	return NULL;
+}
+
+/**
+ * Query log sink statistics.
+ *
+ * Returns an object with the following counters, accumulated over the lifetime
+ * of the VM:
+ *
+ * - `queued` - number of messages accepted into the ring buffer
+ * - `pending` - number of messages currently awaiting emission
+ * - `emitted` - number of messages passed to the system logger
+ * - `dropped` - number of messages dropped due to a full ring buffer
+ * - `ratelimited` - number of messages dropped by the rate limit
+ *
+ * @function module:log#sink_stats
+ *
+ * @returns {Object<string, number>}
+ *
+ * @example
+ * const st = sink_stats();
+ * printf("%d of %d messages lost\n", st.dropped + st.ratelimited, st.queued);
+ */
+static uc_value_t *
+uc_sink_stats(uc_vm_t *vm, size_t nargs)
+{
+	log_sink_t *sink = log_sink_get(vm, true);
+	uc_value_t *rv = ucv_object_new(vm);
+
+	ucv_object_add(rv, "queued", ucv_uint64_new(sink->queued));
+	ucv_object_add(rv, "pending", ucv_uint64_new(sink->count));
+	ucv_object_add(rv, "emitted", ucv_uint64_new(sink->emitted));
+	ucv_object_add(rv, "dropped", ucv_uint64_new(sink->dropped_full));
+	ucv_object_add(rv, "ratelimited", ucv_uint64_new(sink->dropped_rate));
+
+	return rv;
+}
+
+
 #ifdef HAVE_ULOG
 /**
  * The following ulog channel strings are recognized:
@@ -695,8 +1236,13 @@ uc_ulog_log_common(uc_vm_t *vm, size_t nargs, int priority)
 {
 	uc_value_t *fmt = uc_fn_arg(0), *msg;
 	uc_cfn_ptr_t fmtfn;
+	log_sink_t *sink;
 	char *s;
 
+	if ((sink = log_sink_active(vm)) != NULL)
+		return ucv_boolean_new(
+			log_sink_enqueue(vm, sink, nargs, 0, LOG_BACKEND_ULOG, priority));
+
 	switch (ucv_type(fmt)) {
 	case UC_STRING:
 		fmtfn = uc_stdlib_function("sprintf");
@@ -1006,6 +1552,10 @@ static const uc_function_list_t global_fns[] = {
 	{ "openlog",		uc_openlog },
 	{ "syslog",			uc_syslog },
 	{ "closelog",		uc_closelog },
+	{ "sink_open",		uc_sink_open },
+	{ "sink_flush",		uc_sink_flush },
+	{ "sink_close",		uc_sink_close },
+	{ "sink_stats",		uc_sink_stats },
 
 #ifdef HAVE_ULOG
 	{ "ulog_open",		uc_ulog_open },
@@ -1024,6 +1574,8 @@ void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 {
 	uc_function_list_register(scope, global_fns);
 
+	ucv_resource_type_add(vm, "log.sink", NULL, log_sink_free);
+
 #define ADD_CONST(x) ucv_object_add(scope, #x, ucv_int64_new(x))
 
 	ADD_CONST(LOG_PID);
@@ -48,6 +48,8 @@
 
 #include <math.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 #include "module.h"
@@ -371,6 +373,130 @@ uc_pow(uc_vm_t *vm, size_t nargs)
 	return ucv_double_new(pow(x, y));
 }
 
+/*
+ * Pseudo-random number generation. Each VM owns a default xoshiro256**
+ * generator used by the module level functions, additional independent
+ * generators are created with prng(). Functions shared by both resolve the
+ * generator from the `this` context and fall back to the VM default one.
+ */
+
+typedef struct {
+	uint64_t s[4];
+} uc_math_prng_t;
+
+static uint64_t
+math_splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+}
+
+static void
+math_prng_seed(uc_math_prng_t *g, uint64_t seed)
+{
+	g->s[0] = math_splitmix64(&seed);
+	g->s[1] = math_splitmix64(&seed);
+	g->s[2] = math_splitmix64(&seed);
+	g->s[3] = math_splitmix64(&seed);
+}
+
+static inline uint64_t
+math_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t
+math_prng_next(uc_math_prng_t *g)
+{
+	uint64_t res = math_rotl(g->s[1] * 5, 7) * 9;
+	uint64_t t = g->s[1] << 17;
+
+	g->s[2] ^= g->s[0];
+	g->s[3] ^= g->s[1];
+	g->s[1] ^= g->s[2];
+	g->s[0] ^= g->s[3];
+	g->s[2] ^= t;
+	g->s[3] = math_rotl(g->s[3], 45);
+
+	return res;
+}
+
+/* uniform double in [0, 1) */
+static inline double
+math_prng_double(uc_math_prng_t *g)
+{
+	return (math_prng_next(g) >> 11) * 0x1.0p-53;
+}
+
+/* uniform integer in [0, range), a range of 0 denotes the full 64 bit span */
+static uint64_t
+math_prng_below(uc_math_prng_t *g, uint64_t range)
+{
+	uint64_t mask = range - 1, x;
+
+	if (range == 0)
+		return math_prng_next(g);
+
+	/* reject values outside the smallest covering power of two instead of
+	 * using a modulo which would favour lower values */
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+	mask |= mask >> 32;
+
+	do {
+		x = math_prng_next(g) & mask;
+	} while (x >= range);
+
+	return x;
+}
+
+static int64_t
+math_prng_between(uc_math_prng_t *g, int64_t a, int64_t b)
+{
+	int64_t t;
+
+	if (a > b) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	return (int64_t)((uint64_t)a + math_prng_below(g, (uint64_t)b - (uint64_t)a + 1));
+}
+
+static uc_math_prng_t *
+math_prng_get(uc_vm_t *vm)
+{
+	uc_math_prng_t *g = uc_fn_thisval("math.prng");
+	struct timeval tv;
+	uc_value_t *res;
+
+	if (g)
+		return g;
+
+	g = ucv_resource_data(uc_vm_registry_get(vm, "math.prng"), "math.prng");
+
+	if (g)
+		return g;
+
+	res = ucv_resource_create_ex(vm, "math.prng", (void **)&g, 0, sizeof(*g));
+
+	gettimeofday(&tv, NULL);
+	math_prng_seed(g, ((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec) ^ (uintptr_t)g);
+
+	uc_vm_registry_set(vm, "math.prng", res);
+
+	return g;
+}
+
 /**
  * Depending on the arguments, it produces a pseudo-random positive integer, 
  * or a pseudo-random number in a supplied range.
@@ -390,7 +516,11 @@ uc_pow(uc_vm_t *vm, size_t nargs)
  * If no seed value is explicitly set by calling
  * {@link module:math~srand `srand()`} prior to the first call to `rand()`,
  * the math module will automatically seed the PRNG once, using the current
- * time of day in milliseconds as seed value.
+ * time of day as seed value.
+ *
+ * Numbers are drawn from a xoshiro256** generator private to the running VM,
+ * or from the generator object the function is invoked on, see
+ * {@link module:math#prng|prng()}.
  *
  * @function module:math#rand
  *
@@ -405,24 +535,17 @@ uc_pow(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_rand(uc_vm_t *vm, size_t nargs)
 {
-	struct timeval tv;
-
-	if (!ucv_boolean_get(uc_vm_registry_get(vm, "math.srand_called"))) {
-		gettimeofday(&tv, NULL);
-		srand((tv.tv_sec * 1000) + (tv.tv_usec / 1000));
-
-		uc_vm_registry_set(vm, "math.srand_called", ucv_boolean_new(true));
-	}
+	uc_math_prng_t *g = math_prng_get(vm);
 
 	if (nargs == 0)
-		return ucv_int64_new(rand());
+		return ucv_int64_new(math_prng_below(g, (uint64_t)RAND_MAX + 1));
 
 	double a = ucv_to_double(uc_fn_arg(0)), b = 0;
 
 	if (nargs > 1)
 		b = ucv_to_double(uc_fn_arg(1));
 
-	return ucv_double_new(a + ((b - a) * rand()) / RAND_MAX);
+	return ucv_double_new(a + (b - a) * ((math_prng_next(g) >> 11) * (1.0 / 0x1fffffffffffffULL)));
 }
 
 /**
@@ -435,6 +558,9 @@ uc_rand(uc_vm_t *vm, size_t nargs)
  * Setting the same seed value will result in the same pseudo-random numbers
  * produced by {@link module:math~rand `rand()`}.
  *
+ * The seeding only affects the generator of the calling VM. When invoked as
+ * `seed()` method of a generator object, that generator is reseeded instead.
+ *
  * @function module:math#srand
  *
  * @param {number} seed
@@ -445,12 +571,366 @@ uc_srand(uc_vm_t *vm, size_t nargs)
 {
 	int64_t n = ucv_to_integer(uc_fn_arg(0));
 
-	srand((unsigned int)n);
-	uc_vm_registry_set(vm, "math.srand_called", ucv_boolean_new(true));
+	math_prng_seed(math_prng_get(vm), (uint64_t)n);
 
 	return NULL;
 }
 
+/**
+ * Produces a uniformly distributed pseudo-random integer in the range `a` to
+ * `b` inclusive.
+ *
+ * Unlike scaling the result of {@link module:math~rand `rand()`}, every value
+ * of the range is equally likely.
+ *
+ * Returns `null` if either bound is not a number.
+ *
+ * @function module:math#randint
+ *
+ * @param {number} a
+ * One end of the range.
+ *
+ * @param {number} b
+ * The other end of the range.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * // Randomized backoff between 100 and 500 ms
+ * sleep(randint(100, 500));
+ */
+static uc_value_t *
+uc_randint(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *a = uc_fn_arg(0), *b = uc_fn_arg(1);
+	uc_math_prng_t *g = math_prng_get(vm);
+	int64_t n;
+
+	if (ucv_type(a) != UC_INTEGER && ucv_type(a) != UC_DOUBLE)
+		return NULL;
+
+	if (ucv_type(b) != UC_INTEGER && ucv_type(b) != UC_DOUBLE)
+		return NULL;
+
+	n = math_prng_between(g, ucv_to_integer(a), ucv_to_integer(b));
+
+	return ucv_int64_new(n);
+}
+
+/**
+ * Randomly reorders the elements of the given array in place.
+ *
+ * Returns the given array or `null` if the argument is not an array. Raises a
+ * type exception if the array is immutable.
+ *
+ * @function module:math#shuffle
+ *
+ * @param {Array} arr
+ * The array to shuffle.
+ *
+ * @returns {?Array}
+ *
+ * @example
+ * shuffle([ 1, 2, 3, 4 ]);  // e.g. [ 3, 1, 4, 2 ]
+ */
+static uc_value_t *
+uc_shuffle(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *arr = uc_fn_arg(0), *t;
+	uc_math_prng_t *g = math_prng_get(vm);
+	uc_array_t *array;
+	size_t i, j;
+
+	if (ucv_type(arr) != UC_ARRAY)
+		return NULL;
+
+	if (ucv_is_constant(arr)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "array value is immutable");
+
+		return NULL;
+	}
+
+	array = (uc_array_t *)arr;
+
+	for (i = array->count; i > 1; i--) {
+		j = math_prng_below(g, i);
+
+		t = array->entries[i - 1];
+		array->entries[i - 1] = array->entries[j];
+		array->entries[j] = t;
+	}
+
+	return ucv_get(arr);
+}
+
+/**
+ * Randomly selects elements from the given array.
+ *
+ * Returns a new array holding `count` elements picked from distinct positions
+ * of the given array, in random order. If `count` exceeds the array length, all
+ * elements are returned in random order.
+ *
+ * Returns `null` if the first argument is not an array.
+ *
+ * @function module:math#sample
+ *
+ * @param {Array} arr
+ * The array to pick elements from.
+ *
+ * @param {number} [count=1]
+ * The number of elements to pick.
+ *
+ * @returns {?Array}
+ *
+ * @example
+ * // Pick two upstream servers
+ * sample([ "10.0.0.1", "10.0.0.2", "10.0.0.3" ], 2);
+ */
+static uc_value_t *
+uc_sample(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *arr = uc_fn_arg(0), *cnt = uc_fn_arg(1), *rv;
+	uc_math_prng_t *g = math_prng_get(vm);
+	size_t i, j, t, len, count;
+	size_t *idx;
+
+	if (ucv_type(arr) != UC_ARRAY)
+		return NULL;
+
+	len = ucv_array_length(arr);
+	count = cnt ? (size_t)ucv_to_unsigned(cnt) : 1;
+
+	if (count > len)
+		count = len;
+
+	idx = xalloc(sizeof(size_t) * (len ? len : 1));
+
+	for (i = 0; i < len; i++)
+		idx[i] = i;
+
+	rv = ucv_array_new_length(vm, count);
+
+	/* partial Fisher-Yates, only the first `count` slots are shuffled */
+	for (i = 0; i < count; i++) {
+		j = i + math_prng_below(g, len - i);
+
+		t = idx[i];
+		idx[i] = idx[j];
+		idx[j] = t;
+
+		ucv_array_push(rv, ucv_get(ucv_array_get(arr, idx[i])));
+	}
+
+	free(idx);
+
+	return rv;
+}
+
+/**
+ * Creates a new pseudo-random number generator.
+ *
+ * The returned object provides the methods `seed()`, `rand()`, `randint()`,
+ * `shuffle()` and `sample()`, which behave like the module functions
+ * {@link module:math#srand|srand()}, {@link module:math#rand|rand()},
+ * {@link module:math#randint|randint()}, {@link module:math#shuffle|shuffle()}
+ * and {@link module:math#sample|sample()} but operate on the generator's own
+ * state. Additionally, the `ints()`, `floats()` and `bytes()` methods generate
+ * values in bulk.
+ *
+ * Generators seeded with the same value produce the same sequence, regardless
+ * of other generators or the module level `srand()` state.
+ *
+ * @function module:math#prng
+ *
+ * @param {number} [seed]
+ * The seed value. If omitted, the generator is seeded from the VM default
+ * generator.
+ *
+ * @returns {module:math.prng}
+ *
+ * @example
+ * const rng = prng(42);
+ *
+ * rng.randint(1, 6);        // reproducible dice roll
+ * rng.ints(4, 0, 255);      // e.g. [ 12, 200, 7, 93 ]
+ * rng.floats(2);            // e.g. [ 0.184..., 0.912... ]
+ */
+static uc_value_t *
+uc_prng(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *seed = uc_fn_arg(0), *res;
+	uc_math_prng_t *g;
+	uint64_t s;
+
+	s = seed ? (uint64_t)ucv_to_integer(seed) : math_prng_next(math_prng_get(vm));
+	res = ucv_resource_create_ex(vm, "math.prng", (void **)&g, 0, sizeof(*g));
+
+	if (res)
+		math_prng_seed(g, s);
+
+	return res;
+}
+
+/**
+ * Represents a pseudo-random number generator created by
+ * {@link module:math#prng|prng()}.
+ *
+ * @class module:math.prng
+ * @hideconstructor
+ */
+
+/**
+ * Generates an array of uniformly distributed integers.
+ *
+ * Returns an array of `count` integers in the range `a` to `b` inclusive.
+ *
+ * Returns `null` if the count or the bounds are invalid.
+ *
+ * @function module:math.prng#ints
+ *
+ * @param {number} count
+ * The number of values to generate.
+ *
+ * @param {number} a
+ * One end of the range.
+ *
+ * @param {number} b
+ * The other end of the range.
+ *
+ * @returns {?number[]}
+ */
+static uc_value_t *
+uc_prng_ints(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *cnt = uc_fn_arg(0), *a = uc_fn_arg(1), *b = uc_fn_arg(2), *rv;
+	uc_math_prng_t *g = math_prng_get(vm);
+	int64_t lo, hi, t;
+	uint64_t range;
+	size_t i, count;
+
+	if (ucv_type(cnt) != UC_INTEGER || ucv_int64_get(cnt) < 0)
+		return NULL;
+
+	if (ucv_type(a) != UC_INTEGER && ucv_type(a) != UC_DOUBLE)
+		return NULL;
+
+	if (ucv_type(b) != UC_INTEGER && ucv_type(b) != UC_DOUBLE)
+		return NULL;
+
+	count = ucv_int64_get(cnt);
+	lo = ucv_to_integer(a);
+	hi = ucv_to_integer(b);
+
+	if (lo > hi) {
+		t = lo;
+		lo = hi;
+		hi = t;
+	}
+
+	range = (uint64_t)hi - (uint64_t)lo + 1;
+	rv = ucv_array_new_length(vm, count);
+
+	for (i = 0; i < count; i++)
+		ucv_array_push(rv,
+			ucv_int64_new((int64_t)((uint64_t)lo + math_prng_below(g, range))));
+
+	return rv;
+}
+
+/**
+ * Generates an array of uniformly distributed doubles.
+ *
+ * Returns an array of `count` doubles in the range `0` inclusive to `1`
+ * exclusive.
+ *
+ * Returns `null` if the count is invalid.
+ *
+ * @function module:math.prng#floats
+ *
+ * @param {number} count
+ * The number of values to generate.
+ *
+ * @returns {?number[]}
+ */
+static uc_value_t *
+uc_prng_floats(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *cnt = uc_fn_arg(0), *rv;
+	uc_math_prng_t *g = math_prng_get(vm);
+	size_t i, count;
+
+	if (ucv_type(cnt) != UC_INTEGER || ucv_int64_get(cnt) < 0)
+		return NULL;
+
+	count = ucv_int64_get(cnt);
+	rv = ucv_array_new_length(vm, count);
+
+	for (i = 0; i < count; i++)
+		ucv_array_push(rv, ucv_double_new(math_prng_double(g)));
+
+	return rv;
+}
+
+/**
+ * Generates random bytes.
+ *
+ * Without a `buffer` argument, returns a string of `count` random bytes.
+ *
+ * If a `struct.buffer` is given, `count` random bytes are written to it at its
+ * current position and the buffer is returned.
+ *
+ * Returns `null` if the count is invalid or if the buffer can't be written.
+ *
+ * @function module:math.prng#bytes
+ *
+ * @param {number} count
+ * The number of bytes to generate.
+ *
+ * @param {module:struct.buffer} [buffer]
+ * The buffer to write the bytes into.
+ *
+ * @returns {?(string|module:struct.buffer)}
+ */
+static uc_value_t *
+uc_prng_bytes(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *cnt = uc_fn_arg(0), *target = uc_fn_arg(1), *rv;
+	uc_math_prng_t *g = math_prng_get(vm);
+	size_t i, count;
+	uint64_t x;
+	char *p;
+
+	if (ucv_type(cnt) != UC_INTEGER || ucv_int64_get(cnt) < 0)
+		return NULL;
+
+	count = ucv_int64_get(cnt);
+	p = target ? ucv_bytes_reserve(vm, target, count) : xalloc(count + 1);
+
+	if (!p)
+		return NULL;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		x = math_prng_next(g);
+		memcpy(p + i, &x, 8);
+	}
+
+	if (i < count) {
+		x = math_prng_next(g);
+		memcpy(p + i, &x, count - i);
+	}
+
+	if (target) {
+		ucv_bytes_commit(target, count);
+
+		return ucv_get(target);
+	}
+
+	rv = ucv_string_new_length(p, count);
+	free(p);
+
+	return rv;
+}
+
 /**
  * Tests whether `x` is a `NaN` double.
  *
@@ -477,23 +957,965 @@ uc_isnan(uc_vm_t *vm, size_t nargs)
 	return ucv_boolean_new(ucv_type(v) == UC_DOUBLE && isnan(ucv_double_get(v)));
 }
 
-static const uc_function_list_t math_fns[] = {
-	{ "abs",	uc_abs },
-	{ "atan2",	uc_atan2 },
-	{ "cos",	uc_cos },
-	{ "exp",	uc_exp },
-	{ "log",	uc_log },
-	{ "sin",	uc_sin },
-	{ "sqrt",	uc_sqrt },
-	{ "pow",	uc_pow },
-	{ "rand",	uc_rand },
-	{ "srand",	uc_srand },
-	{ "isnan",	uc_isnan },
+/*
+ * Array kernels. Input values are first gathered into a flat double vector,
+ * either from a plain array or by decoding a typed byte buffer, and then
+ * processed by the routines below which are written to let the compiler
+ * vectorize them.
+ *
+ * Integer input may additionally be gathered into an exact 64 bit vector,
+ * since doubles can't represent integers beyond 2^53. Sums over it are
+ * overflow checked and fall back to the double vector on overflow.
+ */
+
+typedef struct {
+	double *v;
+	int64_t *iv;
+	size_t count;
+	bool integral;
+	bool uns;
+} math_vec_t;
+
+#define MATH_INT_EXACT 9007199254740992.0 /* 2^53 */
+
+#define MATH_DECODE(ctype, utype, swapfn)						\
+	do {														\
+		for (i = 0; i < vec->count; i++) {						\
+			utype u; ctype t;									\
+			memcpy(&u, p + i * sizeof(u), sizeof(u));			\
+			if (swap) u = swapfn(u);							\
+			memcpy(&t, &u, sizeof(t));							\
+			vec->v[i] = (double)t;								\
+			if (vec->iv) vec->iv[i] = (int64_t)t;				\
+		}														\
+	} while (0)
+
+#define math_noswap(x) (x)
+
+static bool
+math_vec_decode(math_vec_t *vec, const char *p, size_t len, const char *type,
+                bool exact)
+{
+	bool swap = false;
+	size_t i, size;
+
+	switch (*type) {
+	case '<':
+		swap = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+		type++;
+		break;
+
+	case '>':
+	case '!':
+		swap = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+		type++;
+		break;
+
+	case '@':
+	case '=':
+		type++;
+		break;
+	}
+
+	switch (*type) {
+	case 'b': case 'B': size = 1; break;
+	case 'h': case 'H': size = 2; break;
+	case 'i': case 'I': case 'f': size = 4; break;
+	case 'q': case 'Q': case 'd': size = 8; break;
+	default: return false;
+	}
+
+	if (type[1] != '\0' || len % size)
+		return false;
+
+	vec->count = len / size;
+	vec->v = xalloc(sizeof(double) * (vec->count ? vec->count : 1));
+	vec->integral = (*type != 'f' && *type != 'd');
+	vec->uns = (*type == 'Q');
+
+	if (exact && vec->integral)
+		vec->iv = xalloc(sizeof(int64_t) * (vec->count ? vec->count : 1));
+
+	switch (*type) {
+	case 'b': MATH_DECODE(int8_t, uint8_t, math_noswap); break;
+	case 'B': MATH_DECODE(uint8_t, uint8_t, math_noswap); break;
+	case 'h': MATH_DECODE(int16_t, uint16_t, __builtin_bswap16); break;
+	case 'H': MATH_DECODE(uint16_t, uint16_t, __builtin_bswap16); break;
+	case 'i': MATH_DECODE(int32_t, uint32_t, __builtin_bswap32); break;
+	case 'I': MATH_DECODE(uint32_t, uint32_t, __builtin_bswap32); break;
+	case 'q': MATH_DECODE(int64_t, uint64_t, __builtin_bswap64); break;
+	case 'Q': MATH_DECODE(uint64_t, uint64_t, __builtin_bswap64); break;
+	case 'f': MATH_DECODE(float, uint32_t, __builtin_bswap32); break;
+	case 'd': MATH_DECODE(double, uint64_t, __builtin_bswap64); break;
+	}
+
+	return true;
+}
+
+/* Gathers the given values, if `exact` is set, integer values are also
+ * gathered into the 64 bit vector unless they mix negative values with ones
+ * beyond INT64_MAX. */
+static bool
+math_vec_get(math_vec_t *vec, uc_value_t *values, uc_value_t *type, bool exact)
+{
+	bool negative = false, large = false;
+	uc_value_t *v;
+	size_t i, len;
+	int64_t n;
+	char *p;
+
+	vec->v = NULL;
+	vec->iv = NULL;
+	vec->count = 0;
+	vec->integral = true;
+	vec->uns = false;
+
+	if (ucv_type(values) == UC_ARRAY) {
+		vec->count = ucv_array_length(values);
+		vec->v = xalloc(sizeof(double) * (vec->count ? vec->count : 1));
+
+		for (i = 0; i < vec->count; i++) {
+			v = ucv_array_get(values, i);
+
+			if (ucv_type(v) != UC_INTEGER) {
+				vec->integral = false;
+			}
+			else if (exact) {
+				n = ucv_int64_get(v);
+
+				if (errno == ERANGE)
+					large = true;
+				else if (n < 0)
+					negative = true;
+			}
+
+			vec->v[i] = ucv_to_double(v);
+		}
+
+		if (exact && vec->integral && !(negative && large)) {
+			vec->iv = xalloc(sizeof(int64_t) * (vec->count ? vec->count : 1));
+			vec->uns = large;
+
+			for (i = 0; i < vec->count; i++) {
+				v = ucv_array_get(values, i);
+				vec->iv[i] = large ? (int64_t)ucv_uint64_get(v) : ucv_int64_get(v);
+			}
+		}
+
+		return true;
+	}
+
+	if (ucv_type(type) != UC_STRING)
+		return false;
+
+	p = ucv_bytes_get(values, &len);
+
+	if (!p)
+		return false;
+
+	return math_vec_decode(vec, p, len, ucv_string_get(type), exact);
+}
+
+static void
+math_vec_free(math_vec_t *vec)
+{
+	free(vec->v);
+	free(vec->iv);
+}
+
+static uc_value_t *
+math_number_new(double d, bool integral)
+{
+	if (integral && d >= -MATH_INT_EXACT && d <= MATH_INT_EXACT)
+		return ucv_int64_new((int64_t)d);
+
+	return ucv_double_new(d);
+}
+
+static uc_value_t *
+math_int_new(int64_t n, bool uns)
+{
+	return uns ? ucv_uint64_new((uint64_t)n) : ucv_int64_new(n);
+}
+
+static int
+math_int_cmp(int64_t a, int64_t b, bool uns)
+{
+	if (uns)
+		return ((uint64_t)a > (uint64_t)b) - ((uint64_t)a < (uint64_t)b);
+
+	return (a > b) - (a < b);
+}
+
+/* adds `n` to the exact sum `s`, returns false on overflow */
+static bool
+math_int_add(int64_t *s, int64_t n, bool uns)
+{
+	uint64_t u;
+	int64_t r;
+
+	if (uns) {
+		if (__builtin_add_overflow((uint64_t)*s, (uint64_t)n, &u))
+			return false;
+
+		*s = (int64_t)u;
+	}
+	else {
+		if (__builtin_add_overflow(*s, n, &r))
+			return false;
+
+		*s = r;
+	}
+
+	return true;
+}
+
+/* sums up the exact vector, returns false if there is none or on overflow */
+static bool
+math_vec_isum(const math_vec_t *vec, int64_t *sum)
+{
+	size_t i;
+
+	if (!vec->iv)
+		return false;
+
+	for (*sum = 0, i = 0; i < vec->count; i++)
+		if (!math_int_add(sum, vec->iv[i], vec->uns))
+			return false;
+
+	return true;
+}
+
+static double
+math_vec_sum(const double *v, size_t n)
+{
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i;
+
+	/* independent accumulators break the dependency chain of a serial sum */
+	for (i = 0; i + 4 <= n; i += 4) {
+		s0 += v[i];
+		s1 += v[i + 1];
+		s2 += v[i + 2];
+		s3 += v[i + 3];
+	}
+
+	for (; i < n; i++)
+		s0 += v[i];
+
+	return (s0 + s1) + (s2 + s3);
+}
+
+static double
+math_vec_mean(const math_vec_t *vec)
+{
+	int64_t s;
+
+	if (!vec->count)
+		return NAN;
+
+	if (math_vec_isum(vec, &s))
+		return (vec->uns ? (double)(uint64_t)s : (double)s) / vec->count;
+
+	return math_vec_sum(vec->v, vec->count) / vec->count;
+}
+
+static double
+math_vec_sqdev(const double *v, size_t n, double mean)
+{
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0, d0, d1, d2, d3;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		d0 = v[i] - mean;
+		d1 = v[i + 1] - mean;
+		d2 = v[i + 2] - mean;
+		d3 = v[i + 3] - mean;
+
+		s0 += d0 * d0;
+		s1 += d1 * d1;
+		s2 += d2 * d2;
+		s3 += d3 * d3;
+	}
+
+	for (; i < n; i++) {
+		d0 = v[i] - mean;
+		s0 += d0 * d0;
+	}
+
+	return (s0 + s1) + (s2 + s3);
+}
+
+/* drop NaN values, returns the remaining count */
+static size_t
+math_vec_compact(double *v, size_t n)
+{
+	size_t i, j;
+
+	for (i = 0, j = 0; i < n; i++)
+		if (!isnan(v[i]))
+			v[j++] = v[i];
+
+	return j;
+}
+
+static void
+math_vec_swap(double *v, size_t a, size_t b)
+{
+	double t = v[a];
+
+	v[a] = v[b];
+	v[b] = t;
+}
+
+/*
+ * Partially reorder v[lo..hi] so that v[k] holds the value it would have in
+ * a sorted vector, with smaller or equal values before and larger or equal
+ * ones after it.
+ */
+static void
+math_vec_select(double *v, size_t lo, size_t hi, size_t k)
+{
+	size_t i, j, mid;
+	double pivot;
+
+	while (hi > lo) {
+		mid = lo + (hi - lo) / 2;
+
+		if (v[mid] < v[lo])
+			math_vec_swap(v, mid, lo);
+
+		if (v[hi] < v[lo])
+			math_vec_swap(v, hi, lo);
+
+		if (v[hi] < v[mid])
+			math_vec_swap(v, hi, mid);
+
+		pivot = v[mid];
+		i = lo;
+		j = hi;
+
+		while (i <= j) {
+			while (v[i] < pivot)
+				i++;
+
+			while (v[j] > pivot)
+				j--;
+
+			if (i <= j) {
+				math_vec_swap(v, i, j);
+				i++;
+
+				if (j == 0)
+					break;
+
+				j--;
+			}
+		}
+
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;
+	}
+}
+
+/**
+ * Calculates the sum of the given numbers.
+ *
+ * The `values` argument may either be an array of numbers or a typed numeric
+ * buffer, that is a string or a `struct.buffer` holding packed values, in
+ * which case the `type` argument specifies the element format:
+ *
+ * | Type  | Element type               |
+ * |-------|----------------------------|
+ * | `"b"` | Signed 8 bit integer       |
+ * | `"B"` | Unsigned 8 bit integer     |
+ * | `"h"` | Signed 16 bit integer      |
+ * | `"H"` | Unsigned 16 bit integer    |
+ * | `"i"` | Signed 32 bit integer      |
+ * | `"I"` | Unsigned 32 bit integer    |
+ * | `"q"` | Signed 64 bit integer      |
+ * | `"Q"` | Unsigned 64 bit integer    |
+ * | `"f"` | Single precision float     |
+ * | `"d"` | Double precision float     |
+ *
+ * Like in `struct` format strings, the type character may be prefixed by `<`
+ * for little endian, `>` or `!` for big endian or `@` or `=` for native byte
+ * order, which is the default. The same `values` and `type` arguments are
+ * accepted by all array functions of the math module.
+ *
+ * Non-numeric array elements are converted to numbers, elements which can't
+ * be converted yield `NaN`.
+ *
+ * Integer values, including 64 bit buffer elements, are summed up exactly.
+ * Returns an integer if all summed values are integers and the sum fits into
+ * 64 bits, otherwise a double.
+ *
+ * Returns `null` if the given values are neither an array nor a buffer
+ * matching the given type.
+ *
+ * @function module:math#sum
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to sum up.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * sum([ 1, 2, 3.5 ]);                               // 6.5
+ * sum(struct.pack("<4H", 1, 2, 3, 4), "<H");        // 10
+ */
+static uc_value_t *
+uc_sum(uc_vm_t *vm, size_t nargs)
+{
+	math_vec_t vec;
+	uc_value_t *rv;
+	int64_t n;
+
+	if (!math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(1), true))
+		return NULL;
+
+	if (math_vec_isum(&vec, &n))
+		rv = math_int_new(n, vec.uns);
+	else
+		rv = math_number_new(math_vec_sum(vec.v, vec.count), vec.integral);
+
+	math_vec_free(&vec);
+
+	return rv;
+}
+
+/**
+ * Calculates the arithmetic mean of the given numbers.
+ *
+ * Returns `NaN` for an empty set of values.
+ *
+ * Returns `null` if the given values are neither an array nor a typed numeric
+ * buffer, see {@link module:math#sum|sum()} for details.
+ *
+ * @function module:math#mean
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to average.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?number}
+ */
+static uc_value_t *
+uc_mean(uc_vm_t *vm, size_t nargs)
+{
+	math_vec_t vec;
+	double m;
+
+	if (!math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(1), true))
+		return NULL;
+
+	m = math_vec_mean(&vec);
+	math_vec_free(&vec);
+
+	return ucv_double_new(m);
+}
+
+/**
+ * Calculates the variance of the given numbers.
+ *
+ * By default the population variance is returned. A `ddof` ("delta degrees of
+ * freedom") value of `1` yields the sample variance instead.
+ *
+ * Returns `NaN` if there are not more values than `ddof`.
+ *
+ * Returns `null` if the given values are neither an array nor a typed numeric
+ * buffer, see {@link module:math#sum|sum()} for details.
+ *
+ * @function module:math#variance
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to calculate the variance for.
+ *
+ * @param {number} [ddof=0]
+ * The divisor used is the number of values minus `ddof`.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * variance([ 2, 4, 4, 4, 5, 5, 7, 9 ]);     // 4
+ * sqrt(variance([ 2, 4, 4, 4, 5, 5, 7, 9 ], 1)); // 2.138...
+ */
+static uc_value_t *
+uc_variance(uc_vm_t *vm, size_t nargs)
+{
+	int64_t ddof = ucv_to_integer(uc_fn_arg(1));
+	math_vec_t vec;
+	double m, d;
+
+	if (ddof < 0 || !math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(2), true))
+		return NULL;
+
+	if (vec.count > (uint64_t)ddof) {
+		m = math_vec_mean(&vec);
+		d = math_vec_sqdev(vec.v, vec.count, m) / (vec.count - ddof);
+	}
+	else {
+		d = NAN;
+	}
+
+	math_vec_free(&vec);
+
+	return ucv_double_new(d);
+}
+
+/**
+ * Determines the smallest and largest of the given numbers along with their
+ * positions.
+ *
+ * Returns an object with the properties `min`, `min_index`, `max` and
+ * `max_index`. The index values refer to the first occurrence of the minimum
+ * and maximum value respectively. `NaN` values are ignored.
+ *
+ * Returns `null` if there are no comparable values or if the given values are
+ * neither an array nor a typed numeric buffer, see
+ * {@link module:math#sum|sum()} for details.
+ *
+ * @function module:math#minmax
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to scan.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?Object}
+ *
+ * @example
+ * minmax([ 3, 1, 4, 1, 5 ]);
+ * // { "min": 1, "min_index": 1, "max": 5, "max_index": 4 }
+ */
+static uc_value_t *
+uc_minmax(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *rv, *vmin = NULL, *vmax = NULL;
+	size_t i, min_idx = 0, max_idx = 0;
+	double min = NAN, max = NAN;
+	math_vec_t vec;
+
+	if (!math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(1), true))
+		return NULL;
+
+	if (vec.iv && vec.count) {
+		for (i = 1; i < vec.count; i++) {
+			if (math_int_cmp(vec.iv[i], vec.iv[min_idx], vec.uns) < 0)
+				min_idx = i;
+
+			if (math_int_cmp(vec.iv[i], vec.iv[max_idx], vec.uns) > 0)
+				max_idx = i;
+		}
+
+		vmin = math_int_new(vec.iv[min_idx], vec.uns);
+		vmax = math_int_new(vec.iv[max_idx], vec.uns);
+	}
+	else {
+		for (i = 0; i < vec.count; i++) {
+			if (isnan(vec.v[i]))
+				continue;
+
+			if (isnan(min) || vec.v[i] < min) {
+				min = vec.v[i];
+				min_idx = i;
+			}
+
+			if (isnan(max) || vec.v[i] > max) {
+				max = vec.v[i];
+				max_idx = i;
+			}
+		}
+
+		if (!isnan(min)) {
+			vmin = math_number_new(min, vec.integral);
+			vmax = math_number_new(max, vec.integral);
+		}
+	}
+
+	math_vec_free(&vec);
+
+	if (!vmin)
+		return NULL;
+
+	rv = ucv_object_new(vm);
+
+	ucv_object_add(rv, "min", vmin);
+	ucv_object_add(rv, "min_index", ucv_uint64_new(min_idx));
+	ucv_object_add(rv, "max", vmax);
+	ucv_object_add(rv, "max_index", ucv_uint64_new(max_idx));
+
+	return rv;
+}
+
+/**
+ * Calculates the cumulative sums of the given numbers.
+ *
+ * Returns a new array of the same length, where each element holds the sum of
+ * all values up to and including the corresponding input position.
+ *
+ * Returns `null` if the given values are neither an array nor a typed numeric
+ * buffer, see {@link module:math#sum|sum()} for details.
+ *
+ * @function module:math#cumsum
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to accumulate.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?number[]}
+ *
+ * @example
+ * cumsum([ 1, 2, 3, 4 ]);  // [ 1, 3, 6, 10 ]
+ */
+static uc_value_t *
+uc_cumsum(uc_vm_t *vm, size_t nargs)
+{
+	bool exact;
+	math_vec_t vec;
+	uc_value_t *rv;
+	double s = 0;
+	int64_t n = 0;
+	size_t i;
+
+	if (!math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(1), true))
+		return NULL;
+
+	rv = ucv_array_new_length(vm, vec.count);
+	exact = (vec.iv != NULL);
+
+	for (i = 0; i < vec.count; i++) {
+		/* continue with the double sum once the exact one overflows */
+		if (exact && !math_int_add(&n, vec.iv[i], vec.uns)) {
+			s = (vec.uns ? (double)(uint64_t)n : (double)n) + vec.v[i];
+			exact = false;
+		}
+		else if (!exact) {
+			s += vec.v[i];
+		}
+
+		if (exact)
+			ucv_array_push(rv, math_int_new(n, vec.uns));
+		else
+			ucv_array_push(rv, math_number_new(s, vec.integral));
+	}
+
+	math_vec_free(&vec);
+
+	return rv;
+}
+
+/**
+ * Counts the given numbers per bucket.
+ *
+ * If `bounds` is an array of ascending numbers, they're treated as inclusive
+ * upper bucket boundaries. The resulting array holds one more element than
+ * `bounds` with the last one counting all values larger than the last bound.
+ *
+ * If `bounds` is a positive integer, the range between the smallest and the
+ * largest value is divided into that many buckets of equal width.
+ *
+ * `NaN` values are not counted.
+ *
+ * Returns `null` if the bounds are invalid, if a bucket count is given and
+ * the values include infinities or if the given values are neither an array
+ * nor a typed numeric buffer, see {@link module:math#sum|sum()} for details.
+ *
+ * @function module:math#histogram
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to count.
+ *
+ * @param {number[]|number} bounds
+ * The bucket upper bounds or the number of equally sized buckets.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?number[]}
+ *
+ * @example
+ * histogram([ 1, 5, 7, 20, 120 ], [ 5, 10, 100 ]);  // [ 2, 1, 1, 1 ]
+ * histogram([ 1, 2, 3, 4 ], 2);                     // [ 2, 2 ]
+ */
+static uc_value_t *
+uc_histogram(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *bounds = uc_fn_arg(1), *rv;
+	size_t i, lo, hi, mid, nbuckets;
+	double *edges = NULL, min, max, width, scale, d;
+	uint64_t *counts;
+	math_vec_t vec;
+	int64_t n;
+
+	if (ucv_type(bounds) == UC_ARRAY) {
+		nbuckets = ucv_array_length(bounds);
+		edges = xalloc(sizeof(double) * (nbuckets ? nbuckets : 1));
+
+		for (i = 0; i < nbuckets; i++) {
+			edges[i] = ucv_to_double(ucv_array_get(bounds, i));
+
+			if (isnan(edges[i]) || (i > 0 && edges[i] <= edges[i - 1])) {
+				free(edges);
+
+				return NULL;
+			}
+		}
+
+		nbuckets++;
+	}
+	else {
+		n = ucv_to_integer(bounds);
+
+		if (ucv_type(bounds) != UC_INTEGER || n < 1 || n > 65536)
+			return NULL;
+
+		nbuckets = n;
+	}
+
+	if (!math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(2), false)) {
+		free(edges);
+
+		return NULL;
+	}
+
+	vec.count = math_vec_compact(vec.v, vec.count);
+	counts = xalloc(sizeof(uint64_t) * nbuckets);
+
+	if (edges) {
+		for (i = 0; i < vec.count; i++) {
+			lo = 0;
+			hi = nbuckets - 1;
+
+			while (lo < hi) {
+				mid = lo + (hi - lo) / 2;
+
+				if (vec.v[i] <= edges[mid])
+					hi = mid;
+				else
+					lo = mid + 1;
+			}
+
+			counts[lo]++;
+		}
+	}
+	else if (vec.count > 0) {
+		min = max = vec.v[0];
+
+		for (i = 1; i < vec.count; i++) {
+			if (vec.v[i] < min)
+				min = vec.v[i];
+
+			if (vec.v[i] > max)
+				max = vec.v[i];
+		}
+
+		/* infinite values leave no range to divide */
+		if (isinf(min) || isinf(max)) {
+			free(counts);
+			math_vec_free(&vec);
+
+			return NULL;
+		}
+
+		/* halve all values if their range exceeds the double range */
+		scale = isinf(max - min) ? 0.5 : 1;
+		width = (max * scale - min * scale) / nbuckets;
+
+		for (i = 0; i < vec.count; i++) {
+			d = (width > 0) ? (vec.v[i] * scale - min * scale) / width : 0;
+			counts[(d < nbuckets) ? (size_t)d : nbuckets - 1]++;
+		}
+	}
+
+	rv = ucv_array_new_length(vm, nbuckets);
+
+	for (i = 0; i < nbuckets; i++)
+		ucv_array_push(rv, ucv_uint64_new(counts[i]));
+
+	free(counts);
+	free(edges);
+	math_vec_free(&vec);
+
+	return rv;
+}
+
+typedef struct {
+	double q;
+	size_t idx;
+} math_quantile_t;
+
+static int
+math_quantile_cmp(const void *a, const void *b)
+{
+	const math_quantile_t *qa = a, *qb = b;
+
+	return (qa->q > qb->q) - (qa->q < qb->q);
+}
+
+/**
+ * Calculates quantiles of the given numbers.
+ *
+ * Quantiles are determined by partial selection instead of sorting all
+ * values, results between two values are linearly interpolated. `NaN` values
+ * are ignored.
+ *
+ * If `q` is a single number, the corresponding quantile is returned. If `q` is
+ * an array of numbers, an array of the corresponding quantiles in the same
+ * order is returned.
+ *
+ * Returns `null` if there are no comparable values, if any requested quantile
+ * is outside of the range `0` to `1` or if the given values are neither an
+ * array nor a typed numeric buffer, see {@link module:math#sum|sum()} for
+ * details.
+ *
+ * @function module:math#quantile
+ *
+ * @param {number[]|string|module:struct.buffer} values
+ * The values to examine.
+ *
+ * @param {number|number[]} q
+ * The quantile or quantiles to calculate, in the range `0` to `1`.
+ *
+ * @param {string} [type]
+ * The element type of a typed numeric buffer.
+ *
+ * @returns {?(number|number[])}
+ *
+ * @example
+ * quantile([ 5, 1, 4, 2, 3 ], 0.5);              // 3
+ * quantile(latencies, [ 0.5, 0.9, 0.99 ]);       // [ p50, p90, p99 ]
+ */
+static uc_value_t *
+uc_quantile(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *qarg = uc_fn_arg(1), *rv = NULL;
+	size_t i, j, k, lo, nq;
+	math_quantile_t *qs;
+	double h, next, *res;
+	math_vec_t vec;
+
+	nq = (ucv_type(qarg) == UC_ARRAY) ? ucv_array_length(qarg) : 1;
+	qs = xalloc(sizeof(*qs) * (nq ? nq : 1));
+
+	for (i = 0; i < nq; i++) {
+		qs[i].idx = i;
+		qs[i].q = ucv_to_double((ucv_type(qarg) == UC_ARRAY)
+			? ucv_array_get(qarg, i) : qarg);
+
+		if (!(qs[i].q >= 0 && qs[i].q <= 1)) {
+			free(qs);
+
+			return NULL;
+		}
+	}
+
+	if (!math_vec_get(&vec, uc_fn_arg(0), uc_fn_arg(2), false)) {
+		free(qs);
+
+		return NULL;
+	}
+
+	vec.count = math_vec_compact(vec.v, vec.count);
+
+	if (vec.count == 0)
+		goto out;
+
+	/* select in ascending quantile order, each pass narrows the range */
+	qsort(qs, nq, sizeof(*qs), math_quantile_cmp);
+	res = xalloc(sizeof(double) * (nq ? nq : 1));
+
+	for (i = 0, lo = 0; i < nq; i++) {
+		h = (vec.count - 1) * qs[i].q;
+		k = (size_t)h;
+
+		math_vec_select(vec.v, lo, vec.count - 1, k);
+		lo = k;
+
+		res[qs[i].idx] = vec.v[k];
+
+		if (h > k) {
+			for (j = k + 2, next = vec.v[k + 1]; j < vec.count; j++)
+				if (vec.v[j] < next)
+					next = vec.v[j];
+
+			res[qs[i].idx] += (h - k) * (next - vec.v[k]);
+		}
+	}
+
+	if (ucv_type(qarg) == UC_ARRAY) {
+		rv = ucv_array_new_length(vm, nq);
+
+		for (i = 0; i < nq; i++)
+			ucv_array_push(rv, ucv_double_new(res[i]));
+	}
+	else {
+		rv = ucv_double_new(res[0]);
+	}
+
+	free(res);
+
+out:
+	math_vec_free(&vec);
+	free(qs);
+
+	return rv;
+}
+
+static const uc_function_list_t math_fns[] = {
+	{ "abs",	uc_abs },
+	{ "atan2",	uc_atan2 },
+	{ "cos",	uc_cos },
+	{ "exp",	uc_exp },
+	{ "log",	uc_log },
+	{ "sin",	uc_sin },
+	{ "sqrt",	uc_sqrt },
+	{ "pow",	uc_pow },
+	{ "rand",	uc_rand },
+	{ "srand",	uc_srand },
+	{ "randint",	uc_randint },
+	{ "shuffle",	uc_shuffle },
+	{ "sample",	uc_sample },
+	{ "prng",	uc_prng },
+	{ "isnan",	uc_isnan },
+	{ "sum",	uc_sum },
+	{ "mean",	uc_mean },
+	{ "variance",	uc_variance },
+	{ "minmax",	uc_minmax },
+	{ "cumsum",	uc_cumsum },
+	{ "histogram",	uc_histogram },
+	{ "quantile",	uc_quantile },
+};
+
+static const uc_function_list_t prng_fns[] = {
+	{ "seed",	uc_srand },
+	{ "rand",	uc_rand },
+	{ "randint",	uc_randint },
+	{ "shuffle",	uc_shuffle },
+	{ "sample",	uc_sample },
+	{ "ints",	uc_prng_ints },
+	{ "floats",	uc_prng_floats },
+	{ "bytes",	uc_prng_bytes },
 };
 
 MODULE_EXPORT
 void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 {
 	uc_function_list_register(scope, math_fns);
-	uc_vm_registry_set(vm, "math.srand_called", ucv_boolean_new(false));
+	uc_type_declare(vm, "math.prng", prng_fns, NULL);
 }
@@ -0,0 +1,1036 @@
+/*
+ * Copyright (C) 2020-2021 Jo-Philipp Wich <jo@mein.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * # Runtime Metrics
+ *
+ * The `metrics` module maintains a per-VM registry of counters, gauges and
+ * histograms and renders them, together with a set of built-in VM metrics,
+ * in the Prometheus text exposition format.
+ *
+ *   ```
+ *   import { counter, histogram, expose } from 'metrics';
+ *
+ *   const requests = counter('http_requests_total', 'Handled requests', [ 'method' ]);
+ *   const latency = histogram('http_request_seconds', 'Request latency');
+ *   const get_requests = requests.labels('GET');
+ *
+ *   get_requests.inc();
+ *   latency.observe(0.042);
+ *
+ *   expose(client_socket);
+ *   ```
+ *
+ * Updating a metric does not allocate any values, callers updating labeled
+ * metrics in hot paths should keep the series returned by `labels()` around
+ * instead of looking it up for every update.
+ *
+ * @module metrics
+ */
+
+#include <math.h>
+#include <errno.h>
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ucode/module.h"
+
+
+typedef enum {
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM
+} metric_kind_t;
+
+static const char *metric_kind_names[] = {
+	[METRIC_COUNTER] = "counter",
+	[METRIC_GAUGE] = "gauge",
+	[METRIC_HISTOGRAM] = "histogram"
+};
+
+static const double metric_default_bounds[] = {
+	0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+struct metric_series;
+
+/* Families are extended resources holding the object of their series in
+ * value slot 0, series refer back to their family through value slot 0. */
+typedef struct {
+	metric_kind_t kind;
+	char *name;
+	char *help;
+	size_t nlabels;
+	char **labels;
+	size_t nbounds;
+	double *bounds;
+	struct metric_series *series;
+} metric_family_t;
+
+typedef struct metric_series {
+	metric_family_t *family;
+	char *labels;
+	double value;
+	uint64_t count;
+	uint64_t buckets[];
+} metric_series_t;
+
+
+static bool
+metric_name_valid(const char *name, bool label)
+{
+	const char *p;
+
+	if (!name || !*name || isdigit((unsigned char)*name))
+		return false;
+
+	for (p = name; *p; p++)
+		if (!isalnum((unsigned char)*p) && *p != '_' && (label || *p != ':'))
+			return false;
+
+	return true;
+}
+
+static void
+metric_escape(uc_stringbuf_t *buf, const char *s, bool quote)
+{
+	for (; *s; s++) {
+		switch (*s) {
+		case '\\':
+			ucv_stringbuf_append(buf, "\\\\");
+			break;
+
+		case '\n':
+			ucv_stringbuf_append(buf, "\\n");
+			break;
+
+		case '"':
+			if (quote) {
+				ucv_stringbuf_append(buf, "\\\"");
+				break;
+			}
+
+			/* fall through */
+
+		default:
+			ucv_stringbuf_addstr(buf, s, 1);
+			break;
+		}
+	}
+}
+
+static void
+metric_number(uc_stringbuf_t *buf, double d)
+{
+	char s[32];
+
+	if (isnan(d)) {
+		ucv_stringbuf_append(buf, "NaN");
+	}
+	else if (isinf(d)) {
+		if (d > 0)
+			ucv_stringbuf_append(buf, "+Inf");
+		else
+			ucv_stringbuf_append(buf, "-Inf");
+	}
+	else {
+		/* prefer the short representation if it round trips */
+		snprintf(s, sizeof(s), "%.15g", d);
+
+		if (strtod(s, NULL) != d)
+			snprintf(s, sizeof(s), "%.17g", d);
+
+		ucv_stringbuf_addstr(buf, s, strlen(s));
+	}
+}
+
+static bool
+metric_arg_number(uc_value_t *v, double dflt, double *out)
+{
+	switch (ucv_type(v)) {
+	case UC_NULL:
+		*out = dflt;
+		return true;
+
+	case UC_INTEGER:
+		*out = (double)ucv_int64_get(v);
+		return true;
+
+	case UC_DOUBLE:
+		*out = ucv_double_get(v);
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static uc_value_t *
+metric_registry(uc_vm_t *vm)
+{
+	uc_value_t *registry = uc_vm_registry_get(vm, "metrics.families");
+
+	if (!registry) {
+		registry = ucv_object_new(vm);
+		uc_vm_registry_set(vm, "metrics.families", registry);
+	}
+
+	return registry;
+}
+
+static uc_value_t *
+metric_series_new(uc_vm_t *vm, uc_value_t *famres, metric_family_t *fam,
+                  char *labels)
+{
+	metric_series_t *series;
+	uc_value_t *res;
+
+	res = ucv_resource_create_ex(vm, "metrics.series", (void **)&series, 1,
+		sizeof(*series) + fam->nbounds * sizeof(series->buckets[0]));
+
+	if (!res) {
+		free(labels);
+
+		return NULL;
+	}
+
+	series->family = fam;
+	series->labels = labels;
+
+	ucv_resource_value_set(res, 0, ucv_get(famres));
+	ucv_object_add(ucv_resource_value_get(famres, 0), labels ? labels : "",
+		ucv_get(res));
+
+	return res;
+}
+
+static void
+metric_family_free(void *ud)
+{
+	metric_family_t *fam = ud;
+	size_t i;
+
+	for (i = 0; i < fam->nlabels; i++)
+		free(fam->labels[i]);
+
+	free(fam->labels);
+	free(fam->bounds);
+	free(fam->name);
+	free(fam->help);
+}
+
+static void
+metric_series_free(void *ud)
+{
+	metric_series_t *series = ud;
+
+	free(series->labels);
+}
+
+static uc_value_t *
+metric_register(uc_vm_t *vm, size_t nargs, metric_kind_t kind)
+{
+	uc_value_t *name = uc_fn_arg(0);
+	uc_value_t *help = uc_fn_arg(1);
+	uc_value_t *labels = uc_fn_arg(2);
+	uc_value_t *bounds = uc_fn_arg(3);
+	uc_value_t *registry, *res, *series, *v;
+	metric_family_t *fam, *existing;
+	size_t i, nlabels, nbounds;
+	double d, prev = -INFINITY;
+	const char *s;
+
+	if (ucv_type(name) != UC_STRING ||
+	    !metric_name_valid(ucv_string_get(name), false)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Invalid metric name");
+
+		return NULL;
+	}
+
+	if (help && ucv_type(help) != UC_STRING) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Help text must be a string");
+
+		return NULL;
+	}
+
+	if (labels && ucv_type(labels) != UC_ARRAY) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Label names must be an array");
+
+		return NULL;
+	}
+
+	if (bounds && ucv_type(bounds) != UC_ARRAY) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Bucket bounds must be an array");
+
+		return NULL;
+	}
+
+	registry = metric_registry(vm);
+	res = ucv_object_get(registry, ucv_string_get(name), NULL);
+
+	if (res) {
+		existing = ucv_resource_data(res, "metrics.family");
+
+		if (existing->kind != kind) {
+			uc_vm_raise_exception(vm, EXCEPTION_RUNTIME,
+				"Metric '%s' is already registered as %s",
+				existing->name, metric_kind_names[existing->kind]);
+
+			return NULL;
+		}
+
+		return ucv_get(res);
+	}
+
+	nlabels = ucv_array_length(labels);
+
+	for (i = 0; i < nlabels; i++) {
+		v = ucv_array_get(labels, i);
+		s = (ucv_type(v) == UC_STRING) ? ucv_string_get(v) : NULL;
+
+		if (!metric_name_valid(s, true) ||
+		    !strncmp(s, "__", 2) ||
+		    (kind == METRIC_HISTOGRAM && !strcmp(s, "le"))) {
+			uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Invalid label name");
+
+			return NULL;
+		}
+	}
+
+	nbounds = (kind != METRIC_HISTOGRAM) ? 0
+		: bounds ? ucv_array_length(bounds)
+		: ARRAY_SIZE(metric_default_bounds);
+
+	for (i = 0; bounds && i < nbounds; i++, prev = d) {
+		if (!metric_arg_number(ucv_array_get(bounds, i), NAN, &d) ||
+		    !(d > prev) || isinf(d)) {
+			uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+				"Bucket bounds must be increasing finite numbers");
+
+			return NULL;
+		}
+	}
+
+	res = ucv_resource_create_ex(vm, "metrics.family", (void **)&fam, 1,
+		sizeof(*fam));
+
+	if (!res)
+		return NULL;
+
+	fam->kind = kind;
+	fam->name = xstrdup(ucv_string_get(name));
+	fam->help = help ? xstrdup(ucv_string_get(help)) : NULL;
+	fam->nlabels = nlabels;
+	fam->labels = xcalloc(nlabels ? nlabels : 1, sizeof(char *));
+	fam->nbounds = nbounds;
+	fam->bounds = xcalloc(nbounds ? nbounds : 1, sizeof(double));
+
+	for (i = 0; i < nlabels; i++) {
+		v = ucv_array_get(labels, i);
+		fam->labels[i] = xstrdup(ucv_string_get(v));
+	}
+
+	for (i = 0; i < nbounds; i++) {
+		if (bounds)
+			metric_arg_number(ucv_array_get(bounds, i), 0, &fam->bounds[i]);
+		else
+			fam->bounds[i] = metric_default_bounds[i];
+	}
+
+	ucv_resource_value_set(res, 0, ucv_object_new(vm));
+
+	/* unlabeled families expose their single series directly */
+	if (nlabels == 0) {
+		series = metric_series_new(vm, res, fam, NULL);
+		fam->series = ucv_resource_data(series, "metrics.series");
+		ucv_put(series);
+	}
+
+	ucv_object_add(registry, fam->name, ucv_get(res));
+
+	return res;
+}
+
+/**
+ * Register a counter metric.
+ *
+ * Counters are monotonically increasing values, such as the number of
+ * handled requests. Registering an already existing counter returns the
+ * existing one, registering a name already used by a different metric type
+ * raises an exception.
+ *
+ * @function module:metrics#counter
+ *
+ * @param {string} name
+ * The metric name.
+ *
+ * @param {string} [help]
+ * The help text describing the metric.
+ *
+ * @param {string[]} [labels]
+ * The label names of the metric.
+ *
+ * @returns {module:metrics.family}
+ */
+static uc_value_t *
+uc_metrics_counter(uc_vm_t *vm, size_t nargs)
+{
+	return metric_register(vm, nargs, METRIC_COUNTER);
+}
+
+/**
+ * Register a gauge metric.
+ *
+ * Gauges are values which may arbitrarily go up and down, such as the
+ * number of connected clients.
+ *
+ * @function module:metrics#gauge
+ *
+ * @param {string} name
+ * The metric name.
+ *
+ * @param {string} [help]
+ * The help text describing the metric.
+ *
+ * @param {string[]} [labels]
+ * The label names of the metric.
+ *
+ * @returns {module:metrics.family}
+ */
+static uc_value_t *
+uc_metrics_gauge(uc_vm_t *vm, size_t nargs)
+{
+	return metric_register(vm, nargs, METRIC_GAUGE);
+}
+
+/**
+ * Register a histogram metric.
+ *
+ * Histograms count observations, such as request durations, in buckets of
+ * configurable upper bounds and track their sum.
+ *
+ * @function module:metrics#histogram
+ *
+ * @param {string} name
+ * The metric name.
+ *
+ * @param {string} [help]
+ * The help text describing the metric.
+ *
+ * @param {string[]} [labels]
+ * The label names of the metric.
+ *
+ * @param {number[]} [buckets]
+ * The increasing upper bucket bounds, defaults to
+ * `[ 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 ]`.
+ *
+ * @returns {module:metrics.family}
+ */
+static uc_value_t *
+uc_metrics_histogram(uc_vm_t *vm, size_t nargs)
+{
+	return metric_register(vm, nargs, METRIC_HISTOGRAM);
+}
+
+
+/**
+ * Represents a registered metric.
+ *
+ * Metrics without labels can be updated directly through the family, labeled
+ * metrics are updated through the series returned by
+ * {@link module:metrics.family#labels|labels()}.
+ *
+ * @class module:metrics.family
+ * @hideconstructor
+ */
+
+/**
+ * Represents a single labeled series of a metric.
+ *
+ * @class module:metrics.series
+ * @hideconstructor
+ */
+
+/**
+ * Select the series of the given label values, creating it if needed.
+ *
+ * The label values may either be passed as separate arguments in the order
+ * of the label names given at registration time or as single object keyed by
+ * label name.
+ *
+ * @function module:metrics.family#labels
+ *
+ * @param {...*} values
+ * The label values.
+ *
+ * @returns {module:metrics.series}
+ */
+static uc_value_t *
+uc_metrics_labels(uc_vm_t *vm, size_t nargs)
+{
+	metric_family_t *fam = uc_fn_thisval("metrics.family");
+	uc_value_t *famres = _uc_fn_this_res(vm);
+	uc_value_t *arg = uc_fn_arg(0), *v, *series;
+	uc_stringbuf_t *buf;
+	char *s;
+	size_t i;
+
+	if (!fam)
+		return NULL;
+
+	if (fam->nlabels == 0 ||
+	    (ucv_type(arg) == UC_OBJECT ? nargs != 1 : nargs != fam->nlabels)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Metric '%s' expects %zu label values", fam->name, fam->nlabels);
+
+		return NULL;
+	}
+
+	buf = ucv_stringbuf_new();
+
+	for (i = 0; i < fam->nlabels; i++) {
+		if (ucv_type(arg) == UC_OBJECT)
+			v = ucv_object_get(arg, fam->labels[i], NULL);
+		else
+			v = uc_fn_arg(i);
+
+		s = ucv_to_string(vm, v);
+
+		ucv_stringbuf_printf(buf, "%s%s=\"", i ? "," : "", fam->labels[i]);
+		metric_escape(buf, s, true);
+		ucv_stringbuf_append(buf, "\"");
+
+		free(s);
+	}
+
+	series = ucv_object_get(ucv_resource_value_get(famres, 0), buf->buf, NULL);
+
+	if (series) {
+		printbuf_free(buf);
+
+		return ucv_get(series);
+	}
+
+	series = metric_series_new(vm, famres, fam, xstrdup(buf->buf));
+
+	printbuf_free(buf);
+
+	return series;
+}
+
+static metric_series_t *
+metric_series_this(uc_vm_t *vm)
+{
+	metric_series_t *series = uc_fn_thisval("metrics.series");
+	metric_family_t *fam;
+
+	if (series)
+		return series;
+
+	fam = uc_fn_thisval("metrics.family");
+
+	if (fam && !fam->series)
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Metric '%s' has labels, select a series using labels()",
+			fam->name);
+
+	return fam ? fam->series : NULL;
+}
+
+static bool
+metric_update_check(uc_vm_t *vm, metric_series_t *series, uc_value_t *arg,
+                    double dflt, double *value, bool counter, bool gauge,
+                    bool histogram)
+{
+	metric_kind_t kind = series->family->kind;
+
+	if ((kind == METRIC_COUNTER && !counter) ||
+	    (kind == METRIC_GAUGE && !gauge) ||
+	    (kind == METRIC_HISTOGRAM && !histogram)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Operation not supported by %s '%s'",
+			metric_kind_names[kind], series->family->name);
+
+		return false;
+	}
+
+	if (!metric_arg_number(arg, dflt, value)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Value must be a number");
+
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Increase the value of a counter or gauge.
+ *
+ * Counters can not be decreased, passing a negative amount to a counter
+ * raises an exception.
+ *
+ * @function module:metrics.series#inc
+ *
+ * @param {number} [amount=1]
+ * The amount to add.
+ */
+static uc_value_t *
+uc_metrics_inc(uc_vm_t *vm, size_t nargs)
+{
+	metric_series_t *series = metric_series_this(vm);
+	double d;
+
+	if (!series ||
+	    !metric_update_check(vm, series, uc_fn_arg(0), 1, &d, true, true, false))
+		return NULL;
+
+	if (series->family->kind == METRIC_COUNTER && !(d >= 0)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Counter '%s' can not be decreased", series->family->name);
+
+		return NULL;
+	}
+
+	series->value += d;
+
+	return NULL;
+}
+
+/**
+ * Decrease the value of a gauge.
+ *
+ * @function module:metrics.series#dec
+ *
+ * @param {number} [amount=1]
+ * The amount to subtract.
+ */
+static uc_value_t *
+uc_metrics_dec(uc_vm_t *vm, size_t nargs)
+{
+	metric_series_t *series = metric_series_this(vm);
+	double d;
+
+	if (!series ||
+	    !metric_update_check(vm, series, uc_fn_arg(0), 1, &d, false, true, false))
+		return NULL;
+
+	series->value -= d;
+
+	return NULL;
+}
+
+/**
+ * Set the value of a gauge.
+ *
+ * @function module:metrics.series#set
+ *
+ * @param {number} value
+ * The new value.
+ */
+static uc_value_t *
+uc_metrics_set(uc_vm_t *vm, size_t nargs)
+{
+	metric_series_t *series = metric_series_this(vm);
+	double d;
+
+	if (!series ||
+	    !metric_update_check(vm, series, uc_fn_arg(0), NAN, &d, false, true, false))
+		return NULL;
+
+	series->value = d;
+
+	return NULL;
+}
+
+/**
+ * Record an observation in a histogram.
+ *
+ * @function module:metrics.series#observe
+ *
+ * @param {number} value
+ * The observed value.
+ */
+static uc_value_t *
+uc_metrics_observe(uc_vm_t *vm, size_t nargs)
+{
+	metric_series_t *series = metric_series_this(vm);
+	metric_family_t *fam;
+	double d;
+	size_t i;
+
+	if (!series ||
+	    !metric_update_check(vm, series, uc_fn_arg(0), NAN, &d, false, false, true))
+		return NULL;
+
+	fam = series->family;
+
+	/* buckets are stored non-cumulative, the last bucket is implied by the
+	 * total count */
+	for (i = 0; i < fam->nbounds; i++) {
+		if (d <= fam->bounds[i]) {
+			series->buckets[i]++;
+			break;
+		}
+	}
+
+	series->value += d;
+	series->count++;
+
+	return NULL;
+}
+
+/**
+ * Query the current value of a metric series.
+ *
+ * Returns the value of counters and gauges or an object containing the
+ * `count`, `sum` and cumulative `buckets` counts of histograms.
+ *
+ * @function module:metrics.series#get
+ *
+ * @returns {number|Object}
+ */
+static uc_value_t *
+uc_metrics_get(uc_vm_t *vm, size_t nargs)
+{
+	metric_series_t *series = metric_series_this(vm);
+	uc_value_t *rv, *buckets;
+	uint64_t cum = 0;
+	size_t i;
+
+	if (!series)
+		return NULL;
+
+	if (series->family->kind != METRIC_HISTOGRAM)
+		return ucv_double_new(series->value);
+
+	rv = ucv_object_new(vm);
+	buckets = ucv_array_new_length(vm, series->family->nbounds);
+
+	for (i = 0; i < series->family->nbounds; i++) {
+		cum += series->buckets[i];
+		ucv_array_push(buckets, ucv_uint64_new(cum));
+	}
+
+	ucv_object_add(rv, "count", ucv_uint64_new(series->count));
+	ucv_object_add(rv, "sum", ucv_double_new(series->value));
+	ucv_object_add(rv, "buckets", buckets);
+
+	return rv;
+}
+
+
+static void
+expose_header(uc_stringbuf_t *buf, const char *name, const char *help,
+              const char *type)
+{
+	if (help) {
+		ucv_stringbuf_printf(buf, "# HELP %s ", name);
+		metric_escape(buf, help, false);
+		ucv_stringbuf_append(buf, "\n");
+	}
+
+	ucv_stringbuf_printf(buf, "# TYPE %s %s\n", name, type);
+}
+
+static void
+expose_sample(uc_stringbuf_t *buf, const char *name, const char *suffix,
+              const char *labels, const char *le, double value)
+{
+	ucv_stringbuf_printf(buf, "%s%s", name, suffix);
+
+	if ((labels && *labels) || le) {
+		ucv_stringbuf_printf(buf, "{%s%s",
+			labels ? labels : "", (labels && *labels && le) ? "," : "");
+
+		if (le) {
+			ucv_stringbuf_printf(buf, "le=\"%s\"", le);
+		}
+
+		ucv_stringbuf_append(buf, "}");
+	}
+
+	ucv_stringbuf_append(buf, " ");
+	metric_number(buf, value);
+	ucv_stringbuf_append(buf, "\n");
+}
+
+static void
+expose_histogram(uc_stringbuf_t *buf, const char *name, const char *labels,
+                 size_t nbounds, const double *bounds, const uint64_t *buckets,
+                 uint64_t count, double sum)
+{
+	uc_stringbuf_t *le = xprintbuf_new();
+	uint64_t cum = 0;
+	size_t i;
+
+	for (i = 0; i < nbounds; i++) {
+		cum += buckets[i];
+
+		printbuf_reset(le);
+		metric_number(le, bounds[i]);
+		expose_sample(buf, name, "_bucket", labels, le->buf, cum);
+	}
+
+	printbuf_free(le);
+
+	expose_sample(buf, name, "_bucket", labels, "+Inf", count);
+	expose_sample(buf, name, "_sum", labels, NULL, sum);
+	expose_sample(buf, name, "_count", labels, NULL, count);
+}
+
+static void
+expose_vm_histogram(uc_stringbuf_t *buf, const char *name, const char *help,
+                    uc_vm_histogram_t *hist)
+{
+	double bounds[UC_VM_HISTOGRAM_BUCKETS];
+	size_t i;
+
+	for (i = 0; i < UC_VM_HISTOGRAM_BUCKETS; i++)
+		bounds[i] = uc_vm_histogram_bounds[i] / 1e9;
+
+	expose_header(buf, name, help, "histogram");
+	expose_histogram(buf, name, NULL, UC_VM_HISTOGRAM_BUCKETS, bounds,
+		hist->buckets, hist->count, hist->sum / 1e9);
+}
+
+static void
+expose_builtin(uc_vm_t *vm, uc_stringbuf_t *buf)
+{
+	static const char *type_names[] = {
+		[UC_ARRAY] = "array",
+		[UC_OBJECT] = "object",
+		[UC_REGEXP] = "regexp",
+		[UC_CFUNCTION] = "cfunction",
+		[UC_CLOSURE] = "closure",
+		[UC_UPVALUE] = "upvalue",
+		[UC_RESOURCE] = "resource",
+		[UC_PROGRAM] = "program",
+		[UC_SOURCE] = "source"
+	};
+
+	static const char *exception_names[] = {
+		[EXCEPTION_SYNTAX] = "syntax",
+		[EXCEPTION_RUNTIME] = "runtime",
+		[EXCEPTION_TYPE] = "type",
+		[EXCEPTION_REFERENCE] = "reference",
+		[EXCEPTION_USER] = "user",
+		[EXCEPTION_EXIT] = "exit"
+	};
+
+	size_t counts[ARRAY_SIZE(type_names)] = { 0 };
+	uc_weakref_t *ref;
+	uc_value_t *uv;
+	char label[32];
+	size_t i;
+
+	expose_header(buf, "ucode_vm_instructions_total",
+		"Number of executed VM instructions", "counter");
+	expose_sample(buf, "ucode_vm_instructions_total", "", NULL, NULL,
+		vm->stats.insns);
+
+	expose_header(buf, "ucode_vm_exceptions_total",
+		"Number of raised exceptions by type", "counter");
+
+	for (i = EXCEPTION_SYNTAX; i <= EXCEPTION_EXIT; i++) {
+		snprintf(label, sizeof(label), "type=\"%s\"", exception_names[i]);
+		expose_sample(buf, "ucode_vm_exceptions_total", "", label, NULL,
+			vm->stats.exceptions[i]);
+	}
+
+	expose_vm_histogram(buf, "ucode_gc_pause_seconds",
+		"Duration of garbage collection runs", &vm->stats.gc);
+
+	expose_vm_histogram(buf, "ucode_uloop_callback_seconds",
+		"Duration of uloop callback invocations", &vm->stats.callbacks);
+
+	/* only values participating in garbage collection are linked into the
+	 * VM value list, scalars and plain resources are not counted */
+	for (ref = vm->values.next; ref != &vm->values; ref = ref->next) {
+		uv = (uc_value_t *)((uintptr_t)ref - offsetof(uc_array_t, ref));
+
+		if (ucv_type(uv) >= UC_ARRAY && ucv_type(uv) <= UC_SOURCE)
+			counts[ucv_type(uv)]++;
+	}
+
+	expose_header(buf, "ucode_heap_values",
+		"Number of garbage collected heap values by type", "gauge");
+
+	for (i = UC_ARRAY; i < ARRAY_SIZE(type_names); i++) {
+		if (!counts[i])
+			continue;
+
+		snprintf(label, sizeof(label), "type=\"%s\"", type_names[i]);
+
+		expose_sample(buf, "ucode_heap_values", "", label, NULL, counts[i]);
+	}
+}
+
+static bool
+expose_write(uc_value_t *handle, const char *data, size_t len)
+{
+	ssize_t wlen;
+	FILE *fp;
+	int *fd;
+
+	fp = ucv_resource_data(handle, "fs.file");
+
+	if (!fp)
+		fp = ucv_resource_data(handle, "fs.proc");
+
+	if (fp)
+		return (fwrite(data, 1, len, fp) == len && fflush(fp) == 0);
+
+	fd = (int *)ucv_resource_dataptr(handle, "socket");
+
+	if (!fd || *fd < 0)
+		return false;
+
+	while (len > 0) {
+		wlen = write(*fd, data, len);
+
+		if (wlen < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		data += wlen;
+		len -= wlen;
+	}
+
+	return true;
+}
+
+/**
+ * Render all registered metrics in the Prometheus text exposition format.
+ *
+ * Unless disabled, the output includes the built-in VM metrics:
+ *
+ *  - `ucode_vm_instructions_total` - executed VM instructions
+ *  - `ucode_vm_exceptions_total` - raised exceptions by type
+ *  - `ucode_gc_pause_seconds` - garbage collection durations
+ *  - `ucode_uloop_callback_seconds` - uloop callback durations
+ *  - `ucode_heap_values` - garbage collected heap values by type
+ *
+ * If a file or socket handle is given, the output is written to it and
+ * `true` is returned, otherwise the rendered text is returned as string.
+ *
+ * Returns `null` if writing to the handle failed.
+ *
+ * @function module:metrics#expose
+ *
+ * @param {module:fs.file|module:fs.proc|module:socket.socket} [handle]
+ * The handle to write the metrics to.
+ *
+ * @param {boolean} [builtin=true]
+ * Whether to include the built-in VM metrics.
+ *
+ * @returns {?(string|boolean)}
+ */
+static uc_value_t *
+uc_metrics_expose(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *handle = uc_fn_arg(0);
+	uc_value_t *builtin = uc_fn_arg(1);
+	uc_value_t *registry;
+	metric_series_t *s;
+	metric_family_t *fam;
+	uc_stringbuf_t *buf;
+	bool rv;
+
+	if (handle && ucv_type(handle) != UC_RESOURCE) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Invalid output handle");
+
+		return NULL;
+	}
+
+	buf = ucv_stringbuf_new();
+	registry = uc_vm_registry_get(vm, "metrics.families");
+
+	ucv_object_foreach(registry, name, famres) {
+		(void)name;
+
+		fam = ucv_resource_data(famres, "metrics.family");
+
+		if (!fam)
+			continue;
+
+		expose_header(buf, fam->name, fam->help, metric_kind_names[fam->kind]);
+
+		ucv_object_foreach(ucv_resource_value_get(famres, 0), key, series) {
+			(void)key;
+
+			s = ucv_resource_data(series, "metrics.series");
+
+			if (!s)
+				continue;
+
+			if (fam->kind == METRIC_HISTOGRAM)
+				expose_histogram(buf, fam->name, s->labels, fam->nbounds,
+					fam->bounds, s->buckets, s->count, s->value);
+			else
+				expose_sample(buf, fam->name, "", s->labels, NULL, s->value);
+		}
+	}
+
+	if (builtin == NULL || ucv_is_truish(builtin))
+		expose_builtin(vm, buf);
+
+	if (!handle)
+		return ucv_stringbuf_finish(buf);
+
+	rv = expose_write(handle, buf->buf, printbuf_length(buf));
+
+	printbuf_free(buf);
+
+	return rv ? ucv_boolean_new(true) : NULL;
+}
+
+
+static const uc_function_list_t metrics_fns[] = {
+	{ "counter",	uc_metrics_counter },
+	{ "gauge",		uc_metrics_gauge },
+	{ "histogram",	uc_metrics_histogram },
+	{ "expose",		uc_metrics_expose },
+};
+
+static const uc_function_list_t family_fns[] = {
+	{ "labels",		uc_metrics_labels },
+	{ "inc",		uc_metrics_inc },
+	{ "dec",		uc_metrics_dec },
+	{ "set",		uc_metrics_set },
+	{ "observe",	uc_metrics_observe },
+	{ "get",		uc_metrics_get },
+};
+
+static const uc_function_list_t series_fns[] = {
+	{ "inc",		uc_metrics_inc },
+	{ "dec",		uc_metrics_dec },
+	{ "set",		uc_metrics_set },
+	{ "observe",	uc_metrics_observe },
+	{ "get",		uc_metrics_get },
+};
+
+MODULE_EXPORT
+void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
+{
+	uc_function_list_register(scope, metrics_fns);
+
+	uc_type_declare(vm, "metrics.family", family_fns, metric_family_free);
+	uc_type_declare(vm, "metrics.series", series_fns, metric_series_free);
+}
@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <unistd.h>
@@ -26,6 +27,7 @@ limitations under the License.
 #include <assert.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/socket.h>
 
 #include <net/if.h>
 #include <netinet/ether.h>
@@ -37,6 +39,7 @@ limitations under the License.
 #include <netlink/genl/family.h>
 #include <netlink/genl/ctrl.h>
 
+#include <linux/filter.h>
 #include <linux/nl80211.h>
 #include <linux/ieee80211.h>
 #include <linux/mac80211_hwsim.h>
@@ -85,9 +88,25 @@ static uc_resource_type_t *listener_type;
 static uc_value_t *listener_registry;
 static uc_vm_t *listener_vm;
 
+/*
+ * Each listener occupies a group of slots in the listener registry holding
+ * the resource, the callback and the queue of pending events together with
+ * the coalescing key index, so that queued values stay reachable for the GC.
+ */
+enum {
+	LISTENER_THIS,
+	LISTENER_FUNC,
+	LISTENER_QUEUE,
+	LISTENER_KEYS,
+	LISTENER_SLOTS
+};
+
 typedef struct {
 	uint32_t cmds[NL80211_CMDS_BITMAP_SIZE];
 	size_t index;
+	size_t batch;
+	unsigned int coalesce;
+	struct uloop_timeout timer;
 } uc_nl_listener_t;
 
 static bool
@@ -1142,14 +1161,231 @@ uc_nl_parse_attr(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base,
 static uc_value_t *
 uc_nl_convert_attr(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base, struct nlattr *attr, struct nlattr *attr2, uc_vm_t *vm);
 
+static uc_value_t *
+uc_nl_convert_multiple(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base, struct nlattr *nla_nest, uc_vm_t *vm)
+{
+	uc_value_t *v, *arr;
+	struct nlattr *nla;
+	int rem;
+
+	arr = ucv_array_new(vm);
+
+	nla_for_each_attr(nla, nla_data(nla_nest), nla_len(nla_nest), rem) {
+		if (!(spec->flags & (DF_AUTOIDX|DF_TYPEIDX)) &&
+		    spec->auxdata && nla_type(nla) != (intptr_t)spec->auxdata)
+			continue;
+
+		v = uc_nl_convert_attr(spec, msg, base, nla, NULL, vm);
+
+		if (!v)
+			continue;
+
+		if (spec->flags & DF_TYPEIDX)
+			ucv_array_set(arr, nla_type(nla) - !!(spec->flags & DF_OFFSET1), v);
+		else
+			ucv_array_push(arr, v);
+	}
+
+	if (!ucv_array_length(arr)) {
+		ucv_put(arr);
+
+		return NULL;
+	}
+
+	return arr;
+}
+
+static uc_resource_type_t *lazy_type;
+
+/*
+ * Lazily decoded attributes: nested attributes, capability tables and
+ * information elements of reply messages may be stored as a copy of their
+ * raw netlink attribute, which is only converted once a property of it is
+ * accessed. The decoded value is cached in the resource's value slot.
+ *
+ * This is strictly opt-in through the `lazy` request option. Lazy values are
+ * resources, so only direct property access sees their members; type(),
+ * keys(), length(), exists(), for-in loops, JSON conversion and printing do
+ * not. Replies must be passed through expand() before using any of these.
+ */
+typedef struct {
+	const uc_nl_attr_spec_t *spec;
+	char nla[];
+} uc_nl_lazy_t;
+
 static bool
-uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj)
+uc_nl_lazy_type(const uc_nl_attr_spec_t *spec)
 {
-	struct nlattr **tb, *nla, *nla2, *nla_nest;
-	size_t i, type, maxattr = 0;
+	if (spec->flags & (DF_REPEATED|DF_RELATED))
+		return false;
+
+	switch (spec->type) {
+	case DT_NESTED:
+	case DT_HT_MCS:
+	case DT_HT_CAP:
+	case DT_VHT_MCS:
+	case DT_IE:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static uc_value_t *
+uc_nl_lazy_new(uc_vm_t *vm, const uc_nl_attr_spec_t *spec, struct nlattr *nla)
+{
+	uc_nl_lazy_t *lazy;
+	uc_value_t *res;
+
+	res = ucv_resource_new_ex(vm, lazy_type, (void **)&lazy, 1,
+		sizeof(*lazy) + NLA_ALIGN(nla->nla_len));
+
+	lazy->spec = spec;
+	memcpy(lazy->nla, nla, nla->nla_len);
+
+	return res;
+}
+
+static uc_value_t *
+uc_nl_lazy_decode(uc_vm_t *vm, uc_value_t *res)
+{
+	uc_nl_lazy_t *lazy = ucv_resource_data(res, "nl80211.lazy");
+	struct nlattr *nla;
+	uc_value_t *v;
+
+	if (!lazy)
+		return NULL;
+
+	v = ucv_resource_value_get(res, 0);
+
+	if (v)
+		return v;
+
+	nla = (struct nlattr *)lazy->nla;
+
+	if (lazy->spec->flags & DF_MULTIPLE)
+		v = uc_nl_convert_multiple(lazy->spec, NULL, NULL, nla, vm);
+	else
+		v = uc_nl_convert_attr(lazy->spec, NULL, NULL, nla, NULL, vm);
+
+	ucv_resource_value_set(res, 0, v);
+
+	return v;
+}
+
+static uc_value_t *
+uc_nl_lazy_get(uc_vm_t *vm, uc_value_t *res, const char *key)
+{
+	uc_value_t *v = uc_nl_lazy_decode(vm, res);
+	char *e;
+	long n;
+
+	if (ucv_type(v) == UC_ARRAY) {
+		n = strtol(key, &e, 10);
+
+		return (e != key && *e == 0 && n >= 0) ? ucv_get(ucv_array_get(v, n)) : NULL;
+	}
+
+	return ucv_get(ucv_object_get(v, key, NULL));
+}
+
+/*
+ * Replace all lazy values nested within the given value by their decoded
+ * form, in place, and return a new reference to the expanded value.
+ */
+static uc_value_t *
+uc_nl_expand_value(uc_vm_t *vm, uc_value_t *val)
+{
+	size_t i;
+
+	switch (ucv_type(val)) {
+	case UC_RESOURCE:
+		if (ucv_resource_data(val, "nl80211.lazy"))
+			return uc_nl_expand_value(vm, uc_nl_lazy_decode(vm, val));
+
+		break;
+
+	case UC_OBJECT:
+		ucv_object_foreach(val, k, v) {
+			switch (ucv_type(v)) {
+			case UC_RESOURCE:
+			case UC_OBJECT:
+			case UC_ARRAY:
+				ucv_object_add(val, k, uc_nl_expand_value(vm, v));
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		break;
+
+	case UC_ARRAY:
+		for (i = 0; i < ucv_array_length(val); i++)
+			ucv_array_set(val, i, uc_nl_expand_value(vm, ucv_array_get(val, i)));
+
+		break;
+
+	default:
+		break;
+	}
+
+	return ucv_get(val);
+}
+
+static uc_value_t *
+uc_nl_convert_entry(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, void *buf, size_t buflen, struct nlattr **tb, uc_vm_t *vm, bool lazy)
+{
+	struct nlattr *nla, *nla2;
 	uc_value_t *v, *arr;
 	int rem;
 
+	if (lazy && spec->attr != 0 && uc_nl_lazy_type(spec))
+		return uc_nl_lazy_new(vm, spec, tb[spec->attr]);
+
+	if (spec->flags & DF_REPEATED) {
+		arr = ucv_array_new(vm);
+
+		nla = tb[spec->attr];
+		rem = buflen - ((void *)nla - buf);
+		for (; nla_ok(nla, rem); nla = nla_next(nla, &rem)) {
+			if (nla_type(nla) != (int)spec->attr)
+				break;
+			v = uc_nl_convert_attr(spec, msg, (char *)buf, nla, NULL, vm);
+			if (!v)
+				continue;
+
+			ucv_array_push(arr, v);
+		}
+		if (!ucv_array_length(arr)) {
+			ucv_put(arr);
+
+			return NULL;
+		}
+
+		return arr;
+	}
+
+	if (spec->flags & DF_MULTIPLE)
+		return uc_nl_convert_multiple(spec, msg, (char *)buf, tb[spec->attr], vm);
+
+	if (spec->flags & DF_RELATED)
+		nla2 = tb[(uintptr_t)spec->auxdata];
+	else
+		nla2 = NULL;
+
+	return uc_nl_convert_attr(spec, msg, (char *)buf, tb[spec->attr], nla2, vm);
+}
+
+static struct nlattr **
+uc_nl_index_attrs(void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs)
+{
+	size_t i, type, maxattr = 0;
+	struct nlattr **tb, *nla;
+	int rem;
+
 	for (i = 0; i < nattrs; i++)
 		if (attrs[i].attr > maxattr)
 			maxattr = attrs[i].attr;
@@ -1157,7 +1393,7 @@ uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsiz
 	tb = calloc(maxattr + 1, sizeof(struct nlattr *));
 
 	if (!tb)
-		return false;
+		return NULL;
 
 	nla_for_each_attr(nla, buf + headsize, buflen - headsize, rem) {
 		type = nla_type(nla);
@@ -1166,72 +1402,160 @@ uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsiz
 			tb[type] = nla;
 	}
 
+	return tb;
+}
+
+static bool
+uc_nl_convert_attrs_ex(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj, const bool *fields, bool lazy)
+{
+	struct nlattr **tb;
+	uc_value_t *v;
+	size_t i;
+
+	tb = uc_nl_index_attrs(buf, buflen, headsize, attrs, nattrs);
+
+	if (!tb)
+		return false;
+
 	for (i = 0; i < nattrs; i++) {
+		if (fields && !fields[i])
+			continue;
+
 		if (attrs[i].attr != 0 && !tb[attrs[i].attr])
 			continue;
 
-		if (attrs[i].flags & DF_REPEATED) {
-			arr = ucv_array_new(vm);
+		v = uc_nl_convert_entry(&attrs[i], msg, buf, buflen, tb, vm, lazy);
 
-			nla = tb[attrs[i].attr];
-			rem = buflen - ((void *)nla - buf);
-			for (; nla_ok(nla, rem); nla = nla_next(nla, &rem)) {
-				if (nla_type(nla) != (int)attrs[i].attr)
-					break;
-				v = uc_nl_convert_attr(&attrs[i], msg, (char *)buf, nla, NULL, vm);
-				if (!v)
-					continue;
+		if (!v)
+			continue;
 
-				ucv_array_push(arr, v);
-			}
-			if (!ucv_array_length(arr)) {
-				ucv_put(arr);
-				continue;
-			}
+		ucv_object_add(obj, attrs[i].key, v);
+	}
 
-			v = arr;
-		}
-		else if (attrs[i].flags & DF_MULTIPLE) {
-			arr = ucv_array_new(vm);
-			nla_nest = tb[attrs[i].attr];
+	free(tb);
+
+	return true;
+}
+
+static bool
+uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj)
+{
+	return uc_nl_convert_attrs_ex(msg, buf, buflen, headsize, attrs, nattrs, vm, obj, NULL, false);
+}
 
-			nla_for_each_attr(nla, nla_data(nla_nest), nla_len(nla_nest), rem) {
-				if (!(attrs[i].flags & (DF_AUTOIDX|DF_TYPEIDX)) &&
-				    attrs[i].auxdata && nla_type(nla) != (intptr_t)attrs[i].auxdata)
-					continue;
+/*
+ * Split dumps deliver the properties of one object in several messages.
+ * Instead of converting each fragment into a temporary object and merging
+ * it afterwards, the attributes of further fragments are converted straight
+ * into the already assembled object: attributes not seen yet are added,
+ * nested objects are descended into and DF_MULTIPLE elements are addressed
+ * by their index, so each fragment costs time proportional to its own size.
+ * Values present from earlier fragments take precedence.
+ */
+static bool
+uc_nl_merge_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj, const bool *fields);
 
-				v = uc_nl_convert_attr(&attrs[i], msg, (char *)buf, nla, NULL, vm);
+static void
+uc_nl_merge_value(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, struct nlattr *nla, uc_vm_t *vm, uc_value_t *dest)
+{
+	const uc_nl_nested_spec_t *nest = spec->auxdata;
 
-				if (!v)
-					continue;
+	if (spec->type != DT_NESTED || (spec->flags & DF_ARRAY) || !nest)
+		return;
 
-				if (attrs[i].flags & DF_TYPEIDX)
-					ucv_array_set(arr, nla_type(nla) - !!(attrs[i].flags & DF_OFFSET1), v);
-				else
-					ucv_array_push(arr, v);
-			}
+	if (ucv_type(dest) != UC_OBJECT || !nla_check_len(nla, nest->headsize))
+		return;
 
-			if (!ucv_array_length(arr)) {
-				ucv_put(arr);
+	uc_nl_merge_attrs(msg, nla_data(nla), nla_len(nla), nest->headsize,
+		nest->attrs, nest->nattrs, vm, dest, NULL);
+}
 
-				continue;
-			}
+static void
+uc_nl_merge_item(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base, struct nlattr *nla, uc_vm_t *vm, uc_value_t *arr, size_t idx)
+{
+	uc_value_t *e = ucv_array_get(arr, idx), *v;
 
-			v = arr;
-		}
-		else {
-			if (attrs[i].flags & DF_RELATED)
-				nla2 = tb[(uintptr_t)attrs[i].auxdata];
-			else
-				nla2 = NULL;
+	if (e) {
+		uc_nl_merge_value(spec, msg, nla, vm, e);
 
-			v = uc_nl_convert_attr(&attrs[i], msg, (char *)buf, tb[attrs[i].attr], nla2, vm);
+		return;
+	}
 
-			if (!v)
-				continue;
+	v = uc_nl_convert_attr(spec, msg, base, nla, NULL, vm);
+
+	if (v)
+		ucv_array_set(arr, idx, v);
+}
+
+static void
+uc_nl_merge_multiple(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base, struct nlattr *nla_nest, uc_vm_t *vm, uc_value_t *arr)
+{
+	struct nlattr *nla;
+	size_t n = 0;
+	int rem;
+
+	nla_for_each_attr(nla, nla_data(nla_nest), nla_len(nla_nest), rem) {
+		if (!(spec->flags & (DF_AUTOIDX|DF_TYPEIDX)) &&
+		    spec->auxdata && nla_type(nla) != (intptr_t)spec->auxdata)
+			continue;
+
+		if (spec->flags & DF_TYPEIDX)
+			uc_nl_merge_item(spec, msg, base, nla, vm, arr,
+				nla_type(nla) - !!(spec->flags & DF_OFFSET1));
+		else
+			uc_nl_merge_item(spec, msg, base, nla, vm, arr, n++);
+	}
+}
+
+static bool
+uc_nl_merge_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj, const bool *fields)
+{
+	struct nlattr **tb, *nla;
+	uc_value_t *e, *v;
+	bool exists;
+	size_t i, n;
+	int rem;
+
+	tb = uc_nl_index_attrs(buf, buflen, headsize, attrs, nattrs);
+
+	if (!tb)
+		return false;
+
+	for (i = 0; i < nattrs; i++) {
+		if (fields && !fields[i])
+			continue;
+
+		if (attrs[i].attr != 0 && !tb[attrs[i].attr])
+			continue;
+
+		e = ucv_object_get(obj, attrs[i].key, &exists);
+
+		if (!exists) {
+			v = uc_nl_convert_entry(&attrs[i], msg, buf, buflen, tb, vm, false);
+
+			if (v)
+				ucv_object_add(obj, attrs[i].key, v);
 		}
+		else if (attrs[i].flags & DF_REPEATED) {
+			if (ucv_type(e) != UC_ARRAY)
+				continue;
 
-		ucv_object_add(obj, attrs[i].key, v);
+			nla = tb[attrs[i].attr];
+			rem = buflen - ((void *)nla - buf);
+			for (n = 0; nla_ok(nla, rem); nla = nla_next(nla, &rem)) {
+				if (nla_type(nla) != (int)attrs[i].attr)
+					break;
+
+				uc_nl_merge_item(&attrs[i], msg, (char *)buf, nla, vm, e, n++);
+			}
+		}
+		else if (attrs[i].flags & DF_MULTIPLE) {
+			if (ucv_type(e) == UC_ARRAY)
+				uc_nl_merge_multiple(&attrs[i], msg, (char *)buf, tb[attrs[i].attr], vm, e);
+		}
+		else if (attrs[i].attr != 0) {
+			uc_nl_merge_value(&attrs[i], msg, tb[attrs[i].attr], vm, e);
+		}
 	}
 
 	free(tb);
@@ -2037,6 +2361,8 @@ typedef struct {
 	bool merge_phy_info;
 	bool single_phy_info;
 	const uc_nl_nested_spec_t *spec;
+	bool *fields;
+	bool lazy;
 } request_state_t;
 
 
@@ -2078,51 +2404,24 @@ cb_done(struct nl_msg *msg, void *arg)
 	return NL_STOP;
 }
 
-static void
-deep_merge_array(uc_value_t *dest, uc_value_t *src);
-
-static void
-deep_merge_object(uc_value_t *dest, uc_value_t *src);
-
-static void
-deep_merge_array(uc_value_t *dest, uc_value_t *src)
+static uc_value_t *
+uc_nl_merge_target(request_state_t *s, struct genlmsghdr *gnlh)
 {
-	uc_value_t *e, *v;
-	size_t i;
+	struct nlattr *nla;
+	int64_t i;
 
-	if (ucv_type(dest) == UC_ARRAY && ucv_type(src) == UC_ARRAY) {
-		for (i = 0; i < ucv_array_length(src); i++) {
-			e = ucv_array_get(dest, i);
-			v = ucv_array_get(src, i);
-
-			if (!e)
-				ucv_array_set(dest, i, ucv_get(v));
-			else if (ucv_type(v) == UC_ARRAY)
-				deep_merge_array(e, v);
-			else if (ucv_type(v) == UC_OBJECT)
-				deep_merge_object(e, v);
-		}
-	}
-}
+	if (s->single_phy_info)
+		return s->res;
 
-static void
-deep_merge_object(uc_value_t *dest, uc_value_t *src)
-{
-	uc_value_t *e;
-	bool exists;
+	nla = nla_find(genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
+		NL80211_ATTR_WIPHY);
 
-	if (ucv_type(dest) == UC_OBJECT && ucv_type(src) == UC_OBJECT) {
-		ucv_object_foreach(src, k, v) {
-			e = ucv_object_get(dest, k, &exists);
+	if (!nla || !nla_check_len(nla, sizeof(uint32_t)))
+		return NULL;
 
-			if (!exists)
-				ucv_object_add(dest, k, ucv_get(v));
-			else if (ucv_type(v) == UC_ARRAY)
-				deep_merge_array(e, v);
-			else if (ucv_type(v) == UC_OBJECT)
-				deep_merge_object(e, v);
-		}
-	}
+	i = nla_get_u32(nla);
+
+	return ucv_array_get(s->res, i);
 }
 
 static int
@@ -2135,22 +2434,33 @@ cb_reply(struct nl_msg *msg, void *arg)
 	int64_t i;
 	bool rv;
 
+	/* fragment of an already known wiphy, convert into existing object */
+	if ((hdr->nlmsg_flags & NLM_F_MULTI) && s->merge_phy_info) {
+		o = uc_nl_merge_target(s, gnlh);
+
+		if (o) {
+			uc_nl_merge_attrs(msg,
+				genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
+				0, s->spec->attrs, s->spec->nattrs, s->vm, o,
+				s->fields);
+
+			s->state = STATE_CONTINUE;
+
+			return NL_SKIP;
+		}
+	}
+
 	o = ucv_object_new(s->vm);
 
-	rv = uc_nl_convert_attrs(msg,
+	rv = uc_nl_convert_attrs_ex(msg,
 		genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
-		0, s->spec->attrs, s->spec->nattrs, s->vm, o);
+		0, s->spec->attrs, s->spec->nattrs, s->vm, o,
+		s->fields, s->lazy);
 
 	if (rv) {
 		if (hdr->nlmsg_flags & NLM_F_MULTI) {
 			if (s->merge_phy_info && s->single_phy_info) {
-				if (!s->res) {
-					s->res = o;
-				}
-				else {
-					deep_merge_object(s->res, o);
-					ucv_put(o);
-				}
+				s->res = o;
 			}
 			else if (s->merge_phy_info) {
 				idx = ucv_object_get(o, "wiphy", NULL);
@@ -2160,15 +2470,10 @@ cb_reply(struct nl_msg *msg, void *arg)
 					if (!s->res)
 						s->res = ucv_array_new(s->vm);
 
-					idx = ucv_array_get(s->res, i);
-
-					if (idx) {
-						deep_merge_object(idx, o);
-						ucv_put(o);
-					}
-					else {
-						ucv_array_set(s->res, i, o);
-					}
+					ucv_array_set(s->res, i, o);
+				}
+				else {
+					ucv_put(o);
 				}
 			}
 			else {
@@ -2409,54 +2714,242 @@ uc_nl_prepare_event(uc_vm_t *vm, struct nl_msg *msg)
 	return o;
 }
 
+static bool
+uc_nl_listener_call(uc_vm_t *vm, uc_value_t *this, uc_value_t *func, uc_value_t *arg)
+{
+	uc_vm_stack_push(vm, ucv_get(this));
+	uc_vm_stack_push(vm, ucv_get(func));
+	uc_vm_stack_push(vm, arg);
+
+	if (uc_vm_call(vm, true, 1) != EXCEPTION_NONE) {
+		uloop_end();
+		return false;
+	}
+
+	ucv_put(uc_vm_stack_pop(vm));
+
+	return true;
+}
+
+static bool
+uc_nl_listener_flush(uc_vm_t *vm, uc_nl_listener_t *l)
+{
+	uc_value_t *this = ucv_get(ucv_array_get(listener_registry, l->index + LISTENER_THIS));
+	uc_value_t *func = ucv_get(ucv_array_get(listener_registry, l->index + LISTENER_FUNC));
+	uc_value_t *queue = ucv_get(ucv_array_get(listener_registry, l->index + LISTENER_QUEUE));
+	size_t i, j, n = ucv_array_length(queue), step = l->batch ? l->batch : 1;
+	uc_value_t *arg;
+	bool rv = true;
+
+	uloop_timeout_cancel(&l->timer);
+
+	ucv_array_set(listener_registry, l->index + LISTENER_QUEUE, NULL);
+	ucv_array_set(listener_registry, l->index + LISTENER_KEYS, NULL);
+
+	for (i = 0; rv && vm && i < n; i += step) {
+		/* the callback might have closed the listener */
+		if (ucv_resource_data(this, "nl80211.listener") != l)
+			break;
+
+		if (!l->batch) {
+			arg = ucv_get(ucv_array_get(queue, i));
+		}
+		else if (n <= step) {
+			arg = ucv_get(queue);
+		}
+		else {
+			arg = ucv_array_new_length(vm, step);
+
+			for (j = i; j < n && j < i + step; j++)
+				ucv_array_push(arg, ucv_get(ucv_array_get(queue, j)));
+		}
+
+		rv = uc_nl_listener_call(vm, this, func, arg);
+	}
+
+	ucv_put(queue);
+	ucv_put(func);
+	ucv_put(this);
+
+	return rv;
+}
+
+static void
+uc_nl_listener_timer_cb(struct uloop_timeout *t)
+{
+	uc_nl_listener_t *l = container_of(t, uc_nl_listener_t, timer);
+
+	uc_nl_listener_flush(listener_vm, l);
+}
+
+/*
+ * Events referring to the same object - the same command on the same wiphy,
+ * interface and station or BSS address - share a coalescing key.
+ */
+static void
+uc_nl_event_key(struct nl_msg *msg, char *buf, size_t buflen)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+	struct genlmsghdr *gnlh = nlmsg_data(hdr);
+	int64_t wiphy = -1, ifindex = -1;
+	uint8_t *mac = NULL;
+	struct nlattr *nla;
+	int rem;
+
+	nla_for_each_attr(nla, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), rem) {
+		switch (nla_type(nla)) {
+		case NL80211_ATTR_WIPHY:
+			if (nla_len(nla) >= (int)sizeof(uint32_t))
+				wiphy = nla_get_u32(nla);
+
+			break;
+
+		case NL80211_ATTR_IFINDEX:
+			if (nla_len(nla) >= (int)sizeof(uint32_t))
+				ifindex = nla_get_u32(nla);
+
+			break;
+
+		case NL80211_ATTR_MAC:
+			if (nla_len(nla) == ETH_ALEN)
+				mac = nla_data(nla);
+
+			break;
+		}
+	}
+
+	if (mac)
+		snprintf(buf, buflen, "%u:%u:%" PRId64 ":%" PRId64 ":%02x%02x%02x%02x%02x%02x",
+			hdr->nlmsg_type, gnlh->cmd, wiphy, ifindex,
+			mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+	else
+		snprintf(buf, buflen, "%u:%u:%" PRId64 ":%" PRId64,
+			hdr->nlmsg_type, gnlh->cmd, wiphy, ifindex);
+}
+
+static bool
+uc_nl_listener_enqueue(uc_vm_t *vm, uc_nl_listener_t *l, struct nl_msg *msg, uc_value_t *ev)
+{
+	uc_value_t *queue = ucv_array_get(listener_registry, l->index + LISTENER_QUEUE);
+	uc_value_t *keys = ucv_array_get(listener_registry, l->index + LISTENER_KEYS);
+	uc_value_t *idx, *prev, *merged;
+	char key[64];
+
+	if (!queue) {
+		queue = ucv_array_new(vm);
+		ucv_array_set(listener_registry, l->index + LISTENER_QUEUE, queue);
+	}
+
+	if (l->coalesce) {
+		if (!keys) {
+			keys = ucv_object_new(vm);
+			ucv_array_set(listener_registry, l->index + LISTENER_KEYS, keys);
+		}
+
+		uc_nl_event_key(msg, key, sizeof(key));
+
+		idx = ucv_object_get(keys, key, NULL);
+		prev = idx ? ucv_array_get(queue, ucv_int64_get(idx)) : NULL;
+
+		/* merge into the pending event, newer attributes take precedence;
+		 * a new object is built since converted messages are shared */
+		if (prev) {
+			merged = ucv_object_new(vm);
+
+			ucv_object_foreach(ucv_object_get(prev, "msg", NULL), k1, v1)
+				ucv_object_add(merged, k1, ucv_get(v1));
+
+			ucv_object_foreach(ucv_object_get(ev, "msg", NULL), k2, v2)
+				ucv_object_add(merged, k2, ucv_get(v2));
+
+			ucv_object_add(prev, "msg", merged);
+			ucv_put(ev);
+
+			return true;
+		}
+
+		ucv_object_add(keys, key, ucv_int64_new(ucv_array_length(queue)));
+	}
+
+	ucv_array_push(queue, ev);
+
+	if (l->batch && ucv_array_length(queue) >= l->batch)
+		return uc_nl_listener_flush(vm, l);
+
+	if (l->coalesce && !l->timer.pending)
+		uloop_timeout_set(&l->timer, l->coalesce);
+
+	return true;
+}
+
 static int
 cb_listener_event(struct nl_msg *msg, void *arg)
 {
 	struct nlmsghdr *hdr = nlmsg_hdr(msg);
 	struct genlmsghdr *gnlh = nlmsg_data(hdr);
 	uc_vm_t *vm = listener_vm;
+	uc_value_t *data = NULL;
+	bool rv = true;
 
 	if (!nl80211_conn.evsock_fd.registered || !vm)
 		return NL_SKIP;
 
-	for (size_t i = 0; i < ucv_array_length(listener_registry); i += 2) {
-		uc_value_t *this = ucv_array_get(listener_registry, i);
-		uc_value_t *func = ucv_array_get(listener_registry, i + 1);
+	if (gnlh->cmd > NL80211_CMD_MAX)
+		return NL_SKIP;
+
+	for (size_t i = 0; rv && i < ucv_array_length(listener_registry); i += LISTENER_SLOTS) {
+		uc_value_t *this = ucv_array_get(listener_registry, i + LISTENER_THIS);
+		uc_value_t *func = ucv_array_get(listener_registry, i + LISTENER_FUNC);
 		uc_nl_listener_t *l;
-		uc_value_t *o, *data;
+		uc_value_t *o;
 
 		l = ucv_resource_data(this, "nl80211.listener");
 		if (!l)
 			continue;
 
-		if (gnlh->cmd > NL80211_CMD_MAX ||
-			!(l->cmds[gnlh->cmd / 32] & (1 << (gnlh->cmd % 32))))
+		if (!(l->cmds[gnlh->cmd / 32] & (1 << (gnlh->cmd % 32))))
 			continue;
 
 		if (!ucv_is_callable(func))
 			continue;
 
-		data = uc_nl_prepare_event(vm, msg);
-		if (!data)
-			return NL_SKIP;
+		/* convert once and only if any listener is interested */
+		if (!data) {
+			data = uc_nl_prepare_event(vm, msg);
+
+			if (!data)
+				return NL_SKIP;
+		}
 
 		o = ucv_object_new(vm);
 		ucv_object_add(o, "cmd", ucv_int64_new(gnlh->cmd));
-		ucv_object_add(o, "msg", data);
+		ucv_object_add(o, "msg", ucv_get(data));
 
-		uc_vm_stack_push(vm, ucv_get(this));
-		uc_vm_stack_push(vm, ucv_get(func));
-		uc_vm_stack_push(vm, o);
+		if (l->batch || l->coalesce)
+			rv = uc_nl_listener_enqueue(vm, l, msg, o);
+		else
+			rv = uc_nl_listener_call(vm, this, func, o);
+	}
 
-		if (uc_vm_call(vm, true, 1) != EXCEPTION_NONE) {
-			uloop_end();
-			return NL_STOP;
-		}
+	ucv_put(data);
 
-		ucv_put(uc_vm_stack_pop(vm));
-	}
+	return rv ? NL_SKIP : NL_STOP;
+}
 
-	return NL_SKIP;
+static void
+uc_nl_listener_flush_batches(void)
+{
+	uc_nl_listener_t *l;
+	size_t i;
+
+	for (i = 0; i < ucv_array_length(listener_registry); i += LISTENER_SLOTS) {
+		l = ucv_resource_data(ucv_array_get(listener_registry, i + LISTENER_THIS),
+			"nl80211.listener");
+
+		if (l && l->batch && !l->coalesce &&
+		    !uc_nl_listener_flush(listener_vm, l))
+			break;
+	}
 }
 
 static int
@@ -2546,6 +3039,67 @@ uc_nl_evsock_init(void)
 	return true;
 }
 
+/*
+ * Install a classic BPF socket filter on the event socket which lets the
+ * kernel drop multicast notifications whose command no listener (or pending
+ * waitfor() call) asked for, before they are queued to the socket. Unicast
+ * replies to requests carry a non-zero port ID and always pass.
+ */
+static void
+uc_nl_evsock_filter(const uint32_t *extra)
+{
+	uint32_t cmds[NL80211_CMDS_BITMAP_SIZE] = { 0 };
+	struct sock_filter code[NL80211_CMD_MAX + 6], *p = code;
+	struct sock_fprog prog = { .filter = code };
+	size_t i, j, ncmds = 0;
+	uc_nl_listener_t *l;
+	int fd;
+
+	if (!nl80211_conn.evsock)
+		return;
+
+	fd = nl_socket_get_fd(nl80211_conn.evsock);
+
+	for (i = 0; i < ucv_array_length(listener_registry); i += LISTENER_SLOTS) {
+		l = ucv_resource_data(ucv_array_get(listener_registry, i + LISTENER_THIS),
+			"nl80211.listener");
+
+		for (j = 0; l && j < NL80211_CMDS_BITMAP_SIZE; j++)
+			cmds[j] |= l->cmds[j];
+	}
+
+	for (j = 0; extra && j < NL80211_CMDS_BITMAP_SIZE; j++)
+		cmds[j] |= extra[j];
+
+	for (i = 0; i <= NL80211_CMD_MAX; i++)
+		if (cmds[i / 32] & (1 << (i % 32)))
+			ncmds++;
+
+	if (ncmds == NL80211_CMD_MAX + 1) {
+		setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0);
+
+		return;
+	}
+
+	/* accept if nlmsg_pid != 0 */
+	*p++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, offsetof(struct nlmsghdr, nlmsg_pid));
+	*p++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, ncmds + 2);
+
+	/* accept if genlmsghdr.cmd is any of the requested commands */
+	*p++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_B|BPF_ABS, NLMSG_HDRLEN + offsetof(struct genlmsghdr, cmd));
+
+	for (i = 0, j = ncmds; i <= NL80211_CMD_MAX; i++)
+		if (cmds[i / 32] & (1 << (i % 32)))
+			*p++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, i, j--, 0);
+
+	*p++ = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0);
+	*p++ = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0xffffffff);
+
+	prog.len = p - code;
+
+	setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
 static uc_value_t *
 uc_nl_waitfor(uc_vm_t *vm, size_t nargs)
 {
@@ -2585,6 +3139,8 @@ uc_nl_waitfor(uc_vm_t *vm, size_t nargs)
 
 	pfd.fd = nl_socket_get_fd(nl80211_conn.evsock);
 
+	uc_nl_evsock_filter(ctx.cmds);
+
 	if (poll(&pfd, 1, ms) == 1) {
 		while (err == 0 && ctx.cmd == 0)
 			nl_recvmsgs(nl80211_conn.evsock, cb);
@@ -2592,6 +3148,9 @@ uc_nl_waitfor(uc_vm_t *vm, size_t nargs)
 
 	nl_cb_put(cb);
 
+	uc_nl_evsock_filter(NULL);
+	uc_nl_listener_flush_batches();
+
 	if (ctx.cmd) {
 		rv = ucv_object_new(vm);
 
@@ -2608,6 +3167,38 @@ uc_nl_waitfor(uc_vm_t *vm, size_t nargs)
 	}
 }
 
+static bool
+uc_nl_parse_fields(request_state_t *s, uc_value_t *fields)
+{
+	uc_value_t *field;
+	bool found;
+	size_t i, j;
+
+	s->fields = calloc(s->spec->nattrs, sizeof(*s->fields));
+
+	if (!s->fields)
+		err_return(NLE_NOMEM, NULL);
+
+	for (i = 0; i < ucv_array_length(fields); i++) {
+		field = ucv_array_get(fields, i);
+
+		if (ucv_type(field) != UC_STRING)
+			err_return(NLE_INVAL, "Field names must be strings");
+
+		for (j = 0, found = false; j < s->spec->nattrs; j++) {
+			if (!strcmp(s->spec->attrs[j].key, ucv_string_get(field))) {
+				s->fields[j] = true;
+				found = true;
+			}
+		}
+
+		if (!found)
+			err_return(NLE_INVAL, "Unknown field '%s'", ucv_string_get(field));
+	}
+
+	return true;
+}
+
 static uc_value_t *
 uc_nl_request_common(struct nl_sock *sock, uc_vm_t *vm, size_t nargs)
 {
@@ -2615,6 +3206,8 @@ uc_nl_request_common(struct nl_sock *sock, uc_vm_t *vm, size_t nargs)
 	uc_value_t *cmd = uc_fn_arg(0);
 	uc_value_t *flags = uc_fn_arg(1);
 	uc_value_t *payload = uc_fn_arg(2);
+	uc_value_t *opts = uc_fn_arg(3);
+	uc_value_t *fields, *rv;
 	uint16_t flagval = 0;
 	struct nl_msg *msg;
 	struct nl_cb *cb;
@@ -2622,7 +3215,13 @@ uc_nl_request_common(struct nl_sock *sock, uc_vm_t *vm, size_t nargs)
 
 	if (ucv_type(cmd) != UC_INTEGER || ucv_int64_get(cmd) < 0 ||
 	    (flags != NULL && ucv_type(flags) != UC_INTEGER) ||
-	    (payload != NULL && ucv_type(payload) != UC_OBJECT))
+	    (payload != NULL && ucv_type(payload) != UC_OBJECT) ||
+	    (opts != NULL && ucv_type(opts) != UC_OBJECT))
+		err_return(NLE_INVAL, NULL);
+
+	fields = ucv_object_get(opts, "fields", NULL);
+
+	if (fields != NULL && ucv_type(fields) != UC_ARRAY)
 		err_return(NLE_INVAL, NULL);
 
 	if (flags) {
@@ -2671,10 +3270,21 @@ uc_nl_request_common(struct nl_sock *sock, uc_vm_t *vm, size_t nargs)
 		return NULL;
 	}
 
+	/* lazy values cannot be merged, so split wiphy dumps decode eagerly */
+	st.lazy = ucv_is_truish(ucv_object_get(opts, "lazy", NULL)) && !st.merge_phy_info;
+
+	if (fields && !uc_nl_parse_fields(&st, fields)) {
+		nlmsg_free(msg);
+		free(st.fields);
+
+		return NULL;
+	}
+
 	cb = nl_cb_alloc(NL_CB_DEFAULT);
 
 	if (!cb) {
 		nlmsg_free(msg);
+		free(st.fields);
 		err_return(NLE_NOMEM, NULL);
 	}
 
@@ -2692,22 +3302,29 @@ uc_nl_request_common(struct nl_sock *sock, uc_vm_t *vm, size_t nargs)
 
 	nlmsg_free(msg);
 	nl_cb_put(cb);
+	free(st.fields);
 
-	if (ret < 0)
+	if (ret < 0) {
+		ucv_put(st.res);
 		err_return(ret, NULL);
+	}
 
 	switch (st.state) {
 	case STATE_REPLIED:
-		return st.res;
+		rv = st.res;
+		break;
 
 	case STATE_UNREPLIED:
-		return ucv_boolean_new(true);
+		rv = ucv_boolean_new(true);
+		break;
 
 	default:
 		set_error(NLE_FAILURE, "Interrupted reply");
-
-		return ucv_boolean_new(false);
+		rv = ucv_boolean_new(false);
+		break;
 	}
+
+	return rv;
 }
 
 static uc_value_t *
@@ -2719,11 +3336,135 @@ uc_nl_request(uc_vm_t *vm, size_t nargs)
 	return uc_nl_request_common(nl80211_conn.sock, vm, nargs);
 }
 
+/*
+ * decode(cmd, data[, opts])
+ *
+ * Decode recorded reply messages, given as a string or byte buffer of
+ * concatenated netlink messages, as if they were received in response to the
+ * given command. The messages pass through the same reply handling as
+ * request(), including the assembly of split wiphy dumps, which allows
+ * replaying and inspecting captured dumps without a kernel. The `fields` and
+ * `lazy` options behave like the ones of request().
+ *
+ * Returns the decoded reply like request() does, error replies yield null
+ * with the error reported by error(). The replay benchmark of the dump
+ * assembly in tests/nl80211_wiphy_merge.uc is built on it.
+ */
+static uc_value_t *
+uc_nl_decode(uc_vm_t *vm, size_t nargs)
+{
+	request_state_t st = { .vm = vm };
+	uc_value_t *cmd = uc_fn_arg(0);
+	uc_value_t *data = uc_fn_arg(1);
+	uc_value_t *opts = uc_fn_arg(2);
+	uc_value_t *fields;
+	struct nlmsgerr *nlerr;
+	struct nlmsghdr *hdr;
+	struct nl_msg *msg;
+	const char *src;
+	size_t len;
+	void *buf;
+	int rem;
+
+	src = ucv_bytes_get(data, &len);
+
+	if (ucv_type(cmd) != UC_INTEGER || ucv_int64_get(cmd) < 0 || !src ||
+	    len > INT_MAX || (opts != NULL && ucv_type(opts) != UC_OBJECT))
+		err_return(NLE_INVAL, NULL);
+
+	fields = ucv_object_get(opts, "fields", NULL);
+
+	if (fields != NULL && ucv_type(fields) != UC_ARRAY)
+		err_return(NLE_INVAL, NULL);
+
+	if (ucv_int64_get(cmd) >= HWSIM_CMD_OFFSET) {
+		st.spec = &hwsim_msg;
+	}
+	else {
+		st.spec = &nl80211_msg;
+		st.merge_phy_info = (ucv_int64_get(cmd) == NL80211_CMD_GET_WIPHY);
+	}
+
+	st.lazy = ucv_is_truish(ucv_object_get(opts, "lazy", NULL)) && !st.merge_phy_info;
+
+	if (fields && !uc_nl_parse_fields(&st, fields)) {
+		free(st.fields);
+
+		return NULL;
+	}
+
+	/* keep the message headers aligned */
+	buf = malloc(len ? len : 1);
+
+	if (!buf) {
+		free(st.fields);
+		err_return(NLE_NOMEM, NULL);
+	}
+
+	memcpy(buf, src, len);
+
+	for (hdr = buf, rem = len;
+	     nlmsg_ok(hdr, rem) && st.state < STATE_REPLIED;
+	     hdr = nlmsg_next(hdr, &rem)) {
+		switch (hdr->nlmsg_type) {
+		case NLMSG_DONE:
+			st.state = STATE_REPLIED;
+			break;
+
+		case NLMSG_ERROR:
+			nlerr = nlmsg_data(hdr);
+
+			if (!nlmsg_valid_hdr(hdr, sizeof(*nlerr))) {
+				set_error(NLE_MSG_TOOSHORT, NULL);
+				st.state = STATE_ERROR;
+			}
+			else if (nlerr->error != 0) {
+				set_error(nl_syserr2nlerr(nlerr->error), NULL);
+				st.state = STATE_ERROR;
+			}
+			else {
+				st.state = STATE_REPLIED;
+			}
+
+			break;
+
+		default:
+			if (hdr->nlmsg_type < NLMSG_MIN_TYPE || !genlmsg_valid_hdr(hdr, 0))
+				break;
+
+			msg = nlmsg_convert(hdr);
+
+			if (!msg) {
+				set_error(NLE_NOMEM, NULL);
+				st.state = STATE_ERROR;
+				break;
+			}
+
+			cb_reply(msg, &st);
+			nlmsg_free(msg);
+			break;
+		}
+	}
+
+	free(buf);
+	free(st.fields);
+
+	if (st.state == STATE_ERROR) {
+		ucv_put(st.res);
+
+		return NULL;
+	}
+
+	return st.res;
+}
+
 static void
 uc_nl_listener_cb(struct uloop_fd *fd, unsigned int events)
 {
 	while (nl_recvmsgs(nl80211_conn.evsock, nl80211_conn.evsock_cb) == 0)
 		;
+
+	uc_nl_listener_flush_batches();
 }
 
 static uc_value_t *
@@ -2733,6 +3474,9 @@ uc_nl_listener(uc_vm_t *vm, size_t nargs)
 	uc_nl_listener_t *l;
 	uc_value_t *cb_func = uc_fn_arg(0);
 	uc_value_t *cmds = uc_fn_arg(1);
+	uc_value_t *opts = uc_fn_arg(2);
+	uc_value_t *batch = ucv_object_get(opts, "batch", NULL);
+	uc_value_t *coalesce = ucv_object_get(opts, "coalesce", NULL);
 	uc_value_t *rv;
 	size_t i;
 
@@ -2741,6 +3485,19 @@ uc_nl_listener(uc_vm_t *vm, size_t nargs)
 		return NULL;
 	}
 
+	if (opts && ucv_type(opts) != UC_OBJECT) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Invalid options");
+		return NULL;
+	}
+
+	if ((batch && ucv_type(batch) != UC_BOOLEAN &&
+	     (ucv_type(batch) != UC_INTEGER || ucv_int64_get(batch) < 1)) ||
+	    (coalesce && (ucv_type(coalesce) != UC_INTEGER ||
+	     ucv_int64_get(coalesce) < 0 || ucv_int64_get(coalesce) > INT32_MAX))) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Invalid batch or coalesce option");
+		return NULL;
+	}
+
 	if (!uc_nl_evsock_init())
 		return NULL;
 
@@ -2761,12 +3518,11 @@ uc_nl_listener(uc_vm_t *vm, size_t nargs)
 		nl80211_conn.evsock_cb = cb;
 	}
 
-	for (i = 0; i < ucv_array_length(listener_registry); i += 2) {
-		if (!ucv_array_get(listener_registry, i))
+	for (i = 0; i < ucv_array_length(listener_registry); i += LISTENER_SLOTS) {
+		if (!ucv_array_get(listener_registry, i + LISTENER_THIS))
 			break;
 	}
 
-	ucv_array_set(listener_registry, i + 1, ucv_get(cb_func));
 	l = xalloc(sizeof(*l));
 	l->index = i;
 	if (!uc_nl_fill_cmds(l->cmds, cmds)) {
@@ -2775,10 +3531,22 @@ uc_nl_listener(uc_vm_t *vm, size_t nargs)
 		return NULL;
 	}
 
+	if (ucv_type(batch) == UC_INTEGER)
+		l->batch = ucv_int64_get(batch);
+	else if (ucv_is_truish(batch))
+		l->batch = SIZE_MAX;
+
+	l->coalesce = ucv_int64_get(coalesce);
+	l->timer.cb = uc_nl_listener_timer_cb;
+
+	ucv_array_set(listener_registry, i + LISTENER_FUNC, ucv_get(cb_func));
+
 	rv = uc_resource_new(listener_type, l);
-	ucv_array_set(listener_registry, i, ucv_get(rv));
+	ucv_array_set(listener_registry, i + LISTENER_THIS, ucv_get(rv));
 	listener_vm = vm;
 
+	uc_nl_evsock_filter(NULL);
+
 	return rv;
 }
 
@@ -2786,10 +3554,16 @@ static void
 uc_nl_listener_free(void *arg)
 {
 	uc_nl_listener_t *l = arg;
+	size_t i;
+
+	uloop_timeout_cancel(&l->timer);
+
+	for (i = 0; i < LISTENER_SLOTS; i++)
+		ucv_array_set(listener_registry, l->index + i, NULL);
 
-	ucv_array_set(listener_registry, l->index, NULL);
-	ucv_array_set(listener_registry, l->index + 1, NULL);
 	free(l);
+
+	uc_nl_evsock_filter(NULL);
 }
 
 static uc_value_t *
@@ -2805,6 +3579,8 @@ uc_nl_listener_set_commands(uc_vm_t *vm, size_t nargs)
 	if (!uc_nl_fill_cmds(l->cmds, cmds))
 		uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Invalid command ID");
 
+	uc_nl_evsock_filter(NULL);
+
 	return NULL;
 }
 
@@ -3003,11 +3779,19 @@ register_constants(uc_vm_t *vm, uc_value_t *scope)
 	ucv_object_add(scope, "const", c);
 };
 
+static uc_value_t *
+uc_nl_expand(uc_vm_t *vm, size_t nargs)
+{
+	return uc_nl_expand_value(vm, uc_fn_arg(0));
+}
+
 static const uc_function_list_t global_fns[] = {
 	{ "error",		uc_nl_error },
 	{ "request",	uc_nl_request },
 	{ "waitfor",	uc_nl_waitfor },
 	{ "listener",	uc_nl_listener },
+	{ "expand",		uc_nl_expand },
+	{ "decode",		uc_nl_decode },
 };
 
 
@@ -3022,6 +3806,9 @@ void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 	uc_function_list_register(scope, global_fns);
 
 	listener_type = uc_type_declare(vm, "nl80211.listener", listener_fns, uc_nl_listener_free);
+
+	lazy_type = ucv_resource_type_add(vm, "nl80211.lazy", NULL, NULL);
+	lazy_type->get = uc_nl_lazy_get;
 	listener_registry = ucv_array_new(vm);
 
 	uc_vm_registry_set(vm, "nl80211.registry", listener_registry);
@@ -227,6 +227,9 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <fcntl.h>
+#include <ctype.h>
+
+#include <libubox/uloop.h>
 
 #include "ucode/module.h"
 
@@ -237,6 +240,11 @@
 
 #define err_return(code, ...) do { set_error(code, __VA_ARGS__); return NULL; } while(0)
 
+#define RESOLV_SOCKETS		4
+#define RESOLV_ID_BUCKETS	256
+#define RESOLV_CACHE_MAX	1024
+#define RESOLV_CACHE_MAXTTL	86400
+
 static struct {
 	int code;
 	char *msg;
@@ -274,9 +282,12 @@ typedef struct {
 
 typedef struct {
 	char *name;
+	int type;
 	size_t qlen, rlen;
 	unsigned char query[512];
 	int rcode;
+	struct list_head list;
+	void *req;
 } query_t;
 
 typedef struct __attribute__((packed)) {
@@ -299,6 +310,7 @@ typedef struct {
 	uint32_t timeout;
 	uint16_t edns_maxsize;
 	bool txt_as_array;
+	bool cache;
 }  resolve_ctx_t;
 
 
@@ -758,6 +770,185 @@ add_status(uc_vm_t *vm, uc_value_t *res_obj, const char *name, const char *rcode
 	ucv_object_add(name_obj, "rcode", ucv_string_new(rcode));
 }
 
+static unsigned long
+mono_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void
+apply_reply(uc_vm_t *vm, resolve_ctx_t *ctx, query_t *q, uc_value_t *res_obj,
+            const unsigned char *buf, size_t len)
+{
+	q->rcode = buf[3] & 15;
+
+	if (q->rcode == 0)
+		ucv_object_delete(ucv_object_get(res_obj, q->name, NULL), "rcodes");
+	else
+		add_status(vm, res_obj, q->name, rcodes[q->rcode]);
+
+	q->rlen = len;
+
+	parse_reply(vm, res_obj, buf, len, ctx->txt_as_array);
+}
+
+/*
+ * Answer cache, kept per VM in the registry. Successful replies are cached
+ * for the lowest TTL of their answer records, NXDOMAIN and NODATA replies
+ * for the negative TTL derived from the authority SOA record (RFC 2308).
+ * Entries hold the expiry time and the raw reply packet, which is parsed
+ * again on a cache hit to honor per-query options.
+ */
+static void
+cache_key(char *buf, size_t buflen, const query_t *q)
+{
+	size_t i;
+
+	i = snprintf(buf, buflen, "%d/", q->type);
+
+	for (const char *p = q->name; *p && i + 1 < buflen; p++)
+		buf[i++] = tolower((unsigned char)*p);
+
+	buf[i] = 0;
+}
+
+static long
+reply_ttl(const unsigned char *msg, size_t len)
+{
+	long ttl = -1, minimum;
+	ns_msg handle;
+	ns_rr rr;
+	int i;
+
+	if (ns_initparse(msg, len, &handle) != 0)
+		return -1;
+
+	for (i = 0; i < ns_msg_count(handle, ns_s_an); i++) {
+		if (ns_parserr(&handle, ns_s_an, i, &rr) != 0)
+			return -1;
+
+		if (ttl < 0 || (long)ns_rr_ttl(rr) < ttl)
+			ttl = ns_rr_ttl(rr);
+	}
+
+	for (i = 0; ttl < 0 && i < ns_msg_count(handle, ns_s_ns); i++) {
+		if (ns_parserr(&handle, ns_s_ns, i, &rr) != 0)
+			return -1;
+
+		if (ns_rr_type(rr) != ns_t_soa || ns_rr_rdlen(rr) < 20)
+			continue;
+
+		minimum = ns_get32(ns_rr_rdata(rr) + ns_rr_rdlen(rr) - 4);
+		ttl = ((long)ns_rr_ttl(rr) < minimum) ? (long)ns_rr_ttl(rr) : minimum;
+	}
+
+	return (ttl > RESOLV_CACHE_MAXTTL) ? RESOLV_CACHE_MAXTTL : ttl;
+}
+
+static uc_value_t *
+cache_get(uc_vm_t *vm)
+{
+	uc_value_t *cache = uc_vm_registry_get(vm, "resolv.cache");
+
+	if (!cache) {
+		cache = ucv_object_new(vm);
+		uc_vm_registry_set(vm, "resolv.cache", cache);
+	}
+
+	return cache;
+}
+
+static void
+cache_expire(uc_value_t *cache, unsigned long now)
+{
+	uc_value_t *expired = ucv_array_new(NULL), *key;
+	size_t i;
+
+	ucv_object_foreach(cache, k, v)
+		if ((unsigned long)ucv_int64_get(ucv_array_get(v, 0)) <= now)
+			ucv_array_push(expired, ucv_string_new(k));
+
+	for (i = 0; i < ucv_array_length(expired); i++) {
+		key = ucv_array_get(expired, i);
+		ucv_object_delete(cache, ucv_string_get(key));
+	}
+
+	ucv_put(expired);
+}
+
+static void
+cache_store(uc_vm_t *vm, const query_t *q, const unsigned char *msg, size_t len)
+{
+	char key[MAXDNAME + 16];
+	unsigned long now;
+	uc_value_t *cache, *entry;
+	long ttl;
+
+	/* only cache complete positive and negative answers */
+	if ((msg[3] & 15) != 0 && (msg[3] & 15) != 3)
+		return;
+
+	if (msg[2] & 2)
+		return;
+
+	ttl = reply_ttl(msg, len);
+
+	if (ttl <= 0)
+		return;
+
+	cache = cache_get(vm);
+	now = mono_time();
+
+	if (ucv_object_length(cache) >= RESOLV_CACHE_MAX)
+		cache_expire(cache, now);
+
+	if (ucv_object_length(cache) >= RESOLV_CACHE_MAX)
+		return;
+
+	cache_key(key, sizeof(key), q);
+
+	entry = ucv_array_new_length(vm, 2);
+	ucv_array_push(entry, ucv_int64_new(now + ttl * 1000));
+	ucv_array_push(entry, ucv_string_new_length((const char *)msg, len));
+
+	ucv_object_add(cache, key, entry);
+}
+
+static bool
+cache_lookup(uc_vm_t *vm, resolve_ctx_t *ctx, query_t *q, uc_value_t *res_obj)
+{
+	char key[MAXDNAME + 16];
+	uc_value_t *cache, *entry, *pkt;
+
+	cache = uc_vm_registry_get(vm, "resolv.cache");
+
+	if (!cache)
+		return false;
+
+	cache_key(key, sizeof(key), q);
+
+	entry = ucv_object_get(cache, key, NULL);
+
+	if (!entry)
+		return false;
+
+	if ((unsigned long)ucv_int64_get(ucv_array_get(entry, 0)) <= mono_time()) {
+		ucv_object_delete(cache, key);
+
+		return false;
+	}
+
+	pkt = ucv_array_get(entry, 1);
+
+	apply_reply(vm, ctx, q, res_obj,
+		(const unsigned char *)ucv_string_get(pkt), ucv_string_length(pkt));
+
+	return true;
+}
+
 /*
  * Function logic borrowed & modified from musl libc, res_msend.c
  */
@@ -776,6 +967,18 @@ send_queries(resolve_ctx_t *ctx, uc_vm_t *vm, uc_value_t *res_obj)
 	unsigned int nn, qn, next_query = 0;
 	struct { unsigned char *buf; size_t len; } reply_buf = { 0 };
 
+	if (ctx->cache) {
+		for (qn = 0; qn < ctx->n_queries; qn++)
+			if (cache_lookup(vm, ctx, &ctx->queries[qn], res_obj))
+				n_replies++;
+
+		while (next_query < ctx->n_queries && ctx->queries[next_query].rcode != -1)
+			next_query++;
+
+		if (next_query >= ctx->n_queries)
+			return n_replies;
+	}
+
 	from.u.sa.sa_family = AF_INET;
 	from.len = sizeof(from.u.sin);
 
@@ -920,35 +1123,19 @@ send_queries(resolve_ctx_t *ctx, uc_vm_t *vm, uc_value_t *res_obj)
 			    (ctx->queries[qn].rcode == 3 && (reply_buf.buf[3] & 15) != 0))
 				continue;
 
-			ctx->queries[qn].rcode = reply_buf.buf[3] & 15;
-
-			switch (ctx->queries[qn].rcode) {
-			case 0:
-				ucv_object_delete(
-					ucv_object_get(res_obj, ctx->queries[qn].name, NULL),
-					"rcodes");
-
-				break;
-
-			case 2:
-				/* Retry immediately on server failure. */
-				if (servfail_retry && servfail_retry--)
-					sendto(fd, ctx->queries[qn].query, ctx->queries[qn].qlen,
-					       MSG_NOSIGNAL, &ctx->ns[nn].addr.u.sa, ctx->ns[nn].addr.len);
-
-				/* fall through */
-
-			default:
-				add_status(vm, res_obj, ctx->queries[qn].name,
-				           rcodes[ctx->queries[qn].rcode]);
-			}
+			/* Retry immediately on server failure. */
+			if ((reply_buf.buf[3] & 15) == 2 && servfail_retry && servfail_retry--)
+				sendto(fd, ctx->queries[qn].query, ctx->queries[qn].qlen,
+				       MSG_NOSIGNAL, &ctx->ns[nn].addr.u.sa, ctx->ns[nn].addr.len);
 
 			/* Store answer */
 			n_replies++;
 
-			ctx->queries[qn].rlen = recvlen;
+			apply_reply(vm, ctx, &ctx->queries[qn], res_obj,
+			            reply_buf.buf, recvlen);
 
-			parse_reply(vm, res_obj, reply_buf.buf, recvlen, ctx->txt_as_array);
+			if (ctx->cache)
+				cache_store(vm, &ctx->queries[qn], reply_buf.buf, recvlen);
 
 			if (qn == next_query) {
 				while (next_query < ctx->n_queries) {
@@ -1085,6 +1272,7 @@ add_query(resolve_ctx_t *ctx, int type, const char *dname)
 	}
 
 	ctx->queries[ctx->n_queries].qlen = qlen;
+	ctx->queries[ctx->n_queries].type = type;
 	ctx->queries[ctx->n_queries].name = xstrdup(dname);
 	ctx->queries[ctx->n_queries].rcode = -1;
 
@@ -1203,9 +1391,358 @@ parse_options(resolve_ctx_t *ctx, uc_value_t *opts)
 	else if (v)
 		err_return(EINVAL, "Array TXT record flag not a boolean");
 
+	v = ucv_object_get(opts, "cache", NULL);
+
+	if (ucv_type(v) == UC_BOOLEAN)
+		ctx->cache = ucv_boolean_get(v);
+	else if (v)
+		err_return(EINVAL, "Cache flag not a boolean");
+
+	return true;
+}
+
+/*
+ * Asynchronous queries are driven by uloop. All in-flight queries of all
+ * requests of a VM are multiplexed on a small pool of non-blocking UDP
+ * sockets per address family and matched to replies through a table of
+ * their DNS transaction IDs, which are kept unique among in-flight queries.
+ *
+ * This state is kept in a resource stored in the VM registry, so that its
+ * release on VM teardown cancels all pending requests and closes the pooled
+ * sockets.
+ */
+typedef struct async_state async_state_t;
+
+typedef struct {
+	struct uloop_fd fd;
+	async_state_t *state;
+} async_sock_t;
+
+struct async_state {
+	async_sock_t socks[2][RESOLV_SOCKETS];
+	struct list_head ids[RESOLV_ID_BUCKETS];
+	struct list_head requests;
+};
+
+typedef struct {
+	uc_vm_t *vm;
+	uc_value_t *obj;
+	async_state_t *state;
+	struct list_head list;
+	resolve_ctx_t ctx;
+	struct uloop_timeout timer;
+	unsigned long t0;
+	int servfail_retry;
+	size_t pending;
+	size_t n_replies;
+} async_req_t;
+
+static uint16_t
+query_id(const query_t *q)
+{
+	return (q->query[0] << 8) | q->query[1];
+}
+
+static void async_sock_cb(struct uloop_fd *fd, unsigned int events);
+
+static void
+async_unlink(async_req_t *req);
+
+static void
+async_state_free(void *ptr)
+{
+	async_state_t *state = ptr;
+	async_req_t *req, *tmp;
+	struct uloop_fd *fd;
+	size_t i, j;
+
+	/* cancel timers and detach the queries of still pending requests */
+	list_for_each_entry_safe(req, tmp, &state->requests, list)
+		async_unlink(req);
+
+	for (i = 0; i < ARRAY_SIZE(state->socks); i++) {
+		for (j = 0; j < RESOLV_SOCKETS; j++) {
+			fd = &state->socks[i][j].fd;
+
+			if (fd->registered) {
+				uloop_fd_delete(fd);
+				close(fd->fd);
+			}
+		}
+	}
+
+	free(state);
+}
+
+static async_state_t *
+async_state_get(uc_vm_t *vm)
+{
+	uc_value_t *res = uc_vm_registry_get(vm, "resolv.async");
+	async_state_t *state = ucv_resource_data(res, "resolv.async");
+	size_t i, j;
+
+	if (!state) {
+		state = xalloc(sizeof(*state));
+
+		for (i = 0; i < ARRAY_SIZE(state->socks); i++) {
+			for (j = 0; j < RESOLV_SOCKETS; j++) {
+				state->socks[i][j].fd.cb = async_sock_cb;
+				state->socks[i][j].state = state;
+			}
+		}
+
+		for (i = 0; i < RESOLV_ID_BUCKETS; i++)
+			INIT_LIST_HEAD(&state->ids[i]);
+
+		INIT_LIST_HEAD(&state->requests);
+
+		res = ucv_resource_create(vm, "resolv.async", state);
+
+		uc_vm_registry_set(vm, "resolv.async", res);
+	}
+
+	return state;
+}
+
+static query_t *
+async_find(async_state_t *state, uint16_t id)
+{
+	query_t *q;
+
+	list_for_each_entry(q, &state->ids[id % RESOLV_ID_BUCKETS], list)
+		if (query_id(q) == id)
+			return q;
+
+	return NULL;
+}
+
+static bool
+async_link(async_state_t *state, query_t *q)
+{
+	uint16_t id = query_id(q);
+	size_t i;
+
+	for (i = 0; async_find(state, id); i++, id++)
+		if (i > UINT16_MAX)
+			return false;
+
+	q->query[0] = id >> 8;
+	q->query[1] = id & 0xff;
+
+	list_add(&q->list, &state->ids[id % RESOLV_ID_BUCKETS]);
+
 	return true;
 }
 
+static void
+async_unlink(async_req_t *req)
+{
+	size_t i;
+
+	uloop_timeout_cancel(&req->timer);
+
+	if (req->list.next)
+		list_del_init(&req->list);
+
+	for (i = 0; i < req->ctx.n_queries; i++)
+		if (req->ctx.queries[i].list.next)
+			list_del_init(&req->ctx.queries[i].list);
+}
+
+static struct uloop_fd *
+async_sock(async_state_t *state, int family, uint16_t id)
+{
+	struct uloop_fd *fd = &state->socks[family == AF_INET6][id % RESOLV_SOCKETS].fd;
+	int sock;
+
+	if (fd->registered)
+		return fd;
+
+	sock = socket(family, SOCK_DGRAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
+
+	if (sock < 0)
+		return NULL;
+
+	fd->fd = sock;
+
+	if (uloop_fd_add(fd, ULOOP_READ) < 0) {
+		close(sock);
+
+		return NULL;
+	}
+
+	return fd;
+}
+
+static void
+async_send(async_req_t *req, query_t *q, ns_t *ns)
+{
+	struct uloop_fd *fd = async_sock(req->state, ns->addr.u.sa.sa_family, query_id(q));
+
+	if (fd)
+		sendto(fd->fd, q->query, q->qlen, MSG_NOSIGNAL,
+		       &ns->addr.u.sa, ns->addr.len);
+}
+
+static void
+async_release(async_req_t *req)
+{
+	uc_value_t *obj = req->obj;
+
+	if (!obj)
+		return;
+
+	req->obj = NULL;
+
+	ucv_resource_persistent_set(obj, false);
+	ucv_put(obj);
+}
+
+static void
+async_finish(async_req_t *req)
+{
+	uc_vm_t *vm = req->vm;
+	uc_value_t *obj = ucv_get(req->obj);
+	uc_value_t *func = ucv_resource_value_get(obj, 0);
+	uc_value_t *res_obj = ucv_resource_value_get(obj, 1);
+	size_t i;
+
+	async_unlink(req);
+
+	for (i = 0; i < req->ctx.n_queries; i++)
+		if (req->ctx.queries[i].rcode == -1)
+			add_status(vm, res_obj, req->ctx.queries[i].name, "TIMEOUT");
+
+	if (ucv_is_callable(func)) {
+		uc_vm_stack_push(vm, ucv_get(obj));
+		uc_vm_stack_push(vm, ucv_get(func));
+		uc_vm_stack_push(vm, ucv_get(res_obj));
+
+		if (uc_vm_call(vm, true, 1) == EXCEPTION_NONE)
+			ucv_put(uc_vm_stack_pop(vm));
+		else
+			uloop_end();
+	}
+
+	/* the callback might have aborted the request already */
+	async_release(req);
+	ucv_put(obj);
+}
+
+static void
+async_timer_cb(struct uloop_timeout *t)
+{
+	async_req_t *req = container_of(t, async_req_t, timer);
+	unsigned long now = mono_time(), interval;
+	size_t qn, nn;
+
+	if (req->pending == 0 || now - req->t0 >= req->ctx.timeout) {
+		async_finish(req);
+
+		return;
+	}
+
+	for (qn = 0; qn < req->ctx.n_queries; qn++) {
+		if (req->ctx.queries[qn].rcode == 0 || req->ctx.queries[qn].rcode == 3)
+			continue;
+
+		for (nn = 0; nn < req->ctx.n_ns; nn++)
+			async_send(req, &req->ctx.queries[qn], &req->ctx.ns[nn]);
+	}
+
+	req->servfail_retry = 2 * req->ctx.n_queries;
+
+	interval = req->ctx.retries ? req->ctx.timeout / req->ctx.retries : req->ctx.timeout;
+
+	if (interval > req->t0 + req->ctx.timeout - now)
+		interval = req->t0 + req->ctx.timeout - now;
+
+	uloop_timeout_set(&req->timer, interval);
+}
+
+static void
+async_reply(async_req_t *req, query_t *q, ns_t *ns, const unsigned char *buf, size_t len)
+{
+	uc_value_t *res_obj = ucv_resource_value_get(req->obj, 1);
+	bool was_pending = (q->rcode == -1);
+
+	/* Do not overwrite previous replies from other servers
+	 * but allow overwriting preexisting NXDOMAIN reply */
+	if (q->rcode == 0 || (q->rcode == 3 && (buf[3] & 15) != 0))
+		return;
+
+	/* Retry immediately on server failure. */
+	if ((buf[3] & 15) == 2 && req->servfail_retry && req->servfail_retry--)
+		async_send(req, q, ns);
+
+	req->n_replies++;
+
+	apply_reply(req->vm, &req->ctx, q, res_obj, buf, len);
+
+	if (req->ctx.cache)
+		cache_store(req->vm, q, buf, len);
+
+	if (was_pending && --req->pending == 0)
+		async_finish(req);
+}
+
+static void
+async_sock_cb(struct uloop_fd *fd, unsigned int events)
+{
+	async_state_t *state = container_of(fd, async_sock_t, fd)->state;
+	static unsigned char buf[65536];
+	addr_t from = { };
+	async_req_t *req;
+	ssize_t len;
+	query_t *q;
+	size_t nn;
+
+	while (true) {
+		from.len = sizeof(from.u);
+		len = recvfrom(fd->fd, buf, sizeof(buf), 0, &from.u.sa, &from.len);
+
+		/* read error or no more pending packets */
+		if (len < 0)
+			break;
+
+		/* Ignore non-identifiable packets */
+		if (len < 4)
+			continue;
+
+		q = async_find(state, (buf[0] << 8) | buf[1]);
+
+		if (!q)
+			continue;
+
+		req = q->req;
+
+		/* Ignore replies from addresses we didn't send to */
+		for (nn = 0; nn < req->ctx.n_ns; nn++)
+			if (req->ctx.ns[nn].addr.len == from.len &&
+			    memcmp(&from.u.sa, &req->ctx.ns[nn].addr.u.sa, from.len) == 0)
+				break;
+
+		if (nn >= req->ctx.n_ns)
+			continue;
+
+		async_reply(req, q, &req->ctx.ns[nn], buf, len);
+	}
+}
+
+static void
+async_free(void *ud)
+{
+	async_req_t *req = ud;
+
+	async_unlink(req);
+
+	while (req->ctx.n_queries)
+		free(req->ctx.queries[--req->ctx.n_queries].name);
+
+	free(req->ctx.queries);
+	free(req->ctx.ns);
+}
+
 /**
  * Perform DNS queries for specified domain names.
  *
@@ -1257,6 +1794,12 @@ parse_options(resolve_ctx_t *ctx, uc_value_t *opts)
  * Return TXT record strings as array elements instead of space-joining all
  * record strings into one single string per record.
  *
+ * @param {boolean} [options.cache=false]
+ * Answer queries from the per-VM answer cache when possible and store
+ * received answers in it. Positive answers are cached for the lowest TTL of
+ * their records, NXDOMAIN and empty answers for the negative caching TTL
+ * announced by the zone's SOA record.
+ *
  * @returns {object}
  * Object containing DNS query results. Keys are domain names, values are
  * objects containing arrays of records grouped by type, or error information
@@ -1364,6 +1907,174 @@ err:
 	return res_obj;
 }
 
+/**
+ * Perform DNS queries asynchronously.
+ *
+ * The `query_async()` function accepts the same arguments as
+ * {@link module:resolv#query|query()} but returns immediately. Queries are
+ * sent and answers received from within the uloop event loop, which must
+ * be running for the request to make progress. Once all queries have been
+ * answered or the timeout expired, the callback is invoked with the result
+ * object, structured like the return value of `query()`.
+ *
+ * Queries of all pending requests share a small pool of sockets. When the
+ * VM is destroyed, still pending requests are cancelled without invoking
+ * their callbacks and the sockets are closed.
+ *
+ * Returns a request object which may be used to abort the request.
+ *
+ * Returns `null` if invalid arguments are provided.
+ *
+ * @function module:resolv#query_async
+ *
+ * @param {string|string[]} names
+ * Domain name(s) to query.
+ *
+ * @param {object} [options]
+ * Query options object, see {@link module:resolv#query|query()}.
+ *
+ * @param {Function} callback
+ * The function to invoke with the result object.
+ *
+ * @returns {?module:resolv.request}
+ *
+ * @example
+ * import * as uloop from 'uloop';
+ * import { query_async } from 'resolv';
+ *
+ * uloop.init();
+ *
+ * query_async('example.com', { type: ['A'], cache: true }, (result) => {
+ *     print(result, "\n");
+ *     uloop.end();
+ * });
+ *
+ * uloop.run();
+ */
+static uc_value_t *
+uc_resolv_query_async(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *names = uc_fn_arg(0);
+	uc_value_t *opts = uc_fn_arg(1);
+	uc_value_t *func = uc_fn_arg(2);
+	uc_value_t *obj, *res_obj;
+	async_req_t *req;
+	query_t *q;
+	size_t i;
+
+	if (!ucv_is_callable(func))
+		err_return(EINVAL, "Callback not callable");
+
+	obj = ucv_resource_create_ex(vm, "resolv.request", (void **)&req, 2, sizeof(*req));
+
+	if (!obj)
+		err_return(ENOMEM, NULL);
+
+	req->vm = vm;
+	req->state = async_state_get(vm);
+	req->ctx.retries = 2;
+	req->ctx.timeout = 5000;
+	req->ctx.edns_maxsize = 4096;
+
+	if (!parse_options(&req->ctx, opts)) {
+		ucv_put(obj);
+
+		return NULL;
+	}
+
+	for_each_item(names, name) {
+		if (ucv_type(name) != UC_STRING) {
+			ucv_put(obj);
+			err_return(EINVAL, "Domain name value not a string");
+		}
+
+		add_queries(&req->ctx, name);
+	}
+
+	res_obj = ucv_object_new(vm);
+
+	ucv_resource_value_set(obj, 0, ucv_get(func));
+	ucv_resource_value_set(obj, 1, res_obj);
+
+	/* the query array is final now, link queries into the ID table */
+	for (i = 0; i < req->ctx.n_queries; i++) {
+		q = &req->ctx.queries[i];
+		q->req = req;
+
+		if (req->ctx.cache && cache_lookup(vm, &req->ctx, q, res_obj)) {
+			req->n_replies++;
+			continue;
+		}
+
+		if (!async_link(req->state, q)) {
+			ucv_put(obj);
+			err_return(EBUSY, "Too many queries in flight");
+		}
+
+		req->pending++;
+	}
+
+	req->obj = ucv_get(obj);
+	ucv_resource_persistent_set(obj, true);
+	list_add(&req->list, &req->state->requests);
+
+	req->t0 = mono_time();
+	req->timer.cb = async_timer_cb;
+	uloop_timeout_set(&req->timer, 0);
+
+	return obj;
+}
+
+/**
+ * Represents a pending asynchronous DNS request.
+ *
+ * @class module:resolv.request
+ * @hideconstructor
+ *
+ * @see {@link module:resolv#query_async|query_async()}
+ */
+
+/**
+ * Abort the request.
+ *
+ * Cancels all outstanding queries of the request, the callback will not be
+ * invoked.
+ *
+ * Returns `true` if the request was still pending, `false` otherwise.
+ *
+ * @function module:resolv.request#abort
+ *
+ * @returns {boolean}
+ */
+static uc_value_t *
+uc_resolv_request_abort(uc_vm_t *vm, size_t nargs)
+{
+	async_req_t *req = uc_fn_thisval("resolv.request");
+
+	if (!req || !req->obj)
+		return ucv_boolean_new(false);
+
+	async_unlink(req);
+	async_release(req);
+
+	return ucv_boolean_new(true);
+}
+
+/**
+ * Flush the answer cache.
+ *
+ * Removes all entries from the answer cache of the current VM.
+ *
+ * @function module:resolv#flush_cache
+ */
+static uc_value_t *
+uc_resolv_flush_cache(uc_vm_t *vm, size_t nargs)
+{
+	uc_vm_registry_delete(vm, "resolv.cache");
+
+	return NULL;
+}
+
 /**
  * Get the last error message from DNS operations.
  *
@@ -1415,11 +2126,20 @@ uc_resolv_error(uc_vm_t *vm, size_t nargs)
 
 
 static const uc_function_list_t resolv_fns[] = {
-	{ "query",	uc_resolv_query },
-	{ "error",	uc_resolv_error },
+	{ "query",			uc_resolv_query },
+	{ "query_async",	uc_resolv_query_async },
+	{ "flush_cache",	uc_resolv_flush_cache },
+	{ "error",			uc_resolv_error },
+};
+
+static const uc_function_list_t request_fns[] = {
+	{ "abort",	uc_resolv_request_abort },
 };
 
 void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 {
 	uc_function_list_register(scope, resolv_fns);
+
+	uc_type_declare(vm, "resolv.request", request_fns, async_free);
+	ucv_resource_type_add(vm, "resolv.async", NULL, async_state_free);
 }
@@ -1370,8 +1370,160 @@ uc_nl_parse_attr(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base,
 static uc_value_t *
 uc_nl_convert_attr(const uc_nl_attr_spec_t *spec, struct nl_msg *msg, char *base, struct nlattr **tb, uc_vm_t *vm);
 
+static uc_resource_type_t *lazy_type;
+
+/*
+ * Lazily decoded attributes: container attributes of reply messages may be
+ * stored as a copy of their raw netlink attribute, which is only converted
+ * once a property of it is accessed. The decoded value is cached in the
+ * resource's value slot.
+ *
+ * This is strictly opt-in through the `lazy` request option. Lazy values are
+ * resources, so only direct property access sees their members; type(),
+ * keys(), length(), exists(), for-in loops, JSON conversion and printing do
+ * not. Replies must be passed through expand() before using any of these.
+ */
+typedef struct {
+	const uc_nl_attr_spec_t *spec;
+	uint8_t family;
+	char nla[];
+} uc_nl_lazy_t;
+
 static bool
-uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj)
+uc_nl_lazy_type(const uc_nl_attr_spec_t *spec)
+{
+	if (spec->flags & DF_MULTIPLE)
+		return false;
+
+	switch (spec->type) {
+	case DT_NESTED:
+	case DT_AFSPEC:
+	case DT_LINKINFO:
+	case DT_MULTIPATH:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static uc_value_t *
+uc_nl_lazy_new(uc_vm_t *vm, const uc_nl_attr_spec_t *spec, struct nl_msg *msg, struct nlattr *nla)
+{
+	struct rtgenmsg *rtg = nlmsg_data(nlmsg_hdr(msg));
+	uc_nl_lazy_t *lazy;
+	uc_value_t *res;
+
+	res = ucv_resource_new_ex(vm, lazy_type, (void **)&lazy, 1,
+		sizeof(*lazy) + NLA_ALIGN(nla->nla_len));
+
+	lazy->spec = spec;
+	lazy->family = rtg->rtgen_family;
+	memcpy(lazy->nla, nla, nla->nla_len);
+
+	return res;
+}
+
+static uc_value_t *
+uc_nl_lazy_decode(uc_vm_t *vm, uc_value_t *res)
+{
+	uc_nl_lazy_t *lazy = ucv_resource_data(res, "rtnl.lazy");
+	struct rtgenmsg rtg = { 0 };
+	struct nlattr **tb;
+	struct nl_msg *msg;
+	uc_value_t *v;
+
+	if (!lazy)
+		return NULL;
+
+	v = ucv_resource_value_get(res, 0);
+
+	if (v)
+		return v;
+
+	tb = calloc(lazy->spec->attr + 1, sizeof(*tb));
+	msg = nlmsg_alloc_simple(0, 0);
+
+	if (tb && msg) {
+		/* the converters only consult the message for its family */
+		rtg.rtgen_family = lazy->family;
+		nlmsg_append(msg, &rtg, sizeof(rtg), NLMSG_ALIGNTO);
+
+		tb[lazy->spec->attr] = (struct nlattr *)lazy->nla;
+		v = uc_nl_convert_attr(lazy->spec, msg, NULL, tb, vm);
+
+		ucv_resource_value_set(res, 0, v);
+	}
+
+	nlmsg_free(msg);
+	free(tb);
+
+	return v;
+}
+
+static uc_value_t *
+uc_nl_lazy_get(uc_vm_t *vm, uc_value_t *res, const char *key)
+{
+	uc_value_t *v = uc_nl_lazy_decode(vm, res);
+	char *e;
+	long n;
+
+	if (ucv_type(v) == UC_ARRAY) {
+		n = strtol(key, &e, 10);
+
+		return (e != key && *e == 0 && n >= 0) ? ucv_get(ucv_array_get(v, n)) : NULL;
+	}
+
+	return ucv_get(ucv_object_get(v, key, NULL));
+}
+
+/*
+ * Replace all lazy values nested within the given value by their decoded
+ * form, in place, and return a new reference to the expanded value.
+ */
+static uc_value_t *
+uc_nl_expand_value(uc_vm_t *vm, uc_value_t *val)
+{
+	size_t i;
+
+	switch (ucv_type(val)) {
+	case UC_RESOURCE:
+		if (ucv_resource_data(val, "rtnl.lazy"))
+			return uc_nl_expand_value(vm, uc_nl_lazy_decode(vm, val));
+
+		break;
+
+	case UC_OBJECT:
+		ucv_object_foreach(val, k, v) {
+			switch (ucv_type(v)) {
+			case UC_RESOURCE:
+			case UC_OBJECT:
+			case UC_ARRAY:
+				ucv_object_add(val, k, uc_nl_expand_value(vm, v));
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		break;
+
+	case UC_ARRAY:
+		for (i = 0; i < ucv_array_length(val); i++)
+			ucv_array_set(val, i, uc_nl_expand_value(vm, ucv_array_get(val, i)));
+
+		break;
+
+	default:
+		break;
+	}
+
+	return ucv_get(val);
+}
+
+static bool
+uc_nl_convert_attrs_ex(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj, const bool *fields, bool lazy)
 {
 	size_t i, maxattr = 0, structlen = headsize;
 	struct nlattr **tb, *nla, *nla_nest;
@@ -1396,6 +1548,9 @@ uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsiz
 	}
 
 	for (i = 0; i < nattrs; i++) {
+		if (fields && !fields[i])
+			continue;
+
 		if (attrs[i].attr == 0 && (uintptr_t)attrs[i].auxdata >= structlen)
 			continue;
 
@@ -1435,6 +1590,9 @@ uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsiz
 
 			v = arr;
 		}
+		else if (lazy && attrs[i].attr != 0 && uc_nl_lazy_type(&attrs[i])) {
+			v = uc_nl_lazy_new(vm, &attrs[i], msg, tb[attrs[i].attr]);
+		}
 		else {
 			v = uc_nl_convert_attr(&attrs[i], msg, (char *)buf, tb, vm);
 
@@ -1450,6 +1608,12 @@ uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsiz
 	return true;
 }
 
+static bool
+uc_nl_convert_attrs(struct nl_msg *msg, void *buf, size_t buflen, size_t headsize, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj)
+{
+	return uc_nl_convert_attrs_ex(msg, buf, buflen, headsize, attrs, nattrs, vm, obj, NULL, false);
+}
+
 static bool
 uc_nl_parse_attrs(struct nl_msg *msg, char *base, const uc_nl_attr_spec_t *attrs, size_t nattrs, uc_vm_t *vm, uc_value_t *obj)
 {
@@ -3232,6 +3396,16 @@ static struct {
 	uint32_t groups[RTNL_GRPS_BITMAP_SIZE];
 } nl_conn;
 
+typedef enum {
+	FILTER_FAMILY,
+	FILTER_TABLE,
+	FILTER_PROTOCOL,
+	FILTER_OIF,
+	FILTER_IFINDEX,
+	FILTER_MASTER,
+	__FILTER_MAX
+} filter_key_t;
+
 typedef enum {
 	STATE_UNREPLIED,
 	STATE_CONTINUE,
@@ -3245,6 +3419,15 @@ typedef struct {
 	uc_value_t *res;
 	int family;
 	const uc_nl_nested_spec_t *spec;
+	uc_value_t *callback;
+	size_t batch;
+	size_t count;
+	bool stop;
+	bool exception;
+	uint32_t filter_set;
+	uint32_t filter[__FILTER_MAX];
+	bool *fields;
+	bool lazy;
 } request_state_t;
 
 
@@ -3304,6 +3487,209 @@ cb_error(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg)
 	return NL_STOP;
 }
 
+/*
+ * Dump filters. Each entry describes where a filter value is found in reply
+ * messages of a given family: a header member and/or an u32 attribute, the
+ * attribute taking precedence when present. `khdr` and `kattr` denote how
+ * the value is passed to the kernel for strict-mode server side filtering.
+ * Every filter is also applied natively before a reply is converted, which
+ * covers the cases the kernel ignores.
+ */
+static const char * const filter_names[__FILTER_MAX] = {
+	[FILTER_FAMILY] = "family",
+	[FILTER_TABLE] = "table",
+	[FILTER_PROTOCOL] = "protocol",
+	[FILTER_OIF] = "oif",
+	[FILTER_IFINDEX] = "ifindex",
+	[FILTER_MASTER] = "master",
+};
+
+static const struct {
+	int family;
+	filter_key_t key;
+	ssize_t hdroff;
+	size_t hdrsize;
+	int attr;
+	bool khdr;
+	int kattr;
+} filter_fields[] = {
+	{ RTM_FAM(RTM_GETROUTE), FILTER_FAMILY, offsetof(struct rtmsg, rtm_family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETROUTE), FILTER_TABLE, offsetof(struct rtmsg, rtm_table), 1, RTA_TABLE, true, RTA_TABLE },
+	{ RTM_FAM(RTM_GETROUTE), FILTER_PROTOCOL, offsetof(struct rtmsg, rtm_protocol), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETROUTE), FILTER_OIF, -1, 0, RTA_OIF, false, RTA_OIF },
+	{ RTM_FAM(RTM_GETLINK), FILTER_FAMILY, offsetof(struct ifinfomsg, ifi_family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETLINK), FILTER_IFINDEX, offsetof(struct ifinfomsg, ifi_index), 4, 0, false, 0 },
+	{ RTM_FAM(RTM_GETLINK), FILTER_MASTER, -1, 0, IFLA_MASTER, false, IFLA_MASTER },
+	{ RTM_FAM(RTM_GETADDR), FILTER_FAMILY, offsetof(struct ifaddrmsg, ifa_family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETADDR), FILTER_IFINDEX, offsetof(struct ifaddrmsg, ifa_index), 4, 0, true, 0 },
+	{ RTM_FAM(RTM_GETNEIGH), FILTER_FAMILY, offsetof(struct ndmsg, ndm_family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETNEIGH), FILTER_IFINDEX, offsetof(struct ndmsg, ndm_ifindex), 4, 0, false, NDA_IFINDEX },
+	{ RTM_FAM(RTM_GETNEIGH), FILTER_MASTER, -1, 0, NDA_MASTER, false, NDA_MASTER },
+	{ RTM_FAM(RTM_GETRULE), FILTER_FAMILY, offsetof(struct fib_rule_hdr, family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETRULE), FILTER_TABLE, offsetof(struct fib_rule_hdr, table), 1, FRA_TABLE, false, 0 },
+	{ RTM_FAM(RTM_GETRULE), FILTER_PROTOCOL, -1, 0, FRA_PROTOCOL, false, 0 },
+	{ RTM_FAM(RTM_GETADDRLABEL), FILTER_FAMILY, offsetof(struct ifaddrlblmsg, ifal_family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETADDRLABEL), FILTER_IFINDEX, offsetof(struct ifaddrlblmsg, ifal_index), 4, 0, false, 0 },
+	{ RTM_FAM(RTM_GETNETCONF), FILTER_FAMILY, offsetof(struct netconfmsg, ncm_family), 1, 0, true, 0 },
+	{ RTM_FAM(RTM_GETNETCONF), FILTER_IFINDEX, -1, 0, NETCONFA_IFINDEX, false, 0 },
+};
+
+static bool
+uc_nl_parse_filter(request_state_t *s, uc_value_t *filter)
+{
+	uint32_t u32;
+	size_t i, j;
+
+	ucv_object_foreach(filter, k, v) {
+		for (i = 0; i < __FILTER_MAX; i++)
+			if (!strcmp(k, filter_names[i]))
+				break;
+
+		if (i == __FILTER_MAX)
+			err_return(NLE_INVAL, "Unknown filter '%s'", k);
+
+		for (j = 0; j < ARRAY_SIZE(filter_fields); j++)
+			if (filter_fields[j].family == s->family && filter_fields[j].key == i)
+				break;
+
+		if (j == ARRAY_SIZE(filter_fields))
+			err_return(NLE_OPNOTSUPP, "Filter '%s' not supported for this request", k);
+
+		if (ucv_type(v) == UC_STRING &&
+		    (i == FILTER_OIF || i == FILTER_IFINDEX || i == FILTER_MASTER)) {
+			u32 = if_nametoindex(ucv_string_get(v));
+
+			if (u32 == 0)
+				err_return(NLE_INVAL, "Unable to resolve interface %s", ucv_string_get(v));
+		}
+		else if (!uc_nl_parse_u32(v, &u32)) {
+			err_return(NLE_INVAL, "Invalid value for filter '%s'", k);
+		}
+
+		s->filter[i] = u32;
+		s->filter_set |= (1u << i);
+	}
+
+	return true;
+}
+
+static bool
+uc_nl_put_filter(request_state_t *s, struct nl_msg *msg)
+{
+	char *base = NLMSG_DATA(nlmsg_hdr(msg));
+	uint32_t val;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(filter_fields); i++) {
+		if (filter_fields[i].family != s->family ||
+		    !(s->filter_set & (1u << filter_fields[i].key)))
+			continue;
+
+		val = s->filter[filter_fields[i].key];
+
+		if (filter_fields[i].khdr) {
+			if (filter_fields[i].hdrsize == 1 && val <= 0xff)
+				uc_nl_put_struct_member_u8(base, (void *)filter_fields[i].hdroff, val);
+			else if (filter_fields[i].hdrsize == 4)
+				uc_nl_put_struct_member_u32(base, (void *)filter_fields[i].hdroff, val);
+		}
+
+		if (filter_fields[i].kattr && nla_put_u32(msg, filter_fields[i].kattr, val))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+uc_nl_match_filter(request_state_t *s, struct nlmsghdr *hdr)
+{
+	char *base = nlmsg_data(hdr);
+	struct nlattr *nla;
+	uint32_t val;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(filter_fields); i++) {
+		if (filter_fields[i].family != s->family ||
+		    !(s->filter_set & (1u << filter_fields[i].key)))
+			continue;
+
+		nla = filter_fields[i].attr
+			? nlmsg_find_attr(hdr, s->spec->headsize, filter_fields[i].attr)
+			: NULL;
+
+		if (nla && nla_len(nla) >= (int)sizeof(uint32_t))
+			val = nla_get_u32(nla);
+		else if (nla && nla_len(nla) == sizeof(uint8_t))
+			val = nla_get_u8(nla);
+		else if (filter_fields[i].hdrsize == 1)
+			val = uc_nl_get_struct_member_u8(base, (void *)filter_fields[i].hdroff);
+		else if (filter_fields[i].hdrsize == 4)
+			val = uc_nl_get_struct_member_u32(base, (void *)filter_fields[i].hdroff);
+		else
+			return false;
+
+		if (val != s->filter[filter_fields[i].key])
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Pass a message object, or an array of up to `batch` message objects, to
+ * the request callback. The callback may return `false` to stop the dump.
+ */
+static bool
+uc_nl_deliver(request_state_t *s, uc_value_t *v)
+{
+	uc_vm_t *vm = s->vm;
+	uc_value_t *rv;
+
+	uc_vm_stack_push(vm, ucv_get(s->callback));
+	uc_vm_stack_push(vm, v);
+
+	if (uc_vm_call(vm, false, 1) != EXCEPTION_NONE) {
+		s->exception = true;
+		s->stop = true;
+
+		return false;
+	}
+
+	rv = uc_vm_stack_pop(vm);
+
+	if (ucv_type(rv) == UC_BOOLEAN && !ucv_boolean_get(rv))
+		s->stop = true;
+
+	ucv_put(rv);
+
+	return !s->stop;
+}
+
+static bool
+uc_nl_deliver_object(request_state_t *s, uc_value_t *o)
+{
+	uc_value_t *batch;
+
+	s->count++;
+
+	if (s->batch <= 1)
+		return uc_nl_deliver(s, o);
+
+	if (!s->res)
+		s->res = ucv_array_new_length(s->vm, s->batch);
+
+	ucv_array_push(s->res, o);
+
+	if (ucv_array_length(s->res) < s->batch)
+		return true;
+
+	batch = s->res;
+	s->res = NULL;
+
+	return uc_nl_deliver(s, batch);
+}
+
 static int
 cb_reply(struct nl_msg *msg, void *arg)
 {
@@ -3312,6 +3698,9 @@ cb_reply(struct nl_msg *msg, void *arg)
 	uc_value_t *o;
 	bool rv;
 
+	if (s->stop)
+		return NL_STOP;
+
 	if (RTM_FAM(hdr->nlmsg_type) != s->family)
 		return NL_SKIP;
 
@@ -3319,16 +3708,24 @@ cb_reply(struct nl_msg *msg, void *arg)
 		if (nlmsg_attrlen(hdr, 0) < (ssize_t)s->spec->headsize)
 			return NL_SKIP;
 
+		if (s->filter_set && !uc_nl_match_filter(s, hdr))
+			return NL_SKIP;
+
 		o = ucv_object_new(s->vm);
 
-		rv = uc_nl_convert_attrs(msg,
+		rv = uc_nl_convert_attrs_ex(msg,
 			nlmsg_attrdata(hdr, 0),
 			nlmsg_attrlen(hdr, 0),
 			s->spec->headsize,
-			s->spec->attrs, s->spec->nattrs, s->vm, o);
+			s->spec->attrs, s->spec->nattrs, s->vm, o,
+			s->fields, s->lazy);
 
 		if (rv) {
-			if (hdr->nlmsg_flags & NLM_F_MULTI) {
+			if (s->callback) {
+				if (!uc_nl_deliver_object(s, o))
+					return NL_STOP;
+			}
+			else if (hdr->nlmsg_flags & NLM_F_MULTI) {
 				if (!s->res)
 					s->res = ucv_array_new(s->vm);
 
@@ -3363,51 +3760,60 @@ static const struct {
 	{ RTM_FAM(RTM_GETNETCONF), &netconf_msg },
 };
 
-static uc_value_t *
-uc_nl_request(uc_vm_t *vm, size_t nargs)
+static bool
+uc_nl_parse_fields(request_state_t *s, uc_value_t *fields)
 {
-	uc_value_t *cmd = uc_fn_arg(0);
-	uc_value_t *flags = uc_fn_arg(1);
-	uc_value_t *payload = uc_fn_arg(2);
-	request_state_t st = { .vm = vm };
-	uint16_t flagval = 0;
-	struct nl_msg *msg;
-	struct nl_cb *cb;
-	socklen_t optlen;
-	int enable, err;
-	void *buf;
-	size_t i;
+	uc_value_t *field;
+	bool found;
+	size_t i, j;
 
-	if (ucv_type(cmd) != UC_INTEGER || ucv_int64_get(cmd) < 0 ||
-	    (flags != NULL && ucv_type(flags) != UC_INTEGER) ||
-	    (payload != NULL && ucv_type(payload) != UC_OBJECT))
-		err_return(NLE_INVAL, NULL);
+	s->fields = calloc(s->spec->nattrs, sizeof(*s->fields));
 
-	if (flags) {
-		if (ucv_int64_get(flags) < 0 || ucv_int64_get(flags) > 0xffff)
-			err_return(NLE_INVAL, NULL);
-		else
-			flagval = (uint16_t)ucv_int64_get(flags);
-	}
+	if (!s->fields)
+		err_return(NLE_NOMEM, NULL);
 
-	for (i = 0; i < ARRAY_SIZE(rtm_families); i++) {
-		if (rtm_families[i].family == RTM_FAM(ucv_int64_get(cmd))) {
-			st.spec = rtm_families[i].spec;
-			st.family = rtm_families[i].family;
-			break;
+	for (i = 0; i < ucv_array_length(fields); i++) {
+		field = ucv_array_get(fields, i);
+
+		if (ucv_type(field) != UC_STRING)
+			err_return(NLE_INVAL, "Field names must be strings");
+
+		for (j = 0, found = false; j < s->spec->nattrs; j++) {
+			if (!strcmp(s->spec->attrs[j].key, ucv_string_get(field))) {
+				s->fields[j] = true;
+				found = true;
+			}
 		}
+
+		if (!found)
+			err_return(NLE_INVAL, "Unknown field '%s'", ucv_string_get(field));
 	}
 
+	return true;
+}
+
+static bool
+uc_nl_connect(uint16_t flagval)
+{
+	socklen_t optlen;
+	int enable, err;
+
 	if (!sock) {
 		sock = nl_socket_alloc();
 
-		if (!sock)
-			err_return(NLE_NOMEM, NULL);
+		if (!sock) {
+			set_error(NLE_NOMEM, NULL);
+
+			return false;
+		}
 
 		err = nl_connect(sock, NETLINK_ROUTE);
 
-		if (err != 0)
-			err_return(err, NULL);
+		if (err != 0) {
+			set_error(err, NULL);
+
+			return false;
+		}
 	}
 
 	optlen = sizeof(enable);
@@ -3418,18 +3824,30 @@ uc_nl_request(uc_vm_t *vm, size_t nargs)
 	if (!!(flagval & NLM_F_STRICT_CHK) != enable) {
 		enable = !!(flagval & NLM_F_STRICT_CHK);
 
-		if (setsockopt(sock->s_fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &enable, sizeof(enable)) < 0)
-			err_return(nl_syserr2nlerr(errno), "Unable to toggle NETLINK_GET_STRICT_CHK");
+		if (setsockopt(sock->s_fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &enable, sizeof(enable)) < 0) {
+			set_error(nl_syserr2nlerr(errno), "Unable to toggle NETLINK_GET_STRICT_CHK");
+
+			return false;
+		}
 	}
 
-	msg = nlmsg_alloc_simple(ucv_int64_get(cmd), NLM_F_REQUEST | (flagval & ~NLM_F_STRICT_CHK));
+	return true;
+}
+
+static struct nl_msg *
+uc_nl_build_msg(uc_vm_t *vm, int cmd, int flags, const uc_nl_nested_spec_t *spec, uc_value_t *payload)
+{
+	struct nl_msg *msg;
+	void *buf;
+
+	msg = nlmsg_alloc_simple(cmd, flags);
 
 	if (!msg)
 		err_return(NLE_NOMEM, NULL);
 
-	if (st.spec) {
-		if (st.spec->headsize) {
-			buf = nlmsg_reserve(msg, st.spec->headsize, 0);
+	if (spec) {
+		if (spec->headsize) {
+			buf = nlmsg_reserve(msg, spec->headsize, 0);
 
 			if (!buf) {
 				nlmsg_free(msg);
@@ -3437,16 +3855,125 @@ uc_nl_request(uc_vm_t *vm, size_t nargs)
 				return NULL;
 			}
 
-			memset(buf, 0, st.spec->headsize);
+			memset(buf, 0, spec->headsize);
 		}
 
-		if (!uc_nl_parse_attrs(msg, NLMSG_DATA(nlmsg_hdr(msg)), st.spec->attrs, st.spec->nattrs, vm, payload)) {
+		if (!uc_nl_parse_attrs(msg, NLMSG_DATA(nlmsg_hdr(msg)), spec->attrs, spec->nattrs, vm, payload)) {
 			nlmsg_free(msg);
 
 			return NULL;
 		}
 	}
 
+	return msg;
+}
+
+static const uc_nl_nested_spec_t *
+uc_nl_cmd_spec(int cmd, int *family)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(rtm_families); i++) {
+		if (rtm_families[i].family == RTM_FAM(cmd)) {
+			if (family)
+				*family = rtm_families[i].family;
+
+			return rtm_families[i].spec;
+		}
+	}
+
+	return NULL;
+}
+
+static uc_value_t *
+uc_nl_request_common(uc_vm_t *vm, size_t nargs, request_state_t *st)
+{
+	uc_value_t *cmd = uc_fn_arg(0);
+	uc_value_t *flags = uc_fn_arg(1);
+	uc_value_t *payload = uc_fn_arg(2);
+	uc_value_t *opts = uc_fn_arg(3);
+	uc_value_t *callback = NULL, *batch = NULL, *filter = NULL, *fields = NULL;
+	uint16_t flagval = 0;
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	int err;
+
+	/* the fourth argument is either a reply callback or an options object */
+	if (ucv_is_callable(opts)) {
+		callback = opts;
+		batch = uc_fn_arg(4);
+	}
+	else if (ucv_type(opts) == UC_OBJECT) {
+		callback = ucv_object_get(opts, "callback", NULL);
+		batch = ucv_object_get(opts, "batch", NULL);
+		filter = ucv_object_get(opts, "filter", NULL);
+		fields = ucv_object_get(opts, "fields", NULL);
+		st->lazy = ucv_is_truish(ucv_object_get(opts, "lazy", NULL));
+	}
+	else if (opts) {
+		err_return(NLE_INVAL, NULL);
+	}
+
+	if (ucv_type(cmd) != UC_INTEGER || ucv_int64_get(cmd) < 0 ||
+	    (flags != NULL && ucv_type(flags) != UC_INTEGER) ||
+	    (payload != NULL && ucv_type(payload) != UC_OBJECT) ||
+	    (filter != NULL && ucv_type(filter) != UC_OBJECT) ||
+	    (fields != NULL && ucv_type(fields) != UC_ARRAY) ||
+	    (callback != NULL && !ucv_is_callable(callback)) ||
+	    (batch != NULL && (ucv_type(batch) != UC_INTEGER || ucv_int64_get(batch) < 1)))
+		err_return(NLE_INVAL, NULL);
+
+	/*
+	 * In callback mode, replies are handed to the callback one by one or in
+	 * arrays of `batch` objects instead of being accumulated, so dumping
+	 * large tables only keeps at most one batch of objects alive.
+	 */
+	if (callback) {
+		st->callback = callback;
+		st->batch = batch ? (size_t)ucv_int64_get(batch) : 1;
+	}
+
+	if (flags) {
+		if (ucv_int64_get(flags) < 0 || ucv_int64_get(flags) > 0xffff)
+			err_return(NLE_INVAL, NULL);
+		else
+			flagval = (uint16_t)ucv_int64_get(flags);
+	}
+
+	st->spec = uc_nl_cmd_spec(ucv_int64_get(cmd), &st->family);
+
+	/* filters imply strict checking so the kernel honours them */
+	if (filter) {
+		if (!st->spec)
+			err_return(NLE_OPNOTSUPP, "Filters not supported for this request");
+
+		if (!uc_nl_parse_filter(st, filter))
+			return NULL;
+
+		flagval |= NLM_F_STRICT_CHK;
+	}
+
+	if (fields) {
+		if (!st->spec)
+			err_return(NLE_OPNOTSUPP, "Field selection not supported for this request");
+
+		if (!uc_nl_parse_fields(st, fields))
+			return NULL;
+	}
+
+	if (!uc_nl_connect(flagval))
+		return NULL;
+
+	msg = uc_nl_build_msg(vm, ucv_int64_get(cmd), NLM_F_REQUEST | (flagval & ~NLM_F_STRICT_CHK), st->spec, payload);
+
+	if (!msg)
+		return NULL;
+
+	if (st->filter_set && !uc_nl_put_filter(st, msg)) {
+		nlmsg_free(msg);
+		err_return(NLE_NOMEM, NULL);
+	}
+
 	cb = nl_cb_alloc(NL_CB_DEFAULT);
 
 	if (!cb) {
@@ -3454,30 +3981,56 @@ uc_nl_request(uc_vm_t *vm, size_t nargs)
 		err_return(NLE_NOMEM, NULL);
 	}
 
-	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, cb_reply, &st);
-	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, cb_done, &st);
-	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, cb_done, &st);
-	nl_cb_err(cb, NL_CB_CUSTOM, cb_error, &st);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, cb_reply, st);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, cb_done, st);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, cb_done, st);
+	nl_cb_err(cb, NL_CB_CUSTOM, cb_error, st);
 
 	nl_send_auto_complete(sock, msg);
 
 	do {
 		err = nl_recvmsgs(sock, cb);
 
-		if (err && st.state != STATE_ERROR) {
+		if (err && st->state != STATE_ERROR) {
 			set_error(err, NULL);
 
-			st.state = STATE_ERROR;
+			st->state = STATE_ERROR;
 		}
 	}
-	while (st.state < STATE_REPLIED);
+	while (st->state < STATE_REPLIED && !st->stop);
 
 	nlmsg_free(msg);
 	nl_cb_put(cb);
 
-	switch (st.state) {
+	/*
+	 * The callback aborted an unfinished dump; drop the socket instead of
+	 * draining the remaining replies, it is reconnected on the next request.
+	 */
+	if (st->stop && st->state < STATE_REPLIED) {
+		nl_socket_free(sock);
+		sock = NULL;
+		st->state = STATE_REPLIED;
+	}
+
+	if (st->callback) {
+		/* deliver the final partial batch */
+		if (st->res && !st->stop && st->state == STATE_REPLIED)
+			uc_nl_deliver(st, st->res);
+		else
+			ucv_put(st->res);
+
+		st->res = NULL;
+
+		if (st->exception)
+			return NULL;
+
+		if (st->state == STATE_REPLIED)
+			return ucv_uint64_new(st->count);
+	}
+
+	switch (st->state) {
 	case STATE_REPLIED:
-		return st.res;
+		return st->res;
 
 	case STATE_UNREPLIED:
 		return ucv_boolean_new(true);
@@ -3492,6 +4045,263 @@ uc_nl_request(uc_vm_t *vm, size_t nargs)
 	}
 }
 
+static uc_value_t *
+uc_nl_request(uc_vm_t *vm, size_t nargs)
+{
+	request_state_t st = { .vm = vm };
+	uc_value_t *rv;
+
+	rv = uc_nl_request_common(vm, nargs, &st);
+
+	free(st.fields);
+
+	return rv;
+}
+
+/*
+ * Batched requests: many messages are packed into few large sendmsg()
+ * buffers, each carrying its own sequence number and NLM_F_ACK, and the
+ * acknowledgements of a buffer are collected in one receive pass before the
+ * next buffer is sent. The result array holds `true` for each acknowledged
+ * message, an error string for each failed one and `null` for messages not
+ * sent because an earlier one failed while stop-on-error was requested.
+ * The kernel processes every message of a buffer regardless of earlier
+ * failures, so with stop-on-error each message is sent and acknowledged on
+ * its own, trading throughput for not applying anything after a failure.
+ */
+
+#define BATCH_BUFSIZE 32768
+
+typedef struct {
+	uc_value_t *res;
+	uint32_t seq;
+	size_t count;
+	size_t pending;
+	size_t errors;
+} batch_state_t;
+
+static bool
+batch_is_pending(batch_state_t *s, uint32_t seq)
+{
+	uint32_t idx = seq - s->seq;
+
+	return (idx < s->count && !ucv_array_get(s->res, idx));
+}
+
+static int
+cb_batch_seq(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+static int
+cb_batch_ack(struct nl_msg *msg, void *arg)
+{
+	batch_state_t *s = arg;
+	uint32_t seq = nlmsg_hdr(msg)->nlmsg_seq;
+
+	if (batch_is_pending(s, seq)) {
+		ucv_array_set(s->res, seq - s->seq, ucv_boolean_new(true));
+		s->pending--;
+	}
+
+	return NL_SKIP;
+}
+
+static int
+cb_batch_error(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg)
+{
+	batch_state_t *s = arg;
+	int errnum = err->error;
+
+	if (batch_is_pending(s, err->msg.nlmsg_seq)) {
+		ucv_array_set(s->res, err->msg.nlmsg_seq - s->seq,
+			ucv_string_new(strerror(errnum < 0 ? -errnum : errnum)));
+
+		s->pending--;
+		s->errors++;
+	}
+
+	return NL_SKIP;
+}
+
+static int
+cb_batch_valid(struct nl_msg *msg, void *arg)
+{
+	return NL_SKIP;
+}
+
+static struct nl_msg *
+uc_nl_batch_msg(uc_vm_t *vm, uc_value_t *req)
+{
+	uc_value_t *cmd = ucv_array_get(req, 0);
+	uc_value_t *flags = ucv_array_get(req, 1);
+	uc_value_t *payload = ucv_array_get(req, 2);
+	int64_t flagval = 0;
+
+	if (ucv_type(req) != UC_ARRAY ||
+	    ucv_type(cmd) != UC_INTEGER || ucv_int64_get(cmd) < 0 ||
+	    ucv_int64_get(cmd) > 0xffff ||
+	    (flags != NULL && ucv_type(flags) != UC_INTEGER) ||
+	    (payload != NULL && ucv_type(payload) != UC_OBJECT))
+		err_return(NLE_INVAL, NULL);
+
+	if (flags) {
+		flagval = ucv_int64_get(flags);
+
+		/* replies of dump requests cannot be told apart within a batch */
+		if (flagval < 0 || flagval > 0xffff || (flagval & NLM_F_DUMP) == NLM_F_DUMP)
+			err_return(NLE_INVAL, "Invalid flags for batched request");
+	}
+
+	return uc_nl_build_msg(vm, ucv_int64_get(cmd),
+		NLM_F_REQUEST | NLM_F_ACK | (flagval & ~NLM_F_STRICT_CHK),
+		uc_nl_cmd_spec(ucv_int64_get(cmd), NULL), payload);
+}
+
+static uc_value_t *
+uc_nl_batch(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *requests = uc_fn_arg(0);
+	uc_value_t *stop_on_error = uc_fn_arg(1);
+	batch_state_t st = { 0 };
+	struct nl_msg **msgs;
+	struct nlmsghdr *hdr;
+	size_t i, j, len, off;
+	bool stop;
+	struct nl_cb *cb;
+	char *buf;
+	int err;
+
+	if (ucv_type(requests) != UC_ARRAY ||
+	    (stop_on_error != NULL && ucv_type(stop_on_error) != UC_BOOLEAN))
+		err_return(NLE_INVAL, NULL);
+
+	st.count = ucv_array_length(requests);
+	st.res = ucv_array_new_length(vm, st.count);
+
+	if (st.count == 0)
+		return st.res;
+
+	ucv_array_set(st.res, st.count - 1, NULL);
+
+	msgs = calloc(st.count, sizeof(*msgs));
+	buf = malloc(BATCH_BUFSIZE);
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+
+	if (!msgs || !buf || !cb) {
+		set_error(NLE_NOMEM, NULL);
+		goto fail;
+	}
+
+	for (i = 0; i < st.count; i++) {
+		msgs[i] = uc_nl_batch_msg(vm, ucv_array_get(requests, i));
+
+		if (!msgs[i])
+			goto fail;
+	}
+
+	if (!uc_nl_connect(0))
+		goto fail;
+
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, cb_batch_seq, &st);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, cb_batch_valid, &st);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, cb_batch_ack, &st);
+	nl_cb_err(cb, NL_CB_CUSTOM, cb_batch_error, &st);
+
+	/* sequence numbers are assigned consecutively */
+	for (i = 0; i < st.count; i++) {
+		nl_complete_msg(sock, msgs[i]);
+
+		if (i == 0)
+			st.seq = nlmsg_hdr(msgs[i])->nlmsg_seq;
+	}
+
+	stop = (stop_on_error && ucv_boolean_get(stop_on_error));
+
+	for (i = 0; i < st.count; i = j) {
+		err = 0;
+
+		for (j = i, off = 0; j < st.count; j++) {
+			hdr = nlmsg_hdr(msgs[j]);
+			len = NLMSG_ALIGN(hdr->nlmsg_len);
+
+			if (off + len > BATCH_BUFSIZE) {
+				/* oversized messages are sent on their own */
+				if (off == 0) {
+					err = nl_sendto(sock, hdr, hdr->nlmsg_len);
+					j++;
+				}
+
+				break;
+			}
+
+			memcpy(buf + off, hdr, hdr->nlmsg_len);
+			memset(buf + off + hdr->nlmsg_len, 0, len - hdr->nlmsg_len);
+			off += len;
+
+			/* later messages of a buffer are applied even if one fails */
+			if (stop) {
+				j++;
+				break;
+			}
+		}
+
+		if (off > 0)
+			err = nl_sendto(sock, buf, off);
+
+		if (err < 0) {
+			set_error(err, NULL);
+			goto reset;
+		}
+
+		st.pending += j - i;
+
+		while (st.pending > 0) {
+			err = nl_recvmsgs(sock, cb);
+
+			if (err < 0) {
+				set_error(err, NULL);
+				goto reset;
+			}
+		}
+
+		if (st.errors && stop)
+			break;
+	}
+
+	for (i = 0; i < st.count; i++)
+		nlmsg_free(msgs[i]);
+
+	/* all acknowledgements were consumed */
+	sock->s_seq_expect = sock->s_seq_next;
+
+	free(msgs);
+	free(buf);
+	nl_cb_put(cb);
+
+	return st.res;
+
+reset:
+	/* drop the socket, pending acknowledgements would confuse later requests */
+	nl_socket_free(sock);
+	sock = NULL;
+
+fail:
+	for (i = 0; msgs && i < st.count; i++)
+		nlmsg_free(msgs[i]);
+
+	free(msgs);
+	free(buf);
+
+	if (cb)
+		nl_cb_put(cb);
+
+	ucv_put(st.res);
+
+	return NULL;
+}
+
 static const uc_nl_nested_spec_t *
 uc_nl_msg_spec(int type)
 {
@@ -4156,9 +4966,17 @@ register_constants(uc_vm_t *vm, uc_value_t *scope)
 	ucv_object_add(scope, "const", c);
 };
 
+static uc_value_t *
+uc_nl_expand(uc_vm_t *vm, size_t nargs)
+{
+	return uc_nl_expand_value(vm, uc_fn_arg(0));
+}
+
 static const uc_function_list_t global_fns[] = {
 	{ "error",		uc_nl_error },
 	{ "request",	uc_nl_request },
+	{ "batch",		uc_nl_batch },
+	{ "expand",		uc_nl_expand },
 	{ "listener",	uc_nl_listener },
 };
 
@@ -4172,6 +4990,9 @@ void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 	uc_function_list_register(scope, global_fns);
 
 	listener_type = uc_type_declare(vm, "rtnl.listener", listener_fns, uc_nl_listener_free);
+
+	lazy_type = ucv_resource_type_add(vm, "rtnl.lazy", NULL, NULL);
+	lazy_type->get = uc_nl_lazy_get;
 	listener_registry = ucv_array_new(vm);
 
 	uc_vm_registry_set(vm, "rtnl.registry", listener_registry);
@@ -3459,7 +3459,8 @@ uc_socket_inst_connect(uc_vm_t *vm, size_t nargs)
  * @function module:socket.socket#send
  *
  * @param {*} data
- * The data to be sent through the socket. String data is sent as-is, any other
+ * The data to be sent through the socket. String data and byte buffers, such
+ * as `struct.buffer()` instances and their views, are sent as-is, any other
  * type is implicitly converted to a string first before being sent on the
  * socket.
  *
@@ -3498,8 +3499,9 @@ uc_socket_inst_send(uc_vm_t *vm, size_t nargs)
 	struct sockaddr_storage ss = { 0 };
 	struct sockaddr *sa = NULL;
 	socklen_t salen = 0;
-	char *buf = NULL;
+	char *buf = NULL, *bytes;
 	ssize_t ret;
+	size_t len;
 	int sockfd;
 
 	args_get(vm, nargs, &sockfd,
@@ -3514,12 +3516,13 @@ uc_socket_inst_send(uc_vm_t *vm, size_t nargs)
 		sa = (struct sockaddr *)&ss;
 	}
 
-	if (ucv_type(data) != UC_STRING)
+	if ((bytes = ucv_bytes_get(data, &len)) == NULL) {
 		buf = ucv_to_string(vm, data);
+		bytes = buf;
+		len = strlen(buf);
+	}
 
-	ret = sendto(sockfd,
-		buf ? buf : ucv_string_get(data),
-		buf ? strlen(buf) : ucv_string_length(data),
+	ret = sendto(sockfd, bytes, len,
 		(flags ? ucv_int64_get(flags) : 0) | MSG_NOSIGNAL, sa, salen);
 
 	free(buf);
@@ -3538,7 +3541,12 @@ uc_socket_inst_send(uc_vm_t *vm, size_t nargs)
  * optional address dictionary where the function will place the address from
  * which the data was received (for unconnected sockets).
  *
- * Returns a string containing the received data.
+ * If a byte buffer, such as a `struct.buffer()` instance, is given, the data is
+ * received directly into the buffer at its current position and the position
+ * is advanced past the received data.
+ *
+ * Returns a string containing the received data or, if receiving into a buffer,
+ * the number of bytes received.
  * Returns an empty string if the remote side closed the socket.
  * Returns `null` if an error occurred during the receive operation.
  *
@@ -3557,28 +3565,57 @@ uc_socket_inst_send(uc_vm_t *vm, size_t nargs)
  * definition of {@link module:socket.socket.SocketAddress|SocketAddress} for
  * details on the format.
  *
- * @returns {?string}
+ * @param {module:struct.buffer} [buffer]
+ * A buffer to receive the data into.
+ *
+ * @returns {?string|number}
  */
 static uc_value_t *
 uc_socket_inst_recv(uc_vm_t *vm, size_t nargs)
 {
-	uc_value_t *length, *flags, *addrobj;
+	uc_value_t *length, *flags, *addrobj, *target;
 	struct sockaddr_storage ss = { 0 };
 	uc_stringbuf_t *buf;
 	ssize_t len, ret;
 	socklen_t sslen;
+	char *p;
 	int sockfd;
 
 	args_get(vm, nargs, &sockfd,
 		"length", UC_INTEGER, true, &length,
 		"flags", UC_INTEGER, true, &flags,
-		"address", UC_OBJECT, true, &addrobj);
+		"address", UC_OBJECT, true, &addrobj,
+		"buffer", UC_NULL, true, &target);
 
 	len = length ? ucv_to_integer(length) : 4096;
 
 	if (errno || len <= 0)
 		err_return(errno, "Invalid length argument");
 
+	/* receive directly into a given byte buffer */
+	if (target) {
+		p = ucv_bytes_reserve(vm, target, len);
+
+		if (!p)
+			err_return(EINVAL, "Argument buffer is not a writable buffer");
+
+		do {
+			sslen = sizeof(ss);
+			ret = recvfrom(sockfd, p, len,
+				flags ? ucv_int64_get(flags) : 0, (struct sockaddr *)&ss, &sslen);
+		} while (ret == -1 && errno == EINTR);
+
+		if (ret == -1)
+			err_return(errno, "recv()");
+
+		ucv_bytes_commit(target, ret);
+
+		if (addrobj)
+			sockaddr_to_uv(&ss, addrobj);
+
+		ok_return(ucv_int64_new(ret));
+	}
+
 	buf = strbuf_alloc(len);
 
 	if (!buf)
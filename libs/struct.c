@@ -410,9 +410,27 @@ typedef struct {
 	size_t len;
 	size_t size;
 	size_t ncodes;
+	size_t nvalues;
+	size_t refcount;
+	bool fixed;
 	formatcode_t codes[];
 } formatstate_t;
 
+#define FORMAT_CACHE_SIZE 32
+
+typedef struct {
+	formatstate_t *state;
+	uint64_t stamp;
+	uint32_t hash;
+	size_t keylen;
+	char *key;
+} formatcache_entry_t;
+
+typedef struct {
+	uint64_t clock;
+	formatcache_entry_t entries[FORMAT_CACHE_SIZE];
+} formatcache_t;
+
 typedef struct {
 	uc_resource_t resource;
 	size_t length;
@@ -420,6 +438,11 @@ typedef struct {
 	size_t position;
 } formatbuffer_t;
 
+typedef struct {
+	size_t start;
+	size_t end;
+} formatview_t;
+
 
 /* Define various structs to figure out the alignments of types */
 
@@ -2450,6 +2473,8 @@ parse_format(uc_vm_t *vm, uc_value_t *fmtval)
 	state = xalloc(sizeof(*state) + ncodes * sizeof(formatcode_t));
 	state->size = size;
 	state->ncodes = ncodes;
+	state->refcount = 1;
+	state->fixed = true;
 
 	codes = state->codes;
 
@@ -2486,6 +2511,12 @@ parse_format(uc_vm_t *vm, uc_value_t *fmtval)
 			codes->repeat = 1;
 			codes++;
 			size += (c == 's' || c == 'p') ? num : 0;
+
+			/* '*', 'X' and 'Z' depend on the argument or input length */
+			if (c != 's' && c != 'p')
+				state->fixed = false;
+
+			state->nvalues++;
 		}
 		else if (c == 'x') {
 			size += num;
@@ -2497,6 +2528,7 @@ parse_format(uc_vm_t *vm, uc_value_t *fmtval)
 			codes->repeat = num;
 			codes++;
 			size += e->size * num;
+			state->nvalues += num;
 		}
 	}
 
@@ -2509,6 +2541,128 @@ overflow:
 	return NULL;
 }
 
+static formatstate_t *
+format_state_get(formatstate_t *state)
+{
+	state->refcount++;
+
+	return state;
+}
+
+static void
+format_state_put(void *ptr)
+{
+	formatstate_t *state = ptr;
+
+	if (state && --state->refcount == 0)
+		free(state);
+}
+
+
+/* Per-VM LRU cache of parsed format strings */
+
+static void
+formatcache_free(void *ptr)
+{
+	formatcache_t *cache = ptr;
+	size_t i;
+
+	for (i = 0; i < FORMAT_CACHE_SIZE; i++) {
+		format_state_put(cache->entries[i].state);
+		free(cache->entries[i].key);
+	}
+
+	free(cache);
+}
+
+static formatcache_t *
+formatcache_get(uc_vm_t *vm)
+{
+	uc_value_t *res = uc_vm_registry_get(vm, "struct.cache");
+	formatcache_t *cache = ucv_resource_data(res, "struct.cache");
+
+	if (!cache) {
+		cache = xalloc(sizeof(*cache));
+		res = ucv_resource_create(vm, "struct.cache", cache);
+
+		uc_vm_registry_set(vm, "struct.cache", res);
+	}
+
+	return cache;
+}
+
+static uint32_t
+formatcache_hash(const char *s, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	while (len--) {
+		h ^= (uint8_t)*s++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/* Look up the parsed representation of the given format string, parsing
+ * and caching it on miss. The returned state must be released using
+ * format_state_put(). */
+
+static formatstate_t *
+lookup_format(uc_vm_t *vm, uc_value_t *fmtval)
+{
+	formatcache_entry_t *entry, *victim;
+	formatcache_t *cache;
+	formatstate_t *state;
+	const char *fmt;
+	uint32_t hash;
+	size_t i, len;
+
+	/* let parse_format() raise the appropriate exception */
+	if (ucv_type(fmtval) != UC_STRING)
+		return parse_format(vm, fmtval);
+
+	fmt = ucv_string_get(fmtval);
+	len = ucv_string_length(fmtval);
+	hash = formatcache_hash(fmt, len);
+
+	cache = formatcache_get(vm);
+	victim = &cache->entries[0];
+
+	for (i = 0; i < FORMAT_CACHE_SIZE; i++) {
+		entry = &cache->entries[i];
+
+		if (entry->state && entry->hash == hash && entry->keylen == len &&
+		    !memcmp(entry->key, fmt, len)) {
+			entry->stamp = ++cache->clock;
+
+			return format_state_get(entry->state);
+		}
+
+		/* unused slots have a zero stamp and are recycled first */
+		if (entry->stamp < victim->stamp)
+			victim = entry;
+	}
+
+	state = parse_format(vm, fmtval);
+
+	if (!state)
+		return NULL;
+
+	format_state_put(victim->state);
+	free(victim->key);
+
+	victim->key = xalloc(len + 1);
+	victim->keylen = len;
+	victim->hash = hash;
+	victim->stamp = ++cache->clock;
+	victim->state = format_state_get(state);
+
+	memcpy(victim->key, fmt, len);
+
+	return state;
+}
+
 static bool
 grow_buffer(uc_vm_t *vm, void **buf, size_t *bufsz, size_t length)
 {
@@ -2836,8 +2990,26 @@ b64enc(const char *src, size_t src_len)
 	return ucv_stringbuf_finish(buf);
 }
 
+/* Fetch the n-th value to pack, either from the function arguments or,
+ * when packing records, from a row array or from the given row of an
+ * array of column arrays. */
+
+static uc_value_t *
+pack_value(uc_vm_t *vm, size_t nargs, uc_value_t *records, ssize_t row,
+           size_t n)
+{
+	if (!records)
+		return uc_fn_arg(n);
+
+	if (row < 0)
+		return ucv_array_get(records, n);
+
+	return ucv_array_get(ucv_array_get(records, n), row);
+}
+
 static bool
 uc_pack_common(uc_vm_t *vm, size_t nargs, formatstate_t *state, size_t argoff,
+               uc_value_t *records, ssize_t row,
                void **buf, size_t *pos, size_t *capacity)
 {
 	size_t ncode, arg, off, new_pos;
@@ -2845,50 +3017,55 @@ uc_pack_common(uc_vm_t *vm, size_t nargs, formatstate_t *state, size_t argoff,
 	ssize_t size, n;
 	const void *p;
 
-	for (ncode = 0, code = &state->codes[0], arg = argoff, off = 0;
-	     ncode < state->ncodes;
-	     code = &state->codes[++ncode]) {
-		if (code->fmtdef->format == '*') {
-			uc_value_t *v = uc_fn_arg(arg++);
+	/* Formats without '*', 'X' or 'Z' directives have a fixed size */
+	off = 0;
 
-			if (ucv_type(v) != UC_STRING)
-				continue;
+	if (!state->fixed) {
+		for (ncode = 0, code = &state->codes[0], arg = argoff;
+		     ncode < state->ncodes;
+		     code = &state->codes[++ncode]) {
+			if (code->fmtdef->format == '*') {
+				uc_value_t *v = pack_value(vm, nargs, records, row, arg++);
 
-			n = ucv_string_length(v);
+				if (ucv_type(v) != UC_STRING)
+					continue;
 
-			if (code->size == -1 || code->size > n)
-				off += n;
-			else
-				off += code->size;
-		}
-		else if (code->fmtdef->format == 'X') {
-			uc_value_t *v = uc_fn_arg(arg++);
+				n = ucv_string_length(v);
 
-			if (ucv_type(v) != UC_STRING)
-				continue;
+				if (code->size == -1 || code->size > n)
+					off += n;
+				else
+					off += code->size;
+			}
+			else if (code->fmtdef->format == 'X') {
+				uc_value_t *v = pack_value(vm, nargs, records, row, arg++);
 
-			n = ucv_string_length(v) / 2;
+				if (ucv_type(v) != UC_STRING)
+					continue;
 
-			if (code->size == -1 || code->size > n)
-				off += n;
-			else
-				off += code->size;
-		}
-		else if (code->fmtdef->format == 'Z') {
-			uc_value_t *v = uc_fn_arg(arg++);
+				n = ucv_string_length(v) / 2;
 
-			if (ucv_type(v) != UC_STRING)
-				continue;
+				if (code->size == -1 || code->size > n)
+					off += n;
+				else
+					off += code->size;
+			}
+			else if (code->fmtdef->format == 'Z') {
+				uc_value_t *v = pack_value(vm, nargs, records, row, arg++);
 
-			n = b64len(ucv_string_get(v), ucv_string_length(v));
+				if (ucv_type(v) != UC_STRING)
+					continue;
 
-			if (code->size == -1 || code->size > n)
-				off += n;
-			else
-				off += code->size;
-		}
-		else {
-			arg += code->repeat;
+				n = b64len(ucv_string_get(v), ucv_string_length(v));
+
+				if (code->size == -1 || code->size > n)
+					off += n;
+				else
+					off += code->size;
+			}
+			else {
+				arg += code->repeat;
+			}
 		}
 	}
 
@@ -2905,7 +3082,7 @@ uc_pack_common(uc_vm_t *vm, size_t nargs, formatstate_t *state, size_t argoff,
 		ssize_t j = code->repeat;
 
 		while (j--) {
-			uc_value_t *v = uc_fn_arg(argoff++);
+			uc_value_t *v = pack_value(vm, nargs, records, row, argoff++);
 
 			size = code->size;
 
@@ -3064,6 +3241,277 @@ hexenc(const char *src, size_t src_len)
 		us->str[(i << 1) + 1] = hexdigits[c & 0x0f];
 	}
 
+	ucv_account(&us->header);
+
+	return &us->header;
+}
+
+static uc_value_t *
+unpack_fixed_value(uc_vm_t *vm, const formatcode_t *code, const char *res)
+{
+	const formatdef_t *e = code->fmtdef;
+	ssize_t n;
+
+	if (e->format == 's')
+		return ucv_string_new_length(res, code->size);
+
+	if (e->format == 'p') {
+		n = *(unsigned char *)res;
+
+		if (n >= code->size)
+			n = (code->size > 0 ? code->size - 1 : 0);
+
+		return ucv_string_new_length(res + 1, n);
+	}
+
+	return e->unpack(vm, res, e);
+}
+
+/* Fast path for fixed size formats when the input is known to be long
+ * enough: no per-item bounds checks and a presized result array. */
+
+static uc_value_t *
+uc_unpack_fixed(uc_vm_t *vm, formatstate_t *state, const char *buf,
+                size_t *rem, bool single)
+{
+	uc_value_t *result, *v;
+	formatcode_t *code;
+	size_t ncode;
+	ssize_t j;
+
+	result = single ? NULL : ucv_array_new_length(vm, state->nvalues);
+
+	for (ncode = 0, code = &state->codes[0];
+	     ncode < state->ncodes;
+	     code = &state->codes[++ncode]) {
+		const char *res = buf + code->offset;
+
+		for (j = 0; j < code->repeat; j++, res += code->size) {
+			v = unpack_fixed_value(vm, code, res);
+
+			if (v == NULL) {
+				ucv_put(result);
+
+				return NULL;
+			}
+
+			*rem -= code->size;
+
+			if (single)
+				return v;
+
+			ucv_array_push(result, v);
+		}
+	}
+
+	return result;
+}
+
+/* Unpack `count` consecutive fixed size records into an array of column
+ * arrays, one per unpacked value. */
+
+static uc_value_t *
+uc_unpack_columns(uc_vm_t *vm, formatstate_t *state, const char *buf,
+                  size_t count)
+{
+	uc_value_t *result, *column, *v;
+	formatcode_t *code;
+	size_t ncode, i;
+	const char *res;
+	ssize_t j;
+
+	result = ucv_array_new_length(vm, state->nvalues);
+
+	for (ncode = 0, code = &state->codes[0];
+	     ncode < state->ncodes;
+	     code = &state->codes[++ncode]) {
+		for (j = 0; j < code->repeat; j++) {
+			column = ucv_array_new_length(vm, count);
+			res = buf + code->offset + j * code->size;
+
+			for (i = 0; i < count; i++, res += state->size) {
+				v = unpack_fixed_value(vm, code, res);
+
+				if (v == NULL) {
+					ucv_put(column);
+					ucv_put(result);
+
+					return NULL;
+				}
+
+				ucv_array_push(column, v);
+			}
+
+			ucv_array_push(result, column);
+		}
+	}
+
+	return result;
+}
+
+static uc_value_t *
+uc_unpack_many_common(uc_vm_t *vm, formatstate_t *state, uc_value_t *bufval,
+                      uc_value_t *countval, uc_value_t *offset,
+                      uc_value_t *columns)
+{
+	uc_value_t *result, *row;
+	long long pos = 0, count;
+	size_t i, rem;
+	char *buf;
+
+	if (!state->fixed) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Format for multiple records must have a fixed size");
+
+		return NULL;
+	}
+
+	/* a zero sized record would let any count through the bounds check */
+	if (state->size == 0) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Format for multiple records must not be empty");
+
+		return NULL;
+	}
+
+	if (ucv_type(bufval) != UC_STRING) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Buffer value not a string");
+
+		return NULL;
+	}
+
+	if (offset && !ucv_as_longlong(vm, offset, &pos))
+		return NULL;
+
+	buf = ucv_string_get(bufval);
+	rem = ucv_string_length(bufval);
+
+	if (pos < 0)
+		pos += rem;
+
+	if (pos < 0 || (size_t)pos > rem)
+		return NULL;
+
+	buf += pos;
+	rem -= pos;
+
+	if (countval) {
+		if (!ucv_as_longlong(vm, countval, &count))
+			return NULL;
+
+		if (count < 0) {
+			uc_vm_raise_exception(vm, EXCEPTION_RUNTIME,
+				"Record count must not be negative");
+
+			return NULL;
+		}
+
+		if ((unsigned long long)count > rem / state->size)
+			return NULL;
+	}
+	else {
+		count = rem / state->size;
+	}
+
+	if (ucv_is_truish(columns))
+		return uc_unpack_columns(vm, state, buf, count);
+
+	result = ucv_array_new_length(vm, count);
+
+	for (i = 0; i < (size_t)count; i++, buf += state->size) {
+		row = uc_unpack_fixed(vm, state, buf, &rem, false);
+
+		if (row == NULL) {
+			ucv_put(result);
+
+			return NULL;
+		}
+
+		ucv_array_push(result, row);
+	}
+
+	return result;
+}
+
+static uc_value_t *
+uc_pack_many_common(uc_vm_t *vm, size_t nargs, formatstate_t *state,
+                    uc_value_t *records, uc_value_t *columns)
+{
+	size_t i, count, pos = 0, capacity = 0;
+	bool by_column = ucv_is_truish(columns);
+	uc_string_t *us = NULL;
+	uc_value_t *rec;
+
+	if (ucv_type(records) != UC_ARRAY) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Records value not an array");
+
+		return NULL;
+	}
+
+	if (by_column) {
+		rec = ucv_array_get(records, 0);
+		count = 0;
+
+		if (ucv_type(rec) == UC_ARRAY)
+			count = ucv_array_length(rec);
+
+		for (i = 0; i < ucv_array_length(records); i++) {
+			rec = ucv_array_get(records, i);
+
+			if (ucv_type(rec) != UC_ARRAY || ucv_array_length(rec) != count) {
+				uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+					"Columns must be arrays of equal length");
+
+				return NULL;
+			}
+		}
+	}
+	else {
+		count = ucv_array_length(records);
+	}
+
+	/* Start with a buffer fitting all records of fixed size formats */
+	if (state->fixed && count > 0 &&
+	    state->size <= SIZE_MAX / count &&
+	    !grow_buffer(vm, (void **)&us, &capacity, state->size * count))
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		if (by_column) {
+			rec = records;
+		}
+		else {
+			rec = ucv_array_get(records, i);
+
+			if (ucv_type(rec) != UC_ARRAY) {
+				uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+					"Record %zu is not an array", i);
+
+				free(us);
+
+				return NULL;
+			}
+		}
+
+		if (!uc_pack_common(vm, nargs, state, 0, rec, by_column ? (ssize_t)i : -1,
+		                    (void **)&us, &pos, &capacity)) {
+			free(us);
+
+			return NULL;
+		}
+	}
+
+	if (!us)
+		return ucv_string_new_length("", 0);
+
+	us->header.type = UC_STRING;
+	us->header.refcount = 1;
+	us->length = pos;
+
+	ucv_account(&us->header);
+
 	return &us->header;
 }
 
@@ -3085,6 +3533,9 @@ uc_unpack_common(uc_vm_t *vm, size_t nargs, formatstate_t *state,
 	buf += pos;
 	*rem -= pos;
 
+	if (state->fixed && state->size <= *rem)
+		return uc_unpack_fixed(vm, state, buf, rem, single);
+
 	result = single ? NULL : ucv_array_new(vm);
 
 	for (ncode = 0, code = &state->codes[0], off = 0;
@@ -3187,24 +3638,27 @@ uc_pack(uc_vm_t *vm, size_t nargs)
 	uc_string_t *us = NULL;
 	formatstate_t *state;
 
-	state = parse_format(vm, fmtval);
+	state = lookup_format(vm, fmtval);
 
 	if (!state)
 		return NULL;
 
-	if (!uc_pack_common(vm, nargs, state, 1, (void **)&us, &pos, &capacity)) {
-		free(state);
+	if (!uc_pack_common(vm, nargs, state, 1, NULL, -1,
+	                    (void **)&us, &pos, &capacity)) {
+		format_state_put(state);
 		free(us);
 
 		return NULL;
 	}
 
-	free(state);
+	format_state_put(state);
 
 	us->header.type = UC_STRING;
 	us->header.refcount = 1;
 	us->length = pos;
 
+	ucv_account(&us->header);
+
 	return &us->header;
 }
 
@@ -3263,7 +3717,7 @@ uc_unpack(uc_vm_t *vm, size_t nargs)
 	if (offset && !ucv_as_longlong(vm, offset, &pos))
 		return NULL;
 
-	state = parse_format(vm, fmtval);
+	state = lookup_format(vm, fmtval);
 
 	if (!state)
 		return NULL;
@@ -3272,12 +3726,140 @@ uc_unpack(uc_vm_t *vm, size_t nargs)
 	rem = ucv_string_length(bufval);
 	res = uc_unpack_common(vm, nargs, state, buf, pos, &rem, false);
 
-	free(state);
+	format_state_put(state);
 
 	return res;
 }
 
 
+/**
+ * Unpack multiple consecutive records according to specified format.
+ *
+ * The `unpack_many()` function interpretes the given byte string as a
+ * sequence of fixed size records laid out back to back, each one described
+ * by the given format string, and unpacks them all in one call.
+ *
+ * The format string must not contain variable length `*`, `X` or `Z`
+ * directives and must describe at least one byte. The size of each record
+ * equals the value returned by packing the format, no trailing alignment
+ * padding is added between records.
+ *
+ * If the optional count argument is omitted, as many complete records as fit
+ * into the input are unpacked. When the columns argument is truthy, an array
+ * holding one column array per unpacked value is returned instead of one
+ * array per record.
+ *
+ * Returns an array of records or an array of columns.
+ *
+ * Returns `null` if the input is too short to hold the requested number of
+ * records or if the offset is out of range.
+ *
+ * Raises a runtime exception if the format string is invalid, empty or not of
+ * fixed size or if an invalid input string, count or offset value is given.
+ *
+ * @function module:struct#unpack_many
+ *
+ * @param {string} format
+ * The format string describing a single record.
+ *
+ * @param {string} input
+ * The input string to unpack.
+ *
+ * @param {number} [count]
+ * The number of records to unpack.
+ *
+ * @param {number} [offset=0]
+ * The offset within the input string to start unpacking from.
+ *
+ * @param {boolean} [columns=false]
+ * Whether to return column arrays instead of record arrays.
+ *
+ * @returns {?array[]}
+ *
+ * @example
+ * const data = pack('!HHHH', 1, 2, 3, 4);
+ *
+ * print(unpack_many('!HH', data), "\n");               // [ [ 1, 2 ], [ 3, 4 ] ]
+ * print(unpack_many('!HH', data, null, 0, true), "\n"); // [ [ 1, 3 ], [ 2, 4 ] ]
+ */
+static uc_value_t *
+uc_unpack_many(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *fmtval = uc_fn_arg(0);
+	uc_value_t *bufval = uc_fn_arg(1);
+	uc_value_t *count = uc_fn_arg(2);
+	uc_value_t *offset = uc_fn_arg(3);
+	uc_value_t *columns = uc_fn_arg(4);
+	formatstate_t *state;
+	uc_value_t *res;
+
+	state = lookup_format(vm, fmtval);
+
+	if (!state)
+		return NULL;
+
+	res = uc_unpack_many_common(vm, state, bufval, count, offset, columns);
+
+	format_state_put(state);
+
+	return res;
+}
+
+/**
+ * Pack multiple records according to specified format.
+ *
+ * The `pack_many()` function packs each record of the given array according
+ * to the format string and returns the concatenation of the packed records.
+ * Each record is an array of values, as would be passed to `pack()`.
+ *
+ * When the columns argument is truthy, the given array is interpreted as an
+ * array of equally sized column arrays, one per format value, and the
+ * records are formed by taking the n-th element of each column.
+ *
+ * Returns the packed string.
+ *
+ * Raises a runtime exception if a record value does not match the required
+ * type of the corresponding format string directive or if an invalid format
+ * string or record array is provided.
+ *
+ * @function module:struct#pack_many
+ *
+ * @param {string} format
+ * The format string describing a single record.
+ *
+ * @param {array[]} records
+ * The records, or columns, to pack.
+ *
+ * @param {boolean} [columns=false]
+ * Whether the given array holds column arrays instead of record arrays.
+ *
+ * @returns {string}
+ *
+ * @example
+ * pack_many('!HH', [ [ 1, 2 ], [ 3, 4 ] ]);     // "\x00\x01\x00\x02\x00\x03\x00\x04"
+ * pack_many('!HH', [ [ 1, 3 ], [ 2, 4 ] ], true); // same result
+ */
+static uc_value_t *
+uc_pack_many(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *fmtval = uc_fn_arg(0);
+	uc_value_t *records = uc_fn_arg(1);
+	uc_value_t *columns = uc_fn_arg(2);
+	formatstate_t *state;
+	uc_value_t *res;
+
+	state = lookup_format(vm, fmtval);
+
+	if (!state)
+		return NULL;
+
+	res = uc_pack_many_common(vm, nargs, state, records, columns);
+
+	format_state_put(state);
+
+	return res;
+}
+
 /**
  * Represents a struct instance created by `new()`.
  *
@@ -3302,6 +3884,10 @@ uc_unpack(uc_vm_t *vm, size_t nargs)
  * a `struct` object instance useful for packing and unpacking multiple items
  * without having to recompute the internal format each time.
  *
+ * Note that format strings passed to `pack()`, `unpack()` and the buffer
+ * methods are parsed once and kept in a small per-VM cache of recently used
+ * formats, so `new()` is mainly useful to hold on to a format beyond that.
+ *
  * Returns an precompiled struct format instance.
  *
  * Raises a runtime exception if the format string is invalid.
@@ -3325,7 +3911,7 @@ uc_struct_new(uc_vm_t *vm, size_t nargs)
 	uc_value_t *fmtval = uc_fn_arg(0);
 	formatstate_t *state;
 
-	state = parse_format(vm, fmtval);
+	state = lookup_format(vm, fmtval);
 
 	if (!state)
 		return NULL;
@@ -3365,7 +3951,8 @@ uc_struct_pack(uc_vm_t *vm, size_t nargs)
 	if (!state || !*state)
 		return NULL;
 
-	if (!uc_pack_common(vm, nargs, *state, 0, (void **)&us, &pos, &capacity)) {
+	if (!uc_pack_common(vm, nargs, *state, 0, NULL, -1,
+	                    (void **)&us, &pos, &capacity)) {
 		free(us);
 
 		return NULL;
@@ -3375,6 +3962,8 @@ uc_struct_pack(uc_vm_t *vm, size_t nargs)
 	us->header.refcount = 1;
 	us->length = pos;
 
+	ucv_account(&us->header);
+
 	return &us->header;
 }
 
@@ -3436,6 +4025,81 @@ uc_struct_unpack(uc_vm_t *vm, size_t nargs)
 }
 
 
+/**
+ * Unpack multiple consecutive records.
+ *
+ * The `unpack_many()` function interpretes the given byte string as a
+ * sequence of records laid out according to the format instance. See
+ * {@link module:struct#unpack_many|struct.unpack_many()} for details.
+ *
+ * Returns an array of records or an array of columns.
+ *
+ * @function module:struct.instance#unpack_many
+ *
+ * @param {string} input
+ * The input string to unpack.
+ *
+ * @param {number} [count]
+ * The number of records to unpack.
+ *
+ * @param {number} [offset=0]
+ * The offset within the input string to start unpacking from.
+ *
+ * @param {boolean} [columns=false]
+ * Whether to return column arrays instead of record arrays.
+ *
+ * @returns {?array[]}
+ *
+ * @example
+ * const fmt = struct.new(…);
+ * const records = fmt.unpack_many(…);
+ */
+static uc_value_t *
+uc_struct_unpack_many(uc_vm_t *vm, size_t nargs)
+{
+	formatstate_t **state = uc_fn_this("struct.format");
+
+	if (!state || !*state)
+		return NULL;
+
+	return uc_unpack_many_common(vm, *state,
+		uc_fn_arg(0), uc_fn_arg(1), uc_fn_arg(2), uc_fn_arg(3));
+}
+
+/**
+ * Pack multiple records.
+ *
+ * The `pack_many()` function packs each record of the given array according
+ * to the format instance. See
+ * {@link module:struct#pack_many|struct.pack_many()} for details.
+ *
+ * Returns the packed string.
+ *
+ * @function module:struct.instance#pack_many
+ *
+ * @param {array[]} records
+ * The records, or columns, to pack.
+ *
+ * @param {boolean} [columns=false]
+ * Whether the given array holds column arrays instead of record arrays.
+ *
+ * @returns {string}
+ *
+ * @example
+ * const fmt = struct.new(…);
+ * const data = fmt.pack_many([ […], […] ]);
+ */
+static uc_value_t *
+uc_struct_pack_many(uc_vm_t *vm, size_t nargs)
+{
+	formatstate_t **state = uc_fn_this("struct.format");
+
+	if (!state || !*state)
+		return NULL;
+
+	return uc_pack_many_common(vm, nargs, *state, uc_fn_arg(0), uc_fn_arg(1));
+}
+
 /**
  * Represents a struct buffer instance created by `buffer()`.
  *
@@ -3516,6 +4180,8 @@ uc_fmtbuf_new(uc_vm_t *vm, size_t nargs)
 		memcpy((char *)buffer->resource.data + sizeof(uc_string_t), buf, len);
 	}
 
+	ucv_account(&buffer->resource.header);
+
 	return &buffer->resource.header;
 }
 
@@ -3741,15 +4407,15 @@ uc_fmtbuf_put(uc_vm_t *vm, size_t nargs)
 	if (!buffer)
 		return NULL;
 
-	state = parse_format(vm, fmt);
+	state = lookup_format(vm, fmt);
 
 	if (!state)
 		return NULL;
 
-	res = uc_pack_common(vm, nargs, state, 1,
+	res = uc_pack_common(vm, nargs, state, 1, NULL, -1,
 		&buffer->resource.data, &buffer->position, &buffer->capacity);
 
-	free(state);
+	format_state_put(state);
 
 	if (!res)
 		return NULL;
@@ -3815,13 +4481,13 @@ ebounds:
 		return NULL;
 	}
 
-	state = parse_format(vm, fmt);
+	state = lookup_format(vm, fmt);
 
 	if (!state)
 		return NULL;
 
 	if (single && (state->ncodes != 1 || state->codes[0].repeat != 1)) {
-		free(state);
+		format_state_put(state);
 		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
 			"get() expects a format string for a single value. "
 			"Use read() for multiple values.");
@@ -3838,7 +4504,7 @@ ebounds:
 	if (result)
 		buffer->position = buffer->length - rem;
 
-	free(state);
+	format_state_put(state);
 
 	return result;
 }
@@ -4079,6 +4745,8 @@ uc_fmtbuf_pull(uc_vm_t *vm, size_t nargs)
 	us->header.refcount = 1;
 	us->length = buffer->length;
 
+	ucv_account(&us->header);
+
 	buffer->resource.data = NULL;
 	buffer->capacity = 0;
 	buffer->position = 0;
@@ -4087,10 +4755,468 @@ uc_fmtbuf_pull(uc_vm_t *vm, size_t nargs)
 	return &us->header;
 }
 
+/**
+ * Get the buffer capacity or reserve memory for future writes.
+ *
+ * If called without arguments, returns the number of bytes the buffer can hold
+ * without reallocating its memory. If called with a size argument, ensures that
+ * at least this many bytes can be stored without further reallocations. The
+ * buffer length and content are not changed.
+ *
+ * @function module:struct.buffer#capacity
+ *
+ * @param {number} [size]
+ * The number of bytes to reserve.
+ *
+ * @returns {number|module:struct.buffer}
+ * If called without arguments, returns the current capacity.
+ * If called with a size argument, returns the buffer instance for chaining.
+ *
+ * @example
+ * const buf = struct.buffer().capacity(65536);
+ * buf.capacity();  // 65536
+ */
+static uc_value_t *
+uc_fmtbuf_capacity(uc_vm_t *vm, size_t nargs)
+{
+	formatbuffer_t *buffer = formatbuffer_ctx(vm);
+	uc_value_t *new_cap = uc_fn_arg(0);
+	size_t cap;
+
+	if (!buffer)
+		return NULL;
+
+	if (new_cap) {
+		if (!ucv_as_size_t(vm, new_cap, &cap))
+			return NULL;
+
+		if (!grow_buffer(vm, &buffer->resource.data, &buffer->capacity, cap))
+			return NULL;
+
+		return ucv_get(&buffer->resource.header);
+	}
+
+	return ucv_uint64_new(buffer->capacity);
+}
+
+/* Zero the region between the end of the buffer content and the given
+ * position, it may still hold stale data from before a truncation. The
+ * buffer must already be grown to cover the position. */
+static void
+formatbuffer_fill_gap(formatbuffer_t *buffer, size_t pos)
+{
+	if (pos > buffer->length)
+		memset((char *)buffer->resource.data + sizeof(uc_string_t) + buffer->length,
+			0, pos - buffer->length);
+}
+
+/**
+ * Write raw data into the buffer.
+ *
+ * The `write()` function copies the given string, buffer or buffer view
+ * contents as-is into the buffer. When an offset is given, data is written at
+ * that position without changing the current buffer position, otherwise it
+ * is written at the current position which is advanced past the written data.
+ *
+ * Negative offsets are relative to the end of the buffer. The buffer is grown
+ * as needed.
+ *
+ * @function module:struct.buffer#write
+ *
+ * @param {string|module:struct.buffer|module:struct.view} data
+ * The data to write.
+ *
+ * @param {number} [offset]
+ * The position to write at.
+ *
+ * @returns {module:struct.buffer}
+ * The buffer instance.
+ *
+ * @example
+ * const buf = struct.buffer("....payload");
+ * buf.write("HDR", 0);     // "HDR.payload", position unchanged
+ * buf.end().write("!");    // "HDR.payload!"
+ */
+static uc_value_t *
+uc_fmtbuf_write(uc_vm_t *vm, size_t nargs)
+{
+	formatbuffer_t *buffer = formatbuffer_ctx(vm);
+	uc_value_t *data = uc_fn_arg(0);
+	uc_value_t *offset = uc_fn_arg(1);
+	long long pos;
+	size_t len;
+	char *src;
+
+	if (!buffer)
+		return NULL;
+
+	if (!ucv_bytes_get(data, &len)) {
+		uc_vm_raise_exception(vm, EXCEPTION_TYPE,
+			"Data value is neither a string nor a buffer");
+
+		return NULL;
+	}
+
+	pos = buffer->position;
+
+	if (offset && !ucv_as_longlong(vm, offset, &pos))
+		return NULL;
+
+	if (pos < 0) pos += buffer->length;
+	if (pos < 0) pos = 0;
+
+	if ((unsigned long long)pos > SIZE_MAX - len) {
+		uc_vm_raise_exception(vm, EXCEPTION_RUNTIME,
+			"Offset value out of bounds");
+
+		return NULL;
+	}
+
+	if (!grow_buffer(vm, &buffer->resource.data, &buffer->capacity, pos + len))
+		return NULL;
+
+	/* data may refer to this very buffer, refetch after growing */
+	src = ucv_bytes_get(data, &len);
+
+	formatbuffer_fill_gap(buffer, pos);
+
+	if (len > 0)
+		memmove((char *)buffer->resource.data + sizeof(uc_string_t) + pos,
+			src, len);
+
+	if (pos + len > buffer->length)
+		buffer->length = pos + len;
+
+	if (!offset)
+		buffer->position = pos + len;
+
+	return ucv_get(&buffer->resource.header);
+}
+
+/**
+ * Copy a region of the buffer to another position within the buffer.
+ *
+ * The `copy()` function copies the buffer content between the start and end
+ * positions to the given target position, similar to the C `memmove()`
+ * function. Source and target regions may overlap.
+ *
+ * All position values may be negative, in which case they're relative to the
+ * end of the buffer. The buffer is grown if the copied data extends beyond its
+ * current length.
+ *
+ * @function module:struct.buffer#copy
+ *
+ * @param {number} target
+ * The position to copy the data to.
+ *
+ * @param {number} [start=0]
+ * The start position of the region to copy.
+ *
+ * @param {number} [end=buffer.length()]
+ * The end position of the region to copy (exclusive).
+ *
+ * @returns {module:struct.buffer}
+ * The buffer instance.
+ *
+ * @example
+ * const buf = struct.buffer("abcdef");
+ * buf.copy(0, 3).slice();  // "defdef"
+ */
+static uc_value_t *
+uc_fmtbuf_copy(uc_vm_t *vm, size_t nargs)
+{
+	formatbuffer_t *buffer = formatbuffer_ctx(vm);
+	uc_value_t *target = uc_fn_arg(0);
+	uc_value_t *from = uc_fn_arg(1);
+	uc_value_t *to = uc_fn_arg(2);
+	long long tpos, spos, epos;
+	char *buf;
+
+	if (!buffer)
+		return NULL;
+
+	spos = 0;
+	epos = buffer->length;
+
+	if (!ucv_as_longlong(vm, target, &tpos))
+		return NULL;
+
+	if (from && !ucv_as_longlong(vm, from, &spos))
+		return NULL;
+
+	if (to && !ucv_as_longlong(vm, to, &epos))
+		return NULL;
+
+	if (tpos < 0) tpos += buffer->length;
+	if (tpos < 0) tpos = 0;
+
+	if (spos < 0) spos += buffer->length;
+	if (spos < 0) spos = 0;
+	if ((unsigned long long)spos > buffer->length) spos = buffer->length;
+
+	if (epos < 0) epos += buffer->length;
+	if (epos < spos) epos = spos;
+	if ((unsigned long long)epos > buffer->length) epos = buffer->length;
+
+	if ((unsigned long long)tpos > SIZE_MAX - (epos - spos)) {
+		uc_vm_raise_exception(vm, EXCEPTION_RUNTIME,
+			"Target position out of bounds");
+
+		return NULL;
+	}
+
+	if (epos > spos) {
+		if ((unsigned long long)(tpos + epos - spos) > buffer->length) {
+			if (!grow_buffer(vm, &buffer->resource.data, &buffer->capacity,
+			                 tpos + epos - spos))
+				return NULL;
+
+			formatbuffer_fill_gap(buffer, tpos);
+			buffer->length = tpos + epos - spos;
+		}
+
+		buf = (char *)buffer->resource.data + sizeof(uc_string_t);
+		memmove(buf + tpos, buf + spos, epos - spos);
+	}
+
+	return ucv_get(&buffer->resource.header);
+}
+
+/**
+ * Represents a view into a region of a struct buffer, created by `view()`.
+ *
+ * A view does not hold a copy of the data but refers to the underlying buffer,
+ * so changes to the buffer content are visible through the view. If the buffer
+ * is truncated, the view is truncated accordingly.
+ *
+ * Views may be passed wherever binary data is accepted as buffer, e.g. to
+ * `buffer.write()`, to file and socket write functions or to zlib.
+ *
+ * @class module:struct.view
+ * @hideconstructor
+ *
+ * @see {@link module:struct.buffer#view|view()}
+ */
+
+/**
+ * Create a view of a region of the buffer.
+ *
+ * The `view()` function returns a view object referring to the buffer content
+ * between the specified start and end positions without copying it.
+ *
+ * Both the start and end position values may be negative, in which case they're
+ * relative to the end of the buffer.
+ *
+ * @function module:struct.buffer#view
+ *
+ * @param {number} [start=0]
+ * The starting position of the view.
+ *
+ * @param {number} [end=buffer.length()]
+ * The ending position of the view (exclusive).
+ *
+ * @returns {module:struct.view}
+ *
+ * @example
+ * const buf = struct.buffer().put('!H', 0).put('*', payload);
+ * buf.pos(0).put('!H', buf.length() - 2);
+ * sock.send(buf.view());
+ */
+static uc_value_t *
+uc_fmtbuf_view(uc_vm_t *vm, size_t nargs)
+{
+	formatbuffer_t *buffer = formatbuffer_ctx(vm);
+	uc_value_t *from = uc_fn_arg(0);
+	uc_value_t *to = uc_fn_arg(1);
+	long long spos, epos;
+	formatview_t *view;
+	uc_value_t *res;
+
+	if (!buffer)
+		return NULL;
+
+	spos = 0;
+	epos = buffer->length;
+
+	if (from && !ucv_as_longlong(vm, from, &spos))
+		return NULL;
+
+	if (to && !ucv_as_longlong(vm, to, &epos))
+		return NULL;
+
+	if (spos < 0) spos += buffer->length;
+	if (spos < 0) spos = 0;
+	if ((unsigned long long)spos > buffer->length) spos = buffer->length;
+
+	if (epos < 0) epos += buffer->length;
+	if (epos < spos) epos = spos;
+	if ((unsigned long long)epos > buffer->length) epos = buffer->length;
+
+	res = ucv_resource_create_ex(vm, "struct.view", (void **)&view, 1, sizeof(*view));
+
+	if (!res)
+		return NULL;
+
+	view->start = spos;
+	view->end = epos;
+
+	ucv_resource_value_set(res, 0, ucv_get(&buffer->resource.header));
+
+	return res;
+}
+
+static char *
+formatbuffer_bytes(uc_value_t *uv, size_t *len)
+{
+	static char empty[1];
+	formatbuffer_t *buffer = (formatbuffer_t *)uv;
+
+	*len = buffer->length;
+
+	if (!buffer->resource.data)
+		return empty;
+
+	return (char *)buffer->resource.data + sizeof(uc_string_t);
+}
+
+static char *
+formatbuffer_reserve(uc_vm_t *vm, uc_value_t *uv, size_t len)
+{
+	static char empty[1];
+	formatbuffer_t *buffer = (formatbuffer_t *)uv;
+
+	if (len > SIZE_MAX - buffer->position ||
+	    !grow_buffer(vm, &buffer->resource.data, &buffer->capacity,
+	                 buffer->position + len))
+		return NULL;
+
+	/* reserving nothing in a never written buffer allocates no storage */
+	if (!buffer->resource.data)
+		return empty;
+
+	return (char *)buffer->resource.data + sizeof(uc_string_t) + buffer->position;
+}
+
+static void
+formatbuffer_commit(uc_value_t *uv, size_t len)
+{
+	formatbuffer_t *buffer = (formatbuffer_t *)uv;
+
+	if (len > 0)
+		formatbuffer_fill_gap(buffer, buffer->position);
+
+	buffer->position += len;
+
+	if (buffer->position > buffer->length)
+		buffer->length = buffer->position;
+}
+
+static char *
+formatview_bytes(uc_value_t *uv, size_t *len)
+{
+	formatview_t *view = ucv_resource_data(uv, "struct.view");
+	uc_value_t *buf = ucv_resource_value_get(uv, 0);
+	size_t start, end, buflen;
+	char *data;
+
+	data = formatbuffer_bytes(buf, &buflen);
+	start = (view->start < buflen) ? view->start : buflen;
+	end = (view->end < buflen) ? view->end : buflen;
+
+	*len = end - start;
+
+	return data + start;
+}
+
+/**
+ * Get the length of the view.
+ *
+ * @function module:struct.view#length
+ *
+ * @returns {number}
+ */
+static uc_value_t *
+uc_fmtview_length(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *this = _uc_fn_this_res(vm);
+	size_t len;
+
+	if (!ucv_resource_data(this, "struct.view"))
+		return NULL;
+
+	formatview_bytes(this, &len);
+
+	return ucv_uint64_new(len);
+}
+
+/**
+ * Extract a copy of the view content.
+ *
+ * The `slice()` function returns the data of the view between the specified
+ * start and end positions, relative to the start of the view, as string.
+ * Negative positions are relative to the end of the view.
+ *
+ * @function module:struct.view#slice
+ *
+ * @param {number} [start=0]
+ * The starting position of the slice.
+ *
+ * @param {number} [end=view.length()]
+ * The ending position of the slice (exclusive).
+ *
+ * @returns {string}
+ */
+static uc_value_t *
+uc_fmtview_slice(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *this = _uc_fn_this_res(vm);
+	uc_value_t *from = uc_fn_arg(0);
+	uc_value_t *to = uc_fn_arg(1);
+	long long spos, epos;
+	size_t len;
+	char *buf;
+
+	if (!ucv_resource_data(this, "struct.view"))
+		return NULL;
+
+	buf = formatview_bytes(this, &len);
+
+	spos = 0;
+	epos = len;
+
+	if (from && !ucv_as_longlong(vm, from, &spos))
+		return NULL;
+
+	if (to && !ucv_as_longlong(vm, to, &epos))
+		return NULL;
+
+	if (spos < 0) spos += len;
+	if (spos < 0) spos = 0;
+	if ((unsigned long long)spos > len) spos = len;
+
+	if (epos < 0) epos += len;
+	if (epos < spos) epos = spos;
+	if ((unsigned long long)epos > len) epos = len;
+
+	return ucv_string_new_length(buf + spos, epos - spos);
+}
+
+static const uc_bytes_ops_t buffer_bytes_ops = {
+	.data = formatbuffer_bytes,
+	.reserve = formatbuffer_reserve,
+	.commit = formatbuffer_commit
+};
+
+static const uc_bytes_ops_t view_bytes_ops = {
+	.data = formatview_bytes
+};
+
 
 static const uc_function_list_t struct_inst_fns[] = {
 	{ "pack",	uc_struct_pack },
-	{ "unpack",	uc_struct_unpack }
+	{ "unpack",	uc_struct_unpack },
+	{ "pack_many",	uc_struct_pack_many },
+	{ "unpack_many",	uc_struct_unpack_many }
 };
 
 static const uc_function_list_t buffer_inst_fns[] = {
@@ -4104,21 +5230,41 @@ static const uc_function_list_t buffer_inst_fns[] = {
 	{ "read",	uc_fmtbuf_read },
 	{ "slice",	uc_fmtbuf_slice },
 	{ "pull",	uc_fmtbuf_pull },
+	{ "capacity",	uc_fmtbuf_capacity },
+	{ "write",	uc_fmtbuf_write },
+	{ "copy",	uc_fmtbuf_copy },
+	{ "view",	uc_fmtbuf_view },
+};
+
+static const uc_function_list_t view_inst_fns[] = {
+	{ "length",	uc_fmtview_length },
+	{ "slice",	uc_fmtview_slice },
 };
 
 static const uc_function_list_t struct_fns[] = {
 	{ "pack",	uc_pack },
 	{ "unpack",	uc_unpack },
+	{ "pack_many",	uc_pack_many },
+	{ "unpack_many",	uc_unpack_many },
 	{ "new",	uc_struct_new },
 	{ "buffer",	uc_fmtbuf_new }
 };
 
 void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 {
+	uc_resource_type_t *buffer_type, *view_type;
+
 	optimize_functions();
 
 	uc_function_list_register(scope, struct_fns);
 
-	uc_type_declare(vm, "struct.format", struct_inst_fns, free);
-	uc_type_declare(vm, "struct.buffer", buffer_inst_fns, free);
+	uc_type_declare(vm, "struct.format", struct_inst_fns, format_state_put);
+
+	buffer_type = uc_type_declare(vm, "struct.buffer", buffer_inst_fns, free);
+	buffer_type->bytes = &buffer_bytes_ops;
+
+	view_type = uc_type_declare(vm, "struct.view", view_inst_fns, NULL);
+	view_type->bytes = &view_bytes_ops;
+
+	ucv_resource_type_add(vm, "struct.cache", NULL, formatcache_free);
 }
@@ -17,6 +17,8 @@
 #include <unistd.h>
 #include <limits.h>
 #include <fnmatch.h>
+#include <time.h>
+#include <poll.h>
 #include <libubus.h>
 #include <libubox/blobmsg.h>
 
@@ -279,27 +281,112 @@ enum {
 	__SUB_RES_MAX,
 };
 
+/*
+ * Table keys of converted messages are interned: ubus replies use the same
+ * small set of field names over and over again, so objects share the pooled
+ * key strings instead of duplicating them for every entry. The pool is kept
+ * per VM in the registry and released along with the VM's values. It is
+ * bounded, once full or for names exceeding its limits, keys are copied as
+ * usual, as are keys of messages converted without a VM.
+ */
+#define KEY_POOL_SIZE	4096
+#define KEY_POOL_MAXLEN	48
+
+typedef struct {
+	const char *keys[KEY_POOL_SIZE];
+	size_t count;
+} key_pool_t;
+
+static void
+key_pool_free(void *ptr)
+{
+	key_pool_t *pool = ptr;
+	size_t i;
+
+	for (i = 0; i < KEY_POOL_SIZE; i++)
+		free((char *)pool->keys[i]);
+
+	free(pool);
+}
+
+static key_pool_t *
+key_pool_get(uc_vm_t *vm)
+{
+	uc_value_t *res = uc_vm_registry_get(vm, "ubus.keys");
+	key_pool_t *pool = ucv_resource_data(res, "ubus.keys");
+
+	if (!pool) {
+		pool = xalloc(sizeof(*pool));
+		res = ucv_resource_create(vm, "ubus.keys", pool);
+
+		uc_vm_registry_set(vm, "ubus.keys", res);
+	}
+
+	return pool;
+}
+
+static const char *
+key_intern(key_pool_t *pool, const char *name, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i, slot;
+
+	if (!pool || len > KEY_POOL_MAXLEN)
+		return NULL;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+
+	for (slot = hash % KEY_POOL_SIZE;
+	     pool->keys[slot];
+	     slot = (slot + 1) % KEY_POOL_SIZE)
+		if (!strcmp(pool->keys[slot], name))
+			return pool->keys[slot];
+
+	if (pool->count >= KEY_POOL_SIZE / 2)
+		return NULL;
+
+	pool->keys[slot] = xstrdup(name);
+	pool->count++;
+
+	return pool->keys[slot];
+}
+
 static uc_value_t *
 blob_to_ucv(uc_vm_t *vm, struct blob_attr *attr, bool table, const char **name);
 
 static uc_value_t *
 blob_array_to_ucv(uc_vm_t *vm, struct blob_attr *attr, size_t len, bool table)
 {
-	uc_value_t *o = table ? ucv_object_new(vm) : ucv_array_new(vm);
-	uc_value_t *v;
+	key_pool_t *pool = (table && vm) ? key_pool_get(vm) : NULL;
+	uc_value_t *o, *v;
 	struct blob_attr *pos;
-	size_t rem = len;
-	const char *name;
+	size_t rem = len, count = 0;
+	const char *name, *key;
+
+	/* count attributes to allocate the container in one go */
+	__blob_for_each_attr(pos, attr, rem)
+		count++;
+
+	o = table ? ucv_object_new_length(vm, count) : ucv_array_new_length(vm, count);
 
 	if (!o)
 		return NULL;
 
+	rem = len;
+
 	__blob_for_each_attr(pos, attr, rem) {
 		name = NULL;
 		v = blob_to_ucv(vm, pos, table, &name);
 
-		if (table && name)
-			ucv_object_add(o, name, v);
+		if (table && name) {
+			key = key_intern(pool, name, blobmsg_namelen(blob_data(pos)));
+
+			if (key)
+				ucv_object_add_static(o, key, v);
+			else
+				ucv_object_add(o, name, v);
+		}
 		else if (!table)
 			ucv_array_push(o, v);
 		else
@@ -366,7 +453,7 @@ static void
 ucv_array_to_blob(uc_value_t *val, struct blob_buf *blob);
 
 static void
-ucv_object_to_blob(uc_value_t *val, struct blob_buf *blob);
+ucv_table_to_blob(uc_value_t *val, struct blob_buf *blob);
 
 static void
 ucv_to_blob(const char *name, uc_value_t *val, struct blob_buf *blob)
@@ -412,7 +499,7 @@ ucv_to_blob(const char *name, uc_value_t *val, struct blob_buf *blob)
 
 	case UC_OBJECT:
 		c = blobmsg_open_table(blob, name);
-		ucv_object_to_blob(val, blob);
+		ucv_table_to_blob(val, blob);
 		blobmsg_close_table(blob, c);
 		break;
 
@@ -431,12 +518,70 @@ ucv_array_to_blob(uc_value_t *val, struct blob_buf *blob)
 }
 
 static void
-ucv_object_to_blob(uc_value_t *val, struct blob_buf *blob)
+ucv_table_to_blob(uc_value_t *val, struct blob_buf *blob)
 {
 	ucv_object_foreach(val, k, v)
 		ucv_to_blob(k, v, blob);
 }
 
+/*
+ * Upper bound of the encoded size of a value, used to grow the reused
+ * blob buffer once up front instead of reallocating it while writing.
+ */
+static size_t
+ucv_blob_size(const char *name, uc_value_t *val)
+{
+	size_t len = sizeof(struct blob_attr) + blobmsg_hdrlen(name ? strlen(name) : 0);
+	size_t i;
+
+	switch (ucv_type(val)) {
+	case UC_NULL:
+		break;
+
+	case UC_BOOLEAN:
+		len += 1;
+		break;
+
+	case UC_INTEGER:
+	case UC_DOUBLE:
+		len += 8;
+		break;
+
+	case UC_STRING:
+		len += ucv_string_length(val) + 1;
+		break;
+
+	case UC_ARRAY:
+		for (i = 0; i < ucv_array_length(val); i++)
+			len += ucv_blob_size(NULL, ucv_array_get(val, i));
+
+		break;
+
+	case UC_OBJECT:
+		ucv_object_foreach(val, k, v)
+			len += ucv_blob_size(k, v);
+
+		break;
+
+	default:
+		return 0;
+	}
+
+	return (len + BLOB_ATTR_ALIGN - 1) & ~(BLOB_ATTR_ALIGN - 1);
+}
+
+static void
+ucv_object_to_blob(uc_value_t *val, struct blob_buf *blob)
+{
+	size_t used = (char *)blob_next(blob->head) - (char *)blob->buf;
+	size_t need = used + ucv_blob_size(NULL, val);
+
+	if (need > (size_t)blob->buflen)
+		blob_buf_grow(blob, need - blob->buflen);
+
+	ucv_table_to_blob(val, blob);
+}
+
 
 static uc_ubus_connection_t *
 uc_ubus_conn_alloc(uc_vm_t *vm, uc_value_t *timeout, const char *type)
@@ -870,6 +1015,286 @@ uc_ubus_call(uc_vm_t *vm, size_t nargs)
 	ok_return(res.res);
 }
 
+typedef struct {
+	struct ubus_request request;
+	uc_vm_t *vm;
+	uint32_t id;
+	int status;
+	bool active;
+	bool complete;
+	int64_t deadline;
+	uc_value_t *reply;
+} uc_ubus_batch_req_t;
+
+static int64_t
+uc_ubus_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void
+uc_ubus_batch_data_cb(struct ubus_request *req, int type, struct blob_attr *msg)
+{
+	uc_ubus_batch_req_t *r = container_of(req, uc_ubus_batch_req_t, request);
+
+	if (!r->reply && msg)
+		r->reply = blob_array_to_ucv(r->vm, blob_data(msg), blob_len(msg), true);
+}
+
+static void
+uc_ubus_batch_done_cb(struct ubus_request *req, int ret)
+{
+	uc_ubus_batch_req_t *r = container_of(req, uc_ubus_batch_req_t, request);
+
+	r->status = ret;
+	r->complete = true;
+}
+
+static void
+uc_ubus_batch_lookup_cb(struct ubus_context *c, struct ubus_object_data *o, void *p)
+{
+	bool exists;
+
+	ucv_object_get(p, o->path, &exists);
+
+	if (exists)
+		ucv_object_add(p, o->path, ucv_uint64_new(o->id));
+}
+
+/* Resolve all object names of the batch, using a single listing of all
+ * objects instead of one lookup round trip per name if there are many. */
+static void
+uc_ubus_batch_resolve(uc_ubus_connection_t *c, uc_value_t *requests,
+                      uc_ubus_batch_req_t *reqs, size_t n)
+{
+	uc_value_t *ids = ucv_object_new(NULL), *obj, *id;
+	enum ubus_msg_status rv;
+	bool listed = false;
+	uint32_t idval;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		obj = ucv_object_get(ucv_array_get(requests, i), "object", NULL);
+
+		if (ucv_type(obj) == UC_STRING)
+			ucv_object_add(ids, ucv_string_get(obj), NULL);
+	}
+
+	if (ucv_object_length(ids) > 1)
+		listed = (ubus_lookup(&c->ctx, NULL, uc_ubus_batch_lookup_cb, ids) == UBUS_STATUS_OK);
+
+	for (i = 0; i < n; i++) {
+		obj = ucv_object_get(ucv_array_get(requests, i), "object", NULL);
+
+		if (ucv_type(obj) == UC_INTEGER) {
+			reqs[i].id = ucv_uint64_get(obj);
+			continue;
+		}
+
+		id = ucv_object_get(ids, ucv_string_get(obj), NULL);
+
+		if (id) {
+			reqs[i].id = ucv_uint64_get(id);
+			continue;
+		}
+
+		rv = listed ? UBUS_STATUS_NOT_FOUND
+		            : ubus_lookup_id(&c->ctx, ucv_string_get(obj), &idval);
+
+		if (rv == UBUS_STATUS_OK) {
+			reqs[i].id = idval;
+			ucv_object_add(ids, ucv_string_get(obj), ucv_uint64_new(idval));
+		}
+		else {
+			reqs[i].status = rv;
+			reqs[i].complete = true;
+		}
+	}
+
+	ucv_put(ids);
+}
+
+static void
+uc_ubus_batch_start(uc_ubus_connection_t *c, uc_value_t *request,
+                    uc_ubus_batch_req_t *r, int timeout)
+{
+	uc_value_t *method = ucv_object_get(request, "method", NULL);
+	uc_value_t *data = ucv_object_get(request, "data", NULL);
+	enum ubus_msg_status rv;
+
+	blob_buf_init(&c->buf, 0);
+
+	if (data)
+		ucv_object_to_blob(data, &c->buf);
+
+	rv = ubus_invoke_async(&c->ctx, r->id, ucv_string_get(method),
+	                       c->buf.head, &r->request);
+
+	if (rv != UBUS_STATUS_OK) {
+		r->status = rv;
+		r->complete = true;
+
+		return;
+	}
+
+	r->request.data_cb = uc_ubus_batch_data_cb;
+	r->request.complete_cb = uc_ubus_batch_done_cb;
+	r->deadline = timeout ? uc_ubus_now() + timeout : INT64_MAX;
+	r->active = true;
+
+	ubus_complete_request_async(&c->ctx, &r->request);
+}
+
+static uc_value_t *
+uc_ubus_batch(uc_vm_t *vm, size_t nargs)
+{
+	uc_value_t *requests, *opts, *request, *limit, *timeout, *res, *item;
+	size_t i, n, next = 0, oldest = 0, active = 0, max_active = 16;
+	uc_ubus_batch_req_t *reqs;
+	uc_ubus_connection_t *c;
+	int64_t now, deadline;
+	struct pollfd pfd;
+	size_t finished;
+	int tmo;
+
+	conn_get(vm, &c);
+
+	args_get(vm, nargs,
+	         "requests", UC_ARRAY, REQUIRED, &requests,
+	         "options", UC_OBJECT, OPTIONAL, &opts);
+
+	limit = ucv_object_get(opts, "concurrency", NULL);
+	timeout = ucv_object_get(opts, "timeout", NULL);
+	tmo = c->timeout * 1000;
+
+	if (limit) {
+		if (ucv_type(limit) != UC_INTEGER || ucv_int64_get(limit) < 1)
+			err_return(UBUS_STATUS_INVALID_ARGUMENT, "Invalid concurrency limit");
+
+		max_active = ucv_int64_get(limit);
+	}
+
+	if (timeout) {
+		if (ucv_type(timeout) != UC_INTEGER || ucv_int64_get(timeout) < 0 ||
+		    ucv_int64_get(timeout) > INT_MAX)
+			err_return(UBUS_STATUS_INVALID_ARGUMENT, "Invalid timeout");
+
+		tmo = ucv_int64_get(timeout);
+	}
+
+	n = ucv_array_length(requests);
+
+	for (i = 0; i < n; i++) {
+		request = ucv_array_get(requests, i);
+
+		if (ucv_type(request) != UC_OBJECT ||
+		    (ucv_type(ucv_object_get(request, "object", NULL)) != UC_STRING &&
+		     ucv_type(ucv_object_get(request, "object", NULL)) != UC_INTEGER) ||
+		    ucv_type(ucv_object_get(request, "method", NULL)) != UC_STRING ||
+		    (ucv_object_get(request, "data", NULL) &&
+		     ucv_type(ucv_object_get(request, "data", NULL)) != UC_OBJECT))
+			err_return(UBUS_STATUS_INVALID_ARGUMENT,
+			           "Request #%zu is not an object with object, method and optional data", i);
+	}
+
+	reqs = xalloc(n * sizeof(*reqs) + 1);
+
+	for (i = 0; i < n; i++)
+		reqs[i].vm = vm;
+
+	uc_ubus_batch_resolve(c, requests, reqs, n);
+
+	while (next < n || active) {
+		/* keep up to max_active requests in flight */
+		for (; next < n && active < max_active; next++) {
+			if (reqs[next].complete)
+				continue;
+
+			uc_ubus_batch_start(c, ucv_array_get(requests, next), &reqs[next], tmo);
+
+			if (reqs[next].active)
+				active++;
+		}
+
+		while (oldest < next && !reqs[oldest].active)
+			oldest++;
+
+		/* expire overdue requests and find the nearest pending deadline */
+		now = uc_ubus_now();
+		deadline = INT64_MAX;
+
+		for (i = oldest; i < next; i++) {
+			if (!reqs[i].active || reqs[i].complete)
+				continue;
+
+			if (reqs[i].deadline <= now) {
+				ubus_abort_request(&c->ctx, &reqs[i].request);
+				reqs[i].status = UBUS_STATUS_TIMEOUT;
+				reqs[i].complete = true;
+			}
+			else if (reqs[i].deadline < deadline) {
+				deadline = reqs[i].deadline;
+			}
+		}
+
+		/* make sure finished requests are unlinked from the context */
+		for (i = oldest, finished = 0; i < next; i++) {
+			if (reqs[i].active && reqs[i].complete) {
+				ubus_abort_request(&c->ctx, &reqs[i].request);
+				reqs[i].active = false;
+				active--;
+				finished++;
+			}
+		}
+
+		/* refill the window as soon as any request finished, otherwise
+		 * dispatch replies until one does or the nearest deadline passes */
+		if (!finished && active && !c->ctx.sock.eof) {
+			pfd.fd = c->ctx.sock.fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+
+			if (poll(&pfd, 1, (deadline == INT64_MAX) ? -1 : (int)(deadline - now)) > 0)
+				ubus_handle_event(&c->ctx);
+		}
+
+		if (c->ctx.sock.eof) {
+			for (i = oldest; i < next; i++) {
+				if (reqs[i].active) {
+					ubus_abort_request(&c->ctx, &reqs[i].request);
+					reqs[i].status = UBUS_STATUS_CONNECTION_FAILED;
+					reqs[i].complete = true;
+					reqs[i].active = false;
+				}
+			}
+
+			for (; next < n; next++) {
+				reqs[next].status = UBUS_STATUS_CONNECTION_FAILED;
+				reqs[next].complete = true;
+			}
+
+			active = 0;
+		}
+	}
+
+	res = ucv_array_new_length(vm, n);
+
+	for (i = 0; i < n; i++) {
+		item = ucv_object_new(vm);
+		ucv_object_add(item, "status", ucv_int64_new(reqs[i].status));
+		ucv_object_add(item, "reply", reqs[i].reply);
+		ucv_array_push(res, item);
+	}
+
+	free(reqs);
+
+	ok_return(res);
+}
+
 static uc_value_t *
 uc_ubus_chan_request(uc_vm_t *vm, size_t nargs)
 {
@@ -2515,6 +2940,7 @@ static const uc_function_list_t global_fns[] = {
 static const uc_function_list_t conn_fns[] = {
 	{ "list",			uc_ubus_list },
 	{ "call",			uc_ubus_call },
+	{ "batch",			uc_ubus_batch },
 	{ "defer",			uc_ubus_defer },
 	{ "publish",		uc_ubus_publish },
 	{ "remove",			uc_ubus_remove },
@@ -2640,4 +3066,6 @@ void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
 	uc_type_declare(vm, "ubus.request", request_fns, free_request);
 	uc_type_declare(vm, "ubus.listener", listener_fns, NULL);
 	uc_type_declare(vm, "ubus.subscriber", subscriber_fns, NULL);
+
+	ucv_resource_type_add(vm, "ubus.keys", NULL, key_pool_free);
 }
@@ -49,6 +49,7 @@
  */
 
 #include <string.h>
+#include <stdint.h>
 #include <uci.h>
 
 #include "ucode/module.h"
@@ -69,6 +70,53 @@ enum pkg_cmd {
 	CMD_REVERT
 };
 
+/* Open addressing string table, keys point into libuci owned memory */
+typedef struct {
+	size_t size;
+	struct {
+		const char *key;
+		void *val;
+	} *slots;
+} uci_index_hash_t;
+
+typedef struct {
+	struct uci_section *s;
+	size_t index;
+	size_t noptions;
+	uci_index_hash_t options;
+} uci_index_section_t;
+
+uc_declare_vector(uci_index_seclist_t, uci_index_section_t *);
+
+typedef struct {
+	const char *type;
+	uci_index_seclist_t sections;
+} uci_index_type_t;
+
+/* Lookup structures for one loaded package, rebuilt lazily whenever
+ * a modification through the cursor invalidates them */
+typedef struct uci_index {
+	struct uci_index *next;
+	struct uci_package *p;
+	char *name;
+	bool valid;
+	size_t nsections;
+	uci_index_section_t *sections;
+	size_t ntypes;
+	uci_index_type_t *types;
+	uci_index_hash_t names;
+	uci_index_hash_t typemap;
+} uci_index_t;
+
+/* The context pointer must remain the first member, cursor methods access
+ * it through the resource data pointer as `struct uci_context **` */
+typedef struct {
+	struct uci_context *ctx;
+	uci_index_t *indexes;
+} uc_uci_cursor_t;
+
+#define cursor_of(c) ((uc_uci_cursor_t *)(c))
+
 /**
  * Query error information.
  *
@@ -181,6 +229,8 @@ uc_uci_cursor(uc_vm_t *vm, size_t nargs)
 	uc_value_t *c2dir = uc_fn_arg(2);
 	uc_value_t *flags = uc_fn_arg(3);
 	struct uci_context *c;
+	uc_uci_cursor_t *cur;
+	uc_value_t *res;
 	int rv;
 
 	if ((cdir && ucv_type(cdir) != UC_STRING) ||
@@ -245,7 +295,10 @@ uc_uci_cursor(uc_vm_t *vm, size_t nargs)
 		c->flags = (c->flags & ~clear) | set;
 	}
 
-	ok_return(ucv_resource_create(vm, "uci.cursor", c));
+	res = ucv_resource_create_ex(vm, "uci.cursor", (void **)&cur, 0, sizeof(*cur));
+	cur->ctx = c;
+
+	ok_return(res);
 
 error:
 	uci_free_context(c);
@@ -391,6 +444,328 @@ error:
  * The section object.
  */
 
+static uint32_t
+index_hash_str(const char *s)
+{
+	uint32_t h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+
+	return h;
+}
+
+static void
+index_hash_init(uci_index_hash_t *h, size_t count)
+{
+	h->size = 8;
+
+	while (h->size < count * 2)
+		h->size *= 2;
+
+	h->slots = xalloc(h->size * sizeof(*h->slots));
+}
+
+static void
+index_hash_insert(uci_index_hash_t *h, const char *key, void *val)
+{
+	size_t i = index_hash_str(key) & (h->size - 1);
+
+	while (h->slots[i].key) {
+		/* keep the first occurrence, like a list walk would */
+		if (!strcmp(h->slots[i].key, key))
+			return;
+
+		i = (i + 1) & (h->size - 1);
+	}
+
+	h->slots[i].key = key;
+	h->slots[i].val = val;
+}
+
+static void *
+index_hash_get(uci_index_hash_t *h, const char *key)
+{
+	size_t i;
+
+	if (!h->slots)
+		return NULL;
+
+	i = index_hash_str(key) & (h->size - 1);
+
+	while (h->slots[i].key) {
+		if (!strcmp(h->slots[i].key, key))
+			return h->slots[i].val;
+
+		i = (i + 1) & (h->size - 1);
+	}
+
+	return NULL;
+}
+
+static void
+index_hash_free(uci_index_hash_t *h)
+{
+	free(h->slots);
+	h->slots = NULL;
+	h->size = 0;
+}
+
+static void
+index_clear(uci_index_t *idx)
+{
+	size_t i;
+
+	for (i = 0; i < idx->nsections; i++)
+		index_hash_free(&idx->sections[i].options);
+
+	for (i = 0; i < idx->ntypes; i++)
+		uc_vector_clear(&idx->types[i].sections);
+
+	index_hash_free(&idx->names);
+	index_hash_free(&idx->typemap);
+
+	free(idx->sections);
+	free(idx->types);
+
+	idx->sections = NULL;
+	idx->types = NULL;
+	idx->nsections = 0;
+	idx->ntypes = 0;
+	idx->valid = false;
+}
+
+static void
+index_build(uci_index_t *idx, struct uci_package *p)
+{
+	uci_index_section_t *se;
+	uci_index_type_t *te;
+	struct uci_section *sc;
+	struct uci_element *e;
+	size_t n = 0;
+
+	uci_foreach_element(&p->sections, e)
+		n++;
+
+	idx->p = p;
+	idx->sections = xalloc((n ? n : 1) * sizeof(*idx->sections));
+	idx->types = xalloc((n ? n : 1) * sizeof(*idx->types));
+
+	index_hash_init(&idx->names, n);
+	index_hash_init(&idx->typemap, n);
+
+	uci_foreach_element(&p->sections, e) {
+		sc = uci_to_section(e);
+		se = &idx->sections[idx->nsections];
+		se->s = sc;
+		se->index = idx->nsections++;
+
+		index_hash_insert(&idx->names, sc->e.name, se);
+
+		te = index_hash_get(&idx->typemap, sc->type);
+
+		if (!te) {
+			te = &idx->types[idx->ntypes++];
+			te->type = sc->type;
+			index_hash_insert(&idx->typemap, sc->type, te);
+		}
+
+		uc_vector_push(&te->sections, se);
+	}
+
+	idx->valid = true;
+}
+
+static uci_index_t *
+index_get(uc_uci_cursor_t *cur, const char *name, bool load)
+{
+	struct uci_package *p = NULL;
+	struct uci_element *e;
+	uci_index_t *idx;
+
+	uci_foreach_element(&cur->ctx->root, e) {
+		if (!strcmp(e->name, name)) {
+			p = uci_to_package(e);
+			break;
+		}
+	}
+
+	if (!p && (!load || uci_load(cur->ctx, name, &p) || !p))
+		return NULL;
+
+	for (idx = cur->indexes; idx; idx = idx->next)
+		if (!strcmp(idx->name, name))
+			break;
+
+	if (!idx) {
+		idx = xalloc(sizeof(*idx));
+		idx->name = xstrdup(name);
+		idx->next = cur->indexes;
+		cur->indexes = idx;
+	}
+
+	if (!idx->valid || idx->p != p) {
+		index_clear(idx);
+		index_build(idx, p);
+	}
+
+	return idx;
+}
+
+static struct uci_option *
+index_option(uci_index_section_t *se, const char *name)
+{
+	struct uci_element *e;
+
+	if (!se->options.slots) {
+		se->noptions = 0;
+
+		uci_foreach_element(&se->s->options, e)
+			se->noptions++;
+
+		index_hash_init(&se->options, se->noptions);
+
+		uci_foreach_element(&se->s->options, e)
+			index_hash_insert(&se->options, e->name, e);
+	}
+
+	return index_hash_get(&se->options, name);
+}
+
+/* Resolve `@type[n]` references through the per-type section lists,
+ * returns false for notations left to libuci */
+static bool
+index_section_extended(uci_index_t *idx, const char *ref,
+                       uci_index_section_t **res)
+{
+	const char *p = strchr(ref, '[');
+	uci_index_type_t *te;
+	char type[256];
+	int64_t n = 0;
+	bool neg;
+
+	*res = NULL;
+
+	if (!p || p == ref + 1 || (size_t)(p - ref - 1) >= sizeof(type))
+		return false;
+
+	memcpy(type, ref + 1, p - ref - 1);
+	type[p - ref - 1] = 0;
+
+	neg = (*++p == '-');
+
+	if (neg)
+		p++;
+
+	if (*p < '0' || *p > '9')
+		return false;
+
+	while (*p >= '0' && *p <= '9') {
+		n = n * 10 + (*p++ - '0');
+
+		if (n > INT32_MAX)
+			return false;
+	}
+
+	if (p[0] != ']' || p[1] != 0)
+		return false;
+
+	te = index_hash_get(&idx->typemap, type);
+
+	if (!te)
+		return true;
+
+	if (neg)
+		n = (int64_t)te->sections.count - n;
+
+	if (n >= 0 && (size_t)n < te->sections.count)
+		*res = te->sections.entries[n];
+
+	return true;
+}
+
+/* Indexed equivalent of lookup_ptr(), returns -1 if the reference cannot
+ * be resolved through the index and a regular lookup is required */
+static int
+index_lookup(uc_uci_cursor_t *cur, struct uci_ptr *ptr)
+{
+	uci_index_section_t *se;
+	struct uci_option *o;
+	uci_index_t *idx;
+
+	if (!ptr->section)
+		return -1;
+
+	idx = index_get(cur, ptr->package, true);
+
+	if (!idx)
+		return -1;
+
+	if (*ptr->section == '@') {
+		if (!index_section_extended(idx, ptr->section, &se))
+			return -1;
+
+		/* mirror libuci which fails extended lookups without a match */
+		if (!se)
+			return UCI_ERR_NOTFOUND;
+
+		ptr->section = se->s->e.name;
+	}
+	else {
+		se = index_hash_get(&idx->names, ptr->section);
+	}
+
+	ptr->p = idx->p;
+	ptr->flags |= UCI_LOOKUP_DONE;
+
+	if (!se)
+		return UCI_OK;
+
+	ptr->s = se->s;
+	ptr->last = &se->s->e;
+
+	if (ptr->option) {
+		o = index_option(se, ptr->option);
+
+		if (!o)
+			return UCI_OK;
+
+		ptr->o = o;
+		ptr->last = &o->e;
+	}
+
+	ptr->flags |= UCI_LOOKUP_COMPLETE;
+
+	return UCI_OK;
+}
+
+/* Drop cached lookup state affected by a modification. When a section is
+ * given, only its option table is discarded, otherwise the entire index of
+ * the package, or of all packages if no package name is given. */
+static void
+index_invalidate(struct uci_context **c, const char *package,
+                 struct uci_section *s)
+{
+	uci_index_section_t *se;
+	uci_index_t *idx;
+
+	for (idx = cursor_of(c)->indexes; idx; idx = idx->next) {
+		if (package && strcmp(idx->name, package))
+			continue;
+
+		if (s && idx->valid) {
+			se = index_hash_get(&idx->names, s->e.name);
+
+			if (se && se->s == s) {
+				index_hash_free(&se->options);
+				continue;
+			}
+		}
+
+		idx->valid = false;
+	}
+}
+
 /**
  * Explicitly reload configuration file.
  *
@@ -415,7 +790,7 @@ error:
 static uc_value_t *
 uc_uci_load(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	struct uci_element *e;
 	char *s;
@@ -428,6 +803,8 @@ uc_uci_load(uc_vm_t *vm, size_t nargs)
 
 	s = ucv_string_get(conf);
 
+	index_invalidate(c, s, NULL);
+
 	uci_foreach_element(&(*c)->root, e) {
 		if (!strcmp(e->name, s)) {
 			uci_unload(*c, uci_to_package(e));
@@ -464,7 +841,7 @@ uc_uci_load(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_unload(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	struct uci_element *e;
 
@@ -476,6 +853,7 @@ uc_uci_unload(uc_vm_t *vm, size_t nargs)
 
 	uci_foreach_element(&(*c)->root, e) {
 		if (!strcmp(e->name, ucv_string_get(conf))) {
+			index_invalidate(c, e->name, NULL);
 			uci_unload(*c, uci_to_package(e));
 
 			ok_return(ucv_boolean_new(true));
@@ -519,13 +897,17 @@ option_to_uval(uc_vm_t *vm, struct uci_option *o)
 {
 	struct uci_element *e;
 	uc_value_t *arr;
+	size_t n = 0;
 
 	switch (o->type) {
 	case UCI_TYPE_STRING:
 		return ucv_string_new(o->v.string);
 
 	case UCI_TYPE_LIST:
-		arr = ucv_array_new(vm);
+		uci_foreach_element(&o->v.list, e)
+			n++;
+
+		arr = ucv_array_new_length(vm, n);
 
 		if (arr)
 			uci_foreach_element(&o->v.list, e)
@@ -541,19 +923,25 @@ option_to_uval(uc_vm_t *vm, struct uci_option *o)
 static uc_value_t *
 section_to_uval(uc_vm_t *vm, struct uci_section *s, int index)
 {
-	uc_value_t *so = ucv_object_new(vm);
 	struct uci_element *e;
 	struct uci_option *o;
+	uc_value_t *so;
+	size_t n = 4;
+
+	uci_foreach_element(&s->options, e)
+		n++;
+
+	so = ucv_object_new_length(vm, n);
 
 	if (!so)
 		return NULL;
 
-	ucv_object_add(so, ".anonymous", ucv_boolean_new(s->anonymous));
-	ucv_object_add(so, ".type", ucv_string_new(s->type));
-	ucv_object_add(so, ".name", ucv_string_new(s->e.name));
+	ucv_object_add_static(so, ".anonymous", ucv_boolean_new(s->anonymous));
+	ucv_object_add_static(so, ".type", ucv_string_new(s->type));
+	ucv_object_add_static(so, ".name", ucv_string_new(s->e.name));
 
 	if (index >= 0)
-		ucv_object_add(so, ".index", ucv_int64_new(index));
+		ucv_object_add_static(so, ".index", ucv_int64_new(index));
 
 	uci_foreach_element(&s->options, e) {
 		o = uci_to_option(e);
@@ -566,11 +954,16 @@ section_to_uval(uc_vm_t *vm, struct uci_section *s, int index)
 static uc_value_t *
 package_to_uval(uc_vm_t *vm, struct uci_package *p)
 {
-	uc_value_t *po = ucv_object_new(vm);
-	uc_value_t *so;
 	struct uci_element *e;
+	uc_value_t *po, *so;
+	size_t n = 0;
 	int i = 0;
 
+	uci_foreach_element(&p->sections, e)
+		n++;
+
+	po = ucv_object_new_length(vm, n);
+
 	if (!po)
 		return NULL;
 
@@ -585,7 +978,7 @@ package_to_uval(uc_vm_t *vm, struct uci_package *p)
 static uc_value_t *
 uc_uci_get_any(uc_vm_t *vm, size_t nargs, bool all)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *sect = uc_fn_arg(1);
 	uc_value_t *opt = uc_fn_arg(2);
@@ -607,7 +1000,10 @@ uc_uci_get_any(uc_vm_t *vm, size_t nargs, bool all)
 	ptr.section = sect ? ucv_string_get(sect) : NULL;
 	ptr.option = opt ? ucv_string_get(opt) : NULL;
 
-	rv = lookup_ptr(*c, &ptr, true);
+	rv = index_lookup(cursor_of(c), &ptr);
+
+	if (rv < 0)
+		rv = lookup_ptr(*c, &ptr, true);
 
 	if (rv != UCI_OK)
 		err_return(rv);
@@ -778,59 +1174,44 @@ uc_uci_get_all(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_get_first(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *type = uc_fn_arg(1);
 	uc_value_t *opt = uc_fn_arg(2);
-	struct uci_package *p = NULL;
-	struct uci_section *sc;
-	struct uci_element *e;
-	struct uci_ptr ptr = { 0 };
-	int rv;
+	uci_index_section_t *se;
+	uci_index_type_t *te;
+	struct uci_option *o;
+	uci_index_t *idx;
+
+	if (!c || !*c)
+		err_return(UCI_ERR_INVAL);
 
 	if (ucv_type(conf) != UC_STRING ||
 	    ucv_type(type) != UC_STRING ||
 	    (opt && ucv_type(opt) != UC_STRING))
 		err_return(UCI_ERR_INVAL);
 
-	uci_foreach_element(&(*c)->root, e) {
-		if (strcmp(e->name, ucv_string_get(conf)))
-			continue;
+	idx = index_get(cursor_of(c), ucv_string_get(conf), true);
 
-		p = uci_to_package(e);
-		break;
-	}
-
-	if (!p && uci_load(*c, ucv_string_get(conf), &p))
+	if (!idx)
 		err_return((*c)->err);
 
-	uci_foreach_element(&p->sections, e) {
-		sc = uci_to_section(e);
-
-		if (strcmp(sc->type, ucv_string_get(type)))
-			continue;
-
-		if (!opt)
-			ok_return(ucv_string_new(sc->e.name));
+	te = index_hash_get(&idx->typemap, ucv_string_get(type));
 
-		ptr.package = ucv_string_get(conf);
-		ptr.section = sc->e.name;
-		ptr.option = ucv_string_get(opt);
-		ptr.p = p;
-		ptr.s = sc;
+	if (!te || !te->sections.count)
+		err_return(UCI_ERR_NOTFOUND);
 
-		rv = lookup_ptr(*c, &ptr, false);
+	se = te->sections.entries[0];
 
-		if (rv != UCI_OK)
-			err_return(rv);
+	if (!opt)
+		ok_return(ucv_string_new(se->s->e.name));
 
-		if (!(ptr.flags & UCI_LOOKUP_COMPLETE))
-			err_return(UCI_ERR_NOTFOUND);
+	o = index_option(se, ucv_string_get(opt));
 
-		ok_return(option_to_uval(vm, ptr.o));
-	}
+	if (!o)
+		err_return(UCI_ERR_NOTFOUND);
 
-	err_return(UCI_ERR_NOTFOUND);
+	ok_return(option_to_uval(vm, o));
 }
 
 /**
@@ -879,7 +1260,7 @@ uc_uci_get_first(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_add(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *type = uc_fn_arg(1);
 	struct uci_element *e = NULL;
@@ -901,6 +1282,8 @@ uc_uci_add(uc_vm_t *vm, size_t nargs)
 	if (!p)
 		err_return(UCI_ERR_NOTFOUND);
 
+	index_invalidate(c, p->e.name, NULL);
+
 	rv = uci_add_section(*c, p, ucv_string_get(type), &sc);
 
 	if (rv != UCI_OK)
@@ -1013,7 +1396,7 @@ uval_to_uci(uc_vm_t *vm, uc_value_t *val, const char **p, bool *is_list)
 static uc_value_t *
 uc_uci_set(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *sect = uc_fn_arg(1);
 	uc_value_t *opt = NULL, *val = NULL;
@@ -1065,6 +1448,8 @@ uc_uci_set(uc_vm_t *vm, size_t nargs)
 	if (!uval_to_uci(vm, val, &ptr.value, &is_list))
 		err_return(UCI_ERR_INVAL);
 
+	index_invalidate(c, ptr.package, ptr.option ? ptr.s : NULL);
+
 	if (is_list) {
 		/* if we got a one-element array, delete existing option (if any)
 		 * and iterate array at offset 0 */
@@ -1162,7 +1547,7 @@ uc_uci_set(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_delete(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *sect = uc_fn_arg(1);
 	uc_value_t *opt = uc_fn_arg(2);
@@ -1186,6 +1571,8 @@ uc_uci_delete(uc_vm_t *vm, size_t nargs)
 	if (opt ? !ptr.o : !ptr.s)
 		err_return(UCI_ERR_NOTFOUND);
 
+	index_invalidate(c, ptr.package, opt ? ptr.s : NULL);
+
 	rv = uci_delete(*c, &ptr);
 
 	if (rv != UCI_OK)
@@ -1198,7 +1585,7 @@ static uc_value_t *
 uc_uci_list_modify(uc_vm_t *vm, size_t nargs,
                    int (*op)(struct uci_context *, struct uci_ptr *))
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *sect = uc_fn_arg(1);
 	uc_value_t *opt = uc_fn_arg(2);
@@ -1224,6 +1611,8 @@ uc_uci_list_modify(uc_vm_t *vm, size_t nargs,
 	if (!ptr.s)
 		err_return(UCI_ERR_NOTFOUND);
 
+	index_invalidate(c, ptr.package, ptr.s);
+
 	if (uval_to_uci(vm, val, &ptr.value, &is_list) && !is_list)
 		rv = op(*c, &ptr);
 	else
@@ -1383,7 +1772,7 @@ uc_uci_list_remove(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_rename(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *sect = uc_fn_arg(1);
 	uc_value_t *opt = NULL, *val = NULL;
@@ -1432,6 +1821,8 @@ uc_uci_rename(uc_vm_t *vm, size_t nargs)
 	if (!ptr.s && ptr.option)
 		err_return(UCI_ERR_NOTFOUND);
 
+	index_invalidate(c, ptr.package, ptr.option ? ptr.s : NULL);
+
 	rv = uci_rename(*c, &ptr);
 
 	if (rv != UCI_OK)
@@ -1508,7 +1899,7 @@ uc_uci_rename(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_reorder(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *sect = uc_fn_arg(1);
 	uc_value_t *val = uc_fn_arg(2);
@@ -1537,6 +1928,8 @@ uc_uci_reorder(uc_vm_t *vm, size_t nargs)
 	if (!ptr.s)
 		err_return(UCI_ERR_NOTFOUND);
 
+	index_invalidate(c, ptr.package, NULL);
+
 	rv = uci_reorder_section(*c, ptr.s, n);
 
 	if (rv != UCI_OK)
@@ -1571,7 +1964,7 @@ uc_uci_pkg_command_single(struct uci_context *ctx, enum pkg_cmd cmd,
 static uc_value_t *
 uc_uci_pkg_command(uc_vm_t *vm, size_t nargs, enum pkg_cmd cmd)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	struct uci_package *p;
 	char **configs = NULL;
@@ -1585,12 +1978,19 @@ uc_uci_pkg_command(uc_vm_t *vm, size_t nargs, enum pkg_cmd cmd)
 		if (!(p = uci_lookup_package(*c, ucv_string_get(conf))))
 			err_return(UCI_ERR_NOTFOUND);
 
+		/* commit and revert reload the package */
+		if (cmd != CMD_SAVE)
+			index_invalidate(c, ucv_string_get(conf), NULL);
+
 		res = uc_uci_pkg_command_single(*c, cmd, p);
 	}
 	else {
 		if (uci_list_configs(*c, &configs))
 			err_return((*c)->err);
 
+		if (cmd != CMD_SAVE)
+			index_invalidate(c, NULL, NULL);
+
 		if (!configs || !configs[0]) {
 			free(configs);
 			err_return(UCI_ERR_NOTFOUND);
@@ -1865,7 +2265,7 @@ changes_to_uval(uc_vm_t *vm, struct uci_context *ctx, const char *package,
 static uc_value_t *
 uc_uci_changes(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *res, *chg;
 	char **configs;
@@ -1941,7 +2341,7 @@ uc_uci_changes(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_foreach(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *conf = uc_fn_arg(0);
 	uc_value_t *type = uc_fn_arg(1);
 	uc_value_t *func = uc_fn_arg(2);
@@ -2021,7 +2421,7 @@ uc_uci_foreach(uc_vm_t *vm, size_t nargs)
 static uc_value_t *
 uc_uci_configs(uc_vm_t *vm, size_t nargs)
 {
-	struct uci_context **c = uc_fn_this("uci.cursor");
+	struct uci_context **c = uc_fn_thisval("uci.cursor");
 	uc_value_t *a;
 	char **configs;
 	int i, rv;
@@ -2071,7 +2471,17 @@ static const uc_function_list_t global_fns[] = {
 
 
 static void close_uci(void *ud) {
-	uci_free_context((struct uci_context *)ud);
+	uc_uci_cursor_t *cur = ud;
+	uci_index_t *idx;
+
+	while ((idx = cur->indexes) != NULL) {
+		cur->indexes = idx->next;
+		index_clear(idx);
+		free(idx->name);
+		free(idx);
+	}
+
+	uci_free_context(cur->ctx);
 }
 
 void uc_module_init(uc_vm_t *vm, uc_value_t *scope)
@@ -119,9 +119,15 @@ uc_uloop_cb_free(uc_uloop_cb_t *cb)
 static bool
 uc_uloop_vm_call(uc_vm_t *vm, bool mcall, size_t nargs)
 {
+	uint64_t start = uc_vm_clock_ns();
+	uc_exception_type_t ex;
 	uc_value_t *exh, *val;
 
-	if (uc_vm_call(vm, mcall, nargs) == EXCEPTION_NONE)
+	ex = uc_vm_call(vm, mcall, nargs);
+
+	uc_vm_histogram_observe(&vm->stats.callbacks, uc_vm_clock_ns() - start);
+
+	if (ex == EXCEPTION_NONE)
 		return true;
 
 	exh = uc_vm_registry_get(vm, "uloop.ex_handler");
@@ -23,9 +23,13 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <zlib.h>
 
 #include "ucode/module.h"
@@ -43,16 +47,38 @@
 
 static uc_resource_type_t *zstrmd_type, *zstrmi_type;
 
+/*
+ * Error state of the last operation, either a positive errno value in
+ * last_error or a zlib status code in last_zerror, never both.
+ */
 static int last_error = 0;
-#define err_return(err) do { last_error = err; return NULL; } while(0)
+static int last_zerror = Z_OK;
+
+#define err_set(err) do { last_error = err; last_zerror = Z_OK; } while(0)
+#define zerr_set(ret) do { last_zerror = ret; last_error = 0; } while(0)
+#define err_return(err) do { err_set(err); return NULL; } while(0)
+
+/*
+ * IOCHUNK is the buffer size used when pumping data natively between file
+ * handles and a zlib stream, see zio_pump().
+ */
+#define IOCHUNK (4 * CHUNK)
 
 typedef struct {
 	z_stream strm;
 	uc_stringbuf_t *outbuf;
+	unsigned char *iobuf;	// reusable pump buffers, 2 * IOCHUNK
 	int flush;
 } zstrm_t;
 
-/* zlib init error message */
+typedef struct {
+	FILE *fp;
+	int fd;
+	bool owned;
+	bool output;
+} zio_t;
+
+/* zlib status code error message */
 static const char * ziniterr(int ret)
 {
 	const char * msg;
@@ -70,6 +96,15 @@ static const char * ziniterr(int ret)
 	case Z_VERSION_ERROR:
 		msg = "zlib version mismatch!";
 		break;
+	case Z_DATA_ERROR:
+		msg = "invalid or corrupted input data";
+		break;
+	case Z_BUF_ERROR:
+		msg = "unexpected end of input data";
+		break;
+	case Z_NEED_DICT:
+		msg = "preset dictionary required";
+		break;
 	default:
 		msg = "unknown error";
 		break;
@@ -156,20 +191,277 @@ fail:
 }
 
 static bool
-uc_zlib_def_string(uc_vm_t * const vm, uc_value_t * const str, zstrm_t * const zstrm)
+uc_zlib_def_string(uc_vm_t * const vm, uc_value_t *str, zstrm_t * const zstrm)
 {
-	zstrm->strm.next_in = (unsigned char *)ucv_string_get(str);
-	zstrm->strm.avail_in = ucv_string_length(str);
+	size_t len;
+
+	/* strings or byte buffers */
+	zstrm->strm.next_in = (unsigned char *)ucv_bytes_get(str, &len);
+	zstrm->strm.avail_in = len;
 
-	last_error = def_chunks(zstrm);
+	zerr_set(def_chunks(zstrm));
 
 	return true;
 }
 
+/*
+ * Parallel deflate: the input is split into PAR_BLOCK sized blocks which are
+ * compressed independently as raw deflate data on a set of threads, each block
+ * primed with the preceding PAR_DICT bytes of input as dictionary. Every block
+ * but the last one ends with a sync flush, so the compressed blocks can simply
+ * be concatenated and wrapped into a gzip or zlib header and trailer. The
+ * block checksums are merged using crc32_combine() or adler32_combine().
+ */
+#define PAR_BLOCK (128 * 1024)
+#define PAR_DICT 32768
+#define PAR_MAX_THREADS 64
+
+typedef struct {
+	const unsigned char *in;
+	size_t len;
+	size_t dictlen;
+	bool last;
+	unsigned char *out;
+	size_t outlen;
+	uLong check;
+	int ret;
+} pdef_block_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	pdef_block_t *blocks;
+	size_t nblocks;
+	size_t next;
+	int level;
+	bool gzip;
+} pdef_job_t;
+
+static int
+pdef_block(pdef_block_t *b, int level, bool gzip)
+{
+	int ret, flush = b->last ? Z_FINISH : Z_SYNC_FLUSH;
+	z_stream strm = {
+		.zalloc = Z_NULL,
+		.zfree = Z_NULL,
+		.opaque = Z_NULL,
+	};
+	size_t size;
+	void *tmp;
+
+	ret = deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+
+	if (ret != Z_OK)
+		return ret;
+
+	if (b->dictlen) {
+		ret = deflateSetDictionary(&strm, b->in - b->dictlen, b->dictlen);
+
+		if (ret != Z_OK)
+			goto out;
+	}
+
+	size = deflateBound(&strm, b->len) + 16;
+	b->out = malloc(size);
+
+	if (!b->out) {
+		ret = Z_MEM_ERROR;
+		goto out;
+	}
+
+	strm.next_in = (unsigned char *)b->in;
+	strm.avail_in = b->len;
+	strm.next_out = b->out;
+	strm.avail_out = size;
+
+	while (true) {
+		ret = deflate(&strm, flush);
+
+		if (ret == Z_STREAM_ERROR)
+			goto out;
+
+		if (flush == Z_FINISH ? (ret == Z_STREAM_END)
+		                      : (strm.avail_in == 0 && strm.avail_out > 0))
+			break;
+
+		if (strm.avail_out > 0) {
+			ret = Z_BUF_ERROR;
+			goto out;
+		}
+
+		/* should not happen given deflateBound(), but be safe */
+		tmp = realloc(b->out, size * 2);
+
+		if (!tmp) {
+			ret = Z_MEM_ERROR;
+			goto out;
+		}
+
+		b->out = tmp;
+		strm.next_out = b->out + size;
+		strm.avail_out = size;
+		size *= 2;
+	}
+
+	b->outlen = size - strm.avail_out;
+	b->check = gzip ? crc32(0L, b->in, b->len) : adler32(1L, b->in, b->len);
+	ret = Z_OK;
+
+out:
+	(void)deflateEnd(&strm);
+
+	return ret;
+}
+
+static void *
+pdef_worker(void *arg)
+{
+	pdef_job_t *job = arg;
+	size_t i;
+
+	while (true) {
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (i >= job->nblocks)
+			break;
+
+		job->blocks[i].ret = pdef_block(&job->blocks[i], job->level, job->gzip);
+	}
+
+	return NULL;
+}
+
+static void
+pdef_put_be32(uc_stringbuf_t *buf, uint32_t v)
+{
+	unsigned char b[4] = { v >> 24, v >> 16, v >> 8, v };
+
+	printbuf_memappend_fast(buf, (char *)b, 4);
+}
+
+static void
+pdef_put_le32(uc_stringbuf_t *buf, uint32_t v)
+{
+	unsigned char b[4] = { v, v >> 8, v >> 16, v >> 24 };
+
+	printbuf_memappend_fast(buf, (char *)b, 4);
+}
+
+static uc_value_t *
+uc_zlib_deflate_parallel(uc_vm_t *vm, const char *data, size_t len,
+                         bool gzip, int level, size_t nthreads)
+{
+	pthread_t tids[PAR_MAX_THREADS];
+	uc_stringbuf_t *outbuf = NULL;
+	uc_value_t *rv = NULL;
+	size_t i, nspawned;
+	pdef_job_t job = {
+		.nblocks = (len + PAR_BLOCK - 1) / PAR_BLOCK,
+		.level = level,
+		.gzip = gzip,
+	};
+	uLong check;
+	int ret;
+
+	job.blocks = calloc(job.nblocks, sizeof(*job.blocks));
+
+	if (!job.blocks) {
+		uc_vm_raise_exception(vm, EXCEPTION_RUNTIME, "Zlib error: %s", ziniterr(Z_MEM_ERROR));
+
+		return NULL;
+	}
+
+	for (i = 0; i < job.nblocks; i++) {
+		job.blocks[i].in = (const unsigned char *)data + i * PAR_BLOCK;
+		job.blocks[i].len = (i + 1 < job.nblocks) ? PAR_BLOCK : len - i * PAR_BLOCK;
+		job.blocks[i].dictlen = i ? PAR_DICT : 0;
+		job.blocks[i].last = (i + 1 == job.nblocks);
+	}
+
+	if (nthreads > job.nblocks)
+		nthreads = job.nblocks;
+
+	pthread_mutex_init(&job.lock, NULL);
+
+	/* the calling thread is one of the workers */
+	for (nspawned = 0; nspawned + 1 < nthreads; nspawned++)
+		if (pthread_create(&tids[nspawned], NULL, pdef_worker, &job) != 0)
+			break;
+
+	pdef_worker(&job);
+
+	for (i = 0; i < nspawned; i++)
+		pthread_join(tids[i], NULL);
+
+	pthread_mutex_destroy(&job.lock);
+
+	for (i = 0; i < job.nblocks; i++) {
+		if (job.blocks[i].ret != Z_OK) {
+			ret = job.blocks[i].ret;
+			uc_vm_raise_exception(vm, EXCEPTION_RUNTIME, "Zlib error: %s",
+				(ret == Z_BUF_ERROR) ? "buffer error" : ziniterr(ret));
+			goto out;
+		}
+	}
+
+	outbuf = ucv_stringbuf_new();
+
+	if (gzip) {
+		/* magic, deflate, no flags, no mtime, xfl, unix */
+		unsigned char hdr[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0,
+			(level == Z_BEST_COMPRESSION) ? 2 : (level == Z_BEST_SPEED) ? 4 : 0, 3 };
+
+		printbuf_memappend_fast(outbuf, (char *)hdr, sizeof(hdr));
+		check = crc32(0L, Z_NULL, 0);
+	}
+	else {
+		/* 32K window deflate, level hint, header check */
+		unsigned char hdr[2] = { 0x78,
+			(level >= 0 && level <= 1) ? 0 : (level >= 2 && level <= 5) ? 1 :
+			(level == 6 || level == Z_DEFAULT_COMPRESSION) ? 2 : 3 };
+
+		hdr[1] <<= 6;
+		hdr[1] += 31 - ((hdr[0] << 8) + hdr[1]) % 31;
+
+		printbuf_memappend_fast(outbuf, (char *)hdr, sizeof(hdr));
+		check = adler32(0L, Z_NULL, 0);
+	}
+
+	for (i = 0; i < job.nblocks; i++) {
+		pdef_block_t *b = &job.blocks[i];
+
+		printbuf_memappend_fast(outbuf, (char *)b->out, (int)b->outlen);
+
+		check = gzip ? crc32_combine(check, b->check, b->len)
+		             : adler32_combine(check, b->check, b->len);
+	}
+
+	if (gzip) {
+		pdef_put_le32(outbuf, check);
+		pdef_put_le32(outbuf, len & 0xffffffff);
+	}
+	else {
+		pdef_put_be32(outbuf, check);
+	}
+
+	zerr_set(Z_STREAM_END);
+	rv = ucv_stringbuf_finish(outbuf);
+
+out:
+	for (i = 0; i < job.nblocks; i++)
+		free(job.blocks[i].out);
+
+	free(job.blocks);
+
+	return rv;
+}
+
 /**
  * Compresses data in Zlib or gzip format.
  *
- * If the input argument is a plain string, it is directly compressed.
+ * If the input argument is a plain string or a byte buffer, such as a
+ * `struct.buffer()` instance or one of its views, it is directly compressed.
  *
  * If an array, object or resource value is given, this function will attempt to
  * invoke a `read()` method on it to read chunks of input text to incrementally
@@ -191,6 +483,12 @@ uc_zlib_def_string(uc_vm_t * const vm, uc_value_t * const str, zstrm_t * const z
  * @param {?number} [level=Z_DEFAULT_COMPRESSION]
  * The compression level (0-9).
  *
+ * @param {?number} [threads=1]
+ * Compress string or buffer input in parallel using up to this many threads.
+ * The input is split into 128KB blocks which are compressed independently and
+ * joined into a single standard stream, at the expense of a slightly larger
+ * output. Input read through a `read()` method is always compressed serially.
+ *
  * @returns {?string}
  *
  * @example
@@ -198,7 +496,10 @@ uc_zlib_def_string(uc_vm_t * const vm, uc_value_t * const str, zstrm_t * const z
  * const deflated = deflate(content);
  *
  * // deflate content using fastest compression
- * const deflated = deflate(content, Z_BEST_SPEED);
+ * const deflated = deflate(content, false, Z_BEST_SPEED);
+ *
+ * // create a gzip archive of a large buffer using four threads
+ * const gzipped = deflate(content, true, Z_DEFAULT_COMPRESSION, 4);
  */
 static uc_value_t *
 uc_zlib_deflate(uc_vm_t * const vm, const size_t nargs)
@@ -207,8 +508,12 @@ uc_zlib_deflate(uc_vm_t * const vm, const size_t nargs)
 	uc_value_t *src = uc_fn_arg(0);
 	uc_value_t *gzip = uc_fn_arg(1);
 	uc_value_t *level = uc_fn_arg(2);
+	uc_value_t *threads = uc_fn_arg(3);
 	int ret, lvl = Z_DEFAULT_COMPRESSION;
 	bool success, gz = false;
+	int64_t nthreads = 1;
+	const char *data;
+	size_t len;
 	zstrm_t zstrm = {
 		.strm = {
 			.zalloc = Z_NULL,
@@ -237,6 +542,29 @@ uc_zlib_deflate(uc_vm_t * const vm, const size_t nargs)
 		lvl = (int)ucv_int64_get(level);
 	}
 
+	if (threads) {
+		if (ucv_type(threads) != UC_INTEGER) {
+			uc_vm_raise_exception(vm, EXCEPTION_TYPE, "Passed thread count is not a number");
+			goto out;
+		}
+
+		nthreads = ucv_int64_get(threads);
+
+		if (nthreads > PAR_MAX_THREADS)
+			nthreads = PAR_MAX_THREADS;
+	}
+
+	data = ucv_bytes_get(src, &len);
+
+	if (nthreads > 1 && data && len > PAR_BLOCK) {
+		if (lvl < Z_DEFAULT_COMPRESSION || lvl > Z_BEST_COMPRESSION) {
+			uc_vm_raise_exception(vm, EXCEPTION_RUNTIME, "Zlib error: %s", ziniterr(Z_STREAM_ERROR));
+			goto out;
+		}
+
+		return uc_zlib_deflate_parallel(vm, data, len, gz, lvl, nthreads);
+	}
+
 	ret = deflateInit2(&zstrm.strm, lvl,
 			   Z_DEFLATED,		// only allowed method
 			   gz ? 15+16 : 15,	// 15 Zlib default, +16 for gzip
@@ -255,6 +583,12 @@ uc_zlib_deflate(uc_vm_t * const vm, const size_t nargs)
 		break;
 
 	case UC_RESOURCE:
+		if (ucv_bytes_get(src, &len)) {
+			success = uc_zlib_def_string(vm, src, &zstrm);
+			break;
+		}
+
+		/* fall through */
 	case UC_OBJECT:
 	case UC_ARRAY:
 		success = uc_zlib_def_object(vm, src, &zstrm);
@@ -372,16 +706,18 @@ fail:
 }
 
 static bool
-uc_zlib_inf_string(uc_vm_t * const vm, uc_value_t * const str, zstrm_t * const zstrm)
+uc_zlib_inf_string(uc_vm_t * const vm, uc_value_t *str, zstrm_t * const zstrm)
 {
+	size_t len;
 	int ret;
 
-	zstrm->strm.next_in = (unsigned char *)ucv_string_get(str);
-	zstrm->strm.avail_in = ucv_string_length(str);
+	/* strings or byte buffers */
+	zstrm->strm.next_in = (unsigned char *)ucv_bytes_get(str, &len);
+	zstrm->strm.avail_in = len;
 
 	ret = inf_chunks(zstrm);
 	assert(zstrm->strm.avail_in == 0);
-	last_error = ret;
+	zerr_set(ret);
 
 	return Z_STREAM_END == ret;
 }
@@ -389,7 +725,8 @@ uc_zlib_inf_string(uc_vm_t * const vm, uc_value_t * const str, zstrm_t * const z
 /**
  * Decompresses data in Zlib or gzip format.
  *
- * If the input argument is a plain string, it is directly decompressed.
+ * If the input argument is a plain string or a byte buffer, such as a
+ * `struct.buffer()` instance or one of its views, it is directly decompressed.
  *
  * If an array, object or resource value is given, this function will attempt to
  * invoke a `read()` method on it to read chunks of input text to incrementally
@@ -413,6 +750,7 @@ uc_zlib_inflate(uc_vm_t * const vm, const size_t nargs)
 	uc_value_t *rv = NULL;
 	uc_value_t *src = uc_fn_arg(0);
 	bool success;
+	size_t len;
 	int ret;
 	zstrm_t zstrm = {
 		.strm = {
@@ -441,6 +779,13 @@ uc_zlib_inflate(uc_vm_t * const vm, const size_t nargs)
 		break;
 
 	case UC_RESOURCE:
+		if (ucv_bytes_get(src, &len)) {
+			zstrm.flush = Z_FINISH;
+			success = uc_zlib_inf_string(vm, src, &zstrm);
+			break;
+		}
+
+		/* fall through */
 	case UC_OBJECT:
 	case UC_ARRAY:
 		zstrm.flush = Z_NO_FLUSH;
@@ -493,6 +838,45 @@ out:
  * zstrmd.error();
  */
 
+/*
+ * Allocator for stream resources, charging zlib's internal state such as
+ * the deflate window and hash chains to the memory accounting of the VM.
+ * The allocation size is kept in front of each block since zfree() does not
+ * pass it back.
+ */
+typedef union {
+	size_t size;
+	max_align_t align;
+} zmem_t;
+
+static voidpf
+zstrm_alloc(voidpf opaque, uInt items, uInt size)
+{
+	zmem_t *mem;
+
+	if (size && items > (SIZE_MAX - sizeof(*mem)) / size)
+		return Z_NULL;
+
+	mem = malloc(sizeof(*mem) + (size_t)items * size);
+
+	if (!mem)
+		return Z_NULL;
+
+	mem->size = sizeof(*mem) + (size_t)items * size;
+	uc_vm_memory_account(opaque, (ssize_t)mem->size);
+
+	return mem + 1;
+}
+
+static void
+zstrm_free(voidpf opaque, voidpf address)
+{
+	zmem_t *mem = (zmem_t *)address - 1;
+
+	uc_vm_memory_account(opaque, -(ssize_t)mem->size);
+	free(mem);
+}
+
 /**
  * Initializes a deflate stream.
  *
@@ -530,13 +914,13 @@ uc_zlib_deflater(uc_vm_t *vm, size_t nargs)
 	if (!zstrm)
 		err_return(ENOMEM);
 
-	zstrm->strm.zalloc = Z_NULL;
-	zstrm->strm.zfree = Z_NULL;
-	zstrm->strm.opaque = Z_NULL;
+	zstrm->strm.zalloc = zstrm_alloc;
+	zstrm->strm.zfree = zstrm_free;
+	zstrm->strm.opaque = vm;
 
 	if (gzip) {
 		if (ucv_type(gzip) != UC_BOOLEAN) {
-			last_error = EINVAL;
+			err_set(EINVAL);
 			goto fail;
 		}
 
@@ -545,7 +929,7 @@ uc_zlib_deflater(uc_vm_t *vm, size_t nargs)
 
 	if (level) {
 		if (ucv_type(level) != UC_INTEGER) {
-			last_error = EINVAL;
+			err_set(EINVAL);
 			goto fail;
 		}
 
@@ -558,7 +942,7 @@ uc_zlib_deflater(uc_vm_t *vm, size_t nargs)
 			   8,			// default value
 			   Z_DEFAULT_STRATEGY);	// default value
 	if (ret != Z_OK) {
-		last_error = ret;
+		zerr_set(ret);
 		goto fail;
 	}
 
@@ -587,8 +971,8 @@ fail:
  *
  * @function module:zlib.deflate#write
  *
- * @param {string} src
- * The string of data to deflate.
+ * @param {string|module:struct.buffer} src
+ * The string or byte buffer of data to deflate.
  *
  * @param {?number} [flush=Z_NO_FLUSH]
  * The zlib flush mode.
@@ -602,6 +986,7 @@ uc_zlib_defwrite(uc_vm_t *vm, size_t nargs)
 	uc_value_t *flush = uc_fn_arg(1);
 	zstrm_t **z = uc_fn_this("zlib.deflate");
 	zstrm_t *zstrm;
+	size_t len;
 
 	if (!z || !*z)
 		err_return(EBADF);
@@ -630,8 +1015,8 @@ uc_zlib_defwrite(uc_vm_t *vm, size_t nargs)
 	else
 		zstrm->flush = Z_NO_FLUSH;
 
-	/* we only accept strings */
-	if (!src || ucv_type(src) != UC_STRING)
+	/* we only accept strings and byte buffers */
+	if (!ucv_bytes_get(src, &len))
 		err_return(EINVAL);
 
 	if (!zstrm->outbuf)
@@ -725,16 +1110,16 @@ uc_zlib_inflater(uc_vm_t *vm, size_t nargs)
 	if (!zstrm)
 		err_return(ENOMEM);
 
-	zstrm->strm.zalloc = Z_NULL;
-	zstrm->strm.zfree = Z_NULL;
-	zstrm->strm.opaque = Z_NULL;
+	zstrm->strm.zalloc = zstrm_alloc;
+	zstrm->strm.zfree = zstrm_free;
+	zstrm->strm.opaque = vm;
 	zstrm->strm.avail_in = 0;
 	zstrm->strm.next_in = Z_NULL;
 
 	/* tell inflateInit2 to perform either zlib or gzip decompression: 15+32 */
 	ret = inflateInit2(&zstrm->strm, 15+32);
 	if (ret != Z_OK) {
-		last_error = ret;
+		zerr_set(ret);
 		goto fail;
 	}
 
@@ -762,8 +1147,8 @@ fail:
  *
  * @function module:zlib.inflate#write
  *
- * @param {string} src
- * The string of data to inflate.
+ * @param {string|module:struct.buffer} src
+ * The string or byte buffer of data to inflate.
  *
  * @param {?number} [flush=Z_NO_FLUSH]
  * The zlib flush mode.
@@ -777,6 +1162,7 @@ uc_zlib_infwrite(uc_vm_t *vm, size_t nargs)
 	uc_value_t *flush = uc_fn_arg(1);
 	zstrm_t **z = uc_fn_this("zlib.inflate");
 	zstrm_t *zstrm;
+	size_t len;
 
 	if (!z || !*z)
 		err_return(EBADF);
@@ -803,8 +1189,8 @@ uc_zlib_infwrite(uc_vm_t *vm, size_t nargs)
 	else
 		zstrm->flush = Z_NO_FLUSH;
 
-	/* we only accept strings */
-	if (!src || ucv_type(src) != UC_STRING)
+	/* we only accept strings and byte buffers */
+	if (!ucv_bytes_get(src, &len))
 		err_return(EINVAL);
 
 	if (!zstrm->outbuf)
@@ -850,6 +1236,17 @@ uc_zlib_infread(uc_vm_t *vm, size_t nargs)
 	return rv;
 }
 
+/**
+ * Queries error information for the module functions.
+ *
+ * Returns a string containing a description of the last occurred error or
+ * `null` if there is no error information.
+ *
+ * @function module:zlib#error
+ *
+ * @returns {?string}
+ */
+
 /**
  * Queries error information.
  *
@@ -866,24 +1263,652 @@ uc_zlib_error(uc_vm_t *vm, size_t nargs)
 {
 	uc_value_t *errmsg;
 
-	if (!last_error)
-		return NULL;
+	// Z_OK and Z_STREAM_END are no errors
+	if (last_zerror != Z_OK && last_zerror != Z_STREAM_END)
+		errmsg = ucv_string_new(ziniterr(last_zerror));
+	else if (last_error)
+		errmsg = ucv_string_new(strerror(last_error));
+	else
+		errmsg = NULL;
 
-	// negative last_error only happens for zlib init returns
-	errmsg = ucv_string_new(last_error < 0 ? ziniterr(last_error) : strerror(last_error));
-	last_error = 0;
+	err_set(0);
 	return errmsg;
 }
 
+/*
+ * Native pumping between handles: the source and destination may be given as
+ * a path string, an `fs.file` or `fs.proc` handle, a `socket` handle or any
+ * value providing a `fileno()` method. Stdio handles are accessed through
+ * their FILE pointer to remain coherent with buffered script-level I/O.
+ */
+static bool
+zio_open(uc_vm_t *vm, uc_value_t *val, const char *mode, zio_t *zio)
+{
+	uc_value_t *fn;
+	FILE **fp;
+	int *fdp;
+	int64_t n;
+
+	zio->fp = NULL;
+	zio->fd = -1;
+	zio->owned = false;
+	zio->output = (*mode == 'w');
+
+	if (ucv_type(val) == UC_STRING) {
+		zio->fp = fopen(ucv_string_get(val), mode);
+
+		if (!zio->fp) {
+			err_set(errno);
+
+			return false;
+		}
+
+		zio->owned = true;
+
+		return true;
+	}
+
+	fp = (FILE **)ucv_resource_dataptr(val, "fs.file");
+
+	if (!fp)
+		fp = (FILE **)ucv_resource_dataptr(val, "fs.proc");
+
+	if (fp) {
+		if (!*fp) {
+			err_set(EBADF);
+
+			return false;
+		}
+
+		zio->fp = *fp;
+
+		return true;
+	}
+
+	fdp = (int *)ucv_resource_dataptr(val, "socket");
+
+	if (fdp) {
+		zio->fd = *fdp;
+	}
+	else {
+		fn = ucv_property_get(val, "fileno");
+
+		if (!ucv_is_callable(fn)) {
+			err_set(EINVAL);
+
+			return false;
+		}
+
+		uc_vm_stack_push(vm, ucv_get(val));
+		uc_vm_stack_push(vm, ucv_get(fn));
+
+		if (uc_vm_call(vm, true, 0) != EXCEPTION_NONE)
+			return false;
+
+		val = uc_vm_stack_pop(vm);
+		n = ucv_int64_get(val);
+		ucv_put(val);
+
+		zio->fd = (n >= 0 && n <= INT_MAX) ? (int)n : -1;
+	}
+
+	if (zio->fd < 0) {
+		err_set(EBADF);
+
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+zio_close(zio_t *zio)
+{
+	bool rv = true;
+
+	if (zio->fp) {
+		if (zio->owned)
+			rv = (fclose(zio->fp) == 0);
+		else if (zio->output)
+			rv = (fflush(zio->fp) == 0);
+	}
+
+	if (!rv)
+		err_set(errno);
+
+	zio->fp = NULL;
+	zio->fd = -1;
+
+	return rv;
+}
+
+static ssize_t
+zio_read(zio_t *zio, unsigned char *buf, size_t len)
+{
+	ssize_t n;
+
+	if (zio->fp) {
+		n = fread(buf, 1, len, zio->fp);
+
+		if (n == 0 && ferror(zio->fp))
+			return -1;
+
+		return n;
+	}
+
+	do {
+		n = read(zio->fd, buf, len);
+	} while (n < 0 && errno == EINTR);
+
+	return n;
+}
+
+static bool
+zio_write(zio_t *zio, const unsigned char *buf, size_t len)
+{
+	ssize_t n;
+
+	if (zio->fp)
+		return (fwrite(buf, 1, len, zio->fp) == len);
+
+	while (len > 0) {
+		n = write(zio->fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		buf += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+static bool
+zio_progress(uc_vm_t *vm, uc_value_t *progress, uint64_t nin, uint64_t nout)
+{
+	uc_value_t *rv;
+	bool abort;
+
+	if (!progress)
+		return true;
+
+	uc_vm_stack_push(vm, ucv_get(progress));
+	uc_vm_stack_push(vm, ucv_uint64_new(nin));
+	uc_vm_stack_push(vm, ucv_uint64_new(nout));
+
+	if (uc_vm_call(vm, false, 2) != EXCEPTION_NONE)
+		return false;
+
+	rv = uc_vm_stack_pop(vm);
+	abort = (ucv_type(rv) == UC_BOOLEAN && !ucv_boolean_get(rv));
+	ucv_put(rv);
+
+	if (abort) {
+		err_set(ECANCELED);
+
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Read src until EOF and write the deflated or inflated result to dst, using
+ * the stream's reusable I/O buffers. When deflating, `flush` is applied once
+ * all input was consumed. When inflating, input following the end of a stream
+ * is decoded as another member of a concatenated stream, as in multi-member
+ * gzip files, and the input must end with a complete stream.
+ * Returns false with the error state set, or an exception raised by the
+ * progress callback, on failure.
+ */
+static bool
+zio_pump(uc_vm_t *vm, zstrm_t *zstrm, bool def, zio_t *src, zio_t *dst,
+         int flush, uc_value_t *progress, uint64_t *nin, uint64_t *nout)
+{
+	unsigned char *inbuf, *outbuf;
+	bool eof = false;
+	int ret = Z_OK;
+	size_t have;
+	ssize_t n;
+
+	if (!zstrm->iobuf) {
+		zstrm->iobuf = malloc(2 * IOCHUNK);
+
+		if (!zstrm->iobuf) {
+			err_set(ENOMEM);
+
+			return false;
+		}
+	}
+
+	inbuf = zstrm->iobuf;
+	outbuf = zstrm->iobuf + IOCHUNK;
+
+	/* emit data buffered by previous write() calls first */
+	if (zstrm->outbuf && printbuf_length(zstrm->outbuf) > 0) {
+		if (!zio_write(dst, (unsigned char *)zstrm->outbuf->buf, printbuf_length(zstrm->outbuf))) {
+			err_set(errno);
+
+			return false;
+		}
+
+		*nout += printbuf_length(zstrm->outbuf);
+		printbuf_reset(zstrm->outbuf);
+	}
+
+	while (!eof) {
+		n = zio_read(src, inbuf, IOCHUNK);
+
+		if (n < 0) {
+			err_set(errno);
+
+			return false;
+		}
+
+		eof = (n == 0);
+		*nin += n;
+
+		zstrm->strm.next_in = inbuf;
+		zstrm->strm.avail_in = n;
+
+		do {
+			zstrm->strm.next_out = outbuf;
+			zstrm->strm.avail_out = IOCHUNK;
+
+			if (def) {
+				ret = deflate(&zstrm->strm, eof ? flush : Z_NO_FLUSH);
+			}
+			else {
+				/* more input after a stream end starts the next member */
+				if (ret == Z_STREAM_END && zstrm->strm.avail_in > 0)
+					inflateReset(&zstrm->strm);
+
+				ret = inflate(&zstrm->strm, Z_NO_FLUSH);
+
+				switch (ret) {
+				case Z_NEED_DICT:
+				case Z_DATA_ERROR:
+					zerr_set(Z_DATA_ERROR);
+
+					return false;
+
+				case Z_MEM_ERROR:
+					err_set(ENOMEM);
+
+					return false;
+				}
+			}
+
+			if (ret == Z_STREAM_ERROR) {
+				err_set(EINVAL);
+
+				return false;
+			}
+
+			have = IOCHUNK - zstrm->strm.avail_out;
+
+			if (have && !zio_write(dst, outbuf, have)) {
+				err_set(errno);
+
+				return false;
+			}
+
+			*nout += have;
+		} while (zstrm->strm.avail_out == 0 ||
+		         (ret == Z_STREAM_END && zstrm->strm.avail_in > 0));
+
+		if (eof) {
+			/* truncated input, the last inflated stream did not end */
+			if (!def && ret != Z_STREAM_END) {
+				zerr_set(Z_BUF_ERROR);
+
+				return false;
+			}
+
+			/* a finishing deflate always ends with Z_STREAM_END */
+			if (ret == Z_STREAM_END)
+				zstrm->flush = Z_FINISH;
+		}
+
+		if (!zio_progress(vm, progress, *nin, *nout))
+			return false;
+	}
+
+	return true;
+}
+
+static uc_value_t *
+uc_zlib_pump_common(uc_vm_t *vm, size_t nargs, bool def)
+{
+	uc_value_t *src = uc_fn_arg(0);
+	uc_value_t *dst = uc_fn_arg(1);
+	uc_value_t *arg = uc_fn_arg(2);
+	uc_value_t *progress = NULL;
+	zstrm_t **z = uc_fn_this(def ? "zlib.deflate" : "zlib.inflate");
+	uint64_t nin = 0, nout = 0;
+	int flush = Z_NO_FLUSH;
+	zio_t in, out;
+	bool success;
+
+	if (!z || !*z)
+		err_return(EBADF);
+
+	if (Z_FINISH == (*z)->flush)
+		err_return(EPIPE);	// can't reuse a finished stream
+
+	/* deflate streams accept a flush mode before the progress callback */
+	if (def && ucv_type(arg) == UC_INTEGER) {
+		flush = (int)ucv_int64_get(arg);
+		arg = uc_fn_arg(3);
+
+		switch (flush) {
+		case Z_NO_FLUSH:
+		case Z_SYNC_FLUSH:
+		case Z_PARTIAL_FLUSH:
+		case Z_FULL_FLUSH:
+		case Z_FINISH:
+			break;
+		default:
+			err_return(EINVAL);
+		}
+	}
+
+	if (arg) {
+		if (!ucv_is_callable(arg))
+			err_return(EINVAL);
+
+		progress = arg;
+	}
+
+	if (!zio_open(vm, src, "r", &in))
+		return NULL;
+
+	if (!zio_open(vm, dst, "w", &out)) {
+		zio_close(&in);
+
+		return NULL;
+	}
+
+	success = zio_pump(vm, *z, def, &in, &out, flush, progress, &nin, &nout);
+
+	zio_close(&in);
+	success = zio_close(&out) && success;
+
+	if (!success)
+		return NULL;
+
+	return ucv_uint64_new(nout);
+}
+
+/**
+ * Compresses all data from a source handle into a destination handle.
+ *
+ * Reads `src` until end of file and writes the compressed data to `dst`,
+ * without passing any intermediate chunk through the script. Both `src` and
+ * `dst` may be file paths, `fs.file` or `fs.proc` handles, sockets or any
+ * value implementing a `fileno()` method. Compressed data previously buffered
+ * by {@link module:zlib.deflate#write} is emitted to `dst` first.
+ *
+ * Once all input is consumed, the given `flush` mode is applied. Passing
+ * `Z_FINISH` completes the stream, after which no more data can be written.
+ *
+ * If a `progress` function is given, it is invoked after each processed chunk
+ * with the total number of bytes read and written so far. Returning `false`
+ * from it aborts the operation.
+ *
+ * Returns the number of bytes written to `dst`.
+ *
+ * Returns `null` if an error occurred.
+ *
+ * @function module:zlib.deflate#pump
+ *
+ * @param {string|module:fs.file|module:socket.socket} src
+ * The input handle or path.
+ *
+ * @param {string|module:fs.file|module:socket.socket} dst
+ * The output handle or path.
+ *
+ * @param {?number} [flush=Z_NO_FLUSH]
+ * The zlib flush mode applied at the end of input.
+ *
+ * @param {?function} [progress]
+ * Progress callback, invoked as `progress(bytes_in, bytes_out)`.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * // concatenate two files into one gzip stream sent over a socket
+ * const zstrmd = deflater(true);
+ * zstrmd.pump('/tmp/a.txt', sock);
+ * zstrmd.pump('/tmp/b.txt', sock, Z_FINISH);
+ */
+static uc_value_t *
+uc_zlib_defpump(uc_vm_t *vm, size_t nargs)
+{
+	return uc_zlib_pump_common(vm, nargs, true);
+}
+
+/**
+ * Decompresses data from a source handle into a destination handle.
+ *
+ * Reads compressed data from `src` until end of file and writes the
+ * decompressed result to `dst`, without passing any intermediate chunk
+ * through the script. Concatenated streams, such as multi-member gzip files,
+ * are decompressed one after another. Both `src` and `dst` may be file
+ * paths, `fs.file` or `fs.proc` handles, sockets or any value implementing
+ * a `fileno()` method. Decompressed data previously buffered by
+ * {@link module:zlib.inflate#write} is emitted to `dst` first.
+ *
+ * If a `progress` function is given, it is invoked after each processed chunk
+ * with the total number of bytes read and written so far. Returning `false`
+ * from it aborts the operation.
+ *
+ * Returns the number of bytes written to `dst`.
+ *
+ * Returns `null` if an error occurred, including truncated input or trailing
+ * data which is not a valid stream.
+ *
+ * @function module:zlib.inflate#pump
+ *
+ * @param {string|module:fs.file|module:socket.socket} src
+ * The input handle or path.
+ *
+ * @param {string|module:fs.file|module:socket.socket} dst
+ * The output handle or path.
+ *
+ * @param {?function} [progress]
+ * Progress callback, invoked as `progress(bytes_in, bytes_out)`.
+ *
+ * @returns {?number}
+ */
+static uc_value_t *
+uc_zlib_infpump(uc_vm_t *vm, size_t nargs)
+{
+	return uc_zlib_pump_common(vm, nargs, false);
+}
+
+static uc_value_t *
+uc_zlib_file_common(uc_vm_t *vm, size_t nargs, bool def)
+{
+	uc_value_t *src = uc_fn_arg(0);
+	uc_value_t *dst = uc_fn_arg(1);
+	uc_value_t *opts = uc_fn_arg(2);
+	uc_value_t *gzip, *level, *progress;
+	uint64_t nin = 0, nout = 0;
+	int ret, lvl = Z_DEFAULT_COMPRESSION;
+	zstrm_t zstrm = { 0 };
+	bool success, gz = false;
+	zio_t in, out;
+
+	if (opts && ucv_type(opts) != UC_OBJECT)
+		err_return(EINVAL);
+
+	gzip = ucv_object_get(opts, "gzip", NULL);
+	level = ucv_object_get(opts, "level", NULL);
+	progress = ucv_object_get(opts, "progress", NULL);
+
+	if (gzip) {
+		if (ucv_type(gzip) != UC_BOOLEAN)
+			err_return(EINVAL);
+
+		gz = ucv_boolean_get(gzip);
+	}
+
+	if (level) {
+		if (ucv_type(level) != UC_INTEGER)
+			err_return(EINVAL);
+
+		lvl = (int)ucv_int64_get(level);
+	}
+
+	if (progress && !ucv_is_callable(progress))
+		err_return(EINVAL);
+
+	if (def)
+		ret = deflateInit2(&zstrm.strm, lvl, Z_DEFLATED, gz ? 15+16 : 15,
+		                   8, Z_DEFAULT_STRATEGY);
+	else
+		ret = inflateInit2(&zstrm.strm, 15+32);
+
+	if (ret != Z_OK) {
+		zerr_set(ret);
+
+		return NULL;
+	}
+
+	success = zio_open(vm, src, "r", &in);
+
+	if (success) {
+		success = zio_open(vm, dst, "w", &out);
+
+		if (success) {
+			success = zio_pump(vm, &zstrm, def, &in, &out, Z_FINISH,
+			                   progress, &nin, &nout);
+			success = zio_close(&out) && success;
+		}
+
+		zio_close(&in);
+	}
+
+	if (def)
+		(void)deflateEnd(&zstrm.strm);
+	else
+		(void)inflateEnd(&zstrm.strm);
+
+	free(zstrm.iobuf);
+
+	if (!success)
+		return NULL;
+
+	return ucv_uint64_new(nout);
+}
+
+/**
+ * Compresses a file or handle into another file or handle.
+ *
+ * Data is pumped natively from `src` to `dst` through a single zlib stream
+ * using reusable buffers, no intermediate chunk is passed through the script.
+ * Both `src` and `dst` may be file paths, `fs.file` or `fs.proc` handles,
+ * sockets or any value implementing a `fileno()` method. Paths are opened
+ * and closed by the function, handles are left open.
+ *
+ * The following options are recognized:
+ *  - `gzip` - produce gzip instead of Zlib output (default `false`)
+ *  - `level` - the compression level (default `Z_DEFAULT_COMPRESSION`)
+ *  - `progress` - function invoked after each chunk with the total number
+ *    of bytes read and written so far; returning `false` aborts
+ *
+ * Returns the number of compressed bytes written.
+ *
+ * Returns `null` if an error occurred.
+ *
+ * @function module:zlib#deflate_file
+ *
+ * @param {string|module:fs.file|module:socket.socket} src
+ * The input path or handle.
+ *
+ * @param {string|module:fs.file|module:socket.socket} dst
+ * The output path or handle.
+ *
+ * @param {?Object} [opts]
+ * Compression options.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * // gzip a log file
+ * deflate_file('/var/log/messages', '/tmp/messages.gz', { gzip: true });
+ *
+ * // stream a compressed file over a socket, reporting progress
+ * deflate_file(fs.open('/tmp/image.bin'), sock, {
+ *     progress: (nin, nout) => print(`${nin} -> ${nout}\n`)
+ * });
+ */
+static uc_value_t *
+uc_zlib_deflate_file(uc_vm_t *vm, size_t nargs)
+{
+	return uc_zlib_file_common(vm, nargs, true);
+}
+
+/**
+ * Decompresses a Zlib or gzip file or handle into another file or handle.
+ *
+ * Data is pumped natively from `src` to `dst` through a single zlib stream
+ * using reusable buffers, no intermediate chunk is passed through the script.
+ * Both `src` and `dst` may be file paths, `fs.file` or `fs.proc` handles,
+ * sockets or any value implementing a `fileno()` method. Paths are opened
+ * and closed by the function, handles are left open.
+ *
+ * The input is read until end of file. Concatenated streams, such as
+ * multi-member gzip files, are decompressed one after another.
+ *
+ * The following options are recognized:
+ *  - `progress` - function invoked after each chunk with the total number
+ *    of bytes read and written so far; returning `false` aborts
+ *
+ * Returns the number of decompressed bytes written.
+ *
+ * Returns `null` if an error occurred, including truncated input or trailing
+ * data which is not a valid stream.
+ *
+ * @function module:zlib#inflate_file
+ *
+ * @param {string|module:fs.file|module:socket.socket} src
+ * The input path or handle.
+ *
+ * @param {string|module:fs.file|module:socket.socket} dst
+ * The output path or handle.
+ *
+ * @param {?Object} [opts]
+ * Decompression options.
+ *
+ * @returns {?number}
+ *
+ * @example
+ * inflate_file('/tmp/messages.gz', '/tmp/messages');
+ */
+static uc_value_t *
+uc_zlib_inflate_file(uc_vm_t *vm, size_t nargs)
+{
+	return uc_zlib_file_common(vm, nargs, false);
+}
+
 static const uc_function_list_t strmd_fns[] = {
 	{ "write",	uc_zlib_defwrite },
 	{ "read",	uc_zlib_defread },
+	{ "pump",	uc_zlib_defpump },
 	{ "error",	uc_zlib_error },
 };
 
 static const uc_function_list_t strmi_fns[] = {
 	{ "write",	uc_zlib_infwrite },
 	{ "read",	uc_zlib_infread },
+	{ "pump",	uc_zlib_infpump },
 	{ "error",	uc_zlib_error },
 };
 
@@ -892,6 +1917,9 @@ static const uc_function_list_t global_fns[] = {
 	{ "inflate",	uc_zlib_inflate },
 	{ "deflater",	uc_zlib_deflater },
 	{ "inflater",	uc_zlib_inflater },
+	{ "deflate_file",	uc_zlib_deflate_file },
+	{ "inflate_file",	uc_zlib_inflate_file },
+	{ "error",	uc_zlib_error },
 };
 
 static void destroy_zstrmd(void *z)
@@ -901,6 +1929,7 @@ static void destroy_zstrmd(void *z)
 	if (zstrm) {
 		(void)deflateEnd(&zstrm->strm);
 		printbuf_free(zstrm->outbuf);
+		free(zstrm->iobuf);
 		free(zstrm);
 	}
 }
@@ -912,6 +1941,7 @@ static void destroy_zstrmi(void *z)
 	if (zstrm) {
 		(void)inflateEnd(&zstrm->strm);
 		printbuf_free(zstrm->outbuf);
+		free(zstrm->iobuf);
 		free(zstrm);
 	}
 }
@@ -1,3 +1,8 @@
+newoption {
+	trigger = "coverage",
+	description = "Record executed code, lcov tracefiles are appended to $UCODE_COVERAGE"
+}
+
 workspace "ucode"
     configurations { "Debug", "Release" }
     gccprefix ""
@@ -12,6 +17,11 @@ workspace "ucode"
 		buildoptions { "-flto"}
 		linkoptions { "-flto"}
 
+	filter "options:coverage"
+		defines { "UC_COVERAGE" }
+
+	filter {}
+
 -------------------------------
 project "ucode"
     kind "ConsoleApp"
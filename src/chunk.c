@@ -44,6 +44,8 @@ uc_chunk_init(uc_chunk_t *chunk)
 	chunk->debuginfo.variables.entries = NULL;
 
 	uc_vallist_init(&chunk->debuginfo.varnames);
+
+	chunk->coverage = NULL;
 }
 
 void
@@ -56,6 +58,8 @@ uc_chunk_free(uc_chunk_t *chunk)
 	uc_vector_clear(&chunk->debuginfo.variables);
 	uc_vallist_free(&chunk->debuginfo.varnames);
 
+	free(chunk->coverage);
+
 	uc_chunk_init(chunk);
 }
 
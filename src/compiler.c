@@ -22,6 +22,7 @@
 #include "source.h"
 #include "program.h"
 #include "lib.h" /* uc_error_context_format() */
+#include "probes.h"
 
 #ifndef NO_COMPILE
 
@@ -3588,6 +3589,8 @@ uc_compiler_compile_module(uc_compiler_t *compiler, const char *name, uc_value_t
 
 	path = uc_compiler_resolve_module_path(compiler, name);
 
+	UC_PROBE(import__resolve, name, path);
+
 	if (uc_compiler_is_dynlink_module(compiler, name, path)) {
 		res = uc_compiler_compile_dynload(compiler, name, imports);
 	}
@@ -3906,6 +3909,8 @@ uc_compile(uc_parse_config_t *config, uc_source_t *source, char **errp)
 	if (!config)
 		config = &uc_default_parse_config;
 
+	UC_PROBE(compile__start, source->filename);
+
 	switch (uc_source_type_test(source)) {
 	case UC_SOURCE_TYPE_PLAIN:
 		prog = uc_compile_from_source(config, source, NULL, errp);
@@ -3922,5 +3927,7 @@ uc_compile(uc_parse_config_t *config, uc_source_t *source, char **errp)
 		break;
 	}
 
+	UC_PROBE(compile__done, source->filename, prog != NULL);
+
 	return prog;
 }
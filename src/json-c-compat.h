@@ -23,6 +23,10 @@
 
 /* json-c compat */
 
+#ifndef JSON_C_OBJECT_ADD_CONSTANT_KEY
+#define JSON_C_OBJECT_ADD_CONSTANT_KEY JSON_C_OBJECT_KEY_IS_CONSTANT
+#endif
+
 #if 0
 #ifndef HAVE_PARSE_END
 static inline size_t json_tokener_get_parse_end(struct json_tokener *tok) {
@@ -54,6 +54,7 @@
 #include "source.h"
 #include "program.h"
 #include "platform.h"
+#include "probes.h"
 
 static void
 format_context_line(uc_stringbuf_t *buf, const char *line, size_t off, bool compact)
@@ -2288,12 +2289,14 @@ enum {
 	FMT_C_JSON = (1 << 6),
 };
 
-static void
-uc_printf_common(uc_vm_t *vm, size_t nargs, uc_stringbuf_t *buf)
+#define fmt_arg(n) ((n) < nargs ? args[n] : NULL)
+
+void
+uc_format_values(uc_vm_t *vm, uc_stringbuf_t *buf, uc_value_t **args, size_t nargs)
 {
 	char *s, sfmt[sizeof("%#0- +0123456789.0123456789%")];
 	uint32_t conv, flags, width, precision;
-	uc_value_t *fmt = uc_fn_arg(0), *arg;
+	uc_value_t *fmt = fmt_arg(0), *arg;
 	const char *fstr, *last, *p, *cfmt;
 	size_t argidx = 1, argpos, sfmtlen;
 	uint64_t u;
@@ -2493,7 +2496,7 @@ parse_precision:
 
 			case FMT_C_INT:
 				argidx++;
-				arg = uc_fn_arg(argpos);
+				arg = fmt_arg(argpos);
 				n = ucv_to_integer(arg);
 
 				if (errno == ERANGE)
@@ -2504,7 +2507,7 @@ parse_precision:
 
 			case FMT_C_UINT:
 				argidx++;
-				arg = uc_fn_arg(argpos);
+				arg = fmt_arg(argpos);
 				u = ucv_to_unsigned(arg);
 
 				if (errno == ERANGE)
@@ -2515,19 +2518,19 @@ parse_precision:
 
 			case FMT_C_DBL:
 				argidx++;
-				d = ucv_to_double(uc_fn_arg(argpos));
+				d = ucv_to_double(fmt_arg(argpos));
 				ucv_stringbuf_printf(buf, sfmt, d);
 				break;
 
 			case FMT_C_CHR:
 				argidx++;
-				n = ucv_to_integer(uc_fn_arg(argpos));
+				n = ucv_to_integer(fmt_arg(argpos));
 				ucv_stringbuf_printf(buf, sfmt, (int)n);
 				break;
 
 			case FMT_C_STR:
 				argidx++;
-				arg = uc_fn_arg(argpos);
+				arg = fmt_arg(argpos);
 
 				switch (ucv_type(arg)) {
 				case UC_STRING:
@@ -2549,7 +2552,7 @@ parse_precision:
 			case FMT_C_JSON:
 				argidx++;
 				s = ucv_to_jsonstring_formatted(vm,
-					uc_fn_arg(argpos),
+					fmt_arg(argpos),
 					precision > 0 ? (precision > 1 ? ' ' : '\t') : '\0',
 					precision > 0 ? (precision > 1 ? precision - 1 : 1) : 0);
 
@@ -2565,6 +2568,16 @@ parse_precision:
 	ucv_stringbuf_addstr(buf, last, p - last);
 }
 
+#undef fmt_arg
+
+static void
+uc_printf_common(uc_vm_t *vm, size_t nargs, uc_stringbuf_t *buf)
+{
+	uc_value_t **args = nargs ? &vm->stack.entries[vm->stack.count - nargs] : NULL;
+
+	uc_format_values(vm, buf, args, nargs);
+}
+
 /**
  * Formats the given arguments according to the given format string.
  *
@@ -2830,8 +2843,10 @@ uc_require_path(uc_vm_t *vm, const char *path_template, const char *name, uc_val
 	if (!strcmp(p + 1, ".uc") && !so_only)
 		rv = uc_require_ucode(vm, buf->buf, NULL, res, true);
 
-	if (rv)
+	if (rv) {
+		UC_PROBE(module__load, name, buf->buf);
 		ucv_object_add(modtable, name, ucv_get(*res));
+	}
 
 out:
 	printbuf_free(buf);
@@ -2859,16 +2874,23 @@ uc_require_library(uc_vm_t *vm, uc_value_t *nameval, bool so_only)
 		return NULL;
 	}
 
+	UC_PROBE(require__entry, name);
+
 	for (arridx = 0, arrlen = ucv_array_length(search); arridx < arrlen; arridx++) {
 		se = ucv_array_get(search, arridx);
 
 		if (ucv_type(se) != UC_STRING)
 			continue;
 
-		if (uc_require_path(vm, ucv_string_get(se), name, &res, so_only))
+		if (uc_require_path(vm, ucv_string_get(se), name, &res, so_only)) {
+			UC_PROBE(require__return, name, 1);
+
 			return res;
+		}
 	}
 
+	UC_PROBE(require__return, name, 0);
+
 	uc_vm_raise_exception(vm, EXCEPTION_RUNTIME,
 	                      "No module named '%s' could be found", name);
 
@@ -3965,6 +3987,8 @@ uc_render(uc_vm_t *vm, size_t nargs)
 	/* update uc_string_t length */
 	ustr->length = len - sizeof(*ustr);
 
+	ucv_account(&ustr->header);
+
 	return &ustr->header;
 
 out:
@@ -5507,6 +5531,12 @@ uc_hexdec(uc_vm_t *vm, size_t nargs)
  *            GC was previously started and is now stopped, `false` otherwise.
  * - `count` - Count the amount of active complex object references in the VM
  *             context, returns the counted amount.
+ * - `usage` - Returns an object with the `current` and `peak` amount of bytes
+ *             accounted to the VM context as well as the configured `limit`.
+ * - `limit` - Set the memory limit of the VM context to `argument` bytes,
+ *             `0` disables the limit. Returns the previous limit. Exceeding
+ *             the limit triggers a garbage collection cycle and, if usage
+ *             remains above the limit, a catchable runtime exception.
  *
  * If the `operation` argument is omitted, the default is `collect`.
  *
@@ -5518,20 +5548,24 @@ uc_hexdec(uc_vm_t *vm, size_t nargs)
  * @param {*} [argument]
  * The argument for the operation.
  *
- * @returns {?(boolean|number)}
+ * @returns {?(boolean|number|Object)}
  *
  * @example
  * gc();         // true
  * gc("start");  // true
  * gc("count");  // 42
+ * gc("limit", 16 * 1024 * 1024);  // 0
+ * gc("usage");  // { "current": 81432, "peak": 90112, "limit": 16777216 }
  */
 static uc_value_t *
 uc_gc(uc_vm_t *vm, size_t nargs)
 {
 	uc_value_t *operation = uc_fn_arg(0);
 	uc_value_t *argument = uc_fn_arg(1);
+	size_t current, peak, limit;
 	const char *op = NULL;
 	uc_weakref_t *ref;
+	uc_value_t *rv;
 	int64_t n;
 
 	if (operation != NULL && ucv_type(operation) != UC_STRING)
@@ -5564,6 +5598,30 @@ uc_gc(uc_vm_t *vm, size_t nargs)
 
 		return ucv_uint64_new(n);
 	}
+	else if (!strcmp(op, "usage")) {
+		uc_vm_memory_usage(vm, &current, &peak);
+
+		rv = ucv_object_new(vm);
+
+		ucv_object_add(rv, "current", ucv_uint64_new(current));
+		ucv_object_add(rv, "peak", ucv_uint64_new(peak));
+		ucv_object_add(rv, "limit", ucv_uint64_new(uc_vm_memory_limit_get(vm)));
+
+		return rv;
+	}
+	else if (!strcmp(op, "limit")) {
+		errno = 0;
+		n = argument ? ucv_int64_get(argument) : 0;
+
+		if (errno || n < 0)
+			return NULL;
+
+		limit = uc_vm_memory_limit_get(vm);
+
+		uc_vm_memory_limit_set(vm, n);
+
+		return ucv_uint64_new(limit);
+	}
 
 	return NULL;
 }
@@ -35,6 +35,8 @@ bool uc_source_context_format(uc_stringbuf_t *buf, uc_source_t *src, size_t off,
 __hidden bool uc_error_context_format(uc_stringbuf_t *buf, uc_source_t *src, uc_value_t *stacktrace, size_t off);
 __hidden void uc_error_message_indent(char **msg);
 
+void uc_format_values(uc_vm_t *vm, uc_stringbuf_t *buf, uc_value_t **args, size_t nargs);
+
 __hidden uc_value_t *uc_require_library(uc_vm_t *vm, uc_value_t *nameval, bool so_only);
 
 /* vm helper */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020-2021 Jo-Philipp Wich <jo@mein.io>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef UCODE_PROBES_H
+#define UCODE_PROBES_H
+
+/*
+ * Statically defined tracepoints of the "ucode" provider, usable with
+ * bpftrace, perf or systemtap, e.g.
+ *
+ *   bpftrace -p $PID -e 'usdt:*:ucode:function__entry {
+ *     printf("%s %s:%d\n", str(arg0), str(arg1), arg2); }'
+ *
+ * Probes are built when <sys/sdt.h> is available unless UC_NO_USDT is
+ * defined. Every probe has a semaphore which the tracer increments while
+ * attached, arguments which are expensive to compute, such as source lines,
+ * are only gathered if UC_PROBE_ENABLED() reports an attached tracer.
+ *
+ *   function__entry(name, file, line)
+ *   function__return(name, file, line)
+ *   native__entry(name)
+ *   native__return(name)
+ *   gc__start(final, allocations)
+ *   gc__done(final, freed, live)
+ *   require__entry(name)
+ *   require__return(name, found)
+ *   module__load(name, path)
+ *   import__resolve(name, path)
+ *   compile__start(file)
+ *   compile__done(file, success)
+ *   exception__raise(type, message, file, line)
+ */
+
+#if !defined(UC_NO_USDT) && defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  define UC_HAVE_USDT 1
+# endif
+#endif
+
+#ifdef UC_HAVE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#include "util.h"
+
+#define __uc_probes \
+	__uc_probe(function__entry) \
+	__uc_probe(function__return) \
+	__uc_probe(native__entry) \
+	__uc_probe(native__return) \
+	__uc_probe(gc__start) \
+	__uc_probe(gc__done) \
+	__uc_probe(require__entry) \
+	__uc_probe(require__return) \
+	__uc_probe(module__load) \
+	__uc_probe(import__resolve) \
+	__uc_probe(compile__start) \
+	__uc_probe(compile__done) \
+	__uc_probe(exception__raise)
+
+#undef __uc_probe
+#define __uc_probe(_name) \
+	extern __hidden unsigned short ucode_##_name##_semaphore;
+
+__uc_probes
+
+#define UC_PROBE_ENABLED(name) \
+	__builtin_expect(ucode_##name##_semaphore != 0, 0)
+
+#define UC_PROBE(name, ...) \
+	STAP_PROBEV(ucode, name, ##__VA_ARGS__)
+
+#else
+
+static inline void
+uc_probe_discard(int dummy, ...) {}
+
+/* keep arguments referenced so that disabled probes don't cause unused
+ * variable warnings, the call itself is never emitted */
+#define UC_PROBE_ENABLED(name) 0
+#define UC_PROBE(name, ...) \
+	do { if (0) uc_probe_discard(0, ##__VA_ARGS__); } while (0)
+
+#endif /* UC_HAVE_USDT */
+
+#endif /* UCODE_PROBES_H */
@@ -23,6 +23,7 @@
 
 #include "json-c-compat.h"
 
+#include "probes.h"
 #include "program.h"
 #include "types.h"
 #include "util.h"
@@ -30,6 +31,129 @@
 
 static char* uc_default_search_path[] = { "./*.dll" };
 
+static const uc_value_tracker_t* ucv_tracker;
+
+/* charge heap values to the VM running on this thread and report them to
+ * an installed allocation tracker */
+#define ucv_track_alloc( uv, size ) \
+	do { \
+		ucv_memory_account( (ssize_t)ucv_memsize( uv ) ); \
+		if( ucv_tracker ) { \
+			ucv_tracker->alloc( ( uv ), ( size ), ucv_tracker->ctx ); \
+		} \
+	} while( 0 )
+
+#define ucv_track_free( uv ) \
+	do { \
+		if( ucv_tracker ) { \
+			ucv_tracker->free( ( uv ), ucv_tracker->ctx ); \
+		} \
+	} while( 0 )
+
+void
+ucv_tracker_set( const uc_value_tracker_t* tracker )
+{
+	ucv_tracker = tracker;
+}
+
+/* Accounted size of array entry storage, derived from the element count
+ * only so that charges and discharges always match up. */
+static size_t
+ucv_array_memsize( size_t count )
+{
+	if( count == 0 ) {
+		return 0;
+	}
+
+	return uc_vector_capacity( UC_VECTOR_INIT_SIZE, count ) * sizeof( uc_value_t* );
+}
+
+/* Accounted size of a heap value. This is an approximation of the memory
+ * owned by the value, it must only depend on state which is accounted for
+ * whenever it changes. Object keys are charged on insertion, the backing
+ * storage of programs and sources is not accounted. */
+static size_t
+ucv_memsize( uc_value_t* uv )
+{
+	uc_resource_ext_t* res;
+	struct lh_entry* entry;
+	uc_object_t* object;
+	size_t size;
+
+	switch( uv->type ) {
+		case UC_STRING:
+			return sizeof( uc_string_t ) + ( (uc_string_t*)uv )->length + 1;
+
+		case UC_INTEGER:
+			return sizeof( uc_integer_t );
+
+		case UC_DOUBLE:
+			return sizeof( uc_double_t );
+
+		case UC_ARRAY:
+			return sizeof( uc_array_t ) + ucv_array_memsize( ( (uc_array_t*)uv )->count );
+
+		case UC_OBJECT:
+			object = (uc_object_t*)uv;
+			size = sizeof( uc_object_t ) + sizeof( struct lh_table ) +
+				   object->table->size * sizeof( struct lh_entry );
+
+			lh_foreach( object->table, entry )
+			{
+				if( !entry->k_is_constant ) {
+					size += strlen( lh_entry_k( entry ) ) + 1;
+				}
+			}
+
+			return size;
+
+		case UC_CLOSURE:
+			return sizeof( uc_closure_t ) +
+				   ( (uc_closure_t*)uv )->function->nupvals * sizeof( uc_upvalref_t* );
+
+		case UC_CFUNCTION:
+			return sizeof( uc_cfunction_t ) + strlen( ( (uc_cfunction_t*)uv )->name ) + 1;
+
+		case UC_REGEXP:
+			return sizeof( uc_regexp_t ) + strlen( ( (uc_regexp_t*)uv )->source ) + 1;
+
+		case UC_UPVALUE:
+			return sizeof( uc_upvalref_t );
+
+		case UC_RESOURCE:
+			if( !uv->ext_flag ) {
+				return sizeof( uc_resource_t );
+			}
+
+			res = (uc_resource_ext_t*)uv;
+
+			return sizeof( uc_resource_ext_t ) +
+				   res->uvcount * sizeof( uc_value_t* ) + res->datasize * 8;
+
+		default:
+			return 0;
+	}
+}
+
+static void
+ucv_memory_account( ssize_t delta )
+{
+	uc_vm_t* vm = uc_thread_context_get( )->memory_vm;
+
+	if( vm && delta ) {
+		uc_vm_memory_account( vm, delta );
+	}
+}
+
+void ucv_account( uc_value_t* uv )
+{
+	if( uv == NULL || (uintptr_t)uv & 3 ) {
+		return;
+	}
+
+	ucv_memory_account( (ssize_t)ucv_memsize( uv ) );
+}
+
 uc_parse_config_t uc_default_parse_config = {
 	.module_search_path = {
 		.count = ARRAY_SIZE( uc_default_search_path ),
@@ -298,6 +422,10 @@ void ucv_free( uc_value_t* uv, bool retain )
 
 	uv->mark = true;
 
+	/* discharge while the contents are intact, shells retained by the GC
+	 * account for nothing when they're eventually released */
+	ucv_memory_account( -(ssize_t)ucv_memsize( uv ) );
+
 	ref = NULL;
 
 	switch( uv->type ) {
@@ -416,6 +544,7 @@ void ucv_free( uc_value_t* uv, bool retain )
 			ucv_unref( ref );
 		}
 
+		ucv_track_free( uv );
 		free( uv );
 	}
 	else {
@@ -497,6 +626,8 @@ ucv_string_new_length( const char* str, size_t length )
 	ustr->length = length;
 	memcpy( ustr->str, str, length );
 
+	ucv_track_alloc( &ustr->header, sizeof( *ustr ) + length + 1 );
+
 	return &ustr->header;
 }
 
@@ -521,6 +652,8 @@ ucv_stringbuf_finish( uc_stringbuf_t* sb )
 
 	ustr->length = printbuf_length( sb ) - offsetof( uc_string_t, str );
 
+	ucv_track_alloc( &ustr->header, (size_t)sb->size );
+
 	free( sb );
 
 	return &ustr->header;
@@ -585,6 +718,8 @@ ucv_int64_new( int64_t n )
 	integer->header.ext_flag = 0;
 	integer->i.s64 = n;
 
+	ucv_track_alloc( &integer->header, sizeof( *integer ) );
+
 	return &integer->header;
 }
 
@@ -606,6 +741,8 @@ ucv_uint64_new( uint64_t n )
 	integer->header.ext_flag = 1;
 	integer->i.u64 = n;
 
+	ucv_track_alloc( &integer->header, sizeof( *integer ) );
+
 	return &integer->header;
 }
 
@@ -730,6 +867,8 @@ ucv_double_new( double d )
 	dbl->header.refcount = 1;
 	dbl->dbl = d;
 
+	ucv_track_alloc( &dbl->header, sizeof( *dbl ) );
+
 	return &dbl->header;
 }
 
@@ -792,6 +931,8 @@ ucv_array_new_length( uc_vm_t* vm, size_t length )
 	array->header.type = UC_ARRAY;
 	array->header.refcount = 1;
 
+	ucv_track_alloc( &array->header, sizeof( *array ) );
+
 	/* preallocate memory */
 	if( length ) {
 		uc_vector_extend( array, length );
@@ -865,6 +1006,9 @@ ucv_array_unshift( uc_value_t* uv, uc_value_t* item )
 
 	uc_vector_extend( array, 1 );
 
+	ucv_memory_account( (ssize_t)ucv_array_memsize( array->count + 1 ) -
+						(ssize_t)ucv_array_memsize( array->count ) );
+
 	for( i = ++array->count; i > 1; i-- ) {
 		array->entries[i - 1] = array->entries[i - 2];
 	}
@@ -937,6 +1081,10 @@ bool ucv_array_delete( uc_value_t* uv, size_t offset, size_t count )
 			 ( array->count - ( offset + count ) ) * sizeof( array->entries[0] ) );
 
 	uc_vector_reduce( array, count );
+
+	ucv_memory_account( (ssize_t)ucv_array_memsize( array->count - count ) -
+						(ssize_t)ucv_array_memsize( array->count ) );
+
 	array->count -= count;
 
 	return true;
@@ -952,6 +1100,10 @@ bool ucv_array_set( uc_value_t* uv, size_t index, uc_value_t* item )
 
 	if( index >= array->count ) {
 		uc_vector_extend( array, index + 1 - array->count );
+
+		ucv_memory_account( (ssize_t)ucv_array_memsize( index + 1 ) -
+							(ssize_t)ucv_array_memsize( array->count ) );
+
 		array->count = index + 1;
 	}
 	else {
@@ -1003,17 +1155,32 @@ ucv_free_object_entry( struct lh_entry* entry )
 		}
 	}
 
-	free( lh_entry_k( entry ) );
+	if( !entry->k_is_constant ) {
+		free( lh_entry_k( entry ) );
+	}
+
 	ucv_put( lh_entry_v( entry ) );
 }
 
 uc_value_t*
 ucv_object_new( uc_vm_t* vm )
+{
+	return ucv_object_new_length( vm, 0 );
+}
+
+uc_value_t*
+ucv_object_new_length( uc_vm_t* vm, size_t length )
 {
 	struct lh_table* table;
 	uc_object_t* object;
+	size_t size = 16;
 
-	table = lh_kchar_table_new( 16, ucv_free_object_entry );
+	/* size table to hold the expected entries without rehashing */
+	while( length >= size * LH_LOAD_FACTOR ) {
+		size *= 2;
+	}
+
+	table = lh_kchar_table_new( size, ucv_free_object_entry );
 
 	if( !table ) {
 		fprintf( stderr, "Out of memory\n" );
@@ -1025,6 +1192,8 @@ ucv_object_new( uc_vm_t* vm )
 	object->header.refcount = 1;
 	object->table = table;
 
+	ucv_track_alloc( &object->header, sizeof( *object ) );
+
 	if( vm ) {
 		ucv_ref( &vm->values, &object->ref );
 		vm->alloc_refs++;
@@ -1033,12 +1202,14 @@ ucv_object_new( uc_vm_t* vm )
 	return &object->header;
 }
 
-bool ucv_object_add( uc_value_t* uv, const char* key, uc_value_t* val )
+static bool
+ucv_object_add_common( uc_value_t* uv, const char* key, uc_value_t* val, bool constant )
 {
 	uc_object_t* object = (uc_object_t*)uv;
 	struct lh_entry* existing_entry;
 	uc_value_t* existing_value;
 	unsigned long hash;
+	size_t size;
 	void* k;
 
 	if( ucv_type( uv ) != UC_OBJECT || uv->ext_flag ) {
@@ -1070,14 +1241,21 @@ bool ucv_object_add( uc_value_t* uv, const char* key, uc_value_t* val )
 			}
 		}
 
-		k = xstrdup( key );
+		k = constant ? (void*)key : xstrdup( key );
+		size = object->table->size;
 
-		if( lh_table_insert_w_hash( object->table, k, val, hash, 0 ) != 0 ) {
-			free( k );
+		if( lh_table_insert_w_hash( object->table, k, val, hash,
+									constant ? JSON_C_OBJECT_ADD_CONSTANT_KEY : 0 ) != 0 ) {
+			if( !constant ) {
+				free( k );
+			}
 
 			return false;
 		}
 
+		ucv_memory_account( ( object->table->size - size ) * sizeof( struct lh_entry ) +
+							( constant ? 0 : strlen( key ) + 1 ) );
+
 		/* restore affected iterator state pointer after rehash */
 		if( rehash ) {
 			uc_list_foreach( item, &uc_thread_context_get( )->object_iterators )
@@ -1112,6 +1290,18 @@ bool ucv_object_add( uc_value_t* uv, const char* key, uc_value_t* val )
 	return true;
 }
 
+bool ucv_object_add( uc_value_t* uv, const char* key, uc_value_t* val )
+{
+	return ucv_object_add_common( uv, key, val, false );
+}
+
+/* Add an entry without copying the key; the caller must ensure that the
+ * key string stays valid for the entire lifetime of the object. */
+bool ucv_object_add_static( uc_value_t* uv, const char* key, uc_value_t* val )
+{
+	return ucv_object_add_common( uv, key, val, true );
+}
+
 typedef struct {
 	int ( *cmp )( const void*, const void* );
 	int ( *cmpr )( const char*, uc_value_t*, const char*, uc_value_t*, void* );
@@ -1198,12 +1388,23 @@ void ucv_object_sort( uc_value_t* uv, int ( *cmp )( const void*, const void* ) )
 bool ucv_object_delete( uc_value_t* uv, const char* key )
 {
 	uc_object_t* object = (uc_object_t*)uv;
+	struct lh_entry* entry;
 
 	if( ucv_type( uv ) != UC_OBJECT || uv->ext_flag ) {
 		return false;
 	}
 
-	return ( lh_table_delete( object->table, key ) == 0 );
+	entry = lh_table_lookup_entry( object->table, key );
+
+	if( entry == NULL ) {
+		return false;
+	}
+
+	if( !entry->k_is_constant ) {
+		ucv_memory_account( -(ssize_t)( strlen( lh_entry_k( entry ) ) + 1 ) );
+	}
+
+	return ( lh_table_delete_entry( object->table, entry ) == 0 );
 }
 
 uc_value_t*
@@ -1262,6 +1463,8 @@ ucv_cfunction_new( const char* name, uc_cfn_ptr_t fptr )
 
 	cfn->cfn = fptr;
 
+	ucv_track_alloc( &cfn->header, sizeof( *cfn ) + namelen + 1 );
+
 	return &cfn->header;
 }
 
@@ -1277,6 +1480,8 @@ ucv_closure_new( uc_vm_t* vm, uc_function_t* function, bool arrow_fn )
 	closure->is_arrow = arrow_fn;
 	closure->upvals = function->nupvals ? (uc_upvalref_t**)( (uintptr_t)closure + ALIGN( sizeof( *closure ) ) ) : NULL;
 
+	ucv_track_alloc( &closure->header, sizeof( *closure ) + ( sizeof( uc_upvalref_t* ) * function->nupvals ) );
+
 	if( vm ) {
 		ucv_ref( &vm->values, &closure->ref );
 		vm->alloc_refs++;
@@ -1334,6 +1539,8 @@ ucv_resource_new( uc_resource_type_t* type, void* data )
 	res->type = type;
 	res->data = data;
 
+	ucv_track_alloc( &res->header, sizeof( *res ) );
+
 	return &res->header;
 }
 
@@ -1361,6 +1568,8 @@ ucv_resource_new_ex( uc_vm_t* vm, uc_resource_type_t* type, void** data, size_t
 		*data = res + 1;
 	}
 
+	ucv_track_alloc( &res->header, size );
+
 	if( vm && uvcount ) {
 		ucv_ref_tail( &vm->values, &res->ref );
 		vm->alloc_refs++;
@@ -1445,6 +1654,70 @@ bool ucv_resource_value_set( uc_value_t* uv, size_t idx, uc_value_t* val )
 	return true;
 }
 
+/* Raw byte access to strings and to resources exposing uc_bytes_ops_t;
+ * like ucv_string_get(), the returned pointer may point into *uv itself */
+char*
+_ucv_bytes_get( uc_value_t** uv, size_t* len )
+{
+	uc_resource_type_t* restype;
+
+	if( ucv_type( *uv ) == UC_STRING ) {
+		*len = ucv_string_length( *uv );
+
+		return _ucv_string_get( uv );
+	}
+
+	if( ucv_type( *uv ) != UC_RESOURCE ) {
+		return NULL;
+	}
+
+	restype = ucv_resource_type( *uv );
+
+	if( !restype || !restype->bytes || !restype->bytes->data ) {
+		return NULL;
+	}
+
+	return restype->bytes->data( *uv, len );
+}
+
+char*
+ucv_bytes_reserve( uc_vm_t* vm, uc_value_t* uv, size_t len )
+{
+	uc_resource_type_t* restype;
+
+	if( ucv_type( uv ) != UC_RESOURCE ) {
+		return NULL;
+	}
+
+	restype = ucv_resource_type( uv );
+
+	if( !restype || !restype->bytes || !restype->bytes->reserve ) {
+		return NULL;
+	}
+
+	return restype->bytes->reserve( vm, uv, len );
+}
+
+bool
+ucv_bytes_commit( uc_value_t* uv, size_t len )
+{
+	uc_resource_type_t* restype;
+
+	if( ucv_type( uv ) != UC_RESOURCE ) {
+		return false;
+	}
+
+	restype = ucv_resource_type( uv );
+
+	if( !restype || !restype->bytes || !restype->bytes->commit ) {
+		return false;
+	}
+
+	restype->bytes->commit( uv, len );
+
+	return true;
+}
+
 uc_value_t*
 ucv_regexp_new( const char* pattern, bool icase, bool newline, bool global, char** error )
 {
@@ -1483,6 +1756,8 @@ ucv_regexp_new( const char* pattern, bool icase, bool newline, bool global, char
 		return NULL;
 	}
 
+	ucv_track_alloc( &re->header, sizeof( *re ) + strlen( pattern ) + 1 );
+
 	return &re->header;
 }
 
@@ -1496,6 +1771,8 @@ ucv_upvalref_new( size_t slot )
 	up->header.refcount = 1;
 	up->slot = slot;
 
+	ucv_track_alloc( &up->header, sizeof( *up ) );
+
 	return &up->header;
 }
 
@@ -2550,6 +2827,7 @@ uc_value_t*
 ucv_key_get( uc_vm_t* vm, uc_value_t* scope, uc_value_t* key )
 {
 	uc_value_t *o, *v = NULL;
+	uc_resource_type_t* restype;
 	bool found = false;
 	uc_upvalref_t* ref;
 	int64_t idx;
@@ -2583,6 +2861,17 @@ ucv_key_get( uc_vm_t* vm, uc_value_t* scope, uc_value_t* key )
 			}
 		}
 
+		if( !found && ucv_type( scope ) == UC_RESOURCE ) {
+			restype = ucv_resource_type( scope );
+
+			if( restype && restype->get ) {
+				v = restype->get( vm, scope, k ? k : ucv_string_get( key ) );
+				free( k );
+
+				return v;
+			}
+		}
+
 		free( k );
 	}
 
@@ -2666,7 +2955,7 @@ ucv_gc_common( uc_vm_t* vm, bool final )
 {
 	uc_weakref_t *ref, *tmp;
 	uc_value_t* val;
-	size_t i;
+	size_t i, live = 0, freed = 0, allocs = vm->alloc_refs;
 
 	vm->alloc_refs = 0;
 
@@ -2675,6 +2964,8 @@ ucv_gc_common( uc_vm_t* vm, bool final )
 		return;
 	}
 
+	UC_PROBE( gc__start, final, allocs );
+
 	if( !final ) {
 		/* mark reachable objects */
 		ucv_gc_mark( vm->globals );
@@ -2721,9 +3012,11 @@ ucv_gc_common( uc_vm_t* vm, bool final )
 
 		if( ucv_is_marked( val ) ) {
 			ucv_clear_mark( val );
+			live++;
 		}
 		else {
 			ucv_free( val, true );
+			freed++;
 		}
 	}
 
@@ -2733,18 +3026,29 @@ ucv_gc_common( uc_vm_t* vm, bool final )
 
 		if( val->type == UC_NULL ) {
 			ucv_unref( ref );
+			ucv_track_free( val );
 			free( val );
 		}
 	}
+
+	UC_PROBE( gc__done, final, freed, live );
 }
 
 void ucv_gc( uc_vm_t* vm )
 {
+	uint64_t start = uc_vm_clock_ns();
+
 	ucv_gc_common( vm, false );
+
+	uc_vm_histogram_observe( &vm->stats.gc, uc_vm_clock_ns() - start );
 }
 
 void ucv_freeall( uc_vm_t* vm )
 {
+	if( ucv_tracker && ucv_tracker->teardown ) {
+		ucv_tracker->teardown( vm, ucv_tracker->ctx );
+	}
+
 	ucv_gc_common( vm, true );
 }
 
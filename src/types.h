@@ -104,6 +104,8 @@ typedef struct {
 		uc_value_list_t varnames;
 		uc_offsetinfo_t offsets;
 	} debuginfo;
+	/* executed basic block bitmap, only maintained in UC_COVERAGE builds */
+	uint8_t *coverage;
 } uc_chunk_t;
 
 
@@ -192,10 +194,21 @@ typedef struct {
 	char name[];
 } uc_cfunction_t;
 
+/* Optional raw byte access for resource types wrapping binary data */
+typedef struct {
+	char *(*data)(uc_value_t *, size_t *);
+	char *(*reserve)(uc_vm_t *, uc_value_t *, size_t);
+	void (*commit)(uc_value_t *, size_t);
+} uc_bytes_ops_t;
+
 typedef struct {
 	const char *name;
 	uc_value_t *proto;
 	void (*free)(void *);
+	const uc_bytes_ops_t *bytes;
+	/* Optional lookup of properties not found in the prototype, returns
+	 * a new reference; used by resources with lazily computed members */
+	uc_value_t *(*get)(uc_vm_t *, uc_value_t *, const char *);
 } uc_resource_type_t;
 
 typedef struct {
@@ -236,6 +249,7 @@ typedef struct {
 
 uc_declare_vector(uc_sources_t, uc_source_t *);
 uc_declare_vector(uc_modexports_t, uc_upvalref_t *);
+uc_declare_vector(uc_programs_t, struct uc_program *);
 
 typedef struct uc_program {
 	uc_value_t header;
@@ -286,6 +300,9 @@ typedef struct {
 
 	/* Object iteration */
 	uc_list_t object_iterators;
+
+	/* VM charged for value allocations */
+	uc_vm_t *memory_vm;
 } uc_thread_context_t;
 
 __hidden uc_thread_context_t *uc_thread_context_get(void);
@@ -323,6 +340,16 @@ uc_declare_vector(uc_stack_t, uc_value_t *);
 
 typedef struct printbuf uc_stringbuf_t;
 
+/* Latency histogram with fixed nanosecond bucket bounds, see
+ * uc_vm_histogram_bounds[] */
+#define UC_VM_HISTOGRAM_BUCKETS 10
+
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t buckets[UC_VM_HISTOGRAM_BUCKETS];
+} uc_vm_histogram_t;
+
 typedef void (uc_exception_handler_t)(uc_vm_t *, uc_exception_t *);
 
 struct uc_vm {
@@ -360,6 +387,20 @@ struct uc_vm {
 #endif
 		int sigpipe[2];
 	} signal;
+	uc_programs_t coverage;
+	struct {
+		uint64_t insns;
+		uint64_t exceptions[EXCEPTION_EXIT + 1];
+		uc_vm_histogram_t gc;
+		uc_vm_histogram_t callbacks;
+	} stats;
+	struct {
+		size_t limit;
+		size_t threshold;
+		size_t current;
+		size_t peak;
+		bool pending;
+	} memory;
 };
 
 
@@ -417,8 +458,10 @@ bool ucv_array_set(uc_value_t *, size_t, uc_value_t *);
 size_t ucv_array_length(uc_value_t *);
 
 uc_value_t *ucv_object_new(uc_vm_t *);
+uc_value_t *ucv_object_new_length(uc_vm_t *, size_t);
 uc_value_t *ucv_object_get(uc_value_t *, const char *, bool *);
 bool ucv_object_add(uc_value_t *, const char *, uc_value_t *);
+bool ucv_object_add_static(uc_value_t *, const char *, uc_value_t *);
 void ucv_object_sort(uc_value_t *, int (*)(const void *, const void *));
 void ucv_object_sort_r(uc_value_t *, int (*)(const char *, uc_value_t *, const char *, uc_value_t *, void *), void *);
 bool ucv_object_delete(uc_value_t *, const char *);
@@ -450,6 +493,11 @@ void **ucv_resource_dataptr(uc_value_t *, const char *);
 uc_value_t *ucv_resource_value_get(uc_value_t *, size_t);
 bool ucv_resource_value_set(uc_value_t *, size_t, uc_value_t *);
 
+char *_ucv_bytes_get(uc_value_t **, size_t *);
+#define ucv_bytes_get(uv, len) _ucv_bytes_get((uc_value_t **)&uv, len)
+char *ucv_bytes_reserve(uc_vm_t *, uc_value_t *, size_t);
+bool ucv_bytes_commit(uc_value_t *, size_t);
+
 static inline uc_resource_type_t *
 ucv_resource_type(uc_value_t *uv)
 {
@@ -675,4 +723,23 @@ void ucv_gc(uc_vm_t *);
 
 __hidden void ucv_freeall(uc_vm_t *);
 
+
+/* Value allocation tracking, used by debugging facilities. The alloc and
+ * free callbacks are invoked for every heap allocated value, on the thread
+ * performing the operation, the teardown callback before a VM releases all
+ * its values. */
+
+typedef struct {
+	void (*alloc)(uc_value_t *, size_t, void *);
+	void (*free)(uc_value_t *, void *);
+	void (*teardown)(uc_vm_t *, void *);
+	void *ctx;
+} uc_value_tracker_t;
+
+void ucv_tracker_set(const uc_value_tracker_t *);
+
+/* Charge a value which was not created by one of the ucv_*_new()
+ * constructors to the memory accounting of the running VM. */
+void ucv_account(uc_value_t *);
+
 #endif /* UCODE_TYPES_H */
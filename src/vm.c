@@ -28,6 +28,15 @@
 #include "program.h"
 #include "lib.h" /* uc_error_context_format() */
 #include "platform.h"
+#include "probes.h"
+
+#ifdef UC_HAVE_USDT
+#undef __uc_probe
+#define __uc_probe(_name) \
+	unsigned short ucode_##_name##_semaphore __attribute__((section(".probes")));
+
+__uc_probes
+#endif
 
 #undef __insn
 #define __insn(_name) #_name,
@@ -107,6 +116,426 @@ uc_vm_insn_to_argtype(uc_vm_insn_t insn)
 	return insn_operand_bytes[insn];
 }
 
+#ifdef UC_COVERAGE
+/* Coverage builds record one bit per entered basic block: the first
+ * instruction of every called function, the instruction following each
+ * executed jump and exception handler targets. Blocks only reached by falling
+ * through from a preceding block are inferred when writing the report. */
+
+#define coverage_bit(map, off) ((map)[(off) / 8] & (1u << ((off) % 8)))
+#define coverage_set(map, off) ((map)[(off) / 8] |= (1u << ((off) % 8)))
+
+static void
+uc_vm_coverage_mark(uc_callframe_t *frame, uc_chunk_t *chunk)
+{
+	coverage_set(chunk->coverage, (size_t)(frame->ip - chunk->entries));
+}
+
+static void
+uc_vm_coverage_enter(uc_vm_t *vm, uc_callframe_t *frame)
+{
+	uc_function_t *function = frame->closure->function;
+	uc_program_t *program = function->program;
+	size_t i;
+
+	if (!function->chunk.coverage) {
+		function->chunk.coverage = xalloc(function->chunk.count / 8 + 1);
+
+		for (i = 0; i < vm->coverage.count; i++)
+			if (vm->coverage.entries[i] == program)
+				break;
+
+		if (i == vm->coverage.count)
+			uc_vector_push(&vm->coverage,
+				(uc_program_t *)ucv_get(&program->header));
+	}
+
+	uc_vm_coverage_mark(frame, &function->chunk);
+}
+
+typedef struct {
+	size_t line, block;
+	int taken, nottaken;
+} uc_coverage_branch_t;
+
+uc_declare_vector(uc_coverage_lines_t, uint8_t);
+uc_declare_vector(uc_coverage_branches_t, uc_coverage_branch_t);
+
+static bool
+uc_vm_coverage_jump_target(uc_chunk_t *chunk, size_t off, size_t *target)
+{
+	uint8_t *p = chunk->entries + off + 1;
+	int64_t addr;
+
+	if (chunk->entries[off] != I_JMP && chunk->entries[off] != I_JMPZ &&
+	    chunk->entries[off] != I_JMPNT)
+		return false;
+
+	if (off + 5 > chunk->count)
+		return false;
+
+	addr = ((uint32_t)p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+
+	if (chunk->entries[off] == I_JMPNT)
+		addr = (addr & 0xffff) - 0x7fff;
+	else
+		addr -= 0x7fffffff;
+
+	if ((int64_t)off + addr < 0 || (int64_t)off + addr >= (int64_t)chunk->count)
+		return false;
+
+	*target = off + addr;
+
+	return true;
+}
+
+static size_t
+uc_vm_coverage_line(uc_function_t *function, uc_source_t *source, size_t off)
+{
+	size_t srcpos = uc_program_function_srcpos(function, off);
+
+	return uc_source_get_line(source, &srcpos);
+}
+
+static void
+uc_vm_coverage_function(uc_function_t *function, uc_source_t *source,
+                        uc_coverage_lines_t *lines,
+                        uc_coverage_branches_t *branches)
+{
+	uc_chunk_t *chunk = &function->chunk;
+	uint8_t *leaders, *map = chunk->coverage, insn, state;
+	size_t off, len, target, line = 0, srcpos, lastpos = (size_t)-1;
+	bool hit = false, fallthrough = false;
+
+	leaders = xalloc(chunk->count / 8 + 1);
+	coverage_set(leaders, 0);
+
+	for (off = 0; off < chunk->count; off += len) {
+		insn = chunk->entries[off];
+		len = 1 + abs(uc_vm_insn_to_argtype(insn));
+
+		if (uc_vm_coverage_jump_target(chunk, off, &target)) {
+			coverage_set(leaders, target);
+
+			if (off + len < chunk->count)
+				coverage_set(leaders, off + len);
+		}
+	}
+
+	for (off = 0; off < chunk->ehranges.count; off++)
+		if (chunk->ehranges.entries[off].target < chunk->count)
+			coverage_set(leaders, chunk->ehranges.entries[off].target);
+
+	for (off = 0; off < chunk->count; off += len) {
+		insn = chunk->entries[off];
+		len = 1 + abs(uc_vm_insn_to_argtype(insn));
+
+		/* a block counts as executed if it was entered through a jump or
+		 * call, or if the preceding executed block falls through into it */
+		if (coverage_bit(leaders, off))
+			hit = map && (coverage_bit(map, off) || (hit && fallthrough));
+
+		srcpos = uc_program_function_srcpos(function, off);
+
+		if (srcpos != lastpos) {
+			lastpos = srcpos;
+			line = uc_source_get_line(source, &srcpos);
+
+			while (line > 0 && lines->count <= line)
+				uc_vector_push(lines, 0);
+		}
+
+		if (line > 0) {
+			state = hit ? 2 : 1;
+
+			if (lines->entries[line] < state)
+				lines->entries[line] = state;
+		}
+
+		if ((insn == I_JMPZ || insn == I_JMPNT) && line > 0 &&
+		    uc_vm_coverage_jump_target(chunk, off, &target)) {
+			uc_vector_push(branches, {
+				.line = line,
+				.block = branches->count,
+				.taken = hit ? !!coverage_bit(map, target) : -1,
+				.nottaken = hit ? !!coverage_bit(map, off + len) : -1
+			});
+		}
+
+		fallthrough = (insn != I_JMP && insn != I_JMPZ &&
+		               insn != I_JMPNT && insn != I_RETURN);
+	}
+
+	free(leaders);
+}
+
+static void
+uc_vm_coverage_source(uc_program_t *program, size_t srcidx, FILE *fp)
+{
+	uc_source_t *source = program->sources.entries[srcidx];
+	uc_coverage_branches_t branches = { 0 };
+	uc_coverage_lines_t lines = { 0 };
+	size_t i, line, nfn = 0, nfnhit = 0, nhit = 0, nbrhit = 0;
+
+	fprintf(fp, "TN:\nSF:%s\n",
+		source->runpath ? source->runpath : source->filename);
+
+	uc_program_function_foreach(program, fn) {
+		if (fn->srcidx != srcidx)
+			continue;
+
+		line = uc_vm_coverage_line(fn, source, 0);
+
+		if (fn->name[0])
+			fprintf(fp, "FN:%zu,%s\n", line, fn->name);
+		else
+			fprintf(fp, "FN:%zu,anonymous@%zu\n", line, line);
+
+		if (fn->name[0])
+			fprintf(fp, "FNDA:%d,%s\n",
+				fn->chunk.coverage && coverage_bit(fn->chunk.coverage, 0),
+				fn->name);
+		else
+			fprintf(fp, "FNDA:%d,anonymous@%zu\n",
+				fn->chunk.coverage && coverage_bit(fn->chunk.coverage, 0),
+				line);
+
+		nfnhit += (fn->chunk.coverage && coverage_bit(fn->chunk.coverage, 0));
+		nfn++;
+
+		uc_vm_coverage_function(fn, source, &lines, &branches);
+	}
+
+	fprintf(fp, "FNF:%zu\nFNH:%zu\n", nfn, nfnhit);
+
+	for (i = 0; i < branches.count; i++) {
+		if (branches.entries[i].taken < 0) {
+			fprintf(fp, "BRDA:%zu,%zu,0,-\nBRDA:%zu,%zu,1,-\n",
+				branches.entries[i].line, branches.entries[i].block,
+				branches.entries[i].line, branches.entries[i].block);
+
+			continue;
+		}
+
+		fprintf(fp, "BRDA:%zu,%zu,0,%d\nBRDA:%zu,%zu,1,%d\n",
+			branches.entries[i].line, branches.entries[i].block,
+			branches.entries[i].taken,
+			branches.entries[i].line, branches.entries[i].block,
+			branches.entries[i].nottaken);
+
+		nbrhit += branches.entries[i].taken + branches.entries[i].nottaken;
+	}
+
+	fprintf(fp, "BRF:%zu\nBRH:%zu\n", branches.count * 2, nbrhit);
+
+	for (i = 1, line = 0; i < lines.count; i++) {
+		if (!lines.entries[i])
+			continue;
+
+		fprintf(fp, "DA:%zu,%d\n", i, lines.entries[i] - 1);
+		nhit += lines.entries[i] - 1;
+		line++;
+	}
+
+	fprintf(fp, "LF:%zu\nLH:%zu\nend_of_record\n", line, nhit);
+
+	uc_vector_clear(&branches);
+	uc_vector_clear(&lines);
+}
+#else
+#define uc_vm_coverage_mark(frame, chunk) do { } while (0)
+#define uc_vm_coverage_enter(vm, frame) do { } while (0)
+#endif
+
+/**
+ * Write the coverage collected so far in lcov tracefile format. Requires a
+ * build with UC_COVERAGE defined, returns false otherwise.
+ */
+bool
+uc_vm_coverage_write(uc_vm_t *vm, FILE *fp)
+{
+#ifdef UC_COVERAGE
+	uc_program_t *program;
+	size_t i, j;
+
+	for (i = 0; i < vm->coverage.count; i++) {
+		program = vm->coverage.entries[i];
+
+		for (j = 0; j < program->sources.count; j++)
+			uc_vm_coverage_source(program, j, fp);
+	}
+
+	fflush(fp);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void
+uc_vm_coverage_flush(uc_vm_t *vm)
+{
+	const char *path = vm->coverage.count ? getenv("UCODE_COVERAGE") : NULL;
+	FILE *fp;
+	size_t i;
+
+	/* appending lets consecutive interpreter runs, e.g. of a test suite,
+	 * accumulate into one tracefile; lcov merges repeated records */
+	if (path && *path) {
+		fp = fopen(path, "a");
+
+		if (fp) {
+			uc_vm_coverage_write(vm, fp);
+			fclose(fp);
+		}
+	}
+
+	for (i = 0; i < vm->coverage.count; i++)
+		ucv_put(&vm->coverage.entries[i]->header);
+
+	uc_vector_clear(&vm->coverage);
+}
+
+/* 10us, 100us, 1ms, 5ms, 10ms, 50ms, 100ms, 500ms, 1s, 5s */
+const uint64_t uc_vm_histogram_bounds[UC_VM_HISTOGRAM_BUCKETS] = {
+	10000ULL, 100000ULL, 1000000ULL, 5000000ULL, 10000000ULL,
+	50000000ULL, 100000000ULL, 500000000ULL, 1000000000ULL, 5000000000ULL
+};
+
+uint64_t
+uc_vm_clock_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+uc_vm_histogram_observe(uc_vm_histogram_t *hist, uint64_t ns)
+{
+	size_t i;
+
+	hist->count++;
+	hist->sum += ns;
+
+	for (i = 0; i < UC_VM_HISTOGRAM_BUCKETS; i++) {
+		if (ns <= uc_vm_histogram_bounds[i]) {
+			hist->buckets[i]++;
+			break;
+		}
+	}
+}
+
+/* Charge, or with a negative delta release, memory accounted to the given
+ * VM or to the VM running on the calling thread if none is given. Modules
+ * use this to account native buffers owned by their resources. */
+void
+uc_vm_memory_account(uc_vm_t *vm, ssize_t delta)
+{
+	if (!vm)
+		vm = uc_thread_context_get()->memory_vm;
+
+	if (!vm)
+		return;
+
+	if (delta < 0) {
+		if ((size_t)-delta > vm->memory.current)
+			vm->memory.current = 0;
+		else
+			vm->memory.current -= (size_t)-delta;
+
+		/* usage dropped back below the limit, withdraw the headroom
+		 * granted to exception handlers */
+		if (vm->memory.current <= vm->memory.limit)
+			vm->memory.threshold = vm->memory.limit;
+
+		return;
+	}
+
+	vm->memory.current += (size_t)delta;
+
+	if (vm->memory.current > vm->memory.peak)
+		vm->memory.peak = vm->memory.current;
+
+	/* GC and exceptions are deferred to the next instruction boundary, the
+	 * allocating code might hold values which aren't reachable yet */
+	if (vm->memory.limit && vm->memory.current > vm->memory.threshold)
+		vm->memory.pending = true;
+}
+
+void
+uc_vm_memory_limit_set(uc_vm_t *vm, size_t limit)
+{
+	vm->memory.limit = limit;
+	vm->memory.threshold = limit;
+	vm->memory.pending = (limit && vm->memory.current > limit);
+}
+
+size_t
+uc_vm_memory_limit_get(uc_vm_t *vm)
+{
+	return vm->memory.limit;
+}
+
+void
+uc_vm_memory_usage(uc_vm_t *vm, size_t *current, size_t *peak)
+{
+	if (current)
+		*current = vm->memory.current;
+
+	if (peak)
+		*peak = vm->memory.peak;
+}
+
+static uc_vm_t *
+uc_vm_memory_enter(uc_vm_t *vm)
+{
+	uc_thread_context_t *tctx = uc_thread_context_get();
+	uc_vm_t *prev = tctx->memory_vm;
+
+	tctx->memory_vm = vm;
+
+	return prev;
+}
+
+static void
+uc_vm_memory_leave(uc_vm_t *prev)
+{
+	uc_thread_context_get()->memory_vm = prev;
+}
+
+static uc_exception_type_t
+uc_vm_memory_enforce(uc_vm_t *vm)
+{
+	size_t limit = vm->memory.limit;
+
+	vm->memory.pending = false;
+
+	if (!limit || vm->memory.current <= vm->memory.threshold)
+		return EXCEPTION_NONE;
+
+	ucv_gc(vm);
+
+	if (vm->memory.current <= vm->memory.threshold)
+		return EXCEPTION_NONE;
+
+	/* let exception handlers allocate another quarter of the limit before
+	 * raising again */
+	if (limit + limit / 4 > limit)
+		vm->memory.threshold = limit + limit / 4;
+	else
+		vm->memory.threshold = SIZE_MAX;
+
+	uc_vm_raise_exception(vm, EXCEPTION_RUNTIME,
+		"Memory limit of %zu bytes exceeded", limit);
+
+	return vm->exception.type;
+}
+
 static void
 uc_vm_reset_stack(uc_vm_t *vm)
 {
@@ -231,6 +660,9 @@ uc_vm_signal_handlers_reset(uc_vm_t *vm)
 
 void uc_vm_init(uc_vm_t *vm, uc_parse_config_t *config)
 {
+	const char *env;
+	uc_vm_t *prev;
+
 	vm->exception.type = EXCEPTION_NONE;
 	vm->exception.message = NULL;
 
@@ -245,6 +677,17 @@ void uc_vm_init(uc_vm_t *vm, uc_parse_config_t *config)
 
 	vm->output = stdout;
 
+	vm->coverage.count = 0;
+	vm->coverage.entries = NULL;
+
+	memset(&vm->stats, 0, sizeof(vm->stats));
+	memset(&vm->memory, 0, sizeof(vm->memory));
+
+	prev = uc_vm_memory_enter(vm);
+
+	if ((env = getenv("UCODE_MEMORY_LIMIT")) != NULL)
+		uc_vm_memory_limit_set(vm, strtoull(env, NULL, 0));
+
 	uc_vm_reset_stack(vm);
 
 	uc_vm_alloc_global_scope(vm);
@@ -256,10 +699,13 @@ void uc_vm_init(uc_vm_t *vm, uc_parse_config_t *config)
 #if !defined( WIN32 ) && !defined(ESP32)
 	uc_vm_signal_handlers_setup(vm);
 #endif
+
+	uc_vm_memory_leave(prev);
 }
 
 void uc_vm_free(uc_vm_t *vm)
 {
+	uc_vm_t *prev = uc_vm_memory_enter(NULL);
 	uc_upvalref_t *ref;
 	size_t i;
 
@@ -267,6 +713,8 @@ void uc_vm_free(uc_vm_t *vm)
 	uc_vm_signal_handlers_reset(vm);
 #endif
 
+	uc_vm_coverage_flush(vm);
+
 	ucv_put(vm->exception.stacktrace);
 	free(vm->exception.message);
 
@@ -292,6 +740,9 @@ void uc_vm_free(uc_vm_t *vm)
 		free(vm->restypes.entries[i]);
 
 	uc_vector_clear(&vm->restypes);
+
+	if (prev != vm)
+		uc_vm_memory_leave(prev);
 }
 
 static uc_chunk_t *
@@ -318,6 +769,19 @@ uc_vm_current_frame(uc_vm_t *vm)
 	return uc_vector_last(&vm->callframes);
 }
 
+static const char *
+uc_vm_probe_location(uc_callframe_t *frame, size_t *line)
+{
+	uc_function_t *function = frame->closure->function;
+	uc_source_t *source = uc_program_function_source(function);
+	size_t off = frame->ip - function->chunk.entries;
+	size_t srcpos = uc_program_function_srcpos(function, off ? off - 1 : 0);
+
+	*line = uc_source_get_line(source, &srcpos);
+
+	return source->runpath ? source->runpath : source->filename;
+}
+
 static uc_program_t *
 uc_vm_current_program(uc_vm_t *vm)
 {
@@ -553,8 +1017,12 @@ uc_vm_call_native(uc_vm_t *vm, uc_value_t *ctx, uc_cfunction_t *fptr, bool mcall
 	if (vm->trace)
 		uc_vm_frame_dump(vm, frame);
 
+	UC_PROBE(native__entry, fptr->name);
+
 	res = fptr->cfn(vm, nargs);
 
+	UC_PROBE(native__return, fptr->name);
+
 	/* Reset stack, check for callframe depth since an uncatched exception in managed
 	 * code executed by fptr->cfn() could've reset the callframe stack already. */
 	if (vm->callframes.count > 0)
@@ -705,6 +1173,15 @@ uc_vm_call_function(uc_vm_t *vm, uc_value_t *ctx, uc_value_t *fno, bool mcall, s
 		.strict = function->strict
 	});
 
+	uc_vm_coverage_enter(vm, frame);
+
+	if (UC_PROBE_ENABLED(function__entry)) {
+		size_t line;
+		const char *file = uc_vm_probe_location(frame, &line);
+
+		UC_PROBE(function__entry, function->name, file, line);
+	}
+
 	if (vm->trace)
 		uc_vm_frame_dump(vm, frame);
 
@@ -935,6 +1412,8 @@ uc_vm_handle_exception(uc_vm_t *vm)
 
 		frame->ip = chunk->entries + chunk->ehranges.entries[i].target;
 
+		uc_vm_coverage_mark(frame, chunk);
+
 		return true;
 	}
 
@@ -1044,6 +1523,9 @@ uc_vm_raise_exception(uc_vm_t *vm, uc_exception_type_t type, const char *fmt, ..
 
 	vm->exception.type = type;
 
+	if (type <= EXCEPTION_EXIT)
+		vm->stats.exceptions[type]++;
+
 	free(vm->exception.message);
 
 	va_start(ap, fmt);
@@ -1052,6 +1534,21 @@ uc_vm_raise_exception(uc_vm_t *vm, uc_exception_type_t type, const char *fmt, ..
 
 	ucv_put(vm->exception.stacktrace);
 	vm->exception.stacktrace = uc_vm_get_error_context(vm);
+
+	if (UC_PROBE_ENABLED(exception__raise)) {
+		const char *file = NULL;
+		size_t i, line = 0;
+
+		for (i = vm->callframes.count; i > 0; i--) {
+			if (vm->callframes.entries[i - 1].closure) {
+				file = uc_vm_probe_location(&vm->callframes.entries[i - 1], &line);
+				break;
+			}
+		}
+
+		UC_PROBE(exception__raise, exception_type_strings[type],
+			vm->exception.message, file, line);
+	}
 }
 
 static bool
@@ -2252,6 +2749,8 @@ uc_vm_insn_jmp(uc_vm_t *vm, uc_vm_insn_t insn)
 	}
 
 	frame->ip += addr;
+
+	uc_vm_coverage_mark(frame, chunk);
 }
 
 static void
@@ -2274,6 +2773,8 @@ uc_vm_insn_jmpz(uc_vm_t *vm, uc_vm_insn_t insn)
 	if (!ucv_is_truish(v))
 		frame->ip += addr;
 
+	uc_vm_coverage_mark(frame, chunk);
+
 	ucv_put(v);
 }
 
@@ -2304,6 +2805,8 @@ uc_vm_insn_jmpnt(uc_vm_t *vm, uc_vm_insn_t insn)
 		uc_vm_stack_push(vm, NULL);
 		frame->ip += addr;
 	}
+
+	uc_vm_coverage_mark(frame, chunk);
 }
 
 
@@ -2338,6 +2841,8 @@ uc_vm_object_iterator_next(uc_vm_t *vm, uc_vm_insn_t insn,
 		res->header.refcount = 1;
 		res->type = &uc_vm_object_iterator_type;
 
+		ucv_account(&res->header);
+
 		iter = res->data = (char *)res + sizeof(*res);
 		iter->table = obj->table;
 		iter->u.pos = obj->table->head;
@@ -2730,6 +3235,13 @@ uc_vm_callframe_pop(uc_vm_t *vm)
 	if (frame->mcall)
 		ucv_put(uc_vm_stack_pop(vm));
 
+	if (frame->closure && UC_PROBE_ENABLED(function__return)) {
+		size_t line;
+		const char *file = uc_vm_probe_location(frame, &line);
+
+		UC_PROBE(function__return, frame->closure->function->name, file, line);
+	}
+
 	/* release function */
 	if (frame->closure)
 		ucv_put(&frame->closure->header);
@@ -2838,7 +3350,8 @@ uc_vm_execute_chunk(uc_vm_t *vm)
 			insn = uc_vm_decode_insn(vm, frame, chunk);
 		}
 
-		
+		vm->stats.insns++;
+
 		switch (insn) {
 		case I_LOAD:
 		case I_LOAD8:
@@ -3093,6 +3606,10 @@ exception:
 		/* run handler for signal(s) delivered during previous instruction */
 		if (uc_vm_signal_dispatch(vm) != EXCEPTION_NONE)
 			goto exception;
+
+		/* collect garbage or raise if the memory limit was exceeded */
+		if (vm->memory.pending && uc_vm_memory_enforce(vm) != EXCEPTION_NONE)
+			goto exception;
 	}
 
 	return STATUS_OK;
@@ -3101,6 +3618,7 @@ exception:
 uc_vm_status_t
 uc_vm_execute(uc_vm_t *vm, uc_program_t *program, uc_value_t **retval)
 {
+	uc_vm_t *prev = uc_vm_memory_enter(vm);
 	uc_function_t *fn = uc_program_entry(program);
 	uc_closure_t *closure = (uc_closure_t *)ucv_closure_new(vm, fn, false);
 	uc_vm_status_t status;
@@ -3115,6 +3633,15 @@ uc_vm_execute(uc_vm_t *vm, uc_program_t *program, uc_value_t **retval)
 		.strict = fn->strict
 	});
 
+	uc_vm_coverage_enter(vm, frame);
+
+	if (UC_PROBE_ENABLED(function__entry)) {
+		size_t line;
+		const char *file = uc_vm_probe_location(frame, &line);
+
+		UC_PROBE(function__entry, fn->name, file, line);
+	}
+
 	if (vm->trace) {
 		buf = xprintbuf_new();
 
@@ -3158,6 +3685,8 @@ uc_vm_execute(uc_vm_t *vm, uc_program_t *program, uc_value_t **retval)
 		break;
 	}
 
+	uc_vm_memory_leave(prev);
+
 	return status;
 }
 
@@ -3166,6 +3695,7 @@ uc_vm_call(uc_vm_t *vm, bool mcall, size_t nargs)
 {
 	uc_value_t *ctx = mcall ? ucv_get(uc_vm_stack_peek(vm, nargs + 1)) : NULL;
 	uc_value_t *fno = ucv_get(uc_vm_stack_peek(vm, nargs));
+	uc_vm_t *prev = uc_vm_memory_enter(vm);
 
 	uc_vm_clear_exception(vm);
 
@@ -3174,6 +3704,8 @@ uc_vm_call(uc_vm_t *vm, bool mcall, size_t nargs)
 			uc_vm_execute_chunk(vm);
 	}
 
+	uc_vm_memory_leave(prev);
+
 	return vm->exception.type;
 }
 
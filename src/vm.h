@@ -157,6 +157,18 @@ uc_value_t *uc_vm_exception_object(uc_vm_t *vm);
 uc_vm_status_t uc_vm_execute(uc_vm_t *vm, uc_program_t *fn, uc_value_t **retval);
 uc_value_t *uc_vm_invoke(uc_vm_t *vm, const char *fname, size_t nargs, ...);
 
+bool uc_vm_coverage_write(uc_vm_t *vm, FILE *fp);
+
+extern const uint64_t uc_vm_histogram_bounds[UC_VM_HISTOGRAM_BUCKETS];
+
+uint64_t uc_vm_clock_ns(void);
+void uc_vm_histogram_observe(uc_vm_histogram_t *hist, uint64_t ns);
+
+void uc_vm_memory_account(uc_vm_t *vm, ssize_t delta);
+void uc_vm_memory_limit_set(uc_vm_t *vm, size_t limit);
+size_t uc_vm_memory_limit_get(uc_vm_t *vm);
+void uc_vm_memory_usage(uc_vm_t *vm, size_t *current, size_t *peak);
+
 uc_exception_type_t uc_vm_signal_dispatch(uc_vm_t *vm);
 void uc_vm_signal_raise(uc_vm_t *vm, int signo);
 int uc_vm_signal_notifyfd(uc_vm_t *vm);
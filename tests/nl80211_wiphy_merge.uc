@@ -0,0 +1,145 @@
+// Replay benchmark of split wiphy dump assembly.
+//
+// Builds a synthetic split dump of several phys, each spreading its bands,
+// frequencies and supported commands over many fragments, and compares
+// replaying it through nl80211.decode(), which assembles the phys while
+// decoding, with decoding each fragment on its own followed by a deep merge
+// in ucode, the approach formerly used by request().
+//
+// Usage: ucode -L <libdir>/*.so tests/nl80211_wiphy_merge.uc [rounds] [phys]
+
+import * as nl80211 from 'nl80211';
+import * as struct from 'struct';
+
+const c = nl80211.const;
+const rounds = +(ARGV[0] ?? 50);
+const nphys = +(ARGV[1] ?? 4);
+
+const NLM_F_MULTI = 2, NLMSG_DONE = 3, GENL_ID = 0x1c;
+
+/* attribute numbers of linux/nl80211.h */
+const WIPHY = 1, WIPHY_NAME = 2, WIPHY_BANDS = 22, SUPPORTED_IFTYPES = 32, SUPPORTED_COMMANDS = 50;
+const BAND_FREQS = 1, BAND_HT_CAPA = 4, FREQ = 1, FREQ_DISABLED = 2;
+
+function nla(type, payload) {
+	const len = 4 + length(payload);
+
+	return struct.pack('=HH', len, type) + payload + substr('\x00\x00\x00', 0, (4 - len % 4) % 4);
+}
+
+const u16 = (type, v) => nla(type, struct.pack('=H', v));
+const u32 = (type, v) => nla(type, struct.pack('=I', v));
+const str = (type, s) => nla(type, s + '\x00');
+const flag = (type) => nla(type, '');
+const nest = (type, ...attrs) => nla(type, join('', attrs));
+
+let seq = 0;
+
+function genlmsg(...attrs) {
+	const payload = struct.pack('=BBH', c.NL80211_CMD_NEW_WIPHY, 1, 0) + join('', attrs);
+
+	return struct.pack('=IHHII', 16 + length(payload), GENL_ID, NLM_F_MULTI, ++seq, 0) + payload;
+}
+
+const done = struct.pack('=IHHIIi', 20, NLMSG_DONE, NLM_F_MULTI, ++seq, 0, 0);
+
+/* the kernel sends a few frequencies per fragment, mimic that */
+let fragments = [];
+
+for (let phy = 0; phy < nphys; phy++) {
+	push(fragments, genlmsg(u32(WIPHY, phy), str(WIPHY_NAME, `phy${phy}`),
+		nest(SUPPORTED_IFTYPES, flag(1), flag(2), flag(3), flag(6))));
+
+	for (let band = 0; band < 3; band++) {
+		push(fragments, genlmsg(u32(WIPHY, phy),
+			nest(WIPHY_BANDS, nest(band, u16(BAND_HT_CAPA, 0x1ff)))));
+
+		for (let f = 0; f < 64; f += 4) {
+			let freqs = [];
+
+			for (let i = f; i < f + 4; i++)
+				push(freqs, nest(i, u32(FREQ, 2412 + band * 2000 + i * 5),
+					...((i % 3) ? [] : [ flag(FREQ_DISABLED) ])));
+
+			push(fragments, genlmsg(u32(WIPHY, phy),
+				nest(WIPHY_BANDS, nest(band, nest(BAND_FREQS, ...freqs)))));
+		}
+	}
+
+	let cmds = [];
+
+	for (let i = 1; i <= 40; i++)
+		push(cmds, u32(i, i + 4));
+
+	push(fragments, genlmsg(u32(WIPHY, phy), nest(SUPPORTED_COMMANDS, ...cmds)));
+}
+
+const dump = join('', fragments) + done;
+
+function deep_merge(dest, src) {
+	if (type(dest) == 'array' && type(src) == 'array') {
+		for (let i = 0; i < length(src); i++) {
+			if (dest[i] == null)
+				dest[i] = src[i];
+			else if (type(src[i]) in [ 'array', 'object' ])
+				deep_merge(dest[i], src[i]);
+		}
+	}
+	else if (type(dest) == 'object' && type(src) == 'object') {
+		for (let k, v in src) {
+			if (!exists(dest, k))
+				dest[k] = v;
+			else if (type(v) in [ 'array', 'object' ])
+				deep_merge(dest[k], v);
+		}
+	}
+}
+
+function replay_merge() {
+	let phys = [];
+
+	for (let frag in fragments) {
+		let res = nl80211.decode(c.NL80211_CMD_GET_WIPHY, frag + done);
+
+		for (let i = 0; i < length(res); i++) {
+			if (res[i] == null)
+				continue;
+
+			if (phys[i] == null)
+				phys[i] = res[i];
+			else
+				deep_merge(phys[i], res[i]);
+		}
+	}
+
+	return phys;
+}
+
+function replay_incremental() {
+	return nl80211.decode(c.NL80211_CMD_GET_WIPHY, dump);
+}
+
+function elapsed_ms(fn) {
+	const t0 = clock(true);
+
+	for (let i = 0; i < rounds; i++)
+		fn();
+
+	const t1 = clock(true);
+
+	return ((t1[0] - t0[0]) * 1e9 + (t1[1] - t0[1])) / 1e6;
+}
+
+if (sprintf('%J', replay_merge()) != sprintf('%J', replay_incremental())) {
+	warn('Assembled phys differ between both methods\n');
+	exit(1);
+}
+
+printf('%d phys in %d fragments of %d bytes total, %d rounds\n',
+	nphys, length(fragments), length(dump), rounds);
+
+for (let method in [ [ 'deep merge', replay_merge ], [ 'incremental', replay_incremental ] ]) {
+	const ms = elapsed_ms(method[1]);
+
+	printf('%-12s %10.3f ms total %8.3f ms per dump\n', method[0], ms, ms / rounds);
+}